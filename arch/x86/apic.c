@@ -0,0 +1,599 @@
+#include <levos/kernel.h>
+#include <levos/arch.h>
+#include <levos/intr.h>
+#include <levos/page.h>
+#include <levos/smp.h>
+#include <levos/task.h>
+
+#include "apic.h"
+
+#define MODULE_NAME apic
+
+#define IA32_APIC_BASE_MSR  0x1B
+#define IA32_APIC_BASE_EN   (1 << 11)
+
+#define IOAPIC_REG_VER      0x01
+#define IOAPIC_REG_REDTBL   0x10
+
+#define IOAPIC_RED_LOW      (1 << 13)
+#define IOAPIC_RED_LEVEL    (1 << 15)
+#define IOAPIC_RED_MASKED   (1 << 16)
+
+/* MP specification 1.4 structures */
+struct mp_fps {
+    char     fps_sig[4];        /* "_MP_" */
+    uint32_t fps_config;
+    uint8_t  fps_length;
+    uint8_t  fps_rev;
+    uint8_t  fps_checksum;
+    uint8_t  fps_feature[5];
+} __packed;
+
+struct mp_config {
+    char     mpc_sig[4];        /* "PCMP" */
+    uint16_t mpc_length;
+    uint8_t  mpc_rev;
+    uint8_t  mpc_checksum;
+    char     mpc_oem[8];
+    char     mpc_product[12];
+    uint32_t mpc_oem_table;
+    uint16_t mpc_oem_size;
+    uint16_t mpc_entries;
+    uint32_t mpc_lapic;
+    uint16_t mpc_ext_length;
+    uint8_t  mpc_ext_checksum;
+    uint8_t  mpc_reserved;
+} __packed;
+
+#define MP_ENTRY_CPU    0
+#define MP_ENTRY_BUS    1
+#define MP_ENTRY_IOAPIC 2
+#define MP_ENTRY_INTSRC 3
+#define MP_ENTRY_LINT   4
+
+struct mp_cpu {
+    uint8_t  type;
+    uint8_t  apic_id;
+    uint8_t  apic_ver;
+#define MP_CPU_ENABLED  (1 << 0)
+#define MP_CPU_BSP      (1 << 1)
+    uint8_t  flags;
+    uint32_t signature;
+    uint32_t features;
+    uint32_t reserved[2];
+} __packed;
+
+struct mp_bus {
+    uint8_t  type;
+    uint8_t  bus_id;
+    char     bus_type[6];
+} __packed;
+
+struct mp_ioapic {
+    uint8_t  type;
+    uint8_t  id;
+    uint8_t  ver;
+    uint8_t  flags;
+    uint32_t addr;
+} __packed;
+
+struct mp_intsrc {
+    uint8_t  type;
+    uint8_t  irq_type;
+    uint16_t flags;
+    uint8_t  src_bus;
+    uint8_t  src_irq;
+    uint8_t  dst_ioapic;
+    uint8_t  dst_pin;
+} __packed;
+
+#define MP_INT_TYPE_INT 0
+
+#define MP_POLARITY(f)  ((f) & 3)
+#define MP_TRIGGER(f)   (((f) >> 2) & 3)
+
+struct mp_info mp_info;
+
+/* how each ISA IRQ reaches the IO APIC */
+struct isa_route {
+    int pin;
+    int level;
+    int low;
+};
+
+static struct isa_route isa_routes[16];
+
+#define MP_MAX_BUS 32
+static uint8_t mp_bus_is_pci[MP_MAX_BUS];
+
+static volatile uint32_t *lapic_base;
+static volatile uint32_t *ioapic_base;
+
+static int __ioapic_enabled;
+
+/* LAPIC timer counts (divided by 16) per PIT tick */
+static uint32_t lapic_timer_count;
+
+static inline uint64_t
+rdmsr(uint32_t msr)
+{
+    uint32_t lo, hi;
+    asm volatile("rdmsr" : "=a"(lo), "=d"(hi) : "c"(msr));
+    return ((uint64_t) hi << 32) | lo;
+}
+
+static inline void
+wrmsr(uint32_t msr, uint64_t val)
+{
+    asm volatile("wrmsr" :: "c"(msr), "a"((uint32_t) val),
+            "d"((uint32_t) (val >> 32)));
+}
+
+/* map a page of MMIO registers into the kernel, uncached */
+static void *
+apic_map_mmio(uint32_t phys)
+{
+    uint8_t *vaddr = kmap_map_page(PG_RND_DOWN(phys));
+    page_t *pte = get_page_from_pgd(kernel_pgd, (uint32_t) vaddr);
+
+    if (pte)
+        *pte |= 1 << PTE_CACHE_SHIFT;
+    __flush_tlb();
+
+    return vaddr + (phys & 0xfff);
+}
+
+/*
+ * mp_phys - get at physical memory the firmware left us
+ *
+ * The low 12 MB are mapped at VIRT_BASE, anything else gets two pages
+ * through kmap, which is plenty for the MP tables.
+ */
+static void *
+mp_phys(uint32_t phys)
+{
+    uint8_t *v1, *v2;
+
+    if (phys < 12 * 1024 * 1024 - 0x1000)
+        return (void *) (VIRT_BASE + phys);
+
+    v1 = kmap_map_page(PG_RND_DOWN(phys));
+    v2 = kmap_map_page(PG_RND_DOWN(phys) + 0x1000);
+    if (v2 != v1 + 0x1000)
+        return NULL;
+
+    return v1 + (phys & 0xfff);
+}
+
+static int
+mp_checksum(uint8_t *p, int len)
+{
+    uint8_t sum = 0;
+
+    while (len --)
+        sum += *p ++;
+
+    return sum;
+}
+
+static struct mp_fps *
+mp_scan(uint32_t phys, int len)
+{
+    uint8_t *p = (uint8_t *) (VIRT_BASE + phys);
+    uint8_t *end = p + len;
+
+    for (; p < end; p += 16) {
+        struct mp_fps *fps = (struct mp_fps *) p;
+
+        if (strncmp(fps->fps_sig, "_MP_", 4) == 0 &&
+                mp_checksum(p, fps->fps_length * 16) == 0)
+            return fps;
+    }
+
+    return NULL;
+}
+
+static struct mp_fps *
+mp_find_fps(void)
+{
+    struct mp_fps *fps;
+    uint32_t ebda = *(uint16_t *) (VIRT_BASE + 0x40E) << 4;
+    uint32_t basemem = *(uint16_t *) (VIRT_BASE + 0x413) * 1024;
+
+    if (ebda && (fps = mp_scan(ebda, 1024)))
+        return fps;
+
+    if (basemem && (fps = mp_scan(basemem - 1024, 1024)))
+        return fps;
+
+    return mp_scan(0xF0000, 0x10000);
+}
+
+static void
+mp_parse_intsrc(struct mp_intsrc *src)
+{
+    int pci, irq;
+    struct isa_route *route;
+
+    if (src->irq_type != MP_INT_TYPE_INT)
+        return;
+
+    pci = src->src_bus < MP_MAX_BUS && mp_bus_is_pci[src->src_bus];
+
+    /*
+     * PCI entries name the device and pin as the source, but on the PIIX
+     * the pin they end up on is the IRQ line the device reports in its
+     * config space, so treat the destination as that IRQ.
+     */
+    irq = pci ? src->dst_pin : src->src_irq;
+    if (irq >= 16)
+        return;
+
+    route = &isa_routes[irq];
+    route->pin = src->dst_pin;
+    route->low = pci;
+    route->level = pci;
+
+    if (MP_POLARITY(src->flags) == 1)
+        route->low = 0;
+    else if (MP_POLARITY(src->flags) == 3)
+        route->low = 1;
+
+    if (MP_TRIGGER(src->flags) == 1)
+        route->level = 0;
+    else if (MP_TRIGGER(src->flags) == 3)
+        route->level = 1;
+}
+
+/*
+ * mp_parse - find the CPUs and the IO APIC
+ *
+ * Returns 0 if we found what is needed to go SMP, -ENODEV otherwise.
+ */
+static int
+mp_parse(void)
+{
+    struct mp_fps *fps;
+    struct mp_config *cfg;
+    uint8_t *entry;
+    int i;
+
+    for (i = 0; i < 16; i ++) {
+        isa_routes[i].pin = i;
+        isa_routes[i].low = 0;
+        isa_routes[i].level = 0;
+    }
+
+    fps = mp_find_fps();
+    if (!fps || !fps->fps_config) {
+        mprintk("no MP configuration table\n");
+        return -ENODEV;
+    }
+
+    cfg = mp_phys(fps->fps_config);
+    if (!cfg || strncmp(cfg->mpc_sig, "PCMP", 4) != 0 ||
+            mp_checksum((uint8_t *) cfg, cfg->mpc_length) != 0) {
+        mprintk("MP configuration table is corrupt\n");
+        return -ENODEV;
+    }
+
+    mp_info.mp_lapic_phys = cfg->mpc_lapic;
+
+    entry = (uint8_t *) (cfg + 1);
+    for (i = 0; i < cfg->mpc_entries; i ++) {
+        switch (*entry) {
+            case MP_ENTRY_CPU: {
+                struct mp_cpu *cpu = (struct mp_cpu *) entry;
+
+                if (cpu->flags & MP_CPU_BSP)
+                    mp_info.mp_bsp_apic_id = cpu->apic_id;
+
+                if ((cpu->flags & MP_CPU_ENABLED) &&
+                        mp_info.mp_num_cpus < NR_CPUS)
+                    mp_info.mp_cpu_apic_ids[mp_info.mp_num_cpus ++] =
+                        cpu->apic_id;
+
+                entry += sizeof(struct mp_cpu);
+                break;
+            }
+            case MP_ENTRY_BUS: {
+                struct mp_bus *bus = (struct mp_bus *) entry;
+
+                if (bus->bus_id < MP_MAX_BUS)
+                    mp_bus_is_pci[bus->bus_id] =
+                        strncmp(bus->bus_type, "PCI", 3) == 0;
+
+                entry += sizeof(struct mp_bus);
+                break;
+            }
+            case MP_ENTRY_IOAPIC: {
+                struct mp_ioapic *io = (struct mp_ioapic *) entry;
+
+                /* we only drive the first one */
+                if ((io->flags & 1) && !mp_info.mp_ioapic_phys) {
+                    mp_info.mp_ioapic_phys = io->addr;
+                    mp_info.mp_ioapic_id = io->id;
+                }
+
+                entry += sizeof(struct mp_ioapic);
+                break;
+            }
+            case MP_ENTRY_INTSRC:
+                mp_parse_intsrc((struct mp_intsrc *) entry);
+                entry += sizeof(struct mp_intsrc);
+                break;
+            case MP_ENTRY_LINT:
+                entry += sizeof(struct mp_intsrc);
+                break;
+            default:
+                mprintk("unknown MP table entry %d\n", *entry);
+                return -ENODEV;
+        }
+    }
+
+    mprintk("MP table: %d CPU(s), LAPIC at 0x%x, IO APIC at 0x%x\n",
+            mp_info.mp_num_cpus, mp_info.mp_lapic_phys,
+            mp_info.mp_ioapic_phys);
+
+    return 0;
+}
+
+uint32_t
+lapic_read(uint32_t reg)
+{
+    return lapic_base[reg / 4];
+}
+
+void
+lapic_write(uint32_t reg, uint32_t val)
+{
+    lapic_base[reg / 4] = val;
+    /* wait for the write to land */
+    (void) lapic_base[LAPIC_ID / 4];
+}
+
+int
+lapic_id(void)
+{
+    return lapic_read(LAPIC_ID) >> 24;
+}
+
+static void
+lapic_eoi(void)
+{
+    lapic_write(LAPIC_EOI, 0);
+}
+
+void
+lapic_send_ipi(int apic_id, uint32_t icr)
+{
+    while (lapic_read(LAPIC_ICR_LO) & LAPIC_ICR_PENDING)
+        asm volatile("pause");
+
+    lapic_write(LAPIC_ICR_HI, apic_id << 24);
+    lapic_write(LAPIC_ICR_LO, icr);
+
+    while (lapic_read(LAPIC_ICR_LO) & LAPIC_ICR_PENDING)
+        asm volatile("pause");
+}
+
+/* bring up the local APIC of the calling CPU */
+void
+lapic_init_cpu(void)
+{
+    uint64_t base = rdmsr(IA32_APIC_BASE_MSR);
+
+    if (!(base & IA32_APIC_BASE_EN))
+        wrmsr(IA32_APIC_BASE_MSR, base | IA32_APIC_BASE_EN);
+
+    lapic_write(LAPIC_TPR, 0);
+    lapic_write(LAPIC_LVT_TIMER, LAPIC_LVT_MASKED);
+    lapic_write(LAPIC_LVT_ERR, LAPIC_LVT_MASKED);
+
+    /*
+     * Only the BSP takes the 8259 through LINT0, and not even that once
+     * the IO APIC is in charge.
+     */
+    if (this_cpu()->cpu_id != 0 || __ioapic_enabled)
+        lapic_write(LAPIC_LVT_LINT0, LAPIC_LVT_MASKED);
+
+    lapic_write(LAPIC_SVR, LAPIC_SVR_ENABLE | IRQ_VEC_SPURIOUS);
+    lapic_eoi();
+}
+
+static void
+lapic_spurious_irq(struct pt_regs *r)
+{
+    /* no EOI for these */
+}
+
+/* the scheduler tick of the application processors */
+static void
+lapic_timer_irq(struct pt_regs *r)
+{
+    sched_tick(r);
+}
+
+static int
+apic_wait_ticks(uint32_t ticks)
+{
+    extern volatile uint32_t __pit_ticks;
+    uint32_t start = __pit_ticks;
+    uint32_t spins = 0;
+
+    while (__pit_ticks - start < ticks) {
+        if (++ spins > 100000000)
+            return 0;
+        asm volatile("pause");
+    }
+
+    return 1;
+}
+
+/* count how fast the LAPIC timer runs against the PIT */
+static void
+lapic_timer_calibrate(void)
+{
+    uint32_t left;
+
+    lapic_write(LAPIC_TIMER_DCR, 0x3); /* divide by 16 */
+    lapic_write(LAPIC_LVT_TIMER, LAPIC_LVT_MASKED);
+
+    apic_wait_ticks(1);
+    lapic_write(LAPIC_TIMER_ICR, 0xFFFFFFFF);
+    apic_wait_ticks(10);
+    left = lapic_read(LAPIC_TIMER_CCR);
+    lapic_write(LAPIC_TIMER_ICR, 0);
+
+    lapic_timer_count = (0xFFFFFFFF - left) / 10;
+    mprintk("LAPIC timer: %d counts per tick\n", lapic_timer_count);
+}
+
+/* start the periodic tick on this CPU, at the rate of the PIT */
+void
+lapic_timer_start(void)
+{
+    lapic_write(LAPIC_TIMER_DCR, 0x3);
+    lapic_write(LAPIC_LVT_TIMER, LAPIC_TIMER_PERIODIC | IRQ_VEC_LAPIC_TIMER);
+    lapic_write(LAPIC_TIMER_ICR, lapic_timer_count);
+}
+
+/*
+ * stop the tick of an idle AP altogether, the BSP kicks it with an IPI
+ * when one of its sleepers is due
+ */
+void
+lapic_timer_stop(void)
+{
+    lapic_write(LAPIC_LVT_TIMER, LAPIC_LVT_MASKED | IRQ_VEC_LAPIC_TIMER);
+    lapic_write(LAPIC_TIMER_ICR, 0);
+}
+
+static uint32_t
+ioapic_read(uint32_t reg)
+{
+    ioapic_base[0] = reg;
+    return ioapic_base[4];
+}
+
+static void
+ioapic_write(uint32_t reg, uint32_t val)
+{
+    ioapic_base[0] = reg;
+    ioapic_base[4] = val;
+}
+
+static void
+ioapic_set_entry(int pin, uint32_t lo, int dest)
+{
+    ioapic_write(IOAPIC_REG_REDTBL + 2 * pin + 1, dest << 24);
+    ioapic_write(IOAPIC_REG_REDTBL + 2 * pin, lo);
+}
+
+static int
+ioapic_num_pins(void)
+{
+    return ((ioapic_read(IOAPIC_REG_VER) >> 16) & 0xff) + 1;
+}
+
+static void
+ioapic_mask_all(void)
+{
+    int pin, pins = ioapic_num_pins();
+
+    for (pin = 0; pin < pins; pin ++)
+        ioapic_set_entry(pin, IOAPIC_RED_MASKED, 0);
+}
+
+/*
+ * ioapic_setup - route the ISA IRQs through the IO APIC
+ *
+ * Vectors stay where the 8259 had them (0x20 + IRQ) so none of the drivers
+ * notice.  Everything is sent to the BSP, the drivers were written for a
+ * single CPU and their interrupt handlers are not ready to run in parallel.
+ */
+static void
+ioapic_setup(void)
+{
+    int irq, pins = ioapic_num_pins();
+    struct isa_route *route;
+    uint32_t lo;
+
+    ioapic_mask_all();
+
+    for (irq = 0; irq < 16; irq ++) {
+        route = &isa_routes[irq];
+
+        /* the cascade, never raised */
+        if (irq == 2 || route->pin >= pins)
+            continue;
+
+        lo = 0x20 + irq;
+        if (route->low)
+            lo |= IOAPIC_RED_LOW;
+        if (route->level)
+            lo |= IOAPIC_RED_LEVEL;
+
+        ioapic_set_entry(route->pin, lo, mp_info.mp_bsp_apic_id);
+    }
+}
+
+int
+apic_enabled(void)
+{
+    return __ioapic_enabled;
+}
+
+void
+arch_irq_eoi(int vec)
+{
+    if (vec >= 0x20 && vec < 0x30 && !__ioapic_enabled)
+        pic_eoi(vec);
+    else if (lapic_base)
+        lapic_eoi();
+}
+
+void
+apic_init(void)
+{
+    if (mp_parse())
+        return;
+
+    if (!mp_info.mp_lapic_phys)
+        return;
+
+    lapic_base = apic_map_mmio(mp_info.mp_lapic_phys);
+    mp_info.mp_bsp_apic_id = lapic_id();
+    this_cpu()->cpu_apic_id = mp_info.mp_bsp_apic_id;
+
+    intr_register_hw(IRQ_VEC_SPURIOUS, lapic_spurious_irq);
+    intr_register_hw(IRQ_VEC_LAPIC_TIMER, lapic_timer_irq);
+    intr_register_hw(IRQ_VEC_RESCHED, sched_resched_irq);
+
+    lapic_init_cpu();
+
+    if (mp_info.mp_ioapic_phys) {
+        ioapic_base = apic_map_mmio(mp_info.mp_ioapic_phys);
+
+        DISABLE_IRQ();
+        pic_disable();
+        __ioapic_enabled = 1;
+        lapic_write(LAPIC_LVT_LINT0, LAPIC_LVT_MASKED);
+        ioapic_setup();
+        ENABLE_IRQ();
+
+        /* if the timer does not come through, go back to the 8259 */
+        if (!apic_wait_ticks(2)) {
+            DISABLE_IRQ();
+            ioapic_mask_all();
+            __ioapic_enabled = 0;
+            lapic_write(LAPIC_LVT_LINT0, LAPIC_LVT_EXTINT);
+            pic_init();
+            ENABLE_IRQ();
+            mprintk("IO APIC routing does not work, using the 8259\n");
+        } else
+            mprintk("IO APIC %d routes the ISA IRQs\n", mp_info.mp_ioapic_id);
+    }
+
+    lapic_timer_calibrate();
+}
@@ -0,0 +1,57 @@
+#ifndef __LEVOS_X86_APIC_H
+#define __LEVOS_X86_APIC_H
+
+#include <levos/types.h>
+#include <levos/smp.h>
+
+/* local APIC registers, offsets from the LAPIC base */
+#define LAPIC_ID        0x020
+#define LAPIC_VER       0x030
+#define LAPIC_TPR       0x080
+#define LAPIC_EOI       0x0B0
+#define LAPIC_SVR       0x0F0
+#define LAPIC_ESR       0x280
+#define LAPIC_ICR_LO    0x300
+#define LAPIC_ICR_HI    0x310
+#define LAPIC_LVT_TIMER 0x320
+#define LAPIC_LVT_LINT0 0x350
+#define LAPIC_LVT_LINT1 0x360
+#define LAPIC_LVT_ERR   0x370
+#define LAPIC_TIMER_ICR 0x380
+#define LAPIC_TIMER_CCR 0x390
+#define LAPIC_TIMER_DCR 0x3E0
+
+#define LAPIC_SVR_ENABLE     (1 << 8)
+#define LAPIC_LVT_MASKED     (1 << 16)
+#define LAPIC_TIMER_PERIODIC (1 << 17)
+#define LAPIC_LVT_EXTINT     0x00000700
+
+#define LAPIC_ICR_FIXED      0x00000000
+#define LAPIC_ICR_INIT       0x00000500
+#define LAPIC_ICR_STARTUP    0x00000600
+#define LAPIC_ICR_PENDING    0x00001000
+#define LAPIC_ICR_ASSERT     0x00004000
+#define LAPIC_ICR_LEVEL      0x00008000
+
+/* what the MP configuration table told us about the machine */
+struct mp_info {
+    uint32_t mp_lapic_phys;
+    uint32_t mp_ioapic_phys;
+    int mp_ioapic_id;
+
+    int mp_num_cpus;
+    int mp_bsp_apic_id;
+    uint8_t mp_cpu_apic_ids[NR_CPUS];
+};
+
+extern struct mp_info mp_info;
+
+uint32_t lapic_read(uint32_t);
+void lapic_write(uint32_t, uint32_t);
+int lapic_id(void);
+void lapic_init_cpu(void);
+void lapic_timer_start(void);
+void lapic_timer_stop(void);
+void lapic_send_ipi(int, uint32_t);
+
+#endif /* __LEVOS_X86_APIC_H */
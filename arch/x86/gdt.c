@@ -1,10 +1,15 @@
 #include "gdt.h"
 #include "tss.h"
 #include <levos/kernel.h>
+#include <levos/smp.h>
 
 #include <stdint.h>
 
-static uint64_t gdt[SEL_CNT];
+/*
+ * Every CPU has its own GDT, so that the TSS and per-CPU selectors can be
+ * the same everywhere while pointing to that CPU's own structures.
+ */
+static uint64_t gdt[NR_CPUS][SEL_CNT];
 
 uint64_t
 make_seg_desc(uint32_t base,
@@ -49,26 +54,44 @@ make_gdtr_operand (uint16_t limit, void *base)
     return limit | ((uint64_t) (uint32_t) base << 16);
 }
 
+static uint64_t
+make_percpu_desc (int cpu)
+{
+    return make_seg_desc ((uint32_t) &cpus[cpu], sizeof(struct cpu) - 1,
+                          CLS_CODE_DATA, 2, 0, GRAN_BYTE);
+}
+
 void
-gdt_init(void)
+gdt_init_cpu(int cpu)
 {
     uint64_t gdtr_operand;
+    uint64_t *g = gdt[cpu];
 
     /* null descriptor */
-    gdt[SEL_NULL  / sizeof(*gdt)] = 0; /* 0x0 */
+    g[SEL_NULL  / sizeof(*g)] = 0; /* 0x0 */
 
     /* kernel descriptors */
-    gdt[SEL_KCSEG / sizeof(*gdt)] = make_code_desc (0); /* 0x8 */
-    gdt[SEL_KDSEG / sizeof(*gdt)] = make_data_desc (0); /* 0x10 */
+    g[SEL_KCSEG / sizeof(*g)] = make_code_desc (0); /* 0x8 */
+    g[SEL_KDSEG / sizeof(*g)] = make_data_desc (0); /* 0x10 */
 
     /* userspace descriptors */
-    gdt[SEL_UCSEG / sizeof(*gdt)] = make_code_desc (3); /* 0x18  / 0x1B*/
-    gdt[SEL_UDSEG / sizeof(*gdt)] = make_data_desc (3); /* 0x20  / 0x23*/
+    g[SEL_UCSEG / sizeof(*g)] = make_code_desc (3); /* 0x18  / 0x1B*/
+    g[SEL_UDSEG / sizeof(*g)] = make_data_desc (3); /* 0x20  / 0x23*/
 
     /* TSS */
-    gdt[SEL_TSS / sizeof(*gdt)] = make_tss_desc(tss_get());
+    g[SEL_TSS / sizeof(*g)] = make_tss_desc(tss_get_cpu(cpu));
+
+    /* per-CPU data */
+    g[SEL_PERCPU / sizeof(*g)] = make_percpu_desc(cpu); /* 0x30 */
 
-    gdtr_operand = make_gdtr_operand (sizeof(gdt) - 1, gdt);
+    gdtr_operand = make_gdtr_operand (sizeof(gdt[cpu]) - 1, g);
     asm volatile ("lgdt %0" : : "m" (gdtr_operand));
     asm volatile ("ltr %w0" : : "q" (SEL_TSS));
+    asm volatile ("movw %w0, %%fs" : : "q" (SEL_PERCPU));
+}
+
+void
+gdt_init(void)
+{
+    gdt_init_cpu(0);
 }
@@ -9,8 +9,9 @@
 #define SEL_UCSEG       0x1B    /* User code selector. */
 #define SEL_UDSEG       0x23    /* User data selector. */
 #define SEL_TSS         0x28    /* Task-state segment. */
+#define SEL_PERCPU      0x30    /* Per-CPU data segment (%fs). */
 
-#define SEL_CNT         6       /* Number of segments. */
+#define SEL_CNT         7       /* Number of segments. */
 
 enum seg_class
 {
@@ -27,6 +28,9 @@ enum seg_granularity
 void
 gdt_init(void);
 
+void
+gdt_init_cpu(int);
+
 uint64_t make_seg_desc(uint32_t,
               uint32_t,
               enum seg_class,
@@ -2,6 +2,7 @@
 #include <levos/arch.h>
 #include <levos/intr.h>
 #include <levos/task.h>
+#include <levos/softirq.h>
 
 #include "gdt.h"
 
@@ -15,8 +16,6 @@ void *intr_data[256];
 
 static intr_handler_func *intr_handlers[INTR_CNT];
 
-struct task *current_task;
-
 void
 __dump_code_at(uint8_t *ptr)
 {
@@ -112,7 +111,9 @@ handle_illop(struct pt_regs *regs)
 void
 intr_handler(struct pt_regs *regs)
 {
-    int external = regs->vec_no >= 0x20 && regs->vec_no < 0x30;
+    int external = (regs->vec_no >= 0x20 && regs->vec_no < 0x30) ||
+                   (regs->vec_no >= IRQ_VEC_LAPIC_TIMER &&
+                    regs->vec_no <= IRQ_VEC_RESCHED);
 
     if (regs->vec_no == 13)
         gpf(regs);
@@ -124,6 +125,9 @@ intr_handler(struct pt_regs *regs)
         return;
     }
 
+    if (external)
+        irq_enter(regs->vec_no);
+
     intr_handler_func *handler = intr_handlers[regs->vec_no];
     if (handler) {
         handler(regs);
@@ -131,8 +135,17 @@ intr_handler(struct pt_regs *regs)
         handle_unexpected_irq(regs);
     }
 
-	if (external)
-		pic_eoi(regs->vec_no);
+	if (external) {
+		arch_irq_eoi(regs->vec_no);
+
+		/* the bottom halves of what we just handled */
+		irq_exit();
+
+		/* an IRQ woke something that should run before us */
+		if (percpu_read(cpu_need_resched) && current_task &&
+				current_task->preempt_count == 0)
+			sched_preempt_irq(regs);
+	}
 }
 
 static uint64_t
@@ -213,19 +226,27 @@ intr_register_user(uint8_t vec_no, intr_handler_func *handler)
 }
 
 
+/* the IDT is shared by all CPUs, APs only need to load it */
+void
+idt_load(void)
+{
+    uint64_t idtr_operand;
+
+    idtr_operand = make_idtr_operand(sizeof(idt) - 1, idt);
+    asm volatile ("lidt %0" : : "m" (idtr_operand));
+}
+
 int
 idt_init(void)
 {
     int i;
-    uint64_t idtr_operand;
 
     pic_init();
 
     for (i = 0; i < INTR_CNT; i++)
         idt[i] = make_intr_gate(intr_stubs[i], 0);
 
-    idtr_operand = make_idtr_operand(sizeof(idt) - 1, idt);
-    asm volatile ("lidt %0" : : "m" (idtr_operand));
+    idt_load();
 
     return 0;
 }
@@ -2,5 +2,6 @@
 #define __LEVOS_X86_IDT_H
 
 extern int idt_init(void);
+extern void idt_load(void);
 
 #endif /* __LEVOS_X86_IDT_H */
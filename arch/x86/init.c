@@ -5,6 +5,7 @@
 #include <levos/syscall.h>
 #include <levos/task.h>
 #include <levos/multiboot.h>
+#include <levos/smp.h>
 
 #include <stdint.h>
 
@@ -49,25 +50,37 @@ enable_sse(void)
     */
 }
 
-static uint8_t saves[512] __attribute__((aligned(16)));
+static uint8_t saves[NR_CPUS][512] __attribute__((aligned(16)));
 
 void
 do_sse_save(struct task *task)
 {
-    asm volatile ("fxsave (%0)" :: "r"(saves));
-	memcpy(task->sse_save, &saves, 512);
+    uint8_t *save = saves[this_cpu()->cpu_id];
+
+    asm volatile ("fxsave (%0)" :: "r"(save));
+	memcpy(task->sse_save, save, 512);
 }
 
 void
 do_sse_restore(struct task *task)
 {
-	memcpy(&saves, task->sse_save, 512);
-    asm volatile ("fxrstor (%0)" :: "r"(saves));
+    uint8_t *save = saves[this_cpu()->cpu_id];
+
+	memcpy(save, task->sse_save, 512);
+    asm volatile ("fxrstor (%0)" :: "r"(save));
+}
+
+void
+arch_cpu_idle(void)
+{
+    asm volatile("sti; hlt");
 }
 
 void
 arch_early_init(uint32_t boot_sig, void *ptr)
 {
+    percpu_init(0);
+
     tss_init();
 
     gdt_init();
@@ -130,7 +143,6 @@ __prepare_system_call(struct pt_regs *regs)
     asm volatile ("mov %%esp, %0":"=r"(stack));
     //printk("syscall: using stack 0x%x 0x%x\n", stack, regs->esp);
 
-    extern struct task *current_task;
     current_task->sys_regs = regs;
     current_task->regs = regs;
     regs->eax = syscall_hub(no, a, b, c, d);
@@ -149,6 +161,7 @@ arch_late_init(void)
     asm volatile("movl $"__stringify(LEVOS_MAGIC)", %%eax; int $0x60":::"eax");
 
     intr_register_user(0x80, __prepare_system_call);
+    sysenter_init_cpu(0);
 
     serial_init();
 }
@@ -156,6 +169,10 @@ arch_late_init(void)
 void
 arch_very_late_init(void)
 {
+#ifdef CONFIG_SMP
+    apic_init();
+#endif
+
     ps2_keyboard_init();
 
     bga_init();
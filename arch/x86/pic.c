@@ -33,3 +33,11 @@ pic_eoi(int irq)
 
     outportb(0x20, 0x20);
 }
+
+/* mask everything, used once the IO APIC takes over */
+void
+pic_disable(void)
+{
+  outportb(PIC0_DATA, 0xff);
+  outportb(PIC1_DATA, 0xff);
+}
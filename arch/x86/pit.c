@@ -2,9 +2,13 @@
 #include <levos/types.h>
 #include <levos/intr.h>
 #include <levos/task.h>
+#include <levos/smp.h>
+#include <levos/time.h>
 
 #include <levos/x86.h>
 
+#include "apic.h"
+
 #define PIT_REG_COUNTER0 0x40
 #define PIT_REG_COUNTER1 0x41
 #define PIT_REG_COUNTER2 0x42
@@ -34,8 +38,19 @@
 #define PIT_OCW_COUNTER_1 0x40 //01000000
 #define PIT_OCW_COUNTER_2 0x80 //10000000
 
+#define PIT_HZ      HZ
+#define PIT_DIVISOR (1193181 / PIT_HZ)
+
+/* the longest one-shot the 16 bit counter can do */
+#define PIT_MAX_NOHZ_TICKS (0xFFFF / PIT_DIVISOR)
+
 volatile uint32_t __pit_ticks = 0;
 
+/* state of the one-shot while the BSP is tickless */
+static uint16_t pit_oneshot_count;
+static int pit_oneshot_fired;
+static uint32_t pit_nohz_residual;
+
 void
 pit_irq(struct pt_regs *r)
 {
@@ -45,7 +60,12 @@ pit_irq(struct pt_regs *r)
 void
 pit_sched_irq(struct pt_regs *r)
 {
-    __pit_ticks ++;
+    /* the ticks we skipped are accounted when the tick restarts */
+    if (this_cpu()->cpu_nohz)
+        pit_oneshot_fired = 1;
+    else
+        __pit_ticks ++;
+
     sched_tick(r);
 }
 
@@ -89,10 +109,92 @@ static void pit_start_counter(uint32_t freq, uint8_t counter, uint8_t mode) {
         __pit_send_data((divisor >> 8) & 0xff, 0);
 }
 
+/* count down COUNT and raise IRQ0 once */
+static void
+pit_start_oneshot(uint16_t count)
+{
+    __pit_send_cmd(PIT_OCW_MODE_TERMINALCOUNT | PIT_OCW_RL_DATA | PIT_OCW_COUNTER_0);
+    __pit_send_data(count & 0xff, 0);
+    __pit_send_data((count >> 8) & 0xff, 0);
+}
+
+static uint16_t
+pit_read_count(void)
+{
+    uint16_t count;
+
+    __pit_send_cmd(PIT_OCW_RL_LATCH | PIT_OCW_COUNTER_0);
+    count = __pit_read_data(PIT_OCW_COUNTER_0);
+    count |= __pit_read_data(PIT_OCW_COUNTER_0) << 8;
+
+    return count;
+}
+
+/*
+ * arch_timer_stop_tick - stop the periodic tick of this CPU
+ *
+ * @ticks - wake up after at most this many ticks, 0 if there is no deadline
+ *
+ * The BSP keeps time, so its PIT is switched to one-shot mode and may fire
+ * earlier than asked if the deadline is beyond what the counter can do.
+ * The APs stop their local APIC timer and rely on the BSP to wake them.
+ * Called with interrupts disabled.
+ */
+void
+arch_timer_stop_tick(uint32_t ticks)
+{
+    if (this_cpu()->cpu_id != 0) {
+        lapic_timer_stop();
+        return;
+    }
+
+    if (ticks == 0 || ticks > PIT_MAX_NOHZ_TICKS)
+        ticks = PIT_MAX_NOHZ_TICKS;
+
+    pit_oneshot_count = ticks * PIT_DIVISOR;
+    pit_oneshot_fired = 0;
+    pit_start_oneshot(pit_oneshot_count);
+}
+
+/*
+ * arch_timer_restart_tick - go back to the periodic tick
+ *
+ * On the BSP, this also brings __pit_ticks up to date with the time that
+ * passed while the tick was stopped.  Called with interrupts disabled.
+ */
+void
+arch_timer_restart_tick(void)
+{
+    uint32_t elapsed;
+    uint16_t left;
+
+    if (this_cpu()->cpu_id != 0) {
+        lapic_timer_start();
+        return;
+    }
+
+    /*
+     * after the terminal count the counter wraps, so don't trust it if
+     * the one-shot has (or might have, with interrupts off) fired
+     */
+    left = pit_read_count();
+    if (pit_oneshot_fired || left > pit_oneshot_count)
+        elapsed = pit_oneshot_count;
+    else
+        elapsed = pit_oneshot_count - left;
+
+    pit_start_counter(PIT_HZ, PIT_OCW_COUNTER_0, PIT_OCW_MODE_SQUAREWAVEGEN);
+
+    /* carry the partial tick over, so that we don't drift */
+    elapsed += pit_nohz_residual;
+    __pit_ticks += elapsed / PIT_DIVISOR;
+    pit_nohz_residual = elapsed % PIT_DIVISOR;
+}
+
 void pit_init(void)
 {
     intr_register_hw(32, pit_irq);
-    pit_start_counter(200,PIT_OCW_COUNTER_0, PIT_OCW_MODE_SQUAREWAVEGEN);
+    pit_start_counter(PIT_HZ, PIT_OCW_COUNTER_0, PIT_OCW_MODE_SQUAREWAVEGEN);
     printk("x86: pit: clocksource registered\n");
 }
 
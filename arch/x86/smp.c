@@ -0,0 +1,144 @@
+#include <levos/kernel.h>
+#include <levos/heap.h>
+#include <levos/errno.h>
+#include <levos/string.h>
+#include <levos/arch.h>
+#include <levos/page.h>
+#include <levos/smp.h>
+#include <levos/task.h>
+
+#include "apic.h"
+#include "gdt.h"
+#include "idt.h"
+#include "tss.h"
+
+#define MODULE_NAME smp
+
+/* keep in sync with trampoline.S */
+#define TRAMPOLINE_PHYS 0x8000
+
+extern char trampoline_start[], trampoline_end[];
+extern uint32_t tramp_cr3, tramp_stack, tramp_entry;
+
+/* the trampoline's parameters, in the copy at TRAMPOLINE_PHYS */
+#define TRAMP_PARAM(sym) (*(uint32_t *) (VIRT_BASE + TRAMPOLINE_PHYS + \
+            ((char *) &(sym) - trampoline_start)))
+
+/* the AP that is currently on its way up */
+static volatile int ap_booting_cpu;
+
+void enable_sse(void);
+
+static void
+smp_udelay(int us)
+{
+    /* a read of port 0x80 takes about a microsecond */
+    while (us --)
+        inportb(0x80);
+}
+
+static void
+smp_wait_ticks(uint32_t ticks)
+{
+    extern volatile uint32_t __pit_ticks;
+    uint32_t start = __pit_ticks;
+
+    while (__pit_ticks - start < ticks)
+        asm volatile("pause");
+}
+
+/* C entry point of the APs, we arrive here from the trampoline */
+static void __noreturn
+ap_main(void)
+{
+    int cpu = ap_booting_cpu;
+
+    gdt_init_cpu(cpu);
+    idt_load();
+    sysenter_init_cpu(cpu);
+    enable_sse();
+
+    lapic_init_cpu();
+    lapic_timer_start();
+
+    sched_ap_enter();
+}
+
+static int
+smp_boot_cpu(int cpu, int apic_id)
+{
+    uint8_t *stack;
+    int i;
+
+    percpu_init(cpu);
+    cpus[cpu].cpu_apic_id = apic_id;
+    tss_init_cpu(cpu);
+
+    if (!sched_create_idle(cpu))
+        return -ENOMEM;
+
+    /* only used until the AP switches to its idle task */
+    stack = malloc(0x1000);
+    if (!stack)
+        return -ENOMEM;
+
+    TRAMP_PARAM(tramp_cr3) = kv2p(kernel_pgd);
+    TRAMP_PARAM(tramp_stack) = (uint32_t) stack + 0x1000;
+    TRAMP_PARAM(tramp_entry) = (uint32_t) ap_main;
+    ap_booting_cpu = cpu;
+
+    /* INIT, then STARTUP twice as the MP spec says */
+    lapic_send_ipi(apic_id, LAPIC_ICR_INIT | LAPIC_ICR_ASSERT | LAPIC_ICR_LEVEL);
+    smp_wait_ticks(2);
+
+    for (i = 0; i < 2 && !cpus[cpu].cpu_online; i ++) {
+        lapic_send_ipi(apic_id, LAPIC_ICR_STARTUP | (TRAMPOLINE_PHYS >> 12));
+        smp_udelay(200);
+    }
+
+    /* give it a second */
+    for (i = 0; i < 200 && !cpus[cpu].cpu_online; i ++)
+        smp_wait_ticks(1);
+
+    if (!cpus[cpu].cpu_online) {
+        mprintk("CPU with APIC id %d did not come up\n", apic_id);
+        return -EIO;
+    }
+
+    mprintk("CPU%d (APIC id %d) is online\n", cpu, apic_id);
+    return 0;
+}
+
+void
+arch_smp_boot(void)
+{
+    int i, cpu = 1;
+
+    if (mp_info.mp_num_cpus < 2 || !mp_info.mp_lapic_phys)
+        return;
+
+    memcpy((void *) (VIRT_BASE + TRAMPOLINE_PHYS), trampoline_start,
+            trampoline_end - trampoline_start);
+
+    /* the trampoline turns on paging while running from low memory */
+    kernel_pgd[0] = kernel_pgd[VIRT_BASE >> 22];
+    __flush_tlb();
+
+    for (i = 0; i < mp_info.mp_num_cpus && cpu < NR_CPUS; i ++) {
+        if (mp_info.mp_cpu_apic_ids[i] == mp_info.mp_bsp_apic_id)
+            continue;
+
+        if (smp_boot_cpu(cpu, mp_info.mp_cpu_apic_ids[i]) == 0)
+            cpu ++;
+    }
+
+    kernel_pgd[0] = 0;
+    __flush_tlb();
+}
+
+void
+smp_send_resched(struct cpu *cpu)
+{
+    lapic_send_ipi(cpu->cpu_apic_id,
+            LAPIC_ICR_FIXED | LAPIC_ICR_ASSERT | IRQ_VEC_RESCHED);
+}
@@ -0,0 +1,89 @@
+#include <levos/kernel.h>
+#include <levos/arch.h>
+#include <levos/intr.h>
+#include <levos/x86.h>
+
+#include "tss.h"
+
+#define MODULE_NAME sysenter
+
+#define MSR_SYSENTER_CS     0x174
+#define MSR_SYSENTER_ESP    0x175
+#define MSR_SYSENTER_EIP    0x176
+
+extern void sysenter_entry(void);
+extern void __prepare_system_call(struct pt_regs *);
+
+static inline void
+wrmsr(uint32_t msr, uint64_t val)
+{
+    asm volatile("wrmsr" :: "c"(msr), "a"((uint32_t) val),
+            "d"((uint32_t) (val >> 32)));
+}
+
+/*
+ * The Pentium Pro claims SEP in CPUID but has no working SYSENTER, that
+ * is family 6, model < 3, stepping < 3.
+ */
+static int
+sysenter_supported(void)
+{
+    uint32_t a, b, c, d;
+
+    arch_cpuid(1, a, b, c, d);
+    if (!(d & X86_FEATURE_SEP))
+        return 0;
+
+    if (((a >> 8) & 0xf) == 6 && ((a >> 4) & 0xf) < 3 && (a & 0xf) < 3)
+        return 0;
+
+    return 1;
+}
+
+/*
+ * sysenter_init_cpu - point this CPU's SYSENTER MSRs at the kernel
+ *
+ * @cpu - the CPU we are running on
+ *
+ * SYSENTER loads ESP from an MSR, but the kernel stack changes with every
+ * task switch.  Rather than rewriting the MSR on each switch, it points
+ * at esp0 of the CPU's TSS, which tss_update() keeps current, and the
+ * entry code loads the real stack from there.  "int $0x80" keeps working
+ * either way.
+ */
+void
+sysenter_init_cpu(int cpu)
+{
+    struct tss *tss = tss_get_cpu(cpu);
+
+    if (!sysenter_supported()) {
+        if (cpu == 0)
+            mprintk("not supported, only int $0x80 is available\n");
+        return;
+    }
+
+    /* the selectors of SS, user CS and user SS follow from this one */
+    wrmsr(MSR_SYSENTER_CS, 0x08);
+    wrmsr(MSR_SYSENTER_ESP, (uint32_t) &tss->esp0);
+    wrmsr(MSR_SYSENTER_EIP, (uint32_t) sysenter_entry);
+
+    if (cpu == 0)
+        mprintk("enabled\n");
+}
+
+/*
+ * Called from sysenter_entry with a frame that looks like "int $0x80"
+ * made it.  Returns nonzero if the system call (exec, sigreturn, ...)
+ * changed where userspace resumes, then we return with IRET, which
+ * restores every register, instead of SYSEXIT.
+ */
+int
+sysenter_handler(struct pt_regs *regs)
+{
+    void (*eip)(void) = regs->eip;
+    void *esp = regs->esp;
+
+    __prepare_system_call(regs);
+
+    return regs->eip != eip || regs->esp != esp;
+}
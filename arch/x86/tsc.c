@@ -0,0 +1,121 @@
+#include <levos/kernel.h>
+#include <levos/types.h>
+#include <levos/arch.h>
+#include <levos/arithmetic.h>
+#include <levos/time.h>
+
+#define MODULE_NAME tsc
+
+#define PIT_FREQ 1193181
+
+/* PIT channel 2 is gated through the keyboard controller's port B */
+#define PORT_B             0x61
+#define PORT_B_GATE2       0x01
+#define PORT_B_SPEAKER     0x02
+#define PORT_B_OUT2        0x20
+
+#define PIT_REG_COUNTER2   0x42
+#define PIT_REG_COMMAND    0x43
+
+/* channel 2, LSB then MSB, mode 0 (interrupt on terminal count) */
+#define PIT_CMD_CH2_ONESHOT 0xB0
+
+#define TSC_CALIBRATE_MS    10
+#define TSC_CALIBRATE_LATCH (PIT_FREQ * TSC_CALIBRATE_MS / 1000)
+
+static uint32_t tsc_khz;
+static uint32_t tsc_mult;
+
+/* the TSC at boot, and the time it stands for */
+static uint64_t tsc_base;
+static uint64_t tsc_base_sec;
+
+/*
+ * tsc_calibrate - measure the TSC frequency against the PIT
+ *
+ * Counts TSC cycles while PIT channel 2 counts down TSC_CALIBRATE_MS,
+ * channel 0 keeps ticking undisturbed.  Returns the frequency in kHz.
+ */
+static uint32_t
+tsc_calibrate(void)
+{
+    uint64_t start, end;
+    uint8_t port_b;
+    int irqs_off = arch_irqs_disabled();
+
+    DISABLE_IRQ();
+
+    port_b = inportb(PORT_B);
+    outportb(PORT_B, (port_b & ~PORT_B_SPEAKER) | PORT_B_GATE2);
+
+    outportb(PIT_REG_COMMAND, PIT_CMD_CH2_ONESHOT);
+    outportb(PIT_REG_COUNTER2, TSC_CALIBRATE_LATCH & 0xff);
+    outportb(PIT_REG_COUNTER2, TSC_CALIBRATE_LATCH >> 8);
+
+    start = arch_rdtsc();
+    while (!(inportb(PORT_B) & PORT_B_OUT2))
+        ;
+    end = arch_rdtsc();
+
+    outportb(PORT_B, port_b);
+
+    if (!irqs_off)
+        ENABLE_IRQ();
+
+    return div_u64_rem(end - start, TSC_CALIBRATE_MS, NULL);
+}
+
+static int
+tsc_gettimeofday(struct timeval *tv, void *tz)
+{
+    uint64_t usec = time_cycles_to_usec(arch_rdtsc() - tsc_base, tsc_mult);
+    uint32_t rem;
+
+    tv->tv_sec = tsc_base_sec + div_u64_rem(usec, 1000000, &rem);
+    tv->tv_usec = rem;
+
+    return 0;
+}
+
+static struct timesource tsc_timesource = {
+    .name = "TSC",
+    .gettimeofday = tsc_gettimeofday,
+};
+
+/*
+ * arch_timesource_init - set up the TSC as the timesource
+ *
+ * @now - the current UNIX time, in seconds
+ *
+ * The TSCs of the CPUs are assumed to be in sync, which they are from
+ * reset on everything we run on.  Returns NULL if there's no usable TSC.
+ */
+struct timesource *
+arch_timesource_init(uint64_t now)
+{
+    uint32_t a, b, c, d;
+
+    arch_cpuid(1, a, b, c, d);
+    if (!(d & X86_FEATURE_TSC)) {
+        mprintk("no TSC\n");
+        return NULL;
+    }
+
+    tsc_khz = tsc_calibrate();
+
+    /* tsc_mult has to fit in 32 bits */
+    if (tsc_khz <= 1000) {
+        mprintk("TSC runs at %d kHz, too slow\n", tsc_khz);
+        return NULL;
+    }
+
+    tsc_mult = div_u64_rem((uint64_t) 1000 << 32, tsc_khz, NULL);
+    tsc_base = arch_rdtsc();
+    tsc_base_sec = now;
+
+    mprintk("running at %d kHz\n", tsc_khz);
+
+    time_page_publish(tsc_base, tsc_base_sec, tsc_khz, tsc_mult);
+
+    return &tsc_timesource;
+}
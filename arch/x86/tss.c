@@ -1,36 +1,51 @@
 #include <levos/kernel.h>
 #include <levos/x86.h>
 #include <levos/task.h>
+#include <levos/smp.h>
 #include "gdt.h"
 
-/* Kernel TSS. */
-static struct tss tss __attribute__((aligned(4096)));
+/* Kernel TSS, one per CPU. */
+static struct tss tss[NR_CPUS] __attribute__((aligned(4096)));
 
 static char irq_stack[4096];
 
-/* Initializes the kernel TSS. */
+/* Initializes the kernel TSS of CPU. */
+void
+tss_init_cpu (int cpu)
+{
+    memset(&tss[cpu], 0, sizeof(struct tss));
+    tss[cpu].ss0 = 0x10;
+    tss[cpu].bitmap = 0xdfff;
+}
+
+/* Initializes the kernel TSS of the boot CPU. */
 void
 tss_init (void) 
 {
-    memset(&tss, 0, sizeof(struct tss));
-    tss.ss0 = 0x10;
-    tss.bitmap = 0xdfff;
+    tss_init_cpu(0);
     memset(irq_stack, 0, sizeof(irq_stack));
 }
 
-/* Returns the kernel TSS. */
+/* Returns the kernel TSS of CPU. */
+struct tss *
+tss_get_cpu (int cpu)
+{
+    return &tss[cpu];
+}
+
+/* Returns the kernel TSS of this CPU. */
 struct tss *
 tss_get (void) 
 {
-    return &tss;
+    return tss_get_cpu(this_cpu()->cpu_id);
 }
 
-/* Sets the ring 0 stack pointer in the TSS to point to the end
+/* Sets the ring 0 stack pointer in this CPU's TSS to point to the end
    of the thread stack. */
 void
 tss_update (struct task *task) 
 {
-    tss.esp0 = task->irq_stack_top;
+    tss_get()->esp0 = task->irq_stack_top;
 }
 
 uint64_t
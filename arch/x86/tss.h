@@ -30,8 +30,12 @@ struct tss
 struct task;
 
 struct tss *tss_get(void);
+struct tss *tss_get_cpu(int);
+void tss_init_cpu(int);
 uint64_t make_tss_desc (void *);
 void tss_update (struct task *task);
 void tss_init(void);
 
+void sysenter_init_cpu(int);
+
 #endif /* __LEVOS_X86_TSS_H */
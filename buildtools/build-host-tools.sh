@@ -170,6 +170,9 @@ cd newlib/libc/sys
 cd ../../../
 patch -p1 < ../../../patches/${newlib_ver}.patch
 
+echo Copying the kernel headers that libc shares...
+cp ../../../../include/levos/time_page.h newlib/libc/sys/levos/sys/time_page.h
+
 cd newlib/libc/sys
 ${host_tools}/src/autoconf-2.64/bin/autoconf
 
@@ -225,6 +225,7 @@ e1000_handle_receive(struct e1000_device *edev)
 
         if ((uint32_t) buf + len > p_page + 0x1000) {
             printk("CRITICAL: overlapping page :(\n");
+            free(kbuf);
             goto drop;
         }
 
@@ -262,10 +263,17 @@ e1000_irq_handler(struct pt_regs *regs)
     }
     else if(status & 0x80)
     {
-        e1000_handle_receive(edev);
+        /* copying the packets out is left to the tasklet */
+        tasklet_schedule(&edev->rx_tasklet);
     }
 }
 
+static void
+e1000_rx_tasklet(unsigned long data)
+{
+    e1000_handle_receive((struct e1000_device *) data);
+}
+
 void
 __e1000_send_packet(struct e1000_device *edev, const void *p_data, uint16_t p_len)
 {    
@@ -383,6 +391,8 @@ e1000_attach(struct pci_device *pdev)
 
     printk("e1000: using IRQ %d mapped to INT %d\n", irqline, finalirq);
 
+    tasklet_init(&edev->rx_tasklet, e1000_rx_tasklet, (unsigned long) edev);
+
     intr_set_priv(finalirq, edev);
     intr_register_hw(finalirq, e1000_irq_handler);
 
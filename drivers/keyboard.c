@@ -1,11 +1,19 @@
 #include <levos/kernel.h>
 #include <levos/tty.h>
+#include <levos/ring.h>
+#include <levos/spinlock.h>
+#include <levos/softirq.h>
 
 #define MODULE_NAME kbd
 
 static struct ring_buffer kbd_ring;
 static struct tty_device *tty_notify;
 
+/* scancodes from the IRQ, turned into characters by kbd_tasklet */
+static struct ring_buffer kbd_scancodes;
+static spinlock_t kbd_scancodes_lock;
+static struct tasklet kbd_tasklet;
+
 enum KEYCODE {
 
     // Alphanumeric keys ////////////////
@@ -417,17 +425,40 @@ keyboard_inject(char *buf, int sz)
 void
 kbd_irq(struct pt_regs *regs)
 {
-    char c = keyboard_to_ascii(parse_keycode(inportb(0x60)));
+    uint8_t code = inportb(0x60);
+
+    spin_lock(&kbd_scancodes_lock);
+    ring_buffer_write(&kbd_scancodes, &code, 1);
+    spin_unlock(&kbd_scancodes_lock);
+
+    tasklet_schedule(&kbd_tasklet);
+}
+
+static void
+kbd_tasklet_func(unsigned long data)
+{
+    uint32_t flags;
+    uint8_t code;
+    char c;
     int rc;
-    char tmp;
 
-    if (_alt && c) {
-        vt_switch(c - 49);
-        return;
-    }
+    while (1) {
+        flags = spin_lock_irqsave(&kbd_scancodes_lock);
+        rc = ring_buffer_read(&kbd_scancodes, &code, 1);
+        spin_unlock_irqrestore(&kbd_scancodes_lock, flags);
+
+        if (rc != 1)
+            break;
+
+        c = keyboard_to_ascii(parse_keycode(code));
+        if (_alt && c) {
+            vt_switch(c - 49);
+            continue;
+        }
 
-    //printk("yay (%x): %c,%x\n", '\b', c, c);
-    __keyboard_inject(c);
+        //printk("yay (%x): %c,%x\n", '\b', c, c);
+        __keyboard_inject(c);
+    }
 }
 
 void
@@ -487,6 +518,11 @@ ps2_keyboard_init()
     ring_buffer_init(&kbd_ring, 128);
     ring_buffer_set_flags(&kbd_ring, RB_FLAG_NONBLOCK);
 
+    ring_buffer_init(&kbd_scancodes, 64);
+    ring_buffer_set_flags(&kbd_scancodes, RB_FLAG_NONBLOCK);
+    spin_lock_init(&kbd_scancodes_lock);
+    tasklet_init(&kbd_tasklet, kbd_tasklet_func, 0);
+
     intr_register_hw(0x20 + 0x01, kbd_irq);
 
     mprintk("setup done\n");
@@ -1,6 +1,7 @@
 #include <levos/kernel.h>
 #include <levos/tty.h>
 #include <levos/device.h>
+#include <levos/poll.h>
 
 /* N_TTY line discipline */
 
@@ -12,6 +13,8 @@ n_tty_flush(struct tty_device *tty)
     
     ret = ring_buffer_write(&priv->line_buffer, priv->line_editing, priv->line_len);
     priv->line_len = 0;
+
+    wait_wake_up(&tty->tty_wq);
     return ret;
 }
 
@@ -224,6 +227,18 @@ n_tty_read_buf(struct tty_device *tty, uint8_t *buf, size_t len)
     return ring_buffer_read(&priv->line_buffer, buf, len);
 }
 
+static int
+n_tty_poll(struct tty_device *tty)
+{
+    struct n_tty_priv *priv = tty->tty_ldisc->priv;
+
+    if (tty->tty_state == TTY_STATE_CLOSED ||
+            ring_buffer_size(&priv->line_buffer))
+        return POLLIN | POLLRDNORM;
+
+    return 0;
+}
+
 static int
 n_tty_init(struct tty_line_discipline *ldisc)
 {
@@ -244,6 +259,7 @@ struct tty_line_discipline n_tty_ldisc = {
     .write_output = n_tty_write_output,
     .write_input = n_tty_write_input,
     .read_buf = n_tty_read_buf,
+    .poll = n_tty_poll,
     .flush = n_tty_flush,
     .init = n_tty_init,
 };
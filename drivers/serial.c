@@ -3,6 +3,9 @@
 #include <levos/fs.h>
 #include <levos/x86.h>
 #include <levos/tty.h>
+#include <levos/ring.h>
+#include <levos/spinlock.h>
+#include <levos/softirq.h>
 
 #define SERIAL_PORT 0x3F8
 
@@ -10,6 +13,11 @@
 
 static struct tty_device *tty_notify;
 
+/* what the IRQ read from the UART, until serial_rx_tasklet gets to it */
+static struct ring_buffer serial_rx_ring;
+static spinlock_t serial_rx_lock;
+static struct tasklet serial_rx_tasklet;
+
 static void serial_out(int o, char d)
 {
     outportb(SERIAL_PORT + o, d);
@@ -92,9 +100,38 @@ serial_file_truncate(struct file *f, int len)
 void
 serial_irq(struct pt_regs *regs)
 {
+    uint8_t c;
+
     //mprintk("IRQ\n");
-    if (tty_notify)
-        tty_notify->tty_ldisc->write_input(tty_notify, serial_read_data());
+    spin_lock(&serial_rx_lock);
+    while (serial_has_recv()) {
+        c = inportb(SERIAL_PORT + 0);
+        ring_buffer_write(&serial_rx_ring, &c, 1);
+    }
+    spin_unlock(&serial_rx_lock);
+
+    tasklet_schedule(&serial_rx_tasklet);
+}
+
+/* feed what the IRQ received to the TTY */
+static void
+serial_rx_func(unsigned long data)
+{
+    uint32_t flags;
+    char c;
+    int rc;
+
+    while (1) {
+        flags = spin_lock_irqsave(&serial_rx_lock);
+        rc = ring_buffer_read(&serial_rx_ring, &c, 1);
+        spin_unlock_irqrestore(&serial_rx_lock, flags);
+
+        if (rc != 1)
+            break;
+
+        if (tty_notify)
+            tty_notify->tty_ldisc->write_input(tty_notify, c);
+    }
 }
 
 struct console serial_console = {
@@ -135,6 +172,11 @@ int serial_init() {
     //outportb(SERIAL_PORT + 3, 0x03);    // 8 bits, no parity, one stop bit
     //outportb(SERIAL_PORT + 2, 0xC7);    // Enable FIFO, clear them, with 14-byte threshold
     //outportb(SERIAL_PORT + 4, 0x0B);    // IRQs enabled, RTS/DSR set
+    ring_buffer_init(&serial_rx_ring, 128);
+    ring_buffer_set_flags(&serial_rx_ring, RB_FLAG_NONBLOCK);
+    spin_lock_init(&serial_rx_lock);
+    tasklet_init(&serial_rx_tasklet, serial_rx_func, 0);
+
     outportb(SERIAL_PORT + 1, 0x01);
     intr_register_hw(0x20 + 0x04, serial_irq);
     mprintk("setup done\n");
@@ -2,6 +2,7 @@
 #include <levos/tty.h>
 #include <levos/device.h>
 #include <levos/fs.h>
+#include <levos/poll.h>
 
 extern struct tty_line_discipline *n_tty_ldisc;
 
@@ -60,6 +61,7 @@ tty_new(struct device *dev)
     memcpy(tty->tty_ldisc, &n_tty_ldisc, sizeof(*tty->tty_ldisc));
     tty->tty_id = tty_get_id();
     ring_buffer_init(&tty->tty_out, PTY_BUF_SIZE);
+    wait_queue_init(&tty->tty_wq);
     termios_init(&tty->tty_termios);
     tty->tty_winsize.ws_row = 80;
     tty->tty_winsize.ws_col = 25;
@@ -199,6 +201,16 @@ int tty_ftruncate(struct file *f, size_t len)
     return 0;
 }
 
+/* output never waits, it's buffered */
+int tty_fpoll(struct file *f, struct poll_table *pt)
+{
+    struct tty_device *tty = f->priv;
+
+    poll_wait(f, &tty->tty_wq, pt);
+
+    return tty->tty_ldisc->poll(tty) | POLLOUT | POLLWRNORM;
+}
+
 struct file_operations tty_fops = {
     .read = tty_fread,
     .write = tty_fwrite,
@@ -207,6 +219,7 @@ struct file_operations tty_fops = {
     .readdir = tty_freaddir,
     .truncate = tty_ftruncate,
     .ioctl = tty_fioctl,
+    .poll = tty_fpoll,
 };
 
 struct file *
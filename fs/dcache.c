@@ -0,0 +1,234 @@
+#include <levos/kernel.h>
+#include <levos/types.h>
+#include <levos/fs.h>
+#include <levos/dcache.h>
+#include <levos/hash.h>
+#include <levos/list.h>
+#include <levos/spinlock.h>
+
+/*
+ * The name cache of the path walk.  Every component of a path costs a read
+ * of the directory inode and of its blocks, this keeps what they said, so
+ * that opening the same paths again doesn't go to the disk at all.
+ *
+ * There is one cache for all the filesystems, looked at by the filesystem
+ * itself, see ext2_find_file_inode().  The filesystem has to drop the entry
+ * of a name with dcache_invalidate() whenever it adds or removes it.
+ */
+static struct hash dcache_hash;
+static struct list dcache_lru;
+static spinlock_t dcache_lock;
+static int dcache_nr;
+
+/*
+ * Bumped by every invalidation.  A lookup that missed and then went to the
+ * disk only adds what it found if nothing was invalidated in the meantime,
+ * else it might put back a name that was just created as a negative one.
+ */
+static unsigned dcache_gen;
+
+static uint32_t dcache_hits, dcache_neg_hits, dcache_misses, dcache_evictions;
+
+static unsigned
+dcache_hash_dentry(const struct hash_elem *e, void *aux)
+{
+    struct dentry *de = hash_entry(e, struct dentry, de_helem);
+
+    return hash_bytes(de->de_name, de->de_len) ^
+        hash_int(de->de_dir) ^ hash_int((int) de->de_fs);
+}
+
+static bool
+dcache_less_dentry(const struct hash_elem *a,
+                   const struct hash_elem *b,
+                   void *aux)
+{
+    struct dentry *da = hash_entry(a, struct dentry, de_helem);
+    struct dentry *db = hash_entry(b, struct dentry, de_helem);
+
+    if (da->de_fs != db->de_fs)
+        return da->de_fs < db->de_fs;
+    if (da->de_dir != db->de_dir)
+        return da->de_dir < db->de_dir;
+    if (da->de_len != db->de_len)
+        return da->de_len < db->de_len;
+
+    return (int) strncmp(da->de_name, db->de_name, da->de_len) < 0;
+}
+
+void
+dcache_init(void)
+{
+    hash_init(&dcache_hash, dcache_hash_dentry, dcache_less_dentry, NULL);
+    list_init(&dcache_lru);
+    spin_lock_init(&dcache_lock);
+    dcache_nr = 0;
+    dcache_gen = 0;
+}
+
+/* the entry for (FS, DIR, NAME), with dcache_lock held */
+static struct dentry *
+__dcache_find(struct filesystem *fs, int dir, char *name, int len)
+{
+    struct {
+        struct dentry de;
+        char name[DCACHE_NAME_MAX];
+    } key;
+    struct hash_elem *e;
+
+    key.de.de_fs = fs;
+    key.de.de_dir = dir;
+    key.de.de_len = len;
+    memcpy(key.de.de_name, name, len);
+
+    e = hash_find(&dcache_hash, &key.de.de_helem);
+    if (!e)
+        return NULL;
+
+    return hash_entry(e, struct dentry, de_helem);
+}
+
+static void
+__dcache_remove(struct dentry *de)
+{
+    hash_delete(&dcache_hash, &de->de_helem);
+    list_remove(&de->de_lru);
+    dcache_nr --;
+}
+
+/*
+ * dcache_lookup - what NAME in the directory DIR resolved to last time
+ *
+ * @fs - the filesystem of DIR
+ * @dir - the inode number of the directory
+ * @name - the name, it need not be terminated
+ * @len - the length of NAME
+ * @gen - where to put the generation to hand to dcache_add() on a miss
+ *
+ * Returns the inode number, -ENOENT if the name is known not to be there
+ * or 0 if the cache doesn't know and the disk has to be asked.
+ */
+int
+dcache_lookup(struct filesystem *fs, int dir, char *name, int len,
+              unsigned *gen)
+{
+    struct dentry *de;
+    int ino = 0;
+
+    if (len > DCACHE_NAME_MAX)
+        return 0;
+
+    spin_lock(&dcache_lock);
+
+    de = __dcache_find(fs, dir, name, len);
+    if (de) {
+        ino = de->de_ino;
+
+        /* to the front of the line, it's the last to go now */
+        list_remove(&de->de_lru);
+        list_push_front(&dcache_lru, &de->de_lru);
+
+        if (ino < 0)
+            dcache_neg_hits ++;
+        else
+            dcache_hits ++;
+    } else {
+        dcache_misses ++;
+        if (gen)
+            *gen = dcache_gen;
+    }
+
+    spin_unlock(&dcache_lock);
+
+    return ino;
+}
+
+/*
+ * dcache_add - remember that NAME in DIR is the inode INO
+ *
+ * @ino - the inode number, or -ENOENT for a name that is not there
+ * @gen - what dcache_lookup() gave on the miss, before the disk was read
+ *
+ * Other errors are not kept.  Nothing is added if the name is already in
+ * the cache or if there was an invalidation since GEN.
+ */
+void
+dcache_add(struct filesystem *fs, int dir, char *name, int len, int ino,
+           unsigned gen)
+{
+    struct dentry *de, *victim;
+
+    if (len > DCACHE_NAME_MAX || (ino <= 0 && ino != -ENOENT))
+        return;
+
+    de = malloc(sizeof(*de) + len);
+    if (!de)
+        return;
+
+    de->de_fs = fs;
+    de->de_dir = dir;
+    de->de_ino = ino;
+    de->de_len = len;
+    memcpy(de->de_name, name, len);
+
+    spin_lock(&dcache_lock);
+
+    if (gen != dcache_gen || hash_insert(&dcache_hash, &de->de_helem)) {
+        spin_unlock(&dcache_lock);
+        free(de);
+        return;
+    }
+
+    list_push_front(&dcache_lru, &de->de_lru);
+    dcache_nr ++;
+
+    victim = NULL;
+    if (dcache_nr > DCACHE_MAX) {
+        victim = list_entry(list_back(&dcache_lru), struct dentry, de_lru);
+        __dcache_remove(victim);
+        dcache_evictions ++;
+    }
+
+    spin_unlock(&dcache_lock);
+
+    if (victim)
+        free(victim);
+}
+
+/*
+ * dcache_invalidate - forget NAME in DIR, it is being created or removed
+ *
+ * To be called after the directory was changed on disk.
+ */
+void
+dcache_invalidate(struct filesystem *fs, int dir, char *name, int len)
+{
+    struct dentry *de = NULL;
+
+    spin_lock(&dcache_lock);
+
+    dcache_gen ++;
+    if (len <= DCACHE_NAME_MAX) {
+        de = __dcache_find(fs, dir, name, len);
+        if (de)
+            __dcache_remove(de);
+    }
+
+    spin_unlock(&dcache_lock);
+
+    if (de)
+        free(de);
+}
+
+size_t
+dcache_proc_stat(int pos, void *buf, size_t len, char *__arg)
+{
+    char buffer[128];
+
+    snprintf(buffer, sizeof(buffer),
+            "entries %d\nhits %u\nnegative %u\nmisses %u\nevictions %u\n",
+            dcache_nr, dcache_hits, dcache_neg_hits,
+            dcache_misses, dcache_evictions);
+
+    return generic_write_buf(pos, buf, len, buffer);
+}
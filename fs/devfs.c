@@ -212,58 +212,52 @@ devfs_get_inode(char *path, struct file **filp, int *flags)
     return -1;
 }
 
+/* ".", ".." and then the files, the position is the index */
 int
-devfs_readdir(struct file *filp, struct linux_dirent *de)
+devfs_iterate(struct file *filp, struct dir_context *ctx)
 {
-    struct devfs_file *f = &_files[0];
-    int i = 0, success = 0;
+    struct devfs_file *f;
+    const char *name;
+    unsigned long ino;
+    unsigned int type;
+
+    for (;;) {
+        if (filp->fpos < 2) {
+            name = filp->fpos == 0 ? "." : "..";
+            ino = 0;
+            type = DT_DIR;
+        } else {
+            if (filp->fpos - 2 >= _files_num)
+                break;
+
+            f = &_files[filp->fpos - 2];
+            if (!f->path)
+                break;
+
+            name = f->path + 1;
+            ino = f->inode_no;
+            type = DT_CHR;
+        }
 
-    //mprintk("readdir: pos %d\n", filp->fpos);
-    memset(de->d_name, 0, 255);
-    
-    if (filp->fpos == 0) {
-        success = 1;
-        de->d_ino = 0;
-        de->d_off = 0;
-        memcpy(de->d_name, ".", 1);
-        de->d_reclen = 10 + 1;
-        filp->fpos ++;
-        goto done;
-    }
+        if (ctx->actor(ctx, name, strlen(name), filp->fpos + 1, ino, type))
+            break;
 
-    if (filp->fpos == 1) {
-        success = 1;
-        de->d_ino = 0;
-        de->d_off = 0;
-        memcpy(de->d_name, "..", 2);
-        de->d_reclen = 10 + 2;
         filp->fpos ++;
-        goto done;
     }
-    
-    i = 2;
-
-    while (f->path) {
-        if (i == filp->fpos) {
-            success = 1;
-            de->d_ino = f->inode_no;
-            de->d_off = 0;
-            memcpy(de->d_name, f->path + 1, strlen(f->path));
-            de->d_reclen = 10 + strlen(f->path);
-            filp->fpos ++;
-            break;
-        }
-        f ++;
-        i ++;
-    }
-
-done:
-    if (!success)
-        return -ENOSPC;
 
     return 0;
 }
 
+/* the root is a copy of /dev/null that can be listed */
+static struct file_operations devfs_root_fops = {
+    .read = null_file_read,
+    .write = null_file_write,
+    .fstat = null_file_fstat,
+    .close = null_file_close,
+    .readdir = generic_readdir,
+    .iterate = devfs_iterate,
+};
+
 struct file *
 devfs_open_root(struct filesystem *fs, struct file *filp)
 {
@@ -271,7 +265,7 @@ devfs_open_root(struct filesystem *fs, struct file *filp)
     filp->type = FILE_TYPE_NORMAL;
     filp->priv = 0x80000000;
     filp->fs = fs;
-    filp->fops->readdir = devfs_readdir;
+    filp->fops = &devfs_root_fops;
     return filp;
 }
 
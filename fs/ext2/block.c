@@ -13,8 +13,7 @@ int ext2_read_block(struct filesystem *fs, void *buf, uint32_t block)
     if (!spb)
         spb ++;
 
-    dev_seek(fs->dev, block * spb);
-    fs->dev->read(fs->dev, buf, spb);
+    dev_read_at(fs->dev, buf, spb, block * spb);
 
     return 0;
 }
@@ -28,13 +27,12 @@ int ext2_write_block(struct filesystem *fs, void *buf, uint32_t block)
     if (!spb)
         spb ++;
 
-    dev_seek(fs->dev, block * spb);
-    fs->dev->write(fs->dev, buf, spb);
+    dev_write_at(fs->dev, buf, spb, block * spb);
 
     return 0;
 }
 
-int ext2_alloc_block(struct filesystem *fs)
+static int __ext2_alloc_block(struct filesystem *fs)
 {
     struct ext2_priv_data *p = EXT2_PRIV(fs);
     int i;
@@ -73,7 +71,6 @@ int ext2_alloc_block(struct filesystem *fs)
             found_block = bitmap_scan_and_flip(&bm, 0, 1, false);
             if (found_block == BITMAP_ERROR) {
                 printk("[ext2] CRITICAL: inconsistent block bitmap\n");
-                free(block_buf);
                 free(buffer);
                 /* this is weird, try with the next bgd */
                 continue;
@@ -103,3 +100,15 @@ int ext2_alloc_block(struct filesystem *fs)
     printk("WARNING: CRITICAL: Couldn't find a free block!\n");
     return -1;
 }
+
+int ext2_alloc_block(struct filesystem *fs)
+{
+    struct ext2_priv_data *p = EXT2_PRIV(fs);
+    int rc;
+
+    mutex_lock(&p->alloc_lock);
+    rc = __ext2_alloc_block(fs);
+    mutex_unlock(&p->alloc_lock);
+
+    return rc;
+}
@@ -1,6 +1,7 @@
 #include <levos/kernel.h>
 #include <levos/fs.h>
 #include <levos/ext2.h>
+#include <levos/dcache.h>
 
 int ext2_read_directory(struct filesystem *fs, int dino, char *f)
 {
@@ -324,6 +325,10 @@ ext2_place_dirent(struct filesystem *fs, int ino, struct ext2_dir *dirent)
 
     ret = __ext2_place_dirent(fs, buf, ino, dirent);
 
+    /* a negative entry of the name would hide it */
+    dcache_invalidate(fs, ino, (char *) &dirent->reserved + 1,
+                      dirent->namelength);
+
     free(buf);
     return ret;
 }
@@ -1,6 +1,7 @@
 #include <levos/kernel.h>
 #include <levos/fs.h>
 #include <levos/ext2.h>
+#include <levos/dcache.h>
 
 struct file *ext2_open(struct filesystem *, char *);
 
@@ -23,10 +24,17 @@ ext2_find_file_inode(struct filesystem *fs, char *path)
 
     /* this means that the tokenizing has at least one token, so
      * let us find the inode number of that token */
-    int ino = 2;
+    int ino = 2, dir, len;
+    unsigned gen;
     while (pch != 0) {
         //printk("looking for \"%s\" in inode %d: ", pch, ino);
-        ino = ext2_read_directory(fs, ino, pch);
+        dir = ino;
+        len = strlen(pch);
+        ino = dcache_lookup(fs, dir, pch, len, &gen);
+        if (ino == 0) {
+            ino = ext2_read_directory(fs, dir, pch);
+            dcache_add(fs, dir, pch, len, ino, gen);
+        }
         if (ino < 0) {
             //printk("ENOENT\n");
             free(fn);
@@ -236,8 +244,9 @@ exit:
     return 0;
 }
 
-int
-ext2_read_file(struct file *f, void *buf, size_t count)
+/* read COUNT bytes at POS, does not move the file position */
+size_t
+ext2_pread_file(struct file *f, void *buf, size_t count, int pos)
 {
     int rc;
 
@@ -262,7 +271,7 @@ ext2_read_file(struct file *f, void *buf, size_t count)
 
     ext2_read_inode(f->fs, theinode, inode);
 
-    if (f->fpos >= theinode->size) {
+    if (pos >= theinode->size) {
         free(theinode);
         return 0;
     }
@@ -273,16 +282,16 @@ ext2_read_file(struct file *f, void *buf, size_t count)
     int rblocks = 0; /* blocks read so far */
 
     /* determine position */
-    int cblock = f->fpos / bs;
-    int coff = f->fpos % bs;
+    int cblock = pos / bs;
+    int coff = pos % bs;
 
-    int start_block = f->fpos / bs;
-    uint32_t end = f->fpos + count;
+    int start_block = pos / bs;
+    uint32_t end = pos + count;
     if (end > theinode->size)
         end = theinode->size;
     int end_block = end / bs;
     uint32_t end_size = end - end_block * bs;
-    uint32_t to_read = end - f->fpos;
+    uint32_t to_read = end - pos;
 
     uint8_t *buffer = malloc(bs);
     if (!buffer) {
@@ -292,7 +301,7 @@ ext2_read_file(struct file *f, void *buf, size_t count)
 
 	if (start_block == end_block) {
 		ext2_file_read_block(f, theinode, buffer, start_block);
-		memcpy(buf, (uint8_t *)(((uint32_t)buffer) + (f->fpos % bs)), to_read);
+		memcpy(buf, (uint8_t *)(((uint32_t)buffer) + (pos % bs)), to_read);
         total += to_read;
 	} else {
 		uint32_t block_offset;
@@ -300,23 +309,21 @@ ext2_read_file(struct file *f, void *buf, size_t count)
 		for (block_offset = start_block; block_offset < end_block; block_offset++, blocks_read++) {
 			if (block_offset == start_block) {
 				ext2_file_read_block(f, theinode, buffer, block_offset);
-				memcpy(buf, (uint8_t *)(((uint32_t)buffer) + (f->fpos % bs)), bs - (f->fpos % bs));
-                total += (bs - (f->fpos % bs));
+				memcpy(buf, (uint8_t *)(((uint32_t)buffer) + (pos % bs)), bs - (pos % bs));
+                total += (bs - (pos % bs));
 			} else {
 				ext2_file_read_block(f, theinode, buffer, block_offset);
-				memcpy(buf + bs * blocks_read - (f->fpos % bs), buffer, bs);
+				memcpy(buf + bs * blocks_read - (pos % bs), buffer, bs);
                 total += bs;
 			}
 		}
 		if (end_size) {
 			ext2_file_read_block(f, theinode, buffer, end_block);
-			memcpy(buf + bs * blocks_read - (f->fpos % bs), buffer, end_size);
+			memcpy(buf + bs * blocks_read - (pos % bs), buffer, end_size);
             total += end_size;
 		}
 	}
 
-    f->fpos += total;
-
     rc = total;
 exit:
     free(theinode);
@@ -325,7 +332,19 @@ exit:
 }
 
 size_t
-ext2_write_file(struct file *f, void *buf, size_t count)
+ext2_read_file(struct file *f, void *buf, size_t count)
+{
+    int rc = ext2_pread_file(f, buf, count, f->fpos);
+
+    if (rc > 0)
+        f->fpos += rc;
+
+    return rc;
+}
+
+/* write COUNT bytes at POS, does not move the file position */
+size_t
+ext2_pwrite_file(struct file *f, void *buf, size_t count, int pos)
 {
     int rc, i;
 
@@ -369,20 +388,20 @@ ext2_write_file(struct file *f, void *buf, size_t count)
     int rblocks = 0; /* blocks read so far */
 
     /* determine position */
-    int cblock = f->fpos / bs;
-    int coff = f->fpos % bs;
+    int cblock = pos / bs;
+    int coff = pos % bs;
 
-    if (f->fpos > inode->size) {
+    if (pos > inode->size) {
         //free(inode);
-        //printk("POOOP fpos %d size %d\n", f->fpos, inode->size);
+        //printk("POOOP fpos %d size %d\n", pos, inode->size);
         //return -EFBIG;
     }
 
-    uint32_t end          = f->fpos + count;
-    uint32_t start_block  = f->fpos / bs;
+    uint32_t end          = pos + count;
+    uint32_t start_block  = pos / bs;
 	uint32_t end_block    = end / bs;
 	uint32_t end_size     = end - end_block * bs;
-	uint32_t size_to_read = end - f->fpos;
+	uint32_t size_to_read = end - pos;
 
     /*printk("end %d start_block %d end_block %d end_size %d s2read %d\n",
             end, start_block, end_block, end_size, size_to_read);*/
@@ -395,7 +414,7 @@ ext2_write_file(struct file *f, void *buf, size_t count)
 
     /* do the write */
     /*printk("start_block %d end %d end_block %d pos %d\n",
-            start_block, end, end_block, f->fpos);*/
+            start_block, end, end_block, pos);*/
 
     if (start_block == end_block) {
         //printk("CASE 1\n");
@@ -457,8 +476,6 @@ done:
         ext2_write_inode(fs, inode, ino);
         f->length = inode->size;
     }
-    f->fpos += total;
-
     rc = total;
 exit:
     free(buffer);
@@ -466,6 +483,17 @@ exit:
     return rc;
 }
 
+size_t
+ext2_write_file(struct file *f, void *buf, size_t count)
+{
+    int rc = ext2_pwrite_file(f, buf, count, f->fpos);
+
+    if (rc > 0)
+        f->fpos += rc;
+
+    return rc;
+}
+
 void *
 ext2_dup_priv(void *priv)
 {
@@ -507,25 +535,71 @@ ext2_create_file(struct filesystem *fs, char *path)
     return ext2_open(fs, path);
 }
 
+/* the file type in a directory entry, if the filesystem keeps it there */
+static const unsigned char ext2_dt[] = {
+    DT_UNKNOWN, DT_REG, DT_DIR, DT_CHR, DT_BLK, DT_FIFO, DT_SOCK, DT_LNK,
+};
+
+/*
+ * ext2_iterate - the entries of a directory, from fpos on
+ *
+ * The position is the byte offset of the entry in the directory, so each
+ * call starts right in the block where the last one stopped and reads
+ * every block once.
+ */
 int
-ext2_filldir(struct file *f, struct linux_dirent *dirent)
+ext2_iterate(struct file *f, struct dir_context *ctx)
 {
-    struct ext2_dir *edir = dirent_get(f->fs, EXT2_FILE_PRIV(f)->inode_no, f->fpos);
-    if (!edir)
-        return -ENOSPC;
+    struct filesystem *fs = f->fs;
+    int bs = EXT2_PRIV(fs)->blocksize;
+    struct ext2_inode *ibuf;
+    struct ext2_dir *de;
+    char *buffer;
+    int b, off, next, rc = 0;
+
+    ibuf = malloc(EXT2_PRIV(fs)->inodesize);
+    if (!ibuf)
+        return -ENOMEM;
 
-    memset(dirent, 0, sizeof(*dirent));
+    buffer = malloc(bs);
+    if (!buffer) {
+        free(ibuf);
+        return -ENOMEM;
+    }
 
-    dirent->d_ino = edir->inode;
-    dirent->d_off = f->fpos;
-    dirent->d_reclen = edir->size;
-    memcpy(dirent->d_name, dirent_get_name(edir), edir->namelength);
+    ext2_read_inode(fs, ibuf, EXT2_FILE_PRIV(f)->inode_no);
 
-    dirent_free(edir);
+    for (b = f->fpos / bs; b < 12 && b * bs < ibuf->size; b ++) {
+        if (!ibuf->dbp[b])
+            break;
 
-    f->fpos ++;
+        ext2_read_block(fs, buffer, ibuf->dbp[b]);
 
-    return 0;
+        for (off = f->fpos % bs; off < bs; off = next) {
+            de = (struct ext2_dir *) (buffer + off);
+            next = off + de->size;
+
+            if (de->size < sizeof(*de) || next > bs) {
+                rc = -EIO;
+                goto out;
+            }
+
+            /* unused space, e.g. what's left of a deleted entry */
+            if (de->inode && ctx->actor(ctx, dirent_get_name(de),
+                        de->namelength, b * bs + next, de->inode,
+                        de->reserved < sizeof(ext2_dt) ?
+                            ext2_dt[de->reserved] : DT_UNKNOWN))
+                goto out;
+
+            f->fpos = b * bs + next;
+        }
+    }
+
+out:
+    free(buffer);
+    free(ibuf);
+
+    return rc;
 }
 
 int
@@ -581,8 +655,12 @@ ext2_truncate_file(struct file *f, int size)
 struct file_operations ext2_fops = {
     .read = ext2_read_file,
     .write = ext2_write_file,
+    .pread = ext2_pread_file,
+    .pwrite = ext2_pwrite_file,
+    .poll = generic_file_poll,
     .truncate = ext2_truncate_file,
-    .readdir = ext2_filldir,
+    .readdir = generic_readdir,
+    .iterate = ext2_iterate,
     .fstat = ext2_file_fstat,
     .close = ext2_file_close,
 };
@@ -46,8 +46,8 @@ int ext2_read_inode(struct filesystem *fs, struct ext2_inode *buf, int inode)
 }
 
 
-int
-ext2_alloc_inode(struct filesystem *fs)
+static int
+__ext2_alloc_inode(struct filesystem *fs)
 {
     struct ext2_priv_data *p = EXT2_PRIV(fs);
     int i;
@@ -112,6 +112,19 @@ ext2_alloc_inode(struct filesystem *fs)
     return -1;
 }
 
+int
+ext2_alloc_inode(struct filesystem *fs)
+{
+    struct ext2_priv_data *p = EXT2_PRIV(fs);
+    int rc;
+
+    mutex_lock(&p->alloc_lock);
+    rc = __ext2_alloc_inode(fs);
+    mutex_unlock(&p->alloc_lock);
+
+    return rc;
+}
+
 /* Creates a new inode in @inode, then allocates an inode number in @fs */
 int
 ext2_new_inode(struct filesystem *fs, struct ext2_inode *inode)
@@ -190,6 +203,7 @@ int ext2_write_inode(struct filesystem *fs, struct ext2_inode *buf, int inode)
     int final = bgd->block_of_inode_table + block;
 
     /* read that block and generate a pointer */
+    mutex_lock(&p->itable_lock);
     ext2_read_block(fs, block_buf, final);
     struct ext2_inode *_inode = (void *)block_buf;
     index = index % p->inodes_per_block;
@@ -201,6 +215,7 @@ int ext2_write_inode(struct filesystem *fs, struct ext2_inode *buf, int inode)
 
     /* write back the block */
     ext2_write_block(fs, block_buf, final);
+    mutex_unlock(&p->itable_lock);
 
     free(block_buf);
     return 0;
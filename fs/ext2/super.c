@@ -23,8 +23,7 @@ struct filesystem *ext2_mount(struct device *dev)
         return NULL;
 
     void *buf = malloc(1024);
-    dev_seek(dev, 2);
-    int i = dev->read(dev, buf, 2);
+    int i = dev_read_at(dev, buf, 2, 2);
     struct ext2_superblock *sb = (struct ext2_superblock *)buf;
     if (sb->ext2_sig != EXT2_SIGNATURE) {
         printk("ext2: signature mismatch (0x%x) on device %s\n", sb->ext2_sig, dev->name);
@@ -51,6 +50,9 @@ struct filesystem *ext2_mount(struct device *dev)
     memcpy(&p->sb, (void *) sb, sizeof(struct ext2_superblock));
     free(buf);
 
+    mutex_init(&p->alloc_lock);
+    mutex_init(&p->itable_lock);
+
 
     dev->fs = fs;
     fs->priv_data = p;
@@ -64,12 +66,11 @@ int
 ext2_write_superblock(struct filesystem *fs)
 {
     void *buffer = &EXT2_PRIV(fs)->sb;
-    dev_seek(fs->dev, 2);
     if (!fs->dev->write) {
         printk("[ext2]: CRIRTICAL: ROFS\n");
         return -EROFS;
     }
-    fs->dev->write(fs->dev, buffer, 2);
+    dev_write_at(fs->dev, buffer, 2, 2);
     //printk("[ext2]: WARNING: writing superblock has been done\n");
 }
 
@@ -0,0 +1,429 @@
+#include <levos/kernel.h>
+#include <levos/types.h>
+#include <levos/fs.h>
+#include <levos/fdtable.h>
+#include <levos/task.h>
+#include <levos/spinlock.h>
+#include <levos/rcu.h>
+
+static struct fdarray *
+fdarray_alloc(int size)
+{
+    struct fdarray *fa;
+    size_t len;
+
+    len = sizeof(*fa) + size * sizeof(struct fd) + size / FD_BITS * 4;
+    fa = malloc(len);
+    if (!fa)
+        return NULL;
+
+    memset(fa, 0, len);
+    fa->fa_size = size;
+    fa->fa_open = (uint32_t *) &fa->fa_fds[size];
+
+    return fa;
+}
+
+static void
+fdarray_free_rcu(struct rcu_head *rh)
+{
+    free(container_of(rh, struct fdarray, fa_rcu));
+}
+
+static inline void
+__fd_set_open(struct fdarray *fa, int fd)
+{
+    fa->fa_open[fd / FD_BITS] |= 1U << (fd % FD_BITS);
+}
+
+static inline void
+__fd_clear_open(struct fdarray *fa, int fd)
+{
+    fa->fa_open[fd / FD_BITS] &= ~(1U << (fd % FD_BITS));
+}
+
+/* the lowest free slot from START on, fa_size if there is none */
+static int
+find_next_zero_fd(struct fdarray *fa, int start)
+{
+    int i = start / FD_BITS;
+    uint32_t word;
+
+    if (start >= fa->fa_size)
+        return fa->fa_size;
+
+    /* the bits below START count as taken */
+    word = fa->fa_open[i] | ((1U << (start % FD_BITS)) - 1);
+
+    for (;;) {
+        if (word != 0xFFFFFFFF)
+            return i * FD_BITS + __builtin_ctz(~word);
+
+        if (++ i == fa->fa_size / FD_BITS)
+            return fa->fa_size;
+
+        word = fa->fa_open[i];
+    }
+}
+
+/*
+ * fdtable_expand - make room for slot NR
+ *
+ * Called with fdt_lock held and returns with it held, but drops it for
+ * the allocation, so the caller has to look at the table again.
+ */
+static int
+fdtable_expand(struct fdtable *fdt, int nr)
+{
+    struct fdarray *fa, *old;
+    int size;
+
+    if (nr >= FD_MAX)
+        return -EMFILE;
+
+    size = fdt->fdt_array->fa_size;
+    while (size <= nr)
+        size *= 2;
+    if (size > FD_MAX)
+        size = FD_MAX;
+
+    spin_unlock(&fdt->fdt_lock);
+    fa = fdarray_alloc(size);
+    spin_lock(&fdt->fdt_lock);
+
+    if (!fa)
+        return -ENOMEM;
+
+    old = fdt->fdt_array;
+
+    /* somebody else grew it in the meantime */
+    if (old->fa_size >= size) {
+        free(fa);
+        return 0;
+    }
+
+    memcpy(fa->fa_fds, old->fa_fds, old->fa_size * sizeof(struct fd));
+    memcpy(fa->fa_open, old->fa_open, old->fa_size / FD_BITS * 4);
+
+    rcu_assign_pointer(fdt->fdt_array, fa);
+    call_rcu(&old->fa_rcu, fdarray_free_rcu);
+
+    return 0;
+}
+
+static struct fdtable *
+__fdtable_create(int size)
+{
+    struct fdtable *fdt = malloc(sizeof(*fdt));
+    if (!fdt)
+        return NULL;
+
+    fdt->fdt_array = fdarray_alloc(size);
+    if (!fdt->fdt_array) {
+        free(fdt);
+        return NULL;
+    }
+
+    fdt->fdt_refc = 1;
+    spin_lock_init(&fdt->fdt_lock);
+    fdt->fdt_next = 0;
+
+    return fdt;
+}
+
+/* a new, empty table */
+struct fdtable *
+fdtable_create(void)
+{
+    return __fdtable_create(FD_INIT);
+}
+
+/*
+ * fdtable_copy - a new table with the files of OLD, for fork()
+ *
+ * Each file gets another reference, the descriptor flags are kept.
+ */
+struct fdtable *
+fdtable_copy(struct fdtable *old)
+{
+    struct fdtable *fdt;
+    struct fdarray *fa, *ofa;
+    int i, size;
+
+    for (;;) {
+        size = old->fdt_array->fa_size;
+        fdt = __fdtable_create(size);
+        if (!fdt)
+            return NULL;
+
+        spin_lock(&old->fdt_lock);
+        if (old->fdt_array->fa_size == size)
+            break;
+
+        /* it grew while we weren't looking */
+        spin_unlock(&old->fdt_lock);
+        fdtable_put(fdt);
+    }
+
+    fa = fdt->fdt_array;
+    ofa = old->fdt_array;
+
+    memcpy(fa->fa_fds, ofa->fa_fds, size * sizeof(struct fd));
+    memcpy(fa->fa_open, ofa->fa_open, size / FD_BITS * 4);
+    fdt->fdt_next = old->fdt_next;
+
+    for (i = 0; i < size; i ++)
+        if (fa->fa_fds[i].fd_file)
+            vfs_inc_refc(fa->fa_fds[i].fd_file);
+
+    spin_unlock(&old->fdt_lock);
+
+    return fdt;
+}
+
+void
+fdtable_get(struct fdtable *fdt)
+{
+    __sync_fetch_and_add(&fdt->fdt_refc, 1);
+}
+
+/* drop a reference to FDT, the last one closes the files */
+void
+fdtable_put(struct fdtable *fdt)
+{
+    struct fdarray *fa = fdt->fdt_array;
+    int i;
+
+    if (__sync_sub_and_fetch(&fdt->fdt_refc, 1))
+        return;
+
+    for (i = 0; i < fa->fa_size; i ++)
+        if (fa->fa_fds[i].fd_file)
+            vfs_close(fa->fa_fds[i].fd_file);
+
+    free(fa);
+    free(fdt);
+}
+
+/*
+ * fd_lookup - the file at FD in the table of TASK
+ *
+ * Returns NULL if FD is not open.  No reference is taken.
+ */
+struct file *
+fd_lookup(struct task *task, int fd)
+{
+    struct fdtable *fdt = task->files;
+    struct fdarray *fa;
+    struct file *f = NULL;
+
+    if (!fdt || fd < 0)
+        return NULL;
+
+    rcu_read_lock();
+    fa = rcu_dereference(fdt->fdt_array);
+    if (fd < fa->fa_size)
+        f = fa->fa_fds[fd].fd_file;
+    rcu_read_unlock();
+
+    return f;
+}
+
+/*
+ * fd_alloc - put F in the lowest free slot of TASK from START on
+ *
+ * @task - whose table
+ * @f - the file, the table takes over the caller's reference
+ * @start - the lowest descriptor that will do
+ *
+ * The table grows if it has to.  Returns the descriptor, -EMFILE if there
+ * is none left below FD_MAX or -ENOMEM.
+ */
+int
+fd_alloc(struct task *task, struct file *f, int start)
+{
+    struct fdtable *fdt = task->files;
+    struct fdarray *fa;
+    int fd, rc;
+
+    if (start < 0)
+        return -EINVAL;
+
+    if (!fdt || start >= FD_MAX)
+        return -EMFILE;
+
+    spin_lock(&fdt->fdt_lock);
+
+    for (;;) {
+        fa = fdt->fdt_array;
+        fd = find_next_zero_fd(fa, start > fdt->fdt_next ? start : fdt->fdt_next);
+        if (fd < fa->fa_size)
+            break;
+
+        rc = fdtable_expand(fdt, fd);
+        if (rc) {
+            spin_unlock(&fdt->fdt_lock);
+            return rc;
+        }
+    }
+
+    fa->fa_fds[fd].fd_file = f;
+    fa->fa_fds[fd].fd_flags = 0;
+    __fd_set_open(fa, fd);
+
+    if (start <= fdt->fdt_next)
+        fdt->fdt_next = fd + 1;
+
+    spin_unlock(&fdt->fdt_lock);
+
+    return fd;
+}
+
+/*
+ * fd_install - put F at FD, for dup2()
+ *
+ * The descriptor flags are cleared.  Returns the file that was there, so
+ * the caller can close it, NULL or an ERR_PTR if the table can't grow.
+ */
+struct file *
+fd_install(struct task *task, int fd, struct file *f)
+{
+    struct fdtable *fdt = task->files;
+    struct fdarray *fa;
+    struct file *old;
+    int rc;
+
+    if (!fdt || fd < 0 || fd >= FD_MAX)
+        return ERR_PTR(-EBADF);
+
+    spin_lock(&fdt->fdt_lock);
+
+    while (fd >= fdt->fdt_array->fa_size) {
+        rc = fdtable_expand(fdt, fd);
+        if (rc) {
+            spin_unlock(&fdt->fdt_lock);
+            return ERR_PTR(rc);
+        }
+    }
+
+    fa = fdt->fdt_array;
+    old = fa->fa_fds[fd].fd_file;
+    fa->fa_fds[fd].fd_file = f;
+    fa->fa_fds[fd].fd_flags = 0;
+    __fd_set_open(fa, fd);
+
+    spin_unlock(&fdt->fdt_lock);
+
+    return old;
+}
+
+/* take FD out of the table of TASK, returns the file for the caller to close */
+struct file *
+fd_remove(struct task *task, int fd)
+{
+    struct fdtable *fdt = task->files;
+    struct fdarray *fa;
+    struct file *f = NULL;
+
+    if (!fdt || fd < 0)
+        return NULL;
+
+    spin_lock(&fdt->fdt_lock);
+
+    fa = fdt->fdt_array;
+    if (fd < fa->fa_size && fa->fa_fds[fd].fd_file) {
+        f = fa->fa_fds[fd].fd_file;
+        fa->fa_fds[fd].fd_file = NULL;
+        fa->fa_fds[fd].fd_flags = 0;
+        __fd_clear_open(fa, fd);
+
+        if (fd < fdt->fdt_next)
+            fdt->fdt_next = fd;
+    }
+
+    spin_unlock(&fdt->fdt_lock);
+
+    return f;
+}
+
+/* the FD_* flags of FD, -EBADF if it's not open */
+int
+fd_get_flags(struct task *task, int fd)
+{
+    struct fdtable *fdt = task->files;
+    struct fdarray *fa;
+    int rc = -EBADF;
+
+    if (!fdt || fd < 0)
+        return -EBADF;
+
+    spin_lock(&fdt->fdt_lock);
+    fa = fdt->fdt_array;
+    if (fd < fa->fa_size && fa->fa_fds[fd].fd_file)
+        rc = fa->fa_fds[fd].fd_flags;
+    spin_unlock(&fdt->fdt_lock);
+
+    return rc;
+}
+
+int
+fd_set_flags(struct task *task, int fd, int flags)
+{
+    struct fdtable *fdt = task->files;
+    struct fdarray *fa;
+    int rc = -EBADF;
+
+    if (!fdt || fd < 0)
+        return -EBADF;
+
+    spin_lock(&fdt->fdt_lock);
+    fa = fdt->fdt_array;
+    if (fd < fa->fa_size && fa->fa_fds[fd].fd_file) {
+        fa->fa_fds[fd].fd_flags = flags;
+        rc = 0;
+    }
+    spin_unlock(&fdt->fdt_lock);
+
+    return rc;
+}
+
+/* close what is marked close-on-exec, on execve() */
+void
+task_do_cloexec(struct task *task)
+{
+    struct fdtable *fdt = task->files;
+    struct fdarray *fa;
+    struct file *f;
+    struct fd *slot;
+    int fd;
+
+    if (!fdt)
+        return;
+
+    for (fd = 0; ; fd ++) {
+        f = NULL;
+
+        spin_lock(&fdt->fdt_lock);
+        fa = fdt->fdt_array;
+        if (fd >= fa->fa_size) {
+            spin_unlock(&fdt->fdt_lock);
+            break;
+        }
+
+        slot = &fa->fa_fds[fd];
+        if (slot->fd_file && (slot->fd_file->mode & O_CLOEXEC ||
+                    slot->fd_flags & FD_CLOEXEC)) {
+            f = slot->fd_file;
+            slot->fd_file = NULL;
+            slot->fd_flags = 0;
+            __fd_clear_open(fa, fd);
+
+            if (fd < fdt->fdt_next)
+                fdt->fdt_next = fd;
+        }
+        spin_unlock(&fdt->fdt_lock);
+
+        if (f)
+            vfs_close(f);
+    }
+}
@@ -1,10 +1,13 @@
 #include <levos/fs.h>
 #include <levos/kernel.h>
 #include <levos/list.h>
+#include <levos/rcu.h>
 #include <levos/task.h>
 #include <levos/tty.h>
+#include <levos/time.h>
+#include <levos/sysstat.h>
 
-static size_t
+size_t
 generic_write_buf(int pos, void *buf, size_t len, char *buffer)
 {
     if (pos > strlen(buffer))
@@ -22,17 +25,21 @@ static size_t
 proc_uptime(int pos, void *buf, size_t len, char *buffer)
 {
     char uptime_buf[32];
+    struct timeval tv;
 
-    memset(uptime_buf, 0, 32);
-
-    itoa((uint32_t) time_get_uptime(), 10, uptime_buf);
-
-    uptime_buf[strlen(uptime_buf)] = '\n';
-    uptime_buf[strlen(uptime_buf)] = '\0';
+    time_get_uptime_tv(&tv);
+    snprintf(uptime_buf, sizeof(uptime_buf), "%u.%02u\n",
+            (uint32_t) tv.tv_sec, (uint32_t) tv.tv_usec / 10000);
 
     return generic_write_buf(pos, buf, len, uptime_buf);
 }
 
+/* inodes of /<pid>/sched, /<pid>/syscalls and /<pid>/strace */
+#define PROCFS_SCHED_INODE    0x40000000
+#define PROCFS_SYSCALLS_INODE 0x20000000
+#define PROCFS_STRACE_INODE   0x10000000
+#define PROCFS_PID_MASK       0x0FFFFFFF
+
 struct procfs_file {
     int inode_no;
     char *path;
@@ -46,6 +53,18 @@ extern size_t palloc_proc_memfree(int, void *, size_t, char *);
 extern size_t palloc_proc_memused(int, void *, size_t, char *);
 extern size_t palloc_proc_memtotal(int, void *, size_t, char *);
 extern size_t heap_proc_heapstats(int, void *, size_t, char *);
+extern size_t sched_proc_idle(int, void *, size_t, char *);
+extern size_t sched_proc_stat(int, void *, size_t, char *);
+extern size_t work_proc_timers(int, void *, size_t, char *);
+extern size_t work_proc_workqueues(int, void *, size_t, char *);
+extern size_t softirq_proc_stat(int, void *, size_t, char *);
+extern size_t packet_proc_rxrings(int, void *, size_t, char *);
+extern size_t sysstat_proc_syscalls(int, void *, size_t, char *);
+extern size_t dcache_proc_stat(int, void *, size_t, char *);
+#ifdef CONFIG_LOCK_STAT
+extern size_t spinlock_proc_lockstat(int, void *, size_t, char *);
+#endif
+extern int sched_task_stats_dump(struct task *, char *, size_t);
 
 static struct procfs_file _files[] = {
     { 0x80000001, "/version", generic_write_buf, procfs_version},
@@ -55,6 +74,17 @@ static struct procfs_file _files[] = {
     { 0x80000005, "/memtotal", palloc_proc_memtotal, NULL},
     { 0x80000006, "/heapstats", heap_proc_heapstats, NULL},
     { 0x80000007, "/uptime", proc_uptime, NULL},
+    { 0x80000008, "/idle", sched_proc_idle, NULL},
+    { 0x80000009, "/stat", sched_proc_stat, NULL},
+    { 0x8000000a, "/timers", work_proc_timers, NULL},
+    { 0x8000000b, "/workqueues", work_proc_workqueues, NULL},
+    { 0x8000000c, "/softirqs", softirq_proc_stat, NULL},
+    { 0x8000000e, "/rxrings", packet_proc_rxrings, NULL},
+    { 0x8000000f, "/syscalls", sysstat_proc_syscalls, NULL},
+    { 0x80000010, "/dcache", dcache_proc_stat, NULL},
+#ifdef CONFIG_LOCK_STAT
+    { 0x8000000d, "/lockstat", spinlock_proc_lockstat, NULL},
+#endif
     { 0x00000000, NULL, NULL},
 };
 
@@ -71,6 +101,23 @@ procfs_get_inode(char *path)
     }
 
     /* check for process files */
+    char *slash = strchr(path + 1, '/');
+    if (slash) {
+        int _pid = atoi_10n(path + 1, slash - path - 1);
+
+        if (!get_task_for_pid(_pid))
+            return -1;
+
+        if (strcmp(slash, "/sched") == 0)
+            return _pid | PROCFS_SCHED_INODE;
+        if (strcmp(slash, "/syscalls") == 0)
+            return _pid | PROCFS_SYSCALLS_INODE;
+        if (strcmp(slash, "/strace") == 0)
+            return _pid | PROCFS_STRACE_INODE;
+
+        return -1;
+    }
+
     int _pid = atoi_10(path + 1);
     if (get_task_for_pid(_pid))
         return _pid;
@@ -78,10 +125,36 @@ procfs_get_inode(char *path)
     return -1;
 }
 
+/* a per-process file that DUMP writes out, in at most SIZE bytes */
+static char *
+procfs_create_task_dump(pid_t pid, int (*dump)(struct task *, char *, size_t),
+                        size_t size, size_t *_size)
+{
+    struct task *task;
+    char *buffer;
+
+    buffer = malloc(size);
+    if (!buffer)
+        return NULL;
+
+    rcu_read_lock();
+    task = get_task_for_pid(pid);
+    if (!task) {
+        rcu_read_unlock();
+        free(buffer);
+        return NULL;
+    }
+
+    *_size = dump(task, buffer, size);
+    rcu_read_unlock();
+
+    return buffer;
+}
+
 /* XXX: convert this to sprintf */
 char *
 procfs_create_process_dump(pid_t pid, size_t *_size) {
-    struct task *task = get_task_for_pid(pid);
+    struct task *task;
     char *buffer = malloc(4096);
     char *orig_buffer = buffer;
     char itoa_buffer[16];
@@ -92,7 +165,10 @@ procfs_create_process_dump(pid_t pid, size_t *_size) {
 
     memset(buffer, 0, 4096);
 
+    rcu_read_lock();
+    task = get_task_for_pid(pid);
     if (!task) {
+        rcu_read_unlock();
         free(buffer);
         return NULL;
     }
@@ -131,41 +207,55 @@ procfs_create_process_dump(pid_t pid, size_t *_size) {
         WRITE_INT(task->ctty->tty_id);
         WRITE_NEWLINE;
     }
-
+    rcu_read_unlock();
 
     *_size = size;
 
     return orig_buffer;
 }
 
-size_t procfs_read(struct file *filp, void *buf, size_t len)
+/* read LEN bytes at POS, does not move the file position */
+size_t procfs_pread(struct file *filp, void *buf, size_t len, int pos)
 {
     struct procfs_file *f = &_files[0];
     int i = 0;
 
     if (filp->priv > 0x80000000) {
-        for (i = 0, f = &_files[i]; f && f->path != NULL; f = &_files[++i]) {
-            if (strcmp(filp->respath, f->path) == 0) {
-                int rc = f->write_buf(filp->fpos, buf, len, f->arg);
-                filp->fpos += rc;
-                return rc;
-            }
-        }
+        for (i = 0, f = &_files[i]; f && f->path != NULL; f = &_files[++i])
+            if (strcmp(filp->respath, f->path) == 0)
+                return f->write_buf(pos, buf, len, f->arg);
     } else {
         size_t size;
+        char *dump;
+
+        int inode = (int) filp->priv;
+        pid_t pid = inode & PROCFS_PID_MASK;
+
         /* construct the description */
-        char *dump = procfs_create_process_dump(filp->priv, &size);
+        if (inode & PROCFS_SCHED_INODE)
+            dump = procfs_create_task_dump(pid, sched_task_stats_dump,
+                    1024, &size);
+        else if (inode & PROCFS_SYSCALLS_INODE)
+            dump = procfs_create_task_dump(pid, sysstat_task_dump,
+                    16384, &size);
+        else if (inode & PROCFS_STRACE_INODE)
+            dump = procfs_create_task_dump(pid, systrace_task_dump,
+                    128 * SYSTRACE_ENTRIES, &size);
+        else
+            dump = procfs_create_process_dump(filp->priv, &size);
+
         if (dump == NULL)
             return -ENOENT;
 
-        if (filp->fpos >= size)
+        if (pos >= size) {
+            free(dump);
             return 0;
+        }
 
-        if (len > size - filp->fpos)
-            len = size - filp->fpos;
+        if (len > size - pos)
+            len = size - pos;
 
-        memcpy(buf, dump + filp->fpos, len);
-        filp->fpos += len;
+        memcpy(buf, dump + pos, len);
 
         free(dump);
         return len;
@@ -174,6 +264,16 @@ size_t procfs_read(struct file *filp, void *buf, size_t len)
     return -ENOENT;
 }
 
+size_t procfs_read(struct file *filp, void *buf, size_t len)
+{
+    int rc = procfs_pread(filp, buf, len, filp->fpos);
+
+    if (rc > 0)
+        filp->fpos += rc;
+
+    return rc;
+}
+
 size_t
 procfs_write(struct file *filp, void *buf, size_t len)
 {
@@ -194,75 +294,48 @@ procfs_close(struct file *filp)
     return 0;
 }
 
+/* ".", "..", the running processes and then the files, by index */
 int
-procfs_readdir(struct file *filp, struct linux_dirent *de)
+procfs_iterate(struct file *filp, struct dir_context *ctx)
 {
-    struct procfs_file *f = &_files[0];
-    int i = 0, success = 0;
-    struct task *task = NULL;
-    struct list_elem *elem;
-    char itoa_buf[12];
     extern struct list *__ALL_TASKS_PTR;
-
-    memset(de->d_name, 0, 255);
-
-    if (filp->fpos == 0) {
-        success = 1;
-        de->d_ino = 0;
-        de->d_off = 0;
-        memcpy(de->d_name, ".", 1);
-        de->d_reclen = 11;
-        filp->fpos ++;
-        goto done;
-    }
-
-    if (filp->fpos == 1) {
-        success = 1;
-        de->d_ino = 0;
-        de->d_off = 0;
-        memcpy(de->d_name, "..", 2);
-        de->d_reclen = 12;
+    struct procfs_file *f;
+    struct list_elem *elem;
+    struct task *task;
+    const char *dot;
+    char name[12];
+    int i;
+
+    while (filp->fpos < 2) {
+        dot = filp->fpos == 0 ? "." : "..";
+        if (ctx->actor(ctx, dot, strlen(dot), filp->fpos + 1, 0, DT_DIR))
+            return 0;
         filp->fpos ++;
-        goto done;
     }
 
     i = 2;
 
-    memset(itoa_buf, 0, 12);
-
-    /* start with the running processes */
     list_foreach_raw(__ALL_TASKS_PTR, elem) {
+        if (i ++ < filp->fpos)
+            continue;
+
         task = list_entry(elem, struct task, all_elem);
-        if (i == filp->fpos) {
-            success = 1;
-            de->d_ino = task->pid;
-            de->d_off = 0;
-            itoa(task->pid, 10, itoa_buf);
-            memcpy(de->d_name, itoa_buf, strlen(itoa_buf));
-            de->d_reclen = 10 + strlen(itoa_buf);
-            filp->fpos ++;
-            goto done;
-        }
-        i ++;
+        snprintf(name, sizeof(name), "%d", task->pid);
+        if (ctx->actor(ctx, name, strlen(name), filp->fpos + 1, task->pid,
+                    DT_UNKNOWN))
+            return 0;
+        filp->fpos ++;
     }
 
-    while (f->path) {
-        if (i == filp->fpos) {
-            success = 1;
-            de->d_ino = f->inode_no;
-            de->d_off = 0;
-            memcpy(de->d_name, f->path + 1, strlen(f->path));
-            de->d_reclen = 10 + strlen(f->path);
-            filp->fpos ++;
-            break;
-        }
-        f ++;
-        i ++;
-    }
+    for (f = &_files[0]; f->path; f ++) {
+        if (i ++ < filp->fpos)
+            continue;
 
-done:
-    if (!success)
-        return -ENOSPC;
+        if (ctx->actor(ctx, f->path + 1, strlen(f->path + 1), filp->fpos + 1,
+                    f->inode_no, DT_REG))
+            return 0;
+        filp->fpos ++;
+    }
 
     return 0;
 }
@@ -276,9 +349,12 @@ procfs_ioctl(struct file *filp, unsigned long req, unsigned long arg)
 struct file_operations procfs_fops = {
     .read = procfs_read,
     .write = procfs_write,
+    .pread = procfs_pread,
+    .poll = generic_file_poll,
     .fstat = procfs_fstat,
     .close = procfs_close,
-    .readdir = procfs_readdir,
+    .readdir = generic_readdir,
+    .iterate = procfs_iterate,
 };
 
 struct file *
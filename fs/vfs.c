@@ -1,9 +1,12 @@
 #include <levos/kernel.h>
 #include <levos/fs.h>
 #include <levos/ext2.h>
+#include <levos/dcache.h>
+#include <levos/eventpoll.h>
 #include <levos/string.h>
 #include <levos/list.h>
 #include <levos/task.h>
+#include <levos/poll.h>
 
 #define MAX_MOUNTS 256
 
@@ -207,6 +210,7 @@ vfs_close(struct file *f)
     f->refc --;
 
     if (f->refc == 0) {
+        eventpoll_release(f);
         free(f->full_path);
         f->fops->close(f);
     }
@@ -214,6 +218,407 @@ vfs_close(struct file *f)
     //dump_stack(8);
 }
 
+/*
+ * vfs_readv - read into several buffers
+ *
+ * @f - the file
+ * @iov - the buffers, in kernel memory
+ * @cnt - number of them
+ *
+ * Files that can do better implement ->readv, otherwise this is a read
+ * per segment, stopping at the first short one.  Returns the number of
+ * bytes read, or an error if nothing was.
+ */
+int
+vfs_readv(struct file *f, struct iovec *iov, int cnt)
+{
+    int i, rc, total = 0;
+
+    if (!f->fops->read)
+        return -EINVAL;
+
+    if (f->fops->readv)
+        return f->fops->readv(f, iov, cnt);
+
+    for (i = 0; i < cnt; i ++) {
+        if (iov[i].iov_len == 0)
+            continue;
+
+        rc = f->fops->read(f, iov[i].iov_base, iov[i].iov_len);
+        if (rc < 0)
+            return total ? total : rc;
+
+        total += rc;
+        if (rc < iov[i].iov_len)
+            break;
+    }
+
+    return total;
+}
+
+/* like vfs_readv(), for writing */
+int
+vfs_writev(struct file *f, struct iovec *iov, int cnt)
+{
+    int i, rc, total = 0;
+
+    if (!f->fops->write)
+        return -EINVAL;
+
+    if (f->fops->writev)
+        return f->fops->writev(f, iov, cnt);
+
+    for (i = 0; i < cnt; i ++) {
+        if (iov[i].iov_len == 0)
+            continue;
+
+        rc = f->fops->write(f, iov[i].iov_base, iov[i].iov_len);
+        if (rc < 0)
+            return total ? total : rc;
+
+        total += rc;
+        if (rc < iov[i].iov_len)
+            break;
+    }
+
+    return total;
+}
+
+/*
+ * vfs_pread - read at an offset
+ *
+ * @f - the file
+ * @buf - where to
+ * @count - how much
+ * @pos - offset in the file
+ *
+ * Does not use or move the file position, so it does not race with
+ * others sharing it.  -ESPIPE for files that have no position.
+ */
+int
+vfs_pread(struct file *f, void *buf, size_t count, int pos)
+{
+    if (pos < 0)
+        return -EINVAL;
+
+    if (!f->fops->pread)
+        return -ESPIPE;
+
+    return f->fops->pread(f, buf, count, pos);
+}
+
+/* like vfs_pread(), for writing */
+int
+vfs_pwrite(struct file *f, void *buf, size_t count, int pos)
+{
+    if (pos < 0)
+        return -EINVAL;
+
+    if (!f->fops->pwrite)
+        return -ESPIPE;
+
+    return f->fops->pwrite(f, buf, count, pos);
+}
+
+/*
+ * vfs_poll - the events pending on a file
+ *
+ * @f - the file
+ * @pt - table to queue on the file's wait queues, or NULL
+ */
+int
+vfs_poll(struct file *f, struct poll_table *pt)
+{
+    if (!f->fops->poll)
+        return DEFAULT_POLLMASK;
+
+    return f->fops->poll(f, pt);
+}
+
+/* a regular file never blocks, there is nothing to wait for */
+int
+generic_file_poll(struct file *f, struct poll_table *pt)
+{
+    return DEFAULT_POLLMASK;
+}
+
+/*
+ * vfs_fsync - get what was written to F to the disk
+ *
+ * Writes go straight to the device unless the file has a ->fsync, so
+ * without one this returns right away.
+ */
+int
+vfs_fsync(struct file *f)
+{
+    if (!f->fops->fsync)
+        return 0;
+
+    return f->fops->fsync(f);
+}
+
+/*
+ * vfs_read_at - read from F at *PPOS and move it along
+ *
+ * With PPOS NULL this is a plain read at the file position.
+ */
+int
+vfs_read_at(struct file *f, void *buf, size_t len, int *ppos)
+{
+    int rc;
+
+    if (!ppos)
+        return f->fops->read(f, buf, len);
+
+    rc = vfs_pread(f, buf, len, *ppos);
+    if (rc > 0)
+        *ppos += rc;
+
+    return rc;
+}
+
+/* the bounce buffer of generic_splice() */
+#define SPLICE_CHUNK 4096
+
+/*
+ * generic_splice - vfs_splice() for files that can't do better
+ *
+ * Goes through a kernel buffer, which still saves the trip through the
+ * process.  What OUT didn't take is given back to IN if it can seek.
+ */
+int
+generic_splice(struct file *in, int *ppos, struct file *out, size_t len)
+{
+    size_t chunk, total = 0;
+    int rc = 0, wr, unread;
+    void *buf;
+
+    buf = malloc(SPLICE_CHUNK);
+    if (!buf)
+        return -ENOMEM;
+
+    while (total < len) {
+        chunk = len - total;
+        if (chunk > SPLICE_CHUNK)
+            chunk = SPLICE_CHUNK;
+
+        rc = vfs_read_at(in, buf, chunk, ppos);
+        if (rc <= 0)
+            break;
+
+        wr = out->fops->write(out, buf, rc);
+        if (wr != rc) {
+            unread = rc - (wr > 0 ? wr : 0);
+            if (ppos)
+                *ppos -= unread;
+            else if (in->fops->pread)
+                in->fpos -= unread;
+
+            if (wr > 0)
+                total += wr;
+            rc = wr;
+            break;
+        }
+
+        total += rc;
+
+        if (rc < chunk)
+            break;
+    }
+
+    free(buf);
+
+    return total ? (int) total : rc;
+}
+
+/*
+ * vfs_splice - move LEN bytes from IN to OUT in the kernel
+ *
+ * @in - where from
+ * @ppos - where in IN, NULL for its file position
+ * @out - where to, always at its file position
+ * @len - how much at most
+ *
+ * OUT filling itself from IN is preferred, as that can put the data right
+ * where it goes (a packet, the pipe's ring), then IN handing over its own
+ * buffers.  Returns how much was moved, or a negative error if nothing was.
+ */
+int
+vfs_splice(struct file *in, int *ppos, struct file *out, size_t len)
+{
+    if (in->isdir || out->isdir)
+        return -EISDIR;
+
+    if (len == 0)
+        return 0;
+
+    if (out->fops->splice_write)
+        return out->fops->splice_write(out, in, ppos, len);
+
+    if (in->fops->splice_read)
+        return in->fops->splice_read(in, ppos, out, len);
+
+    return generic_splice(in, ppos, out, len);
+}
+
+struct getdents_ctx {
+    struct dir_context gc_ctx;
+    char *gc_buf;
+    size_t gc_size;
+    size_t gc_used;
+
+    /* an entry didn't fit */
+    int gc_full;
+};
+
+/* pack one record in, if there's still room for it */
+static int
+getdents_fill(struct dir_context *ctx, const char *name, int len, int off,
+              unsigned long ino, unsigned int type)
+{
+    struct getdents_ctx *gc = container_of(ctx, struct getdents_ctx, gc_ctx);
+    struct getdents_dirent *d;
+    size_t reclen;
+
+    /* the name, its NUL and d_type, rounded up to a long */
+    reclen = (offsetof(struct getdents_dirent, d_name) + len + 2 + 3) & ~3;
+    if (gc->gc_used + reclen > gc->gc_size) {
+        gc->gc_full = 1;
+        return 1;
+    }
+
+    d = (struct getdents_dirent *) (gc->gc_buf + gc->gc_used);
+    memset(d, 0, reclen);
+    d->d_ino = ino;
+    d->d_off = off;
+    d->d_reclen = reclen;
+    memcpy(d->d_name, name, len);
+    ((char *) d)[reclen - 1] = type;
+
+    gc->gc_used += reclen;
+
+    return 0;
+}
+
+/* ->iterate for directories that only have ->readdir, one entry at a time */
+static int
+readdir_iterate(struct file *f, struct dir_context *ctx)
+{
+    struct linux_dirent *de;
+    int pos, len;
+
+    de = malloc(sizeof(*de));
+    if (!de)
+        return -ENOMEM;
+
+    for (;;) {
+        pos = f->fpos;
+        if (f->fops->readdir(f, de))
+            break;
+
+        for (len = 0; len < sizeof(de->d_name) && de->d_name[len]; len ++)
+            ;
+
+        if (ctx->actor(ctx, de->d_name, len, f->fpos, de->d_ino, DT_UNKNOWN)) {
+            f->fpos = pos;
+            break;
+        }
+    }
+
+    free(de);
+
+    return 0;
+}
+
+/*
+ * vfs_getdents - as many entries of F as fit in BUF
+ *
+ * @f - the directory
+ * @buf - where the struct getdents_dirent records go
+ * @size - the size of BUF
+ *
+ * Returns the bytes used, 0 at the end of the directory and -EINVAL if
+ * not even the next entry fits.
+ */
+int
+vfs_getdents(struct file *f, void *buf, size_t size)
+{
+    struct getdents_ctx gc;
+    int rc;
+
+    if (!f->isdir)
+        return -ENOTDIR;
+
+    gc.gc_ctx.actor = getdents_fill;
+    gc.gc_buf = buf;
+    gc.gc_size = size;
+    gc.gc_used = 0;
+    gc.gc_full = 0;
+
+    if (f->fops->iterate)
+        rc = f->fops->iterate(f, &gc.gc_ctx);
+    else if (f->fops->readdir)
+        rc = readdir_iterate(f, &gc.gc_ctx);
+    else
+        return -ENOTDIR;
+
+    if (gc.gc_used)
+        return gc.gc_used;
+
+    if (rc < 0)
+        return rc;
+
+    return gc.gc_full ? -EINVAL : 0;
+}
+
+struct readdir_ctx {
+    struct dir_context rc_ctx;
+    struct linux_dirent *rc_de;
+    int rc_done;
+};
+
+static int
+readdir_fill(struct dir_context *ctx, const char *name, int len, int off,
+             unsigned long ino, unsigned int type)
+{
+    struct readdir_ctx *rc = container_of(ctx, struct readdir_ctx, rc_ctx);
+    struct linux_dirent *de = rc->rc_de;
+
+    if (rc->rc_done)
+        return 1;
+
+    if (len > sizeof(de->d_name))
+        len = sizeof(de->d_name);
+
+    memset(de, 0, sizeof(*de));
+    de->d_ino = ino;
+    de->d_off = off;
+    de->d_reclen = 10 + len;
+    memcpy(de->d_name, name, len);
+
+    rc->rc_done = 1;
+
+    return 0;
+}
+
+/* ->readdir for the filesystems with ->iterate, -ENOSPC at the end */
+int
+generic_readdir(struct file *f, struct linux_dirent *de)
+{
+    struct readdir_ctx rc;
+    int err;
+
+    rc.rc_ctx.actor = readdir_fill;
+    rc.rc_de = de;
+    rc.rc_done = 0;
+
+    err = f->fops->iterate(f, &rc.rc_ctx);
+    if (err < 0)
+        return err;
+
+    return rc.rc_done ? 0 : -ENOSPC;
+}
+
 void
 vfs_inc_refc(struct file *f)
 {
@@ -328,6 +733,8 @@ int vfs_init(void)
     printk("vfs: loading filesystems\n");
     fs_ops_n = 0;
 
+    dcache_init();
+    eventpoll_init();
     ext2_init();
     procfs_init();
     devfs_init();
@@ -491,18 +898,3 @@ canonicalize_path(char *cwd, char *ap)
 	/* And return a working, absolute path */
 	return output;
 }
-
-void
-task_do_cloexec(struct task *task)
-{
-    int i;
-
-    for (i = 0; i < FD_MAX; i ++) {
-        struct file *f = task->file_table[i];
-        if (f && f->mode & O_CLOEXEC || task->file_table_flags[i] & FD_CLOEXEC) {
-            vfs_close(f);
-            task->file_table[i] = NULL;
-            task->file_table_flags[i] = 0;
-        }
-    }
-}
@@ -27,7 +27,22 @@ struct console *arch_get_console(void);
 void arch_switch_timer_sched(void);
 
 void arch_spin_lock(volatile int *);
+int arch_spin_trylock(volatile int *);
 void arch_spin_unlock(volatile int *);
+uint32_t arch_spin_lock_irqsave(volatile int *);
+void arch_spin_unlock_irqrestore(volatile int *, uint32_t);
+
+void arch_cpu_idle(void);
+void arch_timer_stop_tick(uint32_t);
+void arch_timer_restart_tick(void);
+void arch_smp_boot(void);
+
+struct timesource;
+struct timesource *arch_timesource_init(uint64_t);
+
+void arch_switch_to(uint32_t *, uint32_t, int *);
+void arch_switch_resume(uint32_t, int *);
+void arch_switch_to_regs(uint32_t *, struct pt_regs *, int *);
 
 void dump_registers(struct pt_regs *);
 
@@ -1,6 +1,34 @@
 #ifndef __LEVOS_ARITHMETIC_H
 #define __LEVOS_ARITHMETIC_H
 
+#include <levos/types.h>
+
 #define DIV_ROUND_UP(X, STEP) (((X) + (STEP) - 1) / (STEP))
 
+/*
+ * div_u64_rem - divide a 64 bit number by a 32 bit one
+ *
+ * @n - dividend
+ * @d - divisor
+ * @rem - where to store the remainder, may be NULL
+ *
+ * We don't link against libgcc, so '/' on an uint64_t won't link.
+ */
+static inline uint64_t
+div_u64_rem(uint64_t n, uint32_t d, uint32_t *rem)
+{
+    uint32_t hi = n >> 32, lo = n, q_hi, q_lo, r;
+
+    q_hi = hi / d;
+    r = hi % d;
+
+    /* r < d, so the quotient fits in 32 bits */
+    asm("divl %4" : "=a"(q_lo), "=d"(r) : "a"(lo), "d"(r), "rm"(d));
+
+    if (rem)
+        *rem = r;
+
+    return ((uint64_t) q_hi << 32) | q_lo;
+}
+
 #endif /* __LEVOS_ARITHMETIC_H */
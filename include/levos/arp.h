@@ -51,6 +51,6 @@ int arp_handle_packet(struct net_info *, packet_t *, struct arp_header *);
 /* ARP cache */
 int arp_cache_init(void);
 int arp_cache_insert(ip_addr_t, eth_addr_t);
-uint8_t *arp_get_eth_addr(struct net_info *, ip_addr_t);
+int arp_get_eth_addr(struct net_info *, ip_addr_t, eth_addr_t);
 
 #endif
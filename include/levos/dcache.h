@@ -0,0 +1,38 @@
+#ifndef __LEVOS_DCACHE_H
+#define __LEVOS_DCACHE_H
+
+#include <levos/types.h>
+#include <levos/hash.h>
+#include <levos/list.h>
+
+struct filesystem;
+
+/* the most entries kept, the least recently used one goes first */
+#define DCACHE_MAX 512
+
+/* longer names are not worth caching, they are looked up on disk */
+#define DCACHE_NAME_MAX 64
+
+/*
+ * What NAME in the directory DE_DIR of DE_FS resolved to: an inode number,
+ * or -ENOENT if it's not there, so a miss doesn't go to the disk again
+ * either.
+ */
+struct dentry {
+    struct hash_elem de_helem;
+    struct list_elem de_lru;
+
+    struct filesystem *de_fs;
+    int de_dir;
+    int de_ino;
+
+    int de_len;
+    char de_name[];
+};
+
+void dcache_init(void);
+int dcache_lookup(struct filesystem *, int, char *, int, unsigned *);
+void dcache_add(struct filesystem *, int, char *, int, int, unsigned);
+void dcache_invalidate(struct filesystem *, int, char *, int);
+
+#endif /* __LEVOS_DCACHE_H */
@@ -2,6 +2,7 @@
 #define __LEVOS_DEVICE_H
 
 #include <levos/types.h>
+#include <levos/mutex.h>
 
 struct filesystem;
 struct tty_device;
@@ -28,6 +29,9 @@ struct device
 
     unsigned long pos;
 
+    /* serializes users of pos, see dev_read_at() */
+    struct mutex dev_lock;
+
     struct filesystem *fs;
 
     char *name;
@@ -43,5 +47,7 @@ extern struct device *block_devices[];
 void device_register(struct device *);
 void dev_init(void);
 void dev_seek(struct device *, int);
+size_t dev_read_at(struct device *, void *, size_t, unsigned long);
+size_t dev_write_at(struct device *, void *, size_t, unsigned long);
 
 #endif /* __LEVOS_DEVICE_H */
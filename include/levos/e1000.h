@@ -4,6 +4,7 @@
 #include <levos/types.h>
 #include <levos/compiler.h>
 #include <levos/packet.h>
+#include <levos/softirq.h>
 
 #define INTEL_VEND     0x8086  // Vendor ID for Intel 
 #define E1000_DEV      0x100E  // Device ID for the e1000 Qemu, Bochs, and VirtualBox emmulated NICs
@@ -136,6 +137,9 @@ struct e1000_device {
     struct net_device ndev;
 
     struct pci_device *pdev;
+
+    /* takes the received packets off the ring, see e1000_irq_handler */
+    struct tasklet rx_tasklet;
 };
 
 
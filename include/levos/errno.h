@@ -36,14 +36,17 @@
 #define    EDOM          33    /* Math argument out of domain of func */
 #define    ERANGE        34    /* Math result not representable */
 #define    ENOSYS        35    /* No such system call */
+#define    ENAMETOOLONG  36    /* File name too long */
 
 #define    ENOTSOCK      88    /* Socket operation on non-socket */
 #define    EAFNOSUPPORT  97    /* Address family not supported by protocol */
 #define    EADDRINUSE    98    /* Address already in use */
+#define    ENETUNREACH   101   /* Network is unreachable */
 #define    ECONNRESET    104   /* Connection reset by peer */
 #define    ENOTCONN      107   /* Transport endpoint is not connected */
 #define    ETIMEDOUT     110   /* Connection timed out */
 #define    ECONNREFUSED  111   /* Connection refused */
+#define    EHOSTUNREACH  113   /* No route to host */
 
 #define MAX_ERRNO 4095
 
@@ -91,11 +94,14 @@ inline const char *errno_to_string(int errno)
         case EDOM: return "EDOM";
         case ERANGE: return "ERANGE";
         case ENOSYS: return "ENOSYS";
+        case ENAMETOOLONG: return "ENAMETOOLONG";
         case EADDRINUSE: return "EADDRINUSE";
         case ETIMEDOUT: return "ETIMEDOUT";
         case ECONNREFUSED: return "ECONNREFUSED";
         case ENOTCONN: return "ENOTCONN";
         case ECONNRESET: return "ECONNRESET";
+        case ENETUNREACH: return "ENETUNREACH";
+        case EHOSTUNREACH: return "EHOSTUNREACH";
     }
     return "UNKNOWN";
 }
@@ -0,0 +1,114 @@
+#ifndef __LEVOS_EVENTPOLL_H
+#define __LEVOS_EVENTPOLL_H
+
+#include <levos/types.h>
+#include <levos/list.h>
+#include <levos/hash.h>
+#include <levos/mutex.h>
+#include <levos/spinlock.h>
+#include <levos/wait.h>
+#include <levos/poll.h>
+
+struct file;
+
+/* the events are the POLL* ones, plus these, as on Linux */
+#define EPOLLIN      POLLIN
+#define EPOLLPRI     POLLPRI
+#define EPOLLOUT     POLLOUT
+#define EPOLLERR     POLLERR
+#define EPOLLHUP     POLLHUP
+#define EPOLLRDNORM  POLLRDNORM
+#define EPOLLWRNORM  POLLWRNORM
+#define EPOLLONESHOT (1U << 30) /* disable after the first event */
+#define EPOLLET      (1U << 31) /* only report when it changes */
+
+#define EP_PRIVATE_BITS (EPOLLONESHOT | EPOLLET)
+
+#define EPOLL_CTL_ADD 1
+#define EPOLL_CTL_DEL 2
+#define EPOLL_CTL_MOD 3
+
+/* epoll_wait() hands out at most this many events per call */
+#define EP_MAX_BATCH 256
+
+struct epoll_event {
+    uint32_t events;
+    uint64_t data;
+};
+
+/* the most wait queues one file's ->poll queues us on */
+#define EP_MAX_WAIT 2
+
+struct epitem;
+
+struct ep_wait {
+    wait_queue_t *ew_wq;
+    struct wait_queue_entry ew_wqe;
+    struct epitem *ew_epi;
+};
+
+/*
+ * A file in the set of an eventpoll.  It doesn't hold a reference to the
+ * file: the file stays in the set until it's deleted from it or the last
+ * reference to it is dropped, see eventpoll_release().
+ */
+struct epitem {
+    struct eventpoll *epi_ep;
+    struct file *epi_file;
+    int epi_fd;
+    struct epoll_event epi_event;
+
+    struct hash_elem epi_helem;
+
+    /* on the ef_items of the file */
+    struct list_elem epi_fllink;
+
+    /* on ep_rdllist, if epi_ready */
+    struct list_elem epi_rdllink;
+    int epi_ready;
+
+    /* the level triggered ones epoll_wait() puts back */
+    struct list_elem epi_txlink;
+
+    struct poll_table epi_pt;
+    int epi_nwait;
+    struct ep_wait epi_wait[EP_MAX_WAIT];
+};
+
+/*
+ * An epoll instance.  Each of its files has a callback on the file's wait
+ * queues that puts it on the ready list, so epoll_wait() only looks at the
+ * files that were woken, however many there are in the set.
+ */
+struct eventpoll {
+    /* serializes epoll_ctl() and epoll_wait() */
+    struct mutex ep_mtx;
+
+    /* the epitems by fd and file, under ep_mtx */
+    struct hash ep_items;
+
+    /* protects the ready list, taken from wakeups */
+    spinlock_t ep_lock;
+    struct list ep_rdllist;
+    int ep_nready;
+
+    /* woken when something becomes ready */
+    wait_queue_t ep_wq;
+};
+
+/* the epitems of a file, in every set it is in */
+struct ep_file {
+    struct hash_elem ef_helem;
+    struct file *ef_file;
+    struct list ef_items;
+};
+
+void eventpoll_init(void);
+void eventpoll_release(struct file *);
+
+struct file *eventpoll_create(void);
+int eventpoll_ctl(struct file *, int, int, struct file *, struct epoll_event *);
+int eventpoll_wait(struct file *, struct epoll_event *, int, int);
+int is_eventpoll_file(struct file *);
+
+#endif /* __LEVOS_EVENTPOLL_H */
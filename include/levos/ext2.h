@@ -3,6 +3,7 @@
 
 #include <levos/kernel.h>
 #include <levos/types.h>
+#include <levos/mutex.h>
 
 #define EXT2_SIGNATURE 0xEF53
 
@@ -95,6 +96,11 @@ struct ext2_priv_data {
     uint32_t inodesize;
     uint32_t sectors_per_block;
     uint32_t inodes_per_block;
+
+    /* the bitmaps, the BGDT and the superblock's counters */
+    struct mutex alloc_lock;
+    /* read-modify-writes of inode table blocks */
+    struct mutex itable_lock;
 };
 
 struct ext2_file_priv {
@@ -0,0 +1,61 @@
+#ifndef __LEVOS_FDTABLE_H
+#define __LEVOS_FDTABLE_H
+
+#include <levos/types.h>
+#include <levos/fs.h>
+#include <levos/spinlock.h>
+#include <levos/rcu.h>
+
+struct task;
+
+/* the most descriptors a table grows to */
+#define FD_MAX 1024
+
+/* the size of a new table, it doubles from there when it runs out */
+#define FD_INIT 32
+
+#define FD_BITS 32
+
+/*
+ * The slots of a table, and a bit per slot that is in use.  Replaced as a
+ * whole when the table grows, the old one is freed after an RCU grace
+ * period, so fd_lookup() never needs the lock.
+ */
+struct fdarray {
+    struct rcu_head fa_rcu;
+    int fa_size;
+    uint32_t *fa_open;
+    struct fd fa_fds[];
+};
+
+/*
+ * The descriptors of a task.  It is reference counted, so that tasks can
+ * share one: the files are closed when the last of them lets go.
+ */
+struct fdtable {
+    int fdt_refc;
+
+    /* serializes the changes, lookups go without it */
+    spinlock_t fdt_lock;
+
+    struct fdarray *fdt_array;
+
+    /* every slot below this is in use */
+    int fdt_next;
+};
+
+struct fdtable *fdtable_create(void);
+struct fdtable *fdtable_copy(struct fdtable *);
+void fdtable_get(struct fdtable *);
+void fdtable_put(struct fdtable *);
+
+struct file *fd_lookup(struct task *, int);
+int fd_alloc(struct task *, struct file *, int);
+struct file *fd_install(struct task *, int, struct file *);
+struct file *fd_remove(struct task *, int);
+int fd_get_flags(struct task *, int);
+int fd_set_flags(struct task *, int, int);
+
+void task_do_cloexec(struct task *);
+
+#endif /* __LEVOS_FDTABLE_H */
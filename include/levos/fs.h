@@ -4,6 +4,7 @@
 #include <levos/kernel.h>
 #include <levos/types.h>
 #include <levos/device.h>
+#include <levos/uio.h>
 
 struct filesystem;
 
@@ -16,6 +17,7 @@ struct mount {
 
 struct file;
 struct stat;
+struct poll_table;
 
 struct linux_dirent {
     unsigned long  d_ino;
@@ -24,6 +26,37 @@ struct linux_dirent {
     char           d_name[255];
 };
 
+/*
+ * The records getdents(2) packs into its buffer, each d_reclen bytes long.
+ * The name is NUL terminated and d_type is the last byte of the record.
+ */
+struct getdents_dirent {
+    unsigned long  d_ino;
+    unsigned long  d_off;
+    unsigned short d_reclen;
+    char           d_name[];
+};
+
+/* d_type */
+#define DT_UNKNOWN 0
+#define DT_FIFO    1
+#define DT_CHR     2
+#define DT_DIR     4
+#define DT_BLK     6
+#define DT_REG     8
+#define DT_LNK     10
+#define DT_SOCK    12
+
+/*
+ * A walk over a directory, see ->iterate.  The actor gets the name, the
+ * position of the entry after it, the inode and the DT_* type, and returns
+ * non-zero to stop before taking the entry.
+ */
+struct dir_context {
+    int (*actor)(struct dir_context *, const char *, int, int,
+                 unsigned long, unsigned int);
+};
+
 struct file_operations {
     size_t (*read)(struct file *, void *, size_t);
     size_t (*write)(struct file *, void *, size_t);
@@ -32,6 +65,40 @@ struct file_operations {
     int (*close)(struct file *);
     int (*readdir)(struct file *, struct linux_dirent *);
     int (*ioctl)(struct file *, unsigned long, unsigned long arg);
+
+    /* optional, I/O at an offset that leaves fpos alone */
+    size_t (*pread)(struct file *, void *, size_t, int);
+    size_t (*pwrite)(struct file *, void *, size_t, int);
+
+    /* optional, without them each segment is a separate read or write */
+    size_t (*readv)(struct file *, struct iovec *, int);
+    size_t (*writev)(struct file *, struct iovec *, int);
+
+    /*
+     * optional, returns the POLL* mask and queues the table on what wakes
+     * when it changes, see poll_wait().  Without it the file is always
+     * ready.
+     */
+    int (*poll)(struct file *, struct poll_table *);
+
+    /* optional, nothing is cached without it so there is nothing to do */
+    int (*fsync)(struct file *);
+
+    /*
+     * optional, moves data between files without a copy through a
+     * buffer of its own, see vfs_splice().  ->splice_write fills this file
+     * by reading the other one straight into where the data goes,
+     * ->splice_read hands the buffers of this one to the other's ->write.
+     */
+    int (*splice_write)(struct file *out, struct file *in, int *, size_t);
+    int (*splice_read)(struct file *in, int *, struct file *out, size_t);
+
+    /*
+     * optional, hands the entries from fpos on to the actor and leaves
+     * fpos at the first one it didn't take.  getdents() falls back to
+     * ->readdir without it, generic_readdir() is ->readdir on top of it.
+     */
+    int (*iterate)(struct file *, struct dir_context *);
 };
 
 #define O_RDONLY  0
@@ -53,10 +120,12 @@ struct file_operations {
 #define F_GETFL 3
 #define F_SETFL 4
 
-#define FILE_TYPE_NORMAL 0
-#define FILE_TYPE_SOCKET 1
-#define FILE_TYPE_TTY    2
-#define FILE_TYPE_PIPE   3
+#define FILE_TYPE_NORMAL   0
+#define FILE_TYPE_SOCKET   1
+#define FILE_TYPE_TTY      2
+#define FILE_TYPE_PIPE     3
+#define FILE_TYPE_EPOLL    4
+#define FILE_TYPE_IO_URING 5
 
 struct fd {
     int          fd_flags;
@@ -122,6 +191,22 @@ int vfs_stat(char *, struct stat *);
 struct file *dup_file(struct file *);
 struct file *vfs_create(char *);
 void vfs_close(struct file *);
+void vfs_inc_refc(struct file *);
+int vfs_readv(struct file *, struct iovec *, int);
+int vfs_writev(struct file *, struct iovec *, int);
+int vfs_pread(struct file *, void *, size_t, int);
+int vfs_pwrite(struct file *, void *, size_t, int);
+int vfs_poll(struct file *, struct poll_table *);
+int generic_file_poll(struct file *, struct poll_table *);
+int vfs_fsync(struct file *);
+int vfs_read_at(struct file *, void *, size_t, int *);
+int vfs_splice(struct file *, int *, struct file *, size_t);
+int generic_splice(struct file *, int *, struct file *, size_t);
+int vfs_getdents(struct file *, void *, size_t);
+int generic_readdir(struct file *, struct linux_dirent *);
+
+/* procfs helper: copy LEN bytes at POS of the string BUFFER to BUF */
+size_t generic_write_buf(int, void *, size_t, char *);
 
 /* path manipulation stuff */
 inline char *
@@ -0,0 +1,166 @@
+#ifndef __LEVOS_IO_URING_H
+#define __LEVOS_IO_URING_H
+
+#include <levos/types.h>
+#include <levos/list.h>
+#include <levos/spinlock.h>
+#include <levos/wait.h>
+#include <levos/poll.h>
+
+struct file;
+struct work;
+
+/* the operations, same numbers as on Linux */
+#define IORING_OP_NOP      0
+#define IORING_OP_FSYNC    3
+#define IORING_OP_POLL_ADD 6
+#define IORING_OP_READ     22
+#define IORING_OP_WRITE    23
+#define IORING_OP_SEND     26
+#define IORING_OP_RECV     27
+
+/* sqe->off for I/O at the file position, rather than at an offset */
+#define IORING_OFF_FPOS 0xFFFFFFFF
+
+/* io_uring_setup() flags */
+#define IORING_SETUP_CQSIZE (1 << 3) /* cq_entries is set */
+
+/* io_uring_enter() flags */
+#define IORING_ENTER_GETEVENTS (1 << 0)
+
+#define IORING_MAX_ENTRIES 4096
+
+struct io_uring_sqe {
+    uint8_t  opcode;
+    uint8_t  flags;
+    uint16_t ioprio;
+    int32_t  fd;
+    uint32_t off;
+    uint32_t addr;
+    uint32_t len;
+    uint32_t poll_events;
+    uint64_t user_data;
+};
+
+struct io_uring_cqe {
+    uint64_t user_data;
+    int32_t  res;
+    uint32_t flags;
+};
+
+/*
+ * The rings live in memory of the process, handed in at setup.  The
+ * process fills sqes[tail & ring_mask] and moves tail, the kernel moves
+ * head as it takes them.  It's the other way around for the completion
+ * ring.
+ */
+struct io_uring_sq {
+    uint32_t head;
+    uint32_t tail;
+    uint32_t ring_mask;
+    uint32_t ring_entries;
+    struct io_uring_sqe sqes[];
+};
+
+struct io_uring_cq {
+    uint32_t head;
+    uint32_t tail;
+    uint32_t ring_mask;
+    uint32_t ring_entries;
+    struct io_uring_cqe cqes[];
+};
+
+#define IO_URING_SQ_SIZE(n) (sizeof(struct io_uring_sq) + \
+                                (n) * sizeof(struct io_uring_sqe))
+#define IO_URING_CQ_SIZE(n) (sizeof(struct io_uring_cq) + \
+                                (n) * sizeof(struct io_uring_cqe))
+
+struct io_uring_params {
+    uint32_t sq_entries;
+    uint32_t cq_entries;
+    uint32_t flags;
+    uint32_t resv;
+    struct io_uring_sq *sq_ring;
+    struct io_uring_cq *cq_ring;
+};
+
+/* the most wait queues one file's ->poll queues a request on */
+#define IO_MAX_WAIT 2
+
+/* where a request is */
+#define IO_REQ_POLLING   0 /* waiting for the file to be ready */
+#define IO_REQ_QUEUED    1 /* its work is queued or running */
+#define IO_REQ_DONE      2 /* on ctx_done, waiting to be posted */
+#define IO_REQ_CANCELLED 3
+
+struct io_kiocb;
+
+struct io_poll_wait {
+    wait_queue_t *iw_wq;
+    struct wait_queue_entry iw_wqe;
+    struct io_kiocb *iw_req;
+};
+
+struct io_kiocb {
+    struct io_ring_ctx *req_ctx;
+    struct io_uring_sqe req_sqe;
+    struct file *req_file;
+    int req_state;
+    int req_res;
+
+    /* woken while IO_REQ_QUEUED, the worker has to look again */
+    int req_rewake;
+
+    /* what the file has to be ready for before the I/O is started */
+    int req_wait_mask;
+
+    /* the data, copied in at submit or out when posted */
+    void *req_buf;
+
+    /* the next run of the request, freed by the worker after that */
+    struct work *req_work;
+
+    struct poll_table req_pt;
+    int req_nwait;
+    struct io_poll_wait req_wait[IO_MAX_WAIT];
+
+    /* on ctx_inflight until the worker is done, then on ctx_done */
+    struct list_elem req_elem;
+};
+
+/*
+ * A pair of rings.  The kernel only touches the rings from system calls
+ * of the process, the workers do the I/O on kernel buffers and leave the
+ * requests on ctx_done.
+ */
+struct io_ring_ctx {
+    struct io_uring_sq *ctx_sq;
+    struct io_uring_cq *ctx_cq;
+    uint32_t ctx_sq_entries;
+    uint32_t ctx_cq_entries;
+
+    /* our copies, the ones in the rings are only written */
+    uint32_t ctx_sq_head;
+    uint32_t ctx_cq_tail;
+
+    /* protects everything below, taken from wakeups */
+    spinlock_t ctx_lock;
+    struct list ctx_inflight;
+    struct list ctx_done;
+    int ctx_ndone;
+
+    /* requests not posted yet, at most ctx_cq_entries */
+    int ctx_nr_reqs;
+
+    /* the file is gone, the workers free what they finish */
+    int ctx_dead;
+
+    /* woken when a request is done */
+    wait_queue_t ctx_wq;
+};
+
+struct file *io_uring_create(struct io_uring_params *);
+int io_uring_enter(struct file *, unsigned int, unsigned int, unsigned int);
+int is_io_uring_file(struct file *);
+
+#endif /* __LEVOS_IO_URING_H */
@@ -27,6 +27,7 @@ extern void *_kernel_end, *_kernel_start;
 #define ROUND_UP(N, S) ((((N) + (S) - 1) / (S)) * (S))
 
 void printk(char *, ...);
+int snprintf(char *, size_t, const char *, ...);
 void __noreturn panic(char *, ...);
 
 #define panic_on(cond, fmt, ...) if (cond) panic(fmt,##__VA_ARGS__);
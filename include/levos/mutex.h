@@ -0,0 +1,25 @@
+#ifndef __LEVOS_MUTEX_H
+#define __LEVOS_MUTEX_H
+
+#include <levos/types.h>
+#include <levos/wait.h>
+
+struct task;
+
+/*
+ * A lock that sleeps when it is contended, for sections that may block
+ * themselves, e.g. on disk I/O.  Only for task context, and only the owner
+ * may unlock it.  Taking it when it's free is a single cmpxchg.
+ */
+struct mutex {
+    struct task *volatile m_owner;
+    wait_queue_t m_waiters;
+};
+
+void mutex_init(struct mutex *);
+void mutex_lock(struct mutex *);
+int mutex_trylock(struct mutex *);
+void mutex_unlock(struct mutex *);
+int mutex_is_locked(struct mutex *);
+
+#endif /* __LEVOS_MUTEX_H */
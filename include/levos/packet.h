@@ -32,6 +32,27 @@ typedef struct {
 #define NI_DHCP_STATE_OFFER    2 /* we received an offer */
 #define NI_DHCP_STATE_VALID    3 /* ni_src_ip is valid and based on DHCP */
 
+/*
+ * Received packets on their way from the NIC's bottom half to the packet
+ * processor thread.  There is exactly one producer and one consumer, so
+ * the ring needs no lock: only the producer moves pr_head, only the
+ * consumer pr_tail.
+ */
+#define PACKET_RING_SIZE 256 /* a power of two */
+
+struct packet_desc {
+    void *pd_data;
+    size_t pd_len;
+};
+
+struct packet_ring {
+    volatile uint32_t pr_head;
+    volatile uint32_t pr_tail;
+    uint32_t pr_received;
+    uint32_t pr_drops; /* the ring was full */
+    struct packet_desc pr_descs[PACKET_RING_SIZE];
+};
+
 struct net_info {
     uint8_t ni_hw_mac[6]; /* our HW/MAC address */
     uint32_t ni_src_ip; /* our IPv4 address */
@@ -45,6 +66,7 @@ struct net_info {
                                     the private state of the socket
                                 */
     spinlock_t ni_tcp_infos_lock; /* lock for the table */
+    struct packet_ring ni_rx_ring; /* see packet_push_queue() */
 };
 void net_info_init(struct net_info *);
 
@@ -43,6 +43,12 @@ typedef pde_t       *pagedir_t;
 #define PG_R_RO       0
 #define PG_R_RW       1
 
+/*
+ * The last 4 MB hold kernel pages that every process may read, see
+ * map_user_shared()
+ */
+#define USER_SHARED_BASE 0xFFC00000
+
 #define PG_RND_DOWN(a) ROUND_DOWN(a, 0x1000)
 #define PG_RND_UP(a) ROUND_UP(a, 0x1000)
 
@@ -50,6 +56,7 @@ void paging_init(void);
 int map_page(pagedir_t, uint32_t, uint32_t, int);
 int map_page_curr(uint32_t, uint32_t, int);
 int map_page_kernel(uint32_t, uint32_t, int);
+void map_user_shared(uint32_t, uint32_t);
 pagedir_t new_page_directory(void);
 pagedir_t copy_page_dir(pagedir_t);
 void replace_page(pagedir_t, uint32_t, pde_t);
@@ -58,6 +65,7 @@ void handle_pagefault(struct pt_regs *);
 
 
 page_t *get_page_from_curr(uint32_t);
+page_t *get_page_from_pgd(pagedir_t, uint32_t);
 
 void pte_mark_read_only(page_t *);
 void pte_mark_writeable(page_t *);
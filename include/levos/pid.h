@@ -0,0 +1,56 @@
+#ifndef __LEVOS_PID_H
+#define __LEVOS_PID_H
+
+#include <levos/types.h>
+#include <levos/list.h>
+#include <levos/rcu.h>
+#include <levos/spinlock.h>
+#include <levos/task.h>
+
+/* PIDs are handed out from 1 to PID_MAX - 1, then wrap around */
+#define PID_MAX 32768
+
+/*
+ * A PID in use.  It stays around (and so can not be handed out again)
+ * for as long as its process exists, including as a zombie, and for as
+ * long as somebody is still in the process group or session named by
+ * it.
+ */
+struct pid {
+    pid_t pid_nr;
+    int pid_refs;
+
+    /*
+     * the task with this PID, NULL if it's not running (yet, or anymore),
+     * RCU protected
+     */
+    struct task *pid_task;
+
+    /* tasks whose process group and session is this PID */
+    struct list pid_pgrp;
+    struct list pid_session;
+
+    /* next in the hash chain, RCU protected */
+    struct pid *pid_next;
+    struct rcu_head pid_rcu;
+};
+
+/*
+ * protects the PID hash and the group lists against other writers, taken
+ * from IRQ context.  Lookups may use rcu_read_lock() instead.
+ */
+extern spinlock_t pid_lock;
+
+void pid_init(void);
+
+pid_t pid_alloc(void);
+void pid_put(pid_t);
+struct pid *pid_find(pid_t);
+
+void pid_attach_task(struct task *);
+void pid_detach_task(struct task *);
+
+void task_set_pgrp(struct task *, pid_t);
+void task_set_session(struct task *, pid_t);
+
+#endif /* __LEVOS_PID_H */
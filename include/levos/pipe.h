@@ -5,6 +5,8 @@
 #include <levos/fs.h>
 #include <levos/ring.h>
 #include <levos/spinlock.h>
+#include <levos/mutex.h>
+#include <levos/wait.h>
 
 /* XXX: this is 65536 on Linux */
 #define PIPE_BUF 4096
@@ -18,6 +20,16 @@ struct pipe {
     struct ring_buffer pipe_buffer;
     spinlock_t pipe_lock;
     volatile int pipe_flags;
+
+    /*
+     * one reader and one writer at a time, splice fills and drains the
+     * ring in place outside of pipe_lock
+     */
+    struct mutex pipe_rmtx;
+    struct mutex pipe_wmtx;
+
+    /* woken when data comes in or goes out, and when an end closes */
+    wait_queue_t pipe_wq;
 };
 
 #endif /* __LEVOS_PIPE_H */
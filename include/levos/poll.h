@@ -0,0 +1,92 @@
+#ifndef __LEVOS_POLL_H
+#define __LEVOS_POLL_H
+
+#include <levos/types.h>
+#include <levos/wait.h>
+#include <levos/spinlock.h>
+
+struct file;
+struct task;
+
+/* the events, same values as on Linux */
+#define POLLIN     0x0001
+#define POLLPRI    0x0002
+#define POLLOUT    0x0004
+#define POLLERR    0x0008
+#define POLLHUP    0x0010
+#define POLLNVAL   0x0020
+#define POLLRDNORM 0x0040
+#define POLLWRNORM 0x0100
+
+/* always reported, whether asked for or not */
+#define POLL_ALWAYS (POLLERR | POLLHUP | POLLNVAL)
+
+/* what a file without a ->poll is, it never blocks */
+#define DEFAULT_POLLMASK (POLLIN | POLLOUT | POLLRDNORM | POLLWRNORM)
+
+struct pollfd {
+    int   fd;
+    short events;
+    short revents;
+};
+
+/*
+ * Handed to ->poll by whoever wants to be woken when the mask changes.
+ * ->poll calls poll_wait() with each wait queue that is woken then, and
+ * returns the current mask either way.  With a NULL table it only
+ * returns the mask.
+ */
+struct poll_table {
+    void (*pt_queue)(struct file *, wait_queue_t *, struct poll_table *);
+};
+
+static inline void
+poll_wait(struct file *f, wait_queue_t *wq, struct poll_table *pt)
+{
+    if (pt && pt->pt_queue)
+        pt->pt_queue(f, wq, pt);
+}
+
+/* a wait queue poll() has an entry on */
+struct poll_entry {
+    wait_queue_t *pe_wq;
+    struct wait_queue_entry pe_wqe;
+    struct poll_wqueues *pe_owner;
+};
+
+#define POLL_CHUNK_ENTRIES 32
+
+struct poll_chunk {
+    struct poll_chunk *pc_next;
+    int pc_num;
+    struct poll_entry pc_entries[POLL_CHUNK_ENTRIES];
+};
+
+/* the state of one poll() or select() call */
+struct poll_wqueues {
+    struct poll_table pw_pt;
+    struct task *pw_task;
+    spinlock_t pw_lock;
+    volatile int pw_triggered;
+    int pw_error;
+    struct poll_chunk *pw_chunks;
+};
+
+/* whether the tick EXPIRE is here, wrapping around */
+static inline int
+poll_expired(uint32_t expire)
+{
+    extern uint32_t __pit_ticks;
+
+    return (int32_t) (__pit_ticks - expire) >= 0;
+}
+
+void poll_initwait(struct poll_wqueues *);
+void poll_freewait(struct poll_wqueues *);
+int poll_schedule(struct poll_wqueues *, uint32_t);
+uint32_t poll_timeout_to_ticks(int);
+
+int do_poll(struct pollfd *, unsigned int, int);
+int do_select(int, uint32_t *, uint32_t *, uint32_t *, int);
+
+#endif /* __LEVOS_POLL_H */
@@ -0,0 +1,48 @@
+#ifndef __LEVOS_RCU_H
+#define __LEVOS_RCU_H
+
+#include <levos/types.h>
+#include <levos/compiler.h>
+
+/*
+ * Read-copy-update, the quiescent state based flavour.
+ *
+ * Readers only disable preemption, so they take no locks and write no
+ * shared memory.  They may not sleep or yield.  Writers still serialize
+ * among themselves, publish new objects with rcu_assign_pointer() and
+ * hand the old ones to call_rcu(), which frees them once every CPU went
+ * through a quiescent state: a context switch, a tick in user mode, or
+ * idling.  By then nobody can still be looking at them.
+ */
+#define rcu_read_lock()   preempt_disable()
+#define rcu_read_unlock() preempt_enable()
+
+/* x86 does not reorder loads with loads or stores with stores */
+#define rcu_dereference(p) ({                                       \
+            typeof(p) __p = *(volatile typeof(p) *) &(p);           \
+            barrier();                                              \
+            __p; })
+
+#define rcu_assign_pointer(p, v) do {                               \
+            barrier();                                              \
+            *(volatile typeof(p) *) &(p) = (v);                     \
+        } while (0)
+
+struct rcu_head {
+    struct rcu_head *rh_next;
+    void (*rh_func)(struct rcu_head *);
+};
+
+void rcu_init(void);
+
+void call_rcu(struct rcu_head *, void (*)(struct rcu_head *));
+void synchronize_rcu(void);
+
+/* hooks for the scheduler and the interrupt entry */
+void rcu_qs(void);
+void rcu_idle_enter(void);
+void rcu_irq_enter(void);
+int rcu_pending(void);
+void rcu_check_callbacks(void);
+
+#endif /* __LEVOS_RCU_H */
@@ -23,4 +23,10 @@ int ring_buffer_write(struct ring_buffer *, uint8_t *, size_t);
 int ring_buffer_read(struct ring_buffer *, void *, size_t);
 void ring_buffer_destroy(struct ring_buffer *);
 
+/* filling and draining in place, the caller serializes with the other side */
+size_t ring_buffer_write_space(struct ring_buffer *, uint8_t **);
+void ring_buffer_commit(struct ring_buffer *, size_t);
+size_t ring_buffer_read_space(struct ring_buffer *, uint8_t **);
+void ring_buffer_consume(struct ring_buffer *, size_t);
+
 #endif /* __LEVOS_RING_H */
@@ -0,0 +1,35 @@
+#ifndef __LEVOS_SEMAPHORE_H
+#define __LEVOS_SEMAPHORE_H
+
+#include <levos/types.h>
+#include <levos/wait.h>
+
+/* a counting semaphore, down() sleeps while the count is zero */
+struct semaphore {
+    volatile int s_count;
+    wait_queue_t s_waiters;
+};
+
+void sema_init(struct semaphore *, int);
+void down(struct semaphore *);
+int down_trylock(struct semaphore *);
+void up(struct semaphore *);
+
+/*
+ * Somebody waiting for something else to be done, e.g. for an I/O
+ * request to finish.  complete() lets one waiter through, complete_all()
+ * every one from now on.
+ */
+struct completion {
+    volatile int c_done;
+    wait_queue_t c_waiters;
+};
+
+void init_completion(struct completion *);
+void reinit_completion(struct completion *);
+void wait_for_completion(struct completion *);
+int try_wait_for_completion(struct completion *);
+void complete(struct completion *);
+void complete_all(struct completion *);
+
+#endif /* __LEVOS_SEMAPHORE_H */
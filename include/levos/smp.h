@@ -0,0 +1,112 @@
+#ifndef __LEVOS_SMP_H
+#define __LEVOS_SMP_H
+
+#include <levos/kernel.h>
+#include <levos/types.h>
+#include <levos/compiler.h>
+#include <levos/list.h>
+#include <levos/spinlock.h>
+#include <levos/x86.h>
+
+#ifdef CONFIG_SMP
+# define NR_CPUS 8
+#else
+# define NR_CPUS 1
+#endif
+
+struct task;
+
+/*
+ * Every CPU schedules the tasks on its own run queue.  A task belongs to
+ * exactly one run queue at a time (task->cpu), and may only be moved to
+ * another one while it is not running anywhere (task->on_cpu == 0) with
+ * both queues locked.
+ */
+struct runqueue {
+    spinlock_t rq_lock;
+    struct list rq_tasks;
+};
+
+struct cpu {
+    /* must stay first, see this_cpu() */
+    struct cpu *cpu_self;
+
+    /* the task running on this CPU */
+    struct task *cpu_current;
+
+    /* what to run when the run queue has nothing runnable */
+    struct task *cpu_idle;
+
+    /* an interrupt wants us to reschedule as soon as it's allowed */
+    int cpu_need_resched;
+
+    int cpu_id;
+    int cpu_apic_id;
+    int cpu_online;
+
+    /* ticks since the last load balancing pass */
+    uint32_t cpu_balance_ticks;
+
+    /*
+     * Tickless idle: while cpu_nohz is set the periodic tick of this CPU
+     * is stopped, and it needs to be woken at cpu_nohz_until at the
+     * latest (NOHZ_FOREVER if nothing is waiting for a timeout).
+     */
+    volatile int cpu_nohz;
+    uint32_t cpu_nohz_start;
+    uint32_t cpu_nohz_until;
+
+    /* idle accounting, in ticks, see /proc/idle */
+    uint32_t cpu_idle_ticks;
+    uint32_t cpu_nohz_entries;
+
+    /*
+     * RT throttling: real-time tasks may only use RT_RUNTIME ticks out of
+     * every RT_PERIOD, see kernel/sched.c
+     */
+    uint32_t cpu_rt_period_start;
+    uint32_t cpu_rt_time;
+    int cpu_rt_throttled;
+
+    /* see /proc/stat */
+    uint32_t cpu_user_ticks;
+    uint32_t cpu_system_ticks;
+    uint32_t cpu_nr_switches;
+
+    /*
+     * RCU: quiescent states passed, and whether we are halted in the
+     * idle loop, see kernel/rcu.c
+     */
+    volatile uint32_t cpu_rcu_qs;
+    volatile int cpu_rcu_idle;
+
+    struct runqueue cpu_rq;
+};
+
+extern struct cpu cpus[NR_CPUS];
+
+/*
+ * The per-CPU segment (%fs in the kernel) has its base at this CPU's
+ * 'struct cpu', so a field can be read with a single instruction and
+ * without having to worry about being migrated halfway through.
+ */
+#define percpu_read(field) \
+        arch_percpu_read(offsetof(struct cpu, field))
+#define percpu_write(field, val) \
+        arch_percpu_write(offsetof(struct cpu, field), val)
+
+#define NOHZ_FOREVER 0xFFFFFFFF
+
+#define this_cpu() ((struct cpu *) percpu_read(cpu_self))
+#define current_task ((struct task *) percpu_read(cpu_current))
+
+#define for_each_cpu(c) \
+        for ((c) = &cpus[0]; (c) < &cpus[NR_CPUS]; (c) ++)
+
+int smp_num_cpus(void);
+void smp_init(void);
+void smp_send_resched(struct cpu *);
+
+void percpu_init(int);
+
+#endif /* __LEVOS_SMP_H */
@@ -8,6 +8,7 @@
 #include <levos/fs.h>
 
 struct socket;
+struct poll_table;
 
 typedef size_t socklen_t;
 
@@ -26,6 +27,15 @@ struct socket_ops {
     int (*write)(struct socket *, void *buf, size_t len);
     int (*read)(struct socket *, void *buf, size_t len);
     int (*destroy)(struct socket *);
+
+    /* optional, sends the segments together, in as few packets as it can */
+    int (*writev)(struct socket *, struct iovec *, int);
+
+    /* optional, see file_operations, without it the socket is always ready */
+    int (*poll)(struct socket *, struct file *, struct poll_table *);
+
+    /* optional, see file_operations, fills the packets straight from the file */
+    int (*splice_write)(struct socket *, struct file *, int *, size_t);
 };
 
 #define AF_UNIX 0
@@ -50,6 +60,8 @@ struct socket {
 void net_init(void);
 int net_register_device(struct net_device *);
 struct net_device *net_get_default();
+struct net_device *net_find_route(ip_addr_t);
+int net_route_to(struct net_info *, ip_addr_t, eth_addr_t);
 port_t net_allocate_port(int);
 void net_free_port(int, port_t);
 
@@ -0,0 +1,54 @@
+#ifndef __LEVOS_SOFTIRQ_H
+#define __LEVOS_SOFTIRQ_H
+
+#include <levos/types.h>
+#include <levos/list.h>
+
+/*
+ * Softirqs are the bottom halves of interrupt handlers.  A hard IRQ only
+ * raises one, and it runs with interrupts enabled on the way out of the
+ * interrupt, or in ksoftirqd when they keep coming.  Lower numbers run
+ * first.
+ */
+#define SOFTIRQ_HI      0 /* tasklet_hi_schedule() */
+#define SOFTIRQ_TIMER   1 /* the timer wheel, see kernel/work.c */
+#define SOFTIRQ_TASKLET 2 /* tasklet_schedule() */
+#define SOFTIRQ_RCU     3 /* RCU callbacks, see kernel/rcu.c */
+#define NR_SOFTIRQS     4
+
+typedef void softirq_action_t(void);
+
+/*
+ * A tasklet is a softirq for drivers: it is run on the CPU that scheduled
+ * it, and never on two CPUs at the same time.
+ */
+#define TASKLET_STATE_SCHED (1 << 0) /* queued to run */
+#define TASKLET_STATE_RUN   (1 << 1) /* running */
+
+struct tasklet {
+    volatile int t_state;
+    void (*t_func)(unsigned long);
+    unsigned long t_data;
+
+    struct list_elem t_elem;
+};
+
+void softirq_init(void);
+void ksoftirqd_init(void);
+
+void open_softirq(int, softirq_action_t *);
+void raise_softirq(int);
+void __raise_softirq_irqoff(int);
+
+/* around hard IRQ handlers, irq_exit() runs what they raised */
+void irq_enter(int);
+void irq_exit(void);
+int irq_abandon(void);
+
+void do_softirq(void);
+
+void tasklet_init(struct tasklet *, void (*)(unsigned long), unsigned long);
+void tasklet_schedule(struct tasklet *);
+void tasklet_hi_schedule(struct tasklet *);
+
+#endif /* __LEVOS_SOFTIRQ_H */
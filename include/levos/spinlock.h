@@ -2,18 +2,56 @@
 #define __LEVOS_SPINLOCK_H
 
 #include <levos/compiler.h>
+#include <levos/types.h>
 
 struct task;
 
+#ifdef CONFIG_LOCK_STAT
+/*
+ * All the locks initialized at the same place in the code, e.g. every
+ * task's vm_lock, share a class and their statistics.  Times are in TSC
+ * cycles.
+ */
+struct lock_class {
+    const char *lc_name;
+    uint32_t lc_acquired;
+    uint32_t lc_contended;
+    uint32_t lc_wait_max;
+    uint32_t lc_hold_max;
+    int lc_registered;
+    struct lock_class *lc_next;
+};
+#endif
+
+/* a ticket lock, see arch/x86/spinlock.S, all zeroes is unlocked */
 struct __spinlock_t {
     volatile int value;
     struct task *holder;
+#ifdef CONFIG_LOCK_STAT
+    struct lock_class *class;
+    uint64_t acquired_at;
+#endif
 } __packed;
 
 typedef struct __spinlock_t spinlock_t;
 
+#ifdef CONFIG_LOCK_STAT
+#define spin_lock_init(l) do {                                      \
+            static struct lock_class __lock_class = { .lc_name = #l }; \
+            __spin_lock_init((l), &__lock_class);                   \
+        } while (0)
+
+void __spin_lock_init(spinlock_t *, struct lock_class *);
+#else
 void spin_lock_init(spinlock_t *);
+#endif
+
 void spin_lock(spinlock_t *);
+int spin_trylock(spinlock_t *);
 void spin_unlock(spinlock_t *);
 
+/* for locks that are also taken from interrupt context */
+uint32_t spin_lock_irqsave(spinlock_t *);
+void spin_unlock_irqrestore(spinlock_t *, uint32_t);
+
 #endif /* __LEVOS_SPINLOCK_H */
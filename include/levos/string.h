@@ -11,6 +11,9 @@ char *strdup(char *);
 size_t strlen(const char *);
 size_t strncmp(char *, char *, size_t);
 char *strtok_r(char *, const char *, char **);
+char *strchr(const char *, int);
 void itoa(unsigned, unsigned, char *);
+int atoi_10(char *);
+int atoi_10n(char *, int);
 
 #endif /* __LEVOS_STRING_H */
@@ -0,0 +1,65 @@
+#ifndef __LEVOS_SYSSTAT_H
+#define __LEVOS_SYSSTAT_H
+
+#include <levos/types.h>
+
+struct task;
+
+/* the system call numbers we account for, see syscall_names in sysstat.c */
+#define NR_SYSCALLS   0x1b0
+#define SYSSTAT_SLOTS 64
+
+/*
+ * The latency histogram, in TSC cycles: bucket 0 is below 1k, bucket i
+ * below 1k << i, the last one is everything from there on.
+ */
+#define SYSSTAT_LAT_BUCKETS 12
+#define SYSSTAT_LAT_SHIFT   10
+
+struct syscall_stat {
+    uint32_t sc_calls;
+    uint32_t sc_errors;
+    uint64_t sc_cycles;
+    uint32_t sc_lat[SYSSTAT_LAT_BUCKETS];
+};
+
+/* the last SYSTRACE_ENTRIES calls of a task, see PR_SET_SYSCALL_TRACE */
+#define SYSTRACE_ENTRIES 64
+
+struct systrace_entry {
+    /* the number of the call in the task, for telling which is which */
+    uint32_t te_seq;
+    int te_no;
+    uint32_t te_args[4];
+
+    /* only valid once te_done is set, the call may still be running */
+    int te_done;
+    int te_rc;
+    uint32_t te_cycles;
+};
+
+struct systrace {
+    uint32_t st_seq;
+    struct systrace_entry st_ring[SYSTRACE_ENTRIES];
+};
+
+/* task->sysstat_flags */
+#define SYSSTAT_TASK  (1 << 0) /* keep per-task counters too */
+#define SYSSTAT_TRACE (1 << 1) /* log the calls into task->systrace */
+
+/* prctl() options to turn them on and off, arg2 is 0 or 1 */
+#define PR_SET_SYSCALL_STATS 0x4c560001
+#define PR_SET_SYSCALL_TRACE 0x4c560002
+
+void sysstat_init(void);
+uint64_t sysstat_enter(int, uint32_t, uint32_t, uint32_t, uint32_t);
+void sysstat_exit(int, int, uint64_t);
+
+int sysstat_task_set(struct task *, int, int);
+void sysstat_fork(struct task *, struct task *);
+void sysstat_free(struct task *);
+
+int sysstat_task_dump(struct task *, char *, size_t);
+int systrace_task_dump(struct task *, char *, size_t);
+
+#endif /* __LEVOS_SYSSTAT_H */
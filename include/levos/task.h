@@ -6,10 +6,13 @@
 #include <levos/kernel.h>
 #include <levos/page.h>
 #include <levos/fs.h>
+#include <levos/fdtable.h>
 #include <levos/signal.h>
 #include <levos/list.h>
 #include <levos/vma.h>
 #include <levos/spinlock.h>
+#include <levos/smp.h>
+#include <levos/rcu.h>
 
 
 #define WAIT_CODE(info, code) ((int)((uint16_t)(((info) << 8 | (code)))))
@@ -68,6 +71,39 @@ struct process
     struct list_elem elem;
 };
 
+/* scheduling policies, same values as Linux */
+#define SCHED_OTHER 0
+#define SCHED_FIFO  1   /* real-time, runs until it blocks or yields */
+#define SCHED_RR    2   /* real-time, round robin with a time slice */
+
+#define SCHED_RT_PRIO_MIN 1
+#define SCHED_RT_PRIO_MAX 99
+
+/* priority of the latency-critical kernel threads (kworker, packets) */
+#define KTHREAD_RT_PRIO   50
+
+/* wakeup latency histogram: <1, 1, 2-3, 4-7, 8-15, 16-31 and 32+ ticks */
+#define SCHED_LAT_BUCKETS 7
+
+/* CPU accounting of a task, all times are in ticks */
+struct sched_stats {
+    uint32_t ss_utime;      /* running in user mode */
+    uint32_t ss_stime;      /* running in the kernel */
+    uint32_t ss_cutime;     /* utime + cutime of terminated children */
+    uint32_t ss_cstime;     /* stime + cstime of terminated children */
+
+    uint32_t ss_nvcsw;      /* switched out because we blocked */
+    uint32_t ss_nivcsw;     /* switched out while still runnable */
+    uint32_t ss_nr_runs;    /* times we were switched in */
+
+    uint32_t ss_wait_ticks; /* runnable, but waiting for a CPU */
+    uint32_t ss_queued_at;  /* when we last became runnable */
+    int ss_woken;           /* became runnable by a wakeup, not preemption */
+
+    uint32_t ss_wakeups;
+    uint32_t ss_wakeup_lat[SCHED_LAT_BUCKETS];
+};
+
 struct task
 {
 #define LEVOS_TASK_MAGIC 0xC0FFEEEE
@@ -84,6 +120,8 @@ struct task
 #define TFLAG_INTERRUPTED        (1 << 1)
 #define TFLAG_PROCESSING_SYSCALL (1 << 2)
 #define TFLAG_NO_SIGNAL          (1 << 3)
+#define TFLAG_PINNED             (1 << 4) /* never migrated to another CPU */
+#define TFLAG_KTHREAD            (1 << 5) /* has no process to signal */
     int flags;
 
 #define TASK_UNKNOWN   0   /* BUG */
@@ -97,13 +135,28 @@ struct task
 #define TASK_SLEEPING  8   /* sleeping */
     int state;
 
-#define FD_MAX 32
-    struct file *file_table[FD_MAX];
-
-    /* FIXME: get rid of this and use 'struct fd' */
-    int file_table_flags[FD_MAX];
+    /* the descriptors, NULL for kernel threads */
+    struct fdtable *files;
 
     int time_ran;
+    struct sched_stats stats;
+
+    /* SYSSTAT_*, what they gather is NULL until turned on, see sysstat.h */
+    int sysstat_flags;
+    struct syscall_stat *sysstat;
+    struct systrace *systrace;
+
+    /*
+     * preemption is allowed only while this is 0, see preempt_disable();
+     * it is per-task so that a task can block inside a critical section
+     * without leaking it to whoever runs next
+     */
+    int preempt_count;
+
+    /* SCHED_*, rt_priority is 0 for SCHED_OTHER, higher runs first */
+    int policy;
+    int rt_priority;
+
     int exit_code;
     struct process *owner;
 
@@ -112,6 +165,12 @@ struct task
     /* leader of the session */
     struct task *ses_leader;
 
+    /* on the member lists of our process group and session, see pid.h */
+    struct pid *pgrp;
+    struct list_elem pgrp_elem;
+    struct pid *session;
+    struct list_elem session_elem;
+
     struct bin_state bstate;
 
     struct signal_struct signal;
@@ -126,6 +185,9 @@ struct task
 
     struct work *alarm_work;
 
+    /* set if this is one of the workers running deferred work */
+    struct worker *worker;
+
     /*
      * uh, not sure we need this lock, since only the
      * process will modify its children
@@ -143,6 +205,15 @@ struct task
 
     struct list_elem all_elem;
 
+    /* get_task_for_pid() readers may still see us for a grace period */
+    struct rcu_head rcu;
+
+    /* the CPU whose run queue we are on, -1 if none */
+    int cpu;
+    /* set from being picked until the CPU has left our stack */
+    int on_cpu;
+    struct list_elem rq_elem;
+
     uint32_t *irq_stack_top;
     uint32_t *irq_stack_bot;
 
@@ -157,6 +228,12 @@ struct task
     /* regs (if interrupted) */
     struct pt_regs *regs;
     struct pt_regs *sys_regs;
+
+    /*
+     * kernel stack pointer saved by a voluntary switch (see sched_yield),
+     * zero if we have to be resumed through regs instead
+     */
+    uint32_t context;
 };
 
 
@@ -164,6 +241,11 @@ extern struct list *__ALL_TASKS_PTR;
 #define for_each_task(task) struct list_elem *___elem; \
         list_foreach(__ALL_TASKS_PTR, ___elem, task, struct task, all_elem);
 
+inline int task_is_rt(struct task *t)
+{
+    return t->policy != SCHED_OTHER;
+}
+
 inline int task_runnable(struct task *t)
 {
     return t->state == TASK_NEW ||
@@ -173,6 +255,7 @@ int task_do_wait(struct task *, struct process *);
 void task_exit(struct task *t);
 void task_unblock(struct task *t);
 void task_block(struct task *t);
+void task_block_noresched(struct task *);
 
 struct task *create_user_task_fork(void (*)(void));
 struct task *create_kernel_task(void (*)(void));
@@ -185,11 +268,21 @@ void sched_tick(struct pt_regs *);
 void sched_init(void);
 void sched_yield(void);
 void sched_add_rq(struct task *);
+void sched_remove_rq(struct task *);
+struct task *sched_create_idle(int);
+void sched_ap_enter(void) __noreturn;
+void sched_resched_irq(struct pt_regs *);
+int sched_setscheduler(struct task *, int, int);
+void sched_add_rq_cpu(struct task *, struct cpu *);
 void sched_add_child(struct task *, struct task *);
 struct process *sched_get_child(struct task *, pid_t);
 
 void preempt_enable(void);
 void preempt_disable(void);
+void preempt_enable_no_resched(void);
+int preemptible(void);
+void cond_resched(void);
+void sched_preempt_irq(struct pt_regs *);
 
 void task_sleep(struct task *, uint32_t);
 void task_kick(struct task *);
@@ -197,6 +290,4 @@ void sleep(uint32_t);
 
 void setup_filetable(struct task *);
 
-extern struct task *current_task;
-
 #endif /* __LEVOS_TASK_H */
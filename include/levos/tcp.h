@@ -8,6 +8,10 @@
 #include <levos/hash.h>
 #include <levos/ring.h>
 #include <levos/spinlock.h>
+#include <levos/wait.h>
+
+/* what we send at most in one segment, the default MSS */
+#define TCP_MSS 536
 
 #define TCP_FLAGS_NS   (1 << 8)
 #define TCP_FLAGS_CWR  (1 << 7)
@@ -124,6 +128,7 @@ struct tcp_info {
 
 #define TCP_BUFFER_SIZE 16384
              struct ring_buffer ti_rb; /* data collected so far */
+             wait_queue_t     ti_wq; /* woken on new data and state changes */
              
              struct hash_elem ti_helem;
 };
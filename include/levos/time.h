@@ -3,19 +3,74 @@
 
 #include <levos/kernel.h>
 #include <levos/types.h>
+#include <levos/time_page.h>
+
+/* scheduler ticks per second, the rate of the PIT */
+#define HZ 200
+
+/* the clock ticks userspace sees, sysconf(_SC_CLK_TCK) */
+#define USER_HZ 100
+
+#define ticks_to_clock_t(t) ((t) / (HZ / USER_HZ))
 
 struct timeval {
     uint64_t tv_sec;
     uint64_t tv_usec;
 };
 
+/* struct timeval as userspace has it, time_t and suseconds_t are longs */
+struct user_timeval {
+    int32_t tv_sec;
+    int32_t tv_usec;
+};
+
+/* times(2) */
+struct tms {
+    uint32_t tms_utime;
+    uint32_t tms_stime;
+    uint32_t tms_cutime;
+    uint32_t tms_cstime;
+};
+
+#define RUSAGE_SELF      0
+#define RUSAGE_CHILDREN -1
+
+/*
+ * getrusage(2), as in <sys/resource.h> of the newlib port.  We only fill
+ * in the times and the context switches.
+ */
+struct rusage {
+    struct user_timeval ru_utime;
+    struct user_timeval ru_stime;
+    long ru_maxrss;
+    long ru_ixrss;
+    long ru_idrss;
+    long ru_isrss;
+    long ru_minflt;
+    long ru_majflt;
+    long ru_nswap;
+    long ru_inblock;
+    long ru_oublock;
+    long ru_msgsnd;
+    long ru_msgrcv;
+    long ru_nsignals;
+    long ru_nvcsw;
+    long ru_nivcsw;
+};
+
 struct timesource {
     char *name;
     int (*gettimeofday)(struct timeval *, void *);
 };
 
+void time_page_publish(uint64_t, uint64_t, uint32_t, uint32_t);
+
 int time_init();
 int rtc_init();
+uint64_t rtc_get_unix_seconds();
+struct timesource *rtc_get_timesource(void);
 int gettimeofday(struct timeval *, void *);
+uint64_t time_get_uptime(void);
+void time_get_uptime_tv(struct timeval *);
 
 #endif
@@ -0,0 +1,77 @@
+#ifndef __LEVOS_TIME_PAGE_H
+#define __LEVOS_TIME_PAGE_H
+
+/*
+ * The time page, the one layout the kernel and userspace agree on.  The
+ * newlib port gets a copy of this file as <sys/time_page.h> when it is
+ * built (see buildtools/build-host-tools.sh), so it may not use anything
+ * from the kernel.
+ */
+#include <stdint.h>
+
+/*
+ * Every process has the page mapped read-only here, at the start of the
+ * shared area (USER_SHARED_BASE), so that it can tell the time without a
+ * system call.  See time_page_read().
+ */
+#define TIME_PAGE_ADDR 0xFFC00000
+
+struct time_page {
+    /* odd while the kernel is updating the page */
+    volatile uint32_t tp_seq;
+
+    /* 0 if there is no usable TSC, use gettimeofday(2) then */
+    uint32_t tp_tsc_khz;
+
+    /* the TSC and the wall clock time at the same instant */
+    uint64_t tp_tsc_base;
+    uint64_t tp_base_sec;
+
+    /* microseconds = (TSC cycles * tp_tsc_mult) >> 32 */
+    uint32_t tp_tsc_mult;
+};
+
+static inline uint64_t
+time_cycles_to_usec(uint64_t cycles, uint32_t mult)
+{
+    return (cycles >> 32) * mult +
+            (((cycles & 0xFFFFFFFF) * mult) >> 32);
+}
+
+/*
+ * time_page_read - the wall clock time from the time page
+ *
+ * @tp - the page, at TIME_PAGE_ADDR
+ * @sec - where to put the seconds
+ * @usec - where to put the microseconds
+ *
+ * Meant for userspace, the kernel asks its timesource.  Returns 0, or -1
+ * if there is no TSC to go by and gettimeofday(2) has to be asked.
+ */
+static inline int
+time_page_read(const struct time_page *tp, uint32_t *sec, uint32_t *usec)
+{
+    uint64_t tsc, us, base;
+    uint32_t seq;
+
+    if (tp->tp_tsc_khz == 0)
+        return -1;
+
+    do {
+        seq = tp->tp_seq;
+        asm volatile("" ::: "memory");
+
+        asm volatile("rdtsc" : "=A"(tsc));
+        us = time_cycles_to_usec(tsc - tp->tp_tsc_base, tp->tp_tsc_mult);
+        base = tp->tp_base_sec;
+
+        asm volatile("" ::: "memory");
+    } while ((seq & 1) || seq != tp->tp_seq);
+
+    *sec = base + us / 1000000;
+    *usec = us % 1000000;
+
+    return 0;
+}
+
+#endif /* __LEVOS_TIME_PAGE_H */
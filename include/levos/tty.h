@@ -5,6 +5,7 @@
 #include <levos/types.h>
 #include <levos/ring.h>
 #include <levos/task.h>
+#include <levos/wait.h>
 
 typedef unsigned int  tcflag_t;
 typedef unsigned int  speed_t;
@@ -211,6 +212,9 @@ struct tty_device {
 
     struct winsize tty_winsize;
 
+    /* woken when input can be read */
+    wait_queue_t tty_wq;
+
     /* private data for the line discipline */
     void *priv_ldisc;
 };
@@ -220,6 +224,9 @@ struct tty_line_discipline {
 	int (*write_input)(struct tty_device *, uint8_t);
     int (*read_buf)(struct tty_device *, uint8_t *, size_t);
 
+    /* POLLIN if read_buf would not wait */
+    int (*poll)(struct tty_device *);
+
     int (*flush)(struct pty *);
 
     int (*init)(struct tty_line_discipline *);
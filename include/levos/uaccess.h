@@ -0,0 +1,44 @@
+#ifndef __LEVOS_UACCESS_H
+#define __LEVOS_UACCESS_H
+
+#include <levos/kernel.h>
+#include <levos/types.h>
+
+/*
+ * Accessing userspace memory from system calls.
+ *
+ * Nothing is checked up front apart from the address range: these just
+ * perform the access, and a fault on an address that is not backed by a
+ * VMA is recovered through the exception table and turned into -EFAULT.
+ */
+
+struct exception_table_entry {
+    uint32_t insn;
+    uint32_t fixup;
+};
+
+/* is [PTR, PTR + LEN) below the kernel and above the NULL page */
+static inline int
+access_ok(const void *ptr, size_t len)
+{
+    uint32_t start = (uint32_t) ptr;
+
+    return start >= 4096 && start <= VIRT_BASE && len <= VIRT_BASE - start;
+}
+
+size_t arch_copy_user(void *, const void *, size_t);
+long arch_strncpy_user(char *, const char *, long);
+int arch_probe_read(const void *);
+int arch_probe_write(void *);
+
+uint32_t search_exception_table(uint32_t);
+
+int copy_from_user(void *, const void *, size_t);
+int copy_to_user(void *, const void *, size_t);
+long strncpy_from_user(char *, const char *, long);
+char *strndup_user(const char *, long);
+
+int fault_in_readable(const void *, size_t);
+int fault_in_writeable(void *, size_t);
+
+#endif /* __LEVOS_UACCESS_H */
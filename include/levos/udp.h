@@ -8,6 +8,8 @@
 #include <levos/ring.h>
 #include <levos/hash.h>
 #include <levos/list.h>
+#include <levos/uio.h>
+#include <levos/wait.h>
 
 struct udp_header {
     be_port_t   udp_src_port;
@@ -42,6 +44,9 @@ struct udp_sock_priv {
 
     /* list of struct udp_dgram */
     struct list usp_dgrams;
+
+    /* woken when a datagram is queued */
+    wait_queue_t usp_wq;
 };
 
 extern struct socket_ops udp_sock_ops;
@@ -53,6 +58,7 @@ packet_t *
 udp_construct_packet(struct net_info *, eth_addr_t, ip_addr_t, port_t, ip_addr_t, port_t);
 
 int udp_set_payload(packet_t *, void *, size_t);
+int udp_set_payload_iov(packet_t *, struct iovec *, int);
 
 int udp_handle_packet(struct net_info *, packet_t *, struct udp_header *);
 
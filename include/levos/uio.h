@@ -0,0 +1,30 @@
+#ifndef __LEVOS_UIO_H
+#define __LEVOS_UIO_H
+
+#include <levos/types.h>
+
+/* a segment of a readv(2) or writev(2) */
+struct iovec {
+    void  *iov_base;
+    size_t iov_len;
+};
+
+/* the most segments one call takes */
+#define IOV_MAX 1024
+
+/* this many are copied onto the stack, more need an allocation */
+#define UIO_FASTIOV 8
+
+static inline size_t
+iov_length(const struct iovec *iov, int cnt)
+{
+    size_t len = 0;
+    int i;
+
+    for (i = 0; i < cnt; i ++)
+        len += iov[i].iov_len;
+
+    return len;
+}
+
+#endif /* __LEVOS_UIO_H */
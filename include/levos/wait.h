@@ -3,12 +3,46 @@
 
 #include <levos/types.h>
 #include <levos/list.h>
+#include <levos/spinlock.h>
 
+struct task;
+
+/*
+ * Tasks sleeping until something happens.  A sleeper puts an entry on the
+ * queue with prepare_to_wait(), checks its condition, and only then gives
+ * up the CPU.  Whoever makes the condition true wakes the queue after,
+ * so a wakeup that comes in between is not lost.
+ */
 struct wait_queue_struct {
+    spinlock_t  wq_lock;
     struct list wq_waiters;
     int         wq_num;
 };
 
 typedef struct wait_queue_struct wait_queue_t;
 
+/*
+ * lives on the stack of the sleeper.  An entry with a wqe_func is not a
+ * sleeper but a callback, that wakeups call and leave on the queue until
+ * its owner takes it off with wait_queue_remove().
+ */
+struct wait_queue_entry {
+    struct task *wqe_task;
+    int wqe_queued;
+    struct list_elem wqe_elem;
+    void (*wqe_func)(struct wait_queue_entry *);
+};
+
+void wait_queue_init(wait_queue_t *);
+int wait_queue_num_waiters(wait_queue_t *);
+
+void prepare_to_wait(wait_queue_t *, struct wait_queue_entry *);
+void finish_wait(wait_queue_t *, struct wait_queue_entry *);
+
+void wait_queue_add(wait_queue_t *, struct wait_queue_entry *);
+void wait_queue_remove(wait_queue_t *, struct wait_queue_entry *);
+
+struct task *wait_wake_up_one(wait_queue_t *);
+void wait_wake_up(wait_queue_t *);
+
 #endif /* __LEVOS_WAIT_H */
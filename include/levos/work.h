@@ -7,6 +7,15 @@
 #define WORK_FLAG_CANCELLED (1 << 0)
 #define WORK_FLAG_QUEUED    (1 << 1)
 #define WORK_FLAG_KILLED    (1 << 2)
+/* queued on the timer wheel, rather than ready to run */
+#define WORK_FLAG_TIMER     (1 << 3)
+/* queued behind another work of an ordered workqueue */
+#define WORK_FLAG_DELAYED   (1 << 4)
+/* a worker is running it */
+#define WORK_FLAG_RUNNING   (1 << 5)
+
+struct task;
+struct workqueue;
 
 struct work {
     void (*work_func)(void *);
@@ -16,16 +25,84 @@ struct work {
 
     int work_flags;
 
+    /* where it's run, system_wq unless queue_work() said otherwise */
+    struct workqueue *work_wq;
+
+    /* in usecs, for the latency stats of the workqueue */
+    uint64_t work_queued_at;
+
     struct list_elem elem;
 };
 
+/*
+ * A set of workers with the same scheduling class.  When every worker is
+ * blocked in the middle of a work and there's more to do, another worker
+ * is started, up to wp_max_workers.
+ */
+struct worker_pool {
+    char *wp_name;
+    int wp_policy;
+    int wp_prio;
+
+    /* works ready to run, in order */
+    struct list wp_ready;
+
+    struct list wp_workers;
+    struct list wp_idle;
+    int wp_nr_workers;
+    int wp_max_workers;
+
+    /* the manager has been asked for another worker */
+    int wp_need_worker;
+};
+
+struct worker {
+    struct task *wk_task;
+    struct worker_pool *wk_pool;
+
+    /* the work being run, NULL if idle */
+    struct work *wk_current;
+
+    struct list_elem wk_elem;
+    struct list_elem wk_idle_elem;
+};
+
+/* the works of an ordered workqueue run one at a time, in order */
+#define WQ_ORDERED (1 << 0)
+
+struct workqueue {
+    char *wq_name;
+    int wq_flags;
+    struct worker_pool *wq_pool;
+
+    /* WQ_ORDERED: the works waiting for the one in flight */
+    struct list wq_delayed;
+    int wq_active;
+
+    /* from being ready to run to being run, in usecs */
+    uint32_t wq_runs;
+    uint64_t wq_latency_total;
+    uint32_t wq_latency_max;
+
+    struct list_elem wq_elem;
+};
+
+/* for things that must not wait behind slow work, e.g. retransmissions */
+extern struct workqueue *system_highpri_wq;
+extern struct workqueue *system_wq;
+
 int work_init(void);
 
+struct workqueue *workqueue_create_ordered(char *);
+
 /* scheduling work */
 int schedule_work(struct work *);
 int schedule_work_at(struct work *, uint32_t);
 int schedule_work_delay(struct work *, uint32_t);
 
+int queue_work(struct workqueue *, struct work *);
+int queue_work_delay(struct workqueue *, struct work *, uint32_t);
+
 /* rescheduling work */
 int work_reschedule(uint32_t);
 
@@ -33,6 +110,9 @@ int work_reschedule(uint32_t);
 int work_cancel(struct work *);
 int work_cancel_current(void);
 
+/* the timer wheel, SOFTIRQ_TIMER raised by the BSP's tick */
+void work_timer_tick(void);
+uint32_t work_timer_next(void);
 
 /* creating work */
 struct work *work_create(void (*)(void *), void *);
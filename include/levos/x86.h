@@ -41,9 +41,58 @@ uint32_t inportl(uint16_t portid);
 
 void pic_init(void);
 void pic_eoi(int);
+void pic_disable(void);
 void pit_init(void);
 
+/* local APIC / IO APIC, see arch/x86/apic.c */
+#define IRQ_VEC_LAPIC_TIMER 0x40
+#define IRQ_VEC_RESCHED     0x41
+#define IRQ_VEC_SPURIOUS    0xFF
+
+void apic_init(void);
+int apic_enabled(void);
+void arch_irq_eoi(int);
+
+/* per-CPU data lives at the base of %fs while in the kernel */
+#define arch_percpu_read(off) ({                                    \
+            uint32_t __val;                                         \
+            asm volatile("movl %%fs:%c1, %0"                        \
+                    : "=r"(__val) : "i"(off));                      \
+            __val; })
+
+#define arch_percpu_write(off, val)                                 \
+            asm volatile("movl %0, %%fs:%c1"                        \
+                    :: "r"((uint32_t)(val)), "i"(off) : "memory")
+
 #define ENABLE_IRQ() asm volatile("sti")
 #define DISABLE_IRQ() asm volatile("cli")
 
+#define X86_EFLAGS_IF (1 << 9)
+
+/* EDX of CPUID leaf 1 */
+#define X86_FEATURE_TSC (1 << 4)
+#define X86_FEATURE_SEP (1 << 11)
+
+#define arch_cpuid(leaf, a, b, c, d)                                \
+            asm volatile("cpuid"                                    \
+                    : "=a"(a), "=b"(b), "=c"(c), "=d"(d)            \
+                    : "a"(leaf))
+
+#define arch_rdtsc() ({                                             \
+            uint64_t __tsc;                                         \
+            asm volatile("rdtsc" : "=A"(__tsc));                    \
+            __tsc; })
+
+/* disables interrupts, returns EFLAGS from before */
+#define arch_irq_save() ({                                          \
+            uint32_t __flags;                                       \
+            asm volatile("pushfl; popl %0; cli"                     \
+                    : "=r"(__flags) :: "memory");                   \
+            __flags; })
+
+#define arch_irqs_disabled() ({                                     \
+            uint32_t __flags;                                       \
+            asm volatile("pushfl; popl %0" : "=r"(__flags));        \
+            !(__flags & X86_EFLAGS_IF); })
+
 #endif /* __LEVOS_ARCH_X86_H */
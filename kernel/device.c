@@ -19,9 +19,50 @@ dev_seek(struct device *dev, int pos)
     dev->pos = pos;
 }
 
+/*
+ * dev_read_at - read from a device at a position
+ *
+ * @dev - the device
+ * @buf - where to read to
+ * @count - how much to read, in the unit of the device
+ * @pos - where to read from
+ *
+ * The seek and the read are done under the device's lock, so that two
+ * tasks can't move the position from under each other.  Sleeps if the
+ * device is busy.
+ */
+size_t
+dev_read_at(struct device *dev, void *buf, size_t count, unsigned long pos)
+{
+    size_t rc;
+
+    mutex_lock(&dev->dev_lock);
+    dev->pos = pos;
+    rc = dev->read(dev, buf, count);
+    mutex_unlock(&dev->dev_lock);
+
+    return rc;
+}
+
+/* like dev_read_at(), but writes */
+size_t
+dev_write_at(struct device *dev, void *buf, size_t count, unsigned long pos)
+{
+    size_t rc;
+
+    mutex_lock(&dev->dev_lock);
+    dev->pos = pos;
+    rc = dev->write(dev, buf, count);
+    mutex_unlock(&dev->dev_lock);
+
+    return rc;
+}
+
 void
 device_register(struct device *dev)
 {
+    mutex_init(&dev->dev_lock);
+
     if (dev->type == DEV_TYPE_BLOCK) {
         for (int i = 0; i < 32; i ++) {
             if (block_devices[i] == NULL) {
@@ -0,0 +1,614 @@
+#include <levos/kernel.h>
+#include <levos/types.h>
+#include <levos/fs.h>
+#include <levos/eventpoll.h>
+#include <levos/poll.h>
+#include <levos/hash.h>
+#include <levos/mutex.h>
+#include <levos/task.h>
+
+/*
+ * The items of every file that is in a set, by file, for taking it out of
+ * them when it's closed.  ep_files and the ef_items lists are protected by
+ * ep_files_lock.  epmutex keeps the eventpolls from going away while
+ * eventpoll_release() takes a file out of them, and keeps epoll_ctl()
+ * from changing the lists under it.
+ */
+static struct hash ep_files;
+static spinlock_t ep_files_lock;
+static struct mutex epmutex;
+
+static unsigned
+ep_hash_file(const struct hash_elem *e, void *aux)
+{
+    struct ep_file *ef = hash_entry(e, struct ep_file, ef_helem);
+
+    return hash_int((int) ef->ef_file);
+}
+
+static bool
+ep_less_file(const struct hash_elem *a, const struct hash_elem *b, void *aux)
+{
+    struct ep_file *x = hash_entry(a, struct ep_file, ef_helem);
+    struct ep_file *y = hash_entry(b, struct ep_file, ef_helem);
+
+    return x->ef_file < y->ef_file;
+}
+
+/* the items of F, with ep_files_lock held */
+static struct ep_file *
+__ep_file_find(struct file *f)
+{
+    struct ep_file key = { .ef_file = f };
+    struct hash_elem *e;
+
+    e = hash_find(&ep_files, &key.ef_helem);
+    if (!e)
+        return NULL;
+
+    return hash_entry(e, struct ep_file, ef_helem);
+}
+
+/* put EPI on the items of its file */
+static int
+ep_file_link(struct epitem *epi)
+{
+    struct ep_file *ef, *new;
+
+    new = malloc(sizeof(*new));
+    if (!new)
+        return -ENOMEM;
+
+    spin_lock(&ep_files_lock);
+    ef = __ep_file_find(epi->epi_file);
+    if (!ef) {
+        ef = new;
+        new = NULL;
+        ef->ef_file = epi->epi_file;
+        list_init(&ef->ef_items);
+        hash_insert(&ep_files, &ef->ef_helem);
+    }
+    list_push_back(&ef->ef_items, &epi->epi_fllink);
+    spin_unlock(&ep_files_lock);
+
+    if (new)
+        free(new);
+
+    return 0;
+}
+
+static void
+ep_file_unlink(struct epitem *epi)
+{
+    struct ep_file *ef;
+
+    spin_lock(&ep_files_lock);
+    ef = __ep_file_find(epi->epi_file);
+    list_remove(&epi->epi_fllink);
+    if (list_empty(&ef->ef_items))
+        hash_delete(&ep_files, &ef->ef_helem);
+    else
+        ef = NULL;
+    spin_unlock(&ep_files_lock);
+
+    if (ef)
+        free(ef);
+}
+
+static unsigned
+ep_hash_item(const struct hash_elem *e, void *aux)
+{
+    struct epitem *epi = hash_entry(e, struct epitem, epi_helem);
+
+    return hash_int(epi->epi_fd) ^ hash_int((int) epi->epi_file);
+}
+
+static bool
+ep_less_item(const struct hash_elem *a, const struct hash_elem *b, void *aux)
+{
+    struct epitem *x = hash_entry(a, struct epitem, epi_helem);
+    struct epitem *y = hash_entry(b, struct epitem, epi_helem);
+
+    if (x->epi_fd != y->epi_fd)
+        return x->epi_fd < y->epi_fd;
+
+    return x->epi_file < y->epi_file;
+}
+
+static struct epitem *
+ep_find(struct eventpoll *ep, struct file *f, int fd)
+{
+    struct epitem searcher = { .epi_fd = fd, .epi_file = f };
+    struct hash_elem *e;
+
+    e = hash_find(&ep->ep_items, &searcher.epi_helem);
+    if (!e)
+        return NULL;
+
+    return hash_entry(e, struct epitem, epi_helem);
+}
+
+/* caller holds ep_lock */
+static void
+__ep_make_ready(struct eventpoll *ep, struct epitem *epi)
+{
+    if (epi->epi_ready)
+        return;
+
+    list_push_back(&ep->ep_rdllist, &epi->epi_rdllink);
+    epi->epi_ready = 1;
+    ep->ep_nready ++;
+}
+
+static void
+ep_make_ready(struct eventpoll *ep, struct epitem *epi)
+{
+    uint32_t flags;
+
+    flags = spin_lock_irqsave(&ep->ep_lock);
+    __ep_make_ready(ep, epi);
+    spin_unlock_irqrestore(&ep->ep_lock, flags);
+
+    wait_wake_up(&ep->ep_wq);
+}
+
+/*
+ * a wait queue of a file in the set was woken, from whatever context that
+ * happened in.  Whether it's really ready is up to epoll_wait() to find
+ * out.
+ */
+static void
+ep_poll_callback(struct wait_queue_entry *wqe)
+{
+    struct ep_wait *ew = container_of(wqe, struct ep_wait, ew_wqe);
+    struct epitem *epi = ew->ew_epi;
+    struct eventpoll *ep = epi->epi_ep;
+
+    spin_lock(&ep->ep_lock);
+
+    /* a oneshot that fired already, until EPOLL_CTL_MOD */
+    if (!(epi->epi_event.events & ~EP_PRIVATE_BITS)) {
+        spin_unlock(&ep->ep_lock);
+        return;
+    }
+
+    __ep_make_ready(ep, epi);
+    spin_unlock(&ep->ep_lock);
+
+    wait_wake_up(&ep->ep_wq);
+}
+
+static void
+ep_ptable_queue_proc(struct file *f, wait_queue_t *wq, struct poll_table *pt)
+{
+    struct epitem *epi = container_of(pt, struct epitem, epi_pt);
+    struct ep_wait *ew;
+
+    if (epi->epi_nwait < 0)
+        return;
+
+    if (epi->epi_nwait == EP_MAX_WAIT) {
+        epi->epi_nwait = -1;
+        return;
+    }
+
+    ew = &epi->epi_wait[epi->epi_nwait ++];
+    memset(ew, 0, sizeof(*ew));
+    ew->ew_wq = wq;
+    ew->ew_epi = epi;
+    ew->ew_wqe.wqe_func = ep_poll_callback;
+
+    wait_queue_add(wq, &ew->ew_wqe);
+}
+
+/* take EPI off the wait queues, the ready list and its file, and free it */
+static void
+ep_unregister(struct eventpoll *ep, struct epitem *epi)
+{
+    uint32_t flags;
+    int i, nwait;
+
+    nwait = epi->epi_nwait < 0 ? EP_MAX_WAIT : epi->epi_nwait;
+    for (i = 0; i < nwait; i ++)
+        wait_queue_remove(epi->epi_wait[i].ew_wq, &epi->epi_wait[i].ew_wqe);
+
+    flags = spin_lock_irqsave(&ep->ep_lock);
+    if (epi->epi_ready) {
+        list_remove(&epi->epi_rdllink);
+        epi->epi_ready = 0;
+        ep->ep_nready --;
+    }
+    spin_unlock_irqrestore(&ep->ep_lock, flags);
+
+    ep_file_unlink(epi);
+    free(epi);
+}
+
+static int
+ep_insert(struct eventpoll *ep, struct file *f, int fd,
+          struct epoll_event *event)
+{
+    struct epitem *epi;
+    int mask;
+
+    epi = malloc(sizeof(*epi));
+    if (!epi)
+        return -ENOMEM;
+
+    memset(epi, 0, sizeof(*epi));
+    epi->epi_ep = ep;
+    epi->epi_file = f;
+    epi->epi_fd = fd;
+    epi->epi_event = *event;
+    epi->epi_pt.pt_queue = ep_ptable_queue_proc;
+
+    if (ep_file_link(epi)) {
+        free(epi);
+        return -ENOMEM;
+    }
+
+    mask = vfs_poll(f, &epi->epi_pt);
+    if (epi->epi_nwait < 0) {
+        ep_unregister(ep, epi);
+        return -EINVAL;
+    }
+
+    hash_insert(&ep->ep_items, &epi->epi_helem);
+
+    if (mask & (event->events | POLL_ALWAYS))
+        ep_make_ready(ep, epi);
+
+    return 0;
+}
+
+static int
+ep_modify(struct eventpoll *ep, struct epitem *epi, struct epoll_event *event)
+{
+    uint32_t flags;
+    int mask;
+
+    flags = spin_lock_irqsave(&ep->ep_lock);
+    epi->epi_event = *event;
+    spin_unlock_irqrestore(&ep->ep_lock, flags);
+
+    /* it might be ready for what it waits for now */
+    mask = vfs_poll(epi->epi_file, NULL);
+    if (mask & (event->events | POLL_ALWAYS))
+        ep_make_ready(ep, epi);
+
+    return 0;
+}
+
+/*
+ * ep_send_events - collect the events of the ready files
+ *
+ * @ep - the eventpoll, ep_mtx is held
+ * @events - where to put them, in kernel memory
+ * @max - room in @events
+ *
+ * Looks at the files on the ready list at the time of the call, each at
+ * most once.  An edge triggered file leaves the list until its next
+ * wakeup, a level triggered one goes back on it for as long as it has
+ * events.
+ */
+static int
+ep_send_events(struct eventpoll *ep, struct epoll_event *events, int max)
+{
+    struct list txlist;
+    struct epitem *epi;
+    uint32_t flags, revents;
+    int n = 0, todo;
+
+    list_init(&txlist);
+
+    flags = spin_lock_irqsave(&ep->ep_lock);
+    todo = ep->ep_nready;
+    spin_unlock_irqrestore(&ep->ep_lock, flags);
+
+    while (todo -- && n < max) {
+        flags = spin_lock_irqsave(&ep->ep_lock);
+        if (list_empty(&ep->ep_rdllist)) {
+            spin_unlock_irqrestore(&ep->ep_lock, flags);
+            break;
+        }
+        epi = list_entry(list_pop_front(&ep->ep_rdllist),
+                         struct epitem, epi_rdllink);
+        epi->epi_ready = 0;
+        ep->ep_nready --;
+        spin_unlock_irqrestore(&ep->ep_lock, flags);
+
+        revents = vfs_poll(epi->epi_file, NULL) &
+                    (epi->epi_event.events | POLL_ALWAYS);
+        if (!revents || !(epi->epi_event.events & ~EP_PRIVATE_BITS))
+            continue;
+
+        events[n].events = revents;
+        events[n].data = epi->epi_event.data;
+        n ++;
+
+        if (epi->epi_event.events & EPOLLONESHOT)
+            epi->epi_event.events &= EP_PRIVATE_BITS;
+        else if (!(epi->epi_event.events & EPOLLET))
+            list_push_back(&txlist, &epi->epi_txlink);
+    }
+
+    /* level triggered, it's still ready as far as we know */
+    flags = spin_lock_irqsave(&ep->ep_lock);
+    while (!list_empty(&txlist)) {
+        epi = list_entry(list_pop_front(&txlist), struct epitem, epi_txlink);
+        __ep_make_ready(ep, epi);
+    }
+    spin_unlock_irqrestore(&ep->ep_lock, flags);
+
+    return n;
+}
+
+static size_t
+ep_fread(struct file *f, void *buf, size_t len)
+{
+    return -EINVAL;
+}
+
+static size_t
+ep_fwrite(struct file *f, void *buf, size_t len)
+{
+    return -EINVAL;
+}
+
+static int
+ep_fstat(struct file *f, struct stat *st)
+{
+    memset(st, 0, sizeof(*st));
+    return 0;
+}
+
+static void
+ep_free_item(struct hash_elem *e, void *aux)
+{
+    struct epitem *epi = hash_entry(e, struct epitem, epi_helem);
+
+    ep_unregister(epi->epi_ep, epi);
+}
+
+static int
+ep_fclose(struct file *f)
+{
+    struct eventpoll *ep = f->priv;
+
+    mutex_lock(&epmutex);
+    hash_destroy(&ep->ep_items, ep_free_item);
+    mutex_unlock(&epmutex);
+
+    free(ep);
+    free(f);
+    return 0;
+}
+
+/* an eventpoll is readable when epoll_wait() would not wait */
+static int
+ep_fpoll(struct file *f, struct poll_table *pt)
+{
+    struct eventpoll *ep = f->priv;
+
+    poll_wait(f, &ep->ep_wq, pt);
+
+    return ep->ep_nready ? POLLIN | POLLRDNORM : 0;
+}
+
+struct file_operations eventpoll_fops = {
+    .read = ep_fread,
+    .write = ep_fwrite,
+    .fstat = ep_fstat,
+    .close = ep_fclose,
+    .poll = ep_fpoll,
+};
+
+int
+is_eventpoll_file(struct file *f)
+{
+    return f->fops == &eventpoll_fops;
+}
+
+void
+eventpoll_init(void)
+{
+    if (!hash_init(&ep_files, ep_hash_file, ep_less_file, NULL))
+        panic("eventpoll: no memory for the file hash\n");
+
+    spin_lock_init(&ep_files_lock);
+    mutex_init(&epmutex);
+}
+
+/*
+ * eventpoll_release - take F out of every set it is in
+ *
+ * Called when the last reference to F is dropped, the sets don't keep
+ * their files open.
+ */
+void
+eventpoll_release(struct file *f)
+{
+    struct eventpoll *ep;
+    struct epitem *epi;
+    struct ep_file *ef;
+
+    /* most files never were in a set */
+    spin_lock(&ep_files_lock);
+    ef = __ep_file_find(f);
+    spin_unlock(&ep_files_lock);
+    if (!ef)
+        return;
+
+    mutex_lock(&epmutex);
+
+    for (;;) {
+        spin_lock(&ep_files_lock);
+        ef = __ep_file_find(f);
+        epi = ef ? list_entry(list_front(&ef->ef_items),
+                              struct epitem, epi_fllink) : NULL;
+        spin_unlock(&ep_files_lock);
+
+        if (!epi)
+            break;
+
+        /* epmutex keeps EPI and its eventpoll around until we have it */
+        ep = epi->epi_ep;
+        mutex_lock(&ep->ep_mtx);
+        hash_delete(&ep->ep_items, &epi->epi_helem);
+        ep_unregister(ep, epi);
+        mutex_unlock(&ep->ep_mtx);
+    }
+
+    mutex_unlock(&epmutex);
+}
+
+/* a new, empty eventpoll behind a file */
+struct file *
+eventpoll_create(void)
+{
+    struct eventpoll *ep;
+    struct file *filp;
+
+    ep = malloc(sizeof(*ep));
+    if (!ep)
+        return ERR_PTR(-ENOMEM);
+
+    if (!hash_init(&ep->ep_items, ep_hash_item, ep_less_item, NULL)) {
+        free(ep);
+        return ERR_PTR(-ENOMEM);
+    }
+
+    mutex_init(&ep->ep_mtx);
+    spin_lock_init(&ep->ep_lock);
+    list_init(&ep->ep_rdllist);
+    ep->ep_nready = 0;
+    wait_queue_init(&ep->ep_wq);
+
+    filp = malloc(sizeof(*filp));
+    if (!filp) {
+        hash_destroy(&ep->ep_items, NULL);
+        free(ep);
+        return ERR_PTR(-ENOMEM);
+    }
+
+    memset(filp, 0, sizeof(*filp));
+    filp->fops = &eventpoll_fops;
+    filp->type = FILE_TYPE_EPOLL;
+    filp->refc = 1;
+    filp->respath = "eventpoll";
+    filp->full_path = strdup("/internal/eventpoll");
+    filp->priv = ep;
+
+    return filp;
+}
+
+/*
+ * eventpoll_ctl - change the set of an eventpoll
+ *
+ * @epf - the eventpoll
+ * @op - EPOLL_CTL_*
+ * @fd - the descriptor @f was found at
+ * @f - the file
+ * @event - what to wait for, ignored for EPOLL_CTL_DEL
+ */
+int
+eventpoll_ctl(struct file *epf, int op, int fd, struct file *f,
+              struct epoll_event *event)
+{
+    struct eventpoll *ep = epf->priv;
+    struct epitem *epi;
+    int rc = 0;
+
+    /* wakeups would go around in circles */
+    if (is_eventpoll_file(f))
+        return -EINVAL;
+
+    mutex_lock(&epmutex);
+    mutex_lock(&ep->ep_mtx);
+
+    epi = ep_find(ep, f, fd);
+
+    switch (op) {
+        case EPOLL_CTL_ADD:
+            if (epi)
+                rc = -EEXIST;
+            else
+                rc = ep_insert(ep, f, fd, event);
+            break;
+        case EPOLL_CTL_DEL:
+            if (epi) {
+                hash_delete(&ep->ep_items, &epi->epi_helem);
+                ep_unregister(ep, epi);
+            } else
+                rc = -ENOENT;
+            break;
+        case EPOLL_CTL_MOD:
+            if (epi)
+                rc = ep_modify(ep, epi, event);
+            else
+                rc = -ENOENT;
+            break;
+        default:
+            rc = -EINVAL;
+            break;
+    }
+
+    mutex_unlock(&ep->ep_mtx);
+    mutex_unlock(&epmutex);
+
+    return rc;
+}
+
+/*
+ * eventpoll_wait - wait for files in the set to become ready
+ *
+ * @epf - the eventpoll
+ * @events - where the events go, in kernel memory
+ * @max - room in @events
+ * @timeout - in milliseconds, negative to wait for as long as it takes
+ *
+ * Returns the number of events, 0 on a timeout or -EINTR.
+ */
+int
+eventpoll_wait(struct file *epf, struct epoll_event *events, int max,
+               int timeout)
+{
+    extern uint32_t __pit_ticks;
+    struct eventpoll *ep = epf->priv;
+    struct poll_wqueues pw;
+    uint32_t expire = 0;
+    int n, rc = 0;
+
+    if (timeout > 0)
+        expire = __pit_ticks + poll_timeout_to_ticks(timeout);
+
+    /* on the queue before looking, so no wakeup gets lost */
+    poll_initwait(&pw);
+    if (timeout)
+        poll_wait(epf, &ep->ep_wq, &pw.pw_pt);
+
+    for (;;) {
+        mutex_lock(&ep->ep_mtx);
+        n = ep_send_events(ep, events, max);
+        mutex_unlock(&ep->ep_mtx);
+
+        if (n || !timeout)
+            break;
+
+        if (pw.pw_error) {
+            rc = pw.pw_error;
+            break;
+        }
+
+        if (expire && poll_expired(expire))
+            break;
+
+        rc = poll_schedule(&pw, expire);
+        if (rc)
+            break;
+    }
+
+    poll_freewait(&pw);
+
+    return rc ? rc : n;
+}
@@ -0,0 +1,736 @@
+#include <levos/kernel.h>
+#include <levos/types.h>
+#include <levos/fs.h>
+#include <levos/io_uring.h>
+#include <levos/poll.h>
+#include <levos/task.h>
+#include <levos/uaccess.h>
+#include <levos/work.h>
+
+static void io_req_work(void *);
+
+extern struct file_operations ctty_fops;
+
+static inline int
+is_power_of_two(uint32_t n)
+{
+    return n && !(n & (n - 1));
+}
+
+/* the ops that copy data out to the process when they are posted */
+static inline int
+io_op_reads(int op)
+{
+    return op == IORING_OP_READ || op == IORING_OP_RECV;
+}
+
+static void
+io_req_free(struct io_kiocb *req)
+{
+    if (req->req_file)
+        vfs_close(req->req_file);
+
+    /* never queued, so it's ours */
+    if (req->req_work)
+        free(req->req_work);
+
+    free(req->req_buf);
+    free(req);
+}
+
+/* take REQ off the wait queues of its file */
+static void
+io_req_unwait(struct io_kiocb *req)
+{
+    int i, nwait;
+
+    nwait = req->req_nwait < 0 ? IO_MAX_WAIT : req->req_nwait;
+    for (i = 0; i < nwait; i ++)
+        wait_queue_remove(req->req_wait[i].iw_wq, &req->req_wait[i].iw_wqe);
+
+    req->req_nwait = 0;
+}
+
+/*
+ * io_req_complete - REQ is done, with result RES
+ *
+ * It waits on ctx_done for the next io_uring_enter() to post it, unless
+ * the ring was closed in the meantime.  Called by the workers, or when
+ * the request is submitted if there's nothing to wait for.
+ */
+static void
+io_req_complete(struct io_kiocb *req, int res)
+{
+    struct io_ring_ctx *ctx = req->req_ctx;
+    uint32_t flags;
+    int last;
+
+    io_req_unwait(req);
+
+    flags = spin_lock_irqsave(&ctx->ctx_lock);
+    req->req_res = res;
+    list_remove(&req->req_elem);
+
+    if (ctx->ctx_dead) {
+        last = -- ctx->ctx_nr_reqs == 0;
+        spin_unlock_irqrestore(&ctx->ctx_lock, flags);
+
+        io_req_free(req);
+        if (last)
+            free(ctx);
+        return;
+    }
+
+    req->req_state = IO_REQ_DONE;
+    list_push_back(&ctx->ctx_done, &req->req_elem);
+    ctx->ctx_ndone ++;
+    spin_unlock_irqrestore(&ctx->ctx_lock, flags);
+
+    wait_wake_up(&ctx->ctx_wq);
+}
+
+/*
+ * a wait queue of the file of a request was woken.  If the request is
+ * waiting, its work is queued to have a look; if the work is already
+ * queued it is told to look again.
+ */
+static void
+io_poll_wake(struct wait_queue_entry *wqe)
+{
+    struct io_poll_wait *iw = container_of(wqe, struct io_poll_wait, iw_wqe);
+    struct io_kiocb *req = iw->iw_req;
+    struct io_ring_ctx *ctx = req->req_ctx;
+
+    spin_lock(&ctx->ctx_lock);
+    if (req->req_state == IO_REQ_POLLING) {
+        req->req_state = IO_REQ_QUEUED;
+        queue_work(system_wq, req->req_work);
+    } else if (req->req_state == IO_REQ_QUEUED)
+        req->req_rewake = 1;
+    spin_unlock(&ctx->ctx_lock);
+}
+
+static void
+io_queue_proc(struct file *f, wait_queue_t *wq, struct poll_table *pt)
+{
+    struct io_kiocb *req = container_of(pt, struct io_kiocb, req_pt);
+    struct io_poll_wait *iw;
+
+    if (req->req_nwait < 0)
+        return;
+
+    if (req->req_nwait == IO_MAX_WAIT) {
+        req->req_nwait = -1;
+        return;
+    }
+
+    iw = &req->req_wait[req->req_nwait ++];
+    memset(iw, 0, sizeof(*iw));
+    iw->iw_wq = wq;
+    iw->iw_req = req;
+    iw->iw_wqe.wqe_func = io_poll_wake;
+
+    wait_queue_add(wq, &iw->iw_wqe);
+}
+
+/* the events REQ is waiting for, if the file has them now */
+static inline int
+io_req_ready(struct io_kiocb *req, struct poll_table *pt)
+{
+    return vfs_poll(req->req_file, pt) & (req->req_wait_mask | POLL_ALWAYS);
+}
+
+/*
+ * io_req_arm - start a request that was just submitted
+ *
+ * The I/O is left to a worker.  If the request has to wait for its file,
+ * it's queued on the file's wait queues first, and the worker is only
+ * started once the file is ready, so workers don't sit in reads that
+ * block.
+ */
+static void
+io_req_arm(struct io_kiocb *req)
+{
+    struct io_ring_ctx *ctx = req->req_ctx;
+    uint32_t flags;
+    int ready = 1;
+
+    /* a file on too many wait queues is failed by the worker */
+    if (req->req_wait_mask)
+        ready = io_req_ready(req, &req->req_pt) || req->req_nwait < 0;
+
+    /* a wakeup might have beaten us to it */
+    flags = spin_lock_irqsave(&ctx->ctx_lock);
+    if (ready && req->req_state == IO_REQ_POLLING) {
+        req->req_state = IO_REQ_QUEUED;
+        queue_work(system_wq, req->req_work);
+    }
+    spin_unlock_irqrestore(&ctx->ctx_lock, flags);
+}
+
+/* the I/O of REQ, on kernel buffers, from a worker */
+static int
+io_req_issue(struct io_kiocb *req, int mask)
+{
+    struct io_uring_sqe *sqe = &req->req_sqe;
+    struct file *f = req->req_file;
+
+    switch (sqe->opcode) {
+        case IORING_OP_READ:
+        case IORING_OP_RECV:
+            if (sqe->len == 0)
+                return 0;
+            if (sqe->opcode == IORING_OP_READ && sqe->off != IORING_OFF_FPOS)
+                return vfs_pread(f, req->req_buf, sqe->len, sqe->off);
+            return f->fops->read(f, req->req_buf, sqe->len);
+        case IORING_OP_WRITE:
+        case IORING_OP_SEND:
+            if (sqe->len == 0)
+                return 0;
+            if (sqe->opcode == IORING_OP_WRITE && sqe->off != IORING_OFF_FPOS)
+                return vfs_pwrite(f, req->req_buf, sqe->len, sqe->off);
+            return f->fops->write(f, req->req_buf, sqe->len);
+        case IORING_OP_FSYNC:
+            return vfs_fsync(f);
+        case IORING_OP_POLL_ADD:
+            return mask;
+    }
+
+    return -EINVAL;
+}
+
+static void
+io_req_work(void *aux)
+{
+    struct io_kiocb *req = aux;
+    struct io_ring_ctx *ctx = req->req_ctx;
+    uint32_t flags;
+    int mask = 0;
+
+    /* the worker frees this one when we return */
+    req->req_work = NULL;
+
+    if (req->req_nwait < 0) {
+        io_req_complete(req, -EINVAL);
+        return;
+    }
+
+    while (req->req_wait_mask) {
+        flags = spin_lock_irqsave(&ctx->ctx_lock);
+        req->req_rewake = 0;
+        spin_unlock_irqrestore(&ctx->ctx_lock, flags);
+
+        mask = io_req_ready(req, NULL);
+        if (mask)
+            break;
+
+        /* not ready, back to waiting for a wakeup */
+        if (!req->req_work) {
+            req->req_work = work_create(io_req_work, req);
+            if (!req->req_work) {
+                io_req_complete(req, -ENOMEM);
+                return;
+            }
+        }
+
+        flags = spin_lock_irqsave(&ctx->ctx_lock);
+        if (!req->req_rewake) {
+            req->req_state = IO_REQ_POLLING;
+            spin_unlock_irqrestore(&ctx->ctx_lock, flags);
+            return;
+        }
+        spin_unlock_irqrestore(&ctx->ctx_lock, flags);
+    }
+
+    io_req_complete(req, io_req_issue(req, mask));
+}
+
+/*
+ * io_req_prep - check the sqe of REQ and get what it needs
+ *
+ * Takes a reference to the file and copies in the data to write, so the
+ * worker doesn't need the process.  Returns 0 or the error to complete
+ * the request with.
+ */
+static int
+io_req_prep(struct io_kiocb *req)
+{
+    struct io_uring_sqe *sqe = &req->req_sqe;
+    struct file *f;
+
+    f = fd_lookup(current_task, sqe->fd);
+    if (!f)
+        return -EBADF;
+
+    /* a ring holding a reference to itself would never go away */
+    if (is_io_uring_file(f))
+        return -EINVAL;
+
+    /*
+     * /dev/tty is the terminal of whoever does the I/O, and the worker
+     * doing it has none.
+     */
+    if (f->fops == &ctty_fops)
+        return -EINVAL;
+
+    vfs_inc_refc(f);
+    req->req_file = f;
+
+    switch (sqe->opcode) {
+        case IORING_OP_RECV:
+        case IORING_OP_SEND:
+            if (f->type != FILE_TYPE_SOCKET)
+                return -ENOTSOCK;
+            /* fall through */
+        case IORING_OP_READ:
+        case IORING_OP_WRITE:
+            if (f->isdir)
+                return -EISDIR;
+
+            if (sqe->len == 0)
+                break;
+
+            if (!access_ok((void *) sqe->addr, sqe->len))
+                return -EFAULT;
+
+            req->req_buf = malloc(sqe->len);
+            if (!req->req_buf)
+                return -ENOMEM;
+
+            if (io_op_reads(sqe->opcode)) {
+                req->req_wait_mask = POLLIN;
+            } else {
+                if (copy_from_user(req->req_buf, (void *) sqe->addr, sqe->len))
+                    return -EFAULT;
+                req->req_wait_mask = POLLOUT;
+            }
+            break;
+        case IORING_OP_FSYNC:
+            break;
+        case IORING_OP_POLL_ADD:
+            req->req_wait_mask = sqe->poll_events & 0xFFFF;
+            break;
+        default:
+            return -EINVAL;
+    }
+
+    req->req_work = work_create(io_req_work, req);
+    if (!req->req_work)
+        return -ENOMEM;
+
+    return 0;
+}
+
+/* REQ has its sqe, and a slot in the completion ring */
+static void
+io_submit_req(struct io_ring_ctx *ctx, struct io_kiocb *req)
+{
+    uint32_t flags;
+    int rc = 0;
+
+    req->req_ctx = ctx;
+    req->req_state = IO_REQ_POLLING;
+    req->req_pt.pt_queue = io_queue_proc;
+
+    flags = spin_lock_irqsave(&ctx->ctx_lock);
+    list_push_back(&ctx->ctx_inflight, &req->req_elem);
+    spin_unlock_irqrestore(&ctx->ctx_lock, flags);
+
+    if (req->req_sqe.opcode != IORING_OP_NOP)
+        rc = io_req_prep(req);
+
+    if (rc || req->req_sqe.opcode == IORING_OP_NOP)
+        io_req_complete(req, rc);
+    else
+        io_req_arm(req);
+}
+
+/*
+ * io_submit_sqes - take up to NR entries off the submission ring
+ *
+ * Stops early once there are as many requests as the completion ring has
+ * room for.  A bad entry still counts, it completes with an error.
+ * Returns how many were taken, or an error if none were.
+ */
+static int
+io_submit_sqes(struct io_ring_ctx *ctx, unsigned int nr)
+{
+    struct io_uring_sq *sq = ctx->ctx_sq;
+    struct io_kiocb *req;
+    uint32_t tail, flags;
+    int rc = 0, full;
+    unsigned int n = 0;
+
+    if (copy_from_user(&tail, &sq->tail, sizeof(tail)))
+        return -EFAULT;
+
+    if (tail - ctx->ctx_sq_head > ctx->ctx_sq_entries)
+        return -EINVAL;
+
+    if (nr > tail - ctx->ctx_sq_head)
+        nr = tail - ctx->ctx_sq_head;
+
+    while (n < nr) {
+        flags = spin_lock_irqsave(&ctx->ctx_lock);
+        full = ctx->ctx_nr_reqs == ctx->ctx_cq_entries;
+        if (!full)
+            ctx->ctx_nr_reqs ++;
+        spin_unlock_irqrestore(&ctx->ctx_lock, flags);
+
+        if (full) {
+            rc = -EBUSY;
+            break;
+        }
+
+        req = malloc(sizeof(*req));
+        if (req)
+            memset(req, 0, sizeof(*req));
+
+        if (!req || copy_from_user(&req->req_sqe,
+                    &sq->sqes[ctx->ctx_sq_head & (ctx->ctx_sq_entries - 1)],
+                    sizeof(req->req_sqe))) {
+            rc = req ? -EFAULT : -ENOMEM;
+            free(req);
+
+            flags = spin_lock_irqsave(&ctx->ctx_lock);
+            ctx->ctx_nr_reqs --;
+            spin_unlock_irqrestore(&ctx->ctx_lock, flags);
+            break;
+        }
+
+        ctx->ctx_sq_head ++;
+        n ++;
+
+        io_submit_req(ctx, req);
+    }
+
+    if (n && copy_to_user(&sq->head, &ctx->ctx_sq_head, sizeof(uint32_t)))
+        return -EFAULT;
+
+    return n ? n : rc;
+}
+
+/*
+ * io_cqring_flush - post the requests on ctx_done
+ *
+ * Copies out the data of reads, and fills the completion ring for as long
+ * as it has room.  Returns the number of entries in it, or -EFAULT, in
+ * which case the request that couldn't be posted is kept on ctx_done.
+ */
+static int
+io_cqring_flush(struct io_ring_ctx *ctx)
+{
+    struct io_uring_cq *cq = ctx->ctx_cq;
+    struct io_uring_cqe cqe;
+    struct io_kiocb *req;
+    uint32_t head, flags, tail = ctx->ctx_cq_tail;
+    int rc = 0;
+
+    if (copy_from_user(&head, &cq->head, sizeof(head)))
+        return -EFAULT;
+
+    for (;;) {
+        flags = spin_lock_irqsave(&ctx->ctx_lock);
+        if (list_empty(&ctx->ctx_done) ||
+                tail - head >= ctx->ctx_cq_entries) {
+            spin_unlock_irqrestore(&ctx->ctx_lock, flags);
+            break;
+        }
+        req = list_entry(list_pop_front(&ctx->ctx_done),
+                         struct io_kiocb, req_elem);
+        spin_unlock_irqrestore(&ctx->ctx_lock, flags);
+
+        cqe.user_data = req->req_sqe.user_data;
+        cqe.res = req->req_res;
+        cqe.flags = 0;
+
+        if (io_op_reads(req->req_sqe.opcode) && cqe.res > 0 &&
+                copy_to_user((void *) req->req_sqe.addr, req->req_buf, cqe.res))
+            cqe.res = -EFAULT;
+
+        if (copy_to_user(&cq->cqes[tail & (ctx->ctx_cq_entries - 1)],
+                    &cqe, sizeof(cqe))) {
+            flags = spin_lock_irqsave(&ctx->ctx_lock);
+            list_push_front(&ctx->ctx_done, &req->req_elem);
+            spin_unlock_irqrestore(&ctx->ctx_lock, flags);
+            rc = -EFAULT;
+            break;
+        }
+
+        flags = spin_lock_irqsave(&ctx->ctx_lock);
+        ctx->ctx_ndone --;
+        ctx->ctx_nr_reqs --;
+        spin_unlock_irqrestore(&ctx->ctx_lock, flags);
+
+        io_req_free(req);
+        tail ++;
+    }
+
+    if (tail != ctx->ctx_cq_tail) {
+        ctx->ctx_cq_tail = tail;
+        if (copy_to_user(&cq->tail, &tail, sizeof(tail)))
+            return -EFAULT;
+    }
+
+    return rc ? rc : (int) (tail - head);
+}
+
+/*
+ * io_cqring_wait - post completions until the ring has MIN of them
+ *
+ * Gives up early if there is nothing left in flight that could make up
+ * the difference.  Returns the number in the ring, -EINTR or -EFAULT.
+ */
+static int
+io_cqring_wait(struct file *f, unsigned int min)
+{
+    struct io_ring_ctx *ctx = f->priv;
+    struct poll_wqueues pw;
+    uint32_t flags;
+    int rc, idle;
+
+    if (min > ctx->ctx_cq_entries)
+        min = ctx->ctx_cq_entries;
+
+    /* on the queue before looking, so no completion gets lost */
+    poll_initwait(&pw);
+    if (min)
+        poll_wait(f, &ctx->ctx_wq, &pw.pw_pt);
+
+    for (;;) {
+        /* before flushing, or what's done in between would be missed */
+        flags = spin_lock_irqsave(&ctx->ctx_lock);
+        idle = ctx->ctx_nr_reqs == ctx->ctx_ndone;
+        spin_unlock_irqrestore(&ctx->ctx_lock, flags);
+
+        rc = io_cqring_flush(ctx);
+        if (rc < 0 || rc >= min || idle)
+            break;
+
+        if (pw.pw_error) {
+            rc = pw.pw_error;
+            break;
+        }
+
+        rc = poll_schedule(&pw, 0);
+        if (rc)
+            break;
+    }
+
+    poll_freewait(&pw);
+
+    return rc;
+}
+
+/*
+ * io_uring_enter - submit and wait for completions
+ *
+ * @f - the ring
+ * @to_submit - how many entries to take off the submission ring
+ * @min_complete - with IORING_ENTER_GETEVENTS, how many completions to
+ *                 wait for
+ * @flags - IORING_ENTER_*
+ *
+ * Whatever is done by the time it returns is posted either way.  Returns
+ * the number of entries submitted, or an error if there were none.
+ */
+int
+io_uring_enter(struct file *f, unsigned int to_submit,
+               unsigned int min_complete, unsigned int flags)
+{
+    int submitted = 0, rc;
+
+    if (to_submit) {
+        submitted = io_submit_sqes(f->priv, to_submit);
+        if (submitted < 0)
+            return submitted;
+    }
+
+    if (!(flags & IORING_ENTER_GETEVENTS))
+        min_complete = 0;
+
+    rc = io_cqring_wait(f, min_complete);
+    if (rc < 0 && !submitted)
+        return rc;
+
+    return submitted;
+}
+
+static size_t
+io_uring_fread(struct file *f, void *buf, size_t len)
+{
+    return -EINVAL;
+}
+
+static size_t
+io_uring_fwrite(struct file *f, void *buf, size_t len)
+{
+    return -EINVAL;
+}
+
+static int
+io_uring_fstat(struct file *f, struct stat *st)
+{
+    memset(st, 0, sizeof(*st));
+    return 0;
+}
+
+/*
+ * The requests still waiting for their files are cancelled, along with
+ * the ones not posted yet.  The workers free the rest when they are done,
+ * and the last one frees the ring.
+ */
+static int
+io_uring_fclose(struct file *f)
+{
+    struct io_ring_ctx *ctx = f->priv;
+    struct list cancelled;
+    struct list_elem *e, *next;
+    struct io_kiocb *req;
+    uint32_t flags;
+    int last;
+
+    list_init(&cancelled);
+
+    flags = spin_lock_irqsave(&ctx->ctx_lock);
+    ctx->ctx_dead = 1;
+
+    for (e = list_begin(&ctx->ctx_inflight);
+            e != list_end(&ctx->ctx_inflight); e = next) {
+        next = list_next(e);
+        req = list_entry(e, struct io_kiocb, req_elem);
+
+        if (req->req_state != IO_REQ_POLLING)
+            continue;
+
+        req->req_state = IO_REQ_CANCELLED;
+        list_remove(e);
+        list_push_back(&cancelled, e);
+        ctx->ctx_nr_reqs --;
+    }
+
+    while (!list_empty(&ctx->ctx_done)) {
+        list_push_back(&cancelled, list_pop_front(&ctx->ctx_done));
+        ctx->ctx_nr_reqs --;
+    }
+    ctx->ctx_ndone = 0;
+
+    last = ctx->ctx_nr_reqs == 0;
+    spin_unlock_irqrestore(&ctx->ctx_lock, flags);
+
+    while (!list_empty(&cancelled)) {
+        req = list_entry(list_pop_front(&cancelled), struct io_kiocb, req_elem);
+        io_req_unwait(req);
+        io_req_free(req);
+    }
+
+    if (last)
+        free(ctx);
+
+    free(f);
+    return 0;
+}
+
+/* a ring is readable when there are completions to post */
+static int
+io_uring_fpoll(struct file *f, struct poll_table *pt)
+{
+    struct io_ring_ctx *ctx = f->priv;
+
+    poll_wait(f, &ctx->ctx_wq, pt);
+
+    return ctx->ctx_ndone ? POLLIN | POLLRDNORM : 0;
+}
+
+struct file_operations io_uring_fops = {
+    .read = io_uring_fread,
+    .write = io_uring_fwrite,
+    .fstat = io_uring_fstat,
+    .close = io_uring_fclose,
+    .poll = io_uring_fpoll,
+};
+
+int
+is_io_uring_file(struct file *f)
+{
+    return f->fops == &io_uring_fops;
+}
+
+/*
+ * io_uring_create - a new ring behind a file
+ *
+ * @p - the parameters, in kernel memory.  sq_entries has to be a power
+ *      of two, cq_entries too if IORING_SETUP_CQSIZE is set, otherwise
+ *      it is set to twice sq_entries.
+ *
+ * The rings p->sq_ring and p->cq_ring have to be big enough for that,
+ * see IO_URING_SQ_SIZE() and IO_URING_CQ_SIZE().  Their headers are
+ * filled in here.
+ */
+struct file *
+io_uring_create(struct io_uring_params *p)
+{
+    struct io_uring_sq sq_hdr;
+    struct io_uring_cq cq_hdr;
+    struct io_ring_ctx *ctx;
+    struct file *filp;
+
+    if (!is_power_of_two(p->sq_entries) || p->sq_entries > IORING_MAX_ENTRIES)
+        return ERR_PTR(-EINVAL);
+
+    if (p->flags & ~IORING_SETUP_CQSIZE)
+        return ERR_PTR(-EINVAL);
+
+    if (p->flags & IORING_SETUP_CQSIZE) {
+        if (!is_power_of_two(p->cq_entries) || p->cq_entries < p->sq_entries ||
+                p->cq_entries > 2 * IORING_MAX_ENTRIES)
+            return ERR_PTR(-EINVAL);
+    } else
+        p->cq_entries = 2 * p->sq_entries;
+
+    if (!access_ok(p->sq_ring, IO_URING_SQ_SIZE(p->sq_entries)) ||
+            !access_ok(p->cq_ring, IO_URING_CQ_SIZE(p->cq_entries)))
+        return ERR_PTR(-EFAULT);
+
+    memset(&sq_hdr, 0, sizeof(sq_hdr));
+    sq_hdr.ring_mask = p->sq_entries - 1;
+    sq_hdr.ring_entries = p->sq_entries;
+
+    memset(&cq_hdr, 0, sizeof(cq_hdr));
+    cq_hdr.ring_mask = p->cq_entries - 1;
+    cq_hdr.ring_entries = p->cq_entries;
+
+    if (copy_to_user(p->sq_ring, &sq_hdr, sizeof(sq_hdr)) ||
+            copy_to_user(p->cq_ring, &cq_hdr, sizeof(cq_hdr)))
+        return ERR_PTR(-EFAULT);
+
+    ctx = malloc(sizeof(*ctx));
+    if (!ctx)
+        return ERR_PTR(-ENOMEM);
+
+    memset(ctx, 0, sizeof(*ctx));
+    ctx->ctx_sq = p->sq_ring;
+    ctx->ctx_cq = p->cq_ring;
+    ctx->ctx_sq_entries = p->sq_entries;
+    ctx->ctx_cq_entries = p->cq_entries;
+    spin_lock_init(&ctx->ctx_lock);
+    list_init(&ctx->ctx_inflight);
+    list_init(&ctx->ctx_done);
+    wait_queue_init(&ctx->ctx_wq);
+
+    filp = malloc(sizeof(*filp));
+    if (!filp) {
+        free(ctx);
+        return ERR_PTR(-ENOMEM);
+    }
+
+    memset(filp, 0, sizeof(*filp));
+    filp->fops = &io_uring_fops;
+    filp->type = FILE_TYPE_IO_URING;
+    filp->refc = 1;
+    filp->respath = "io_uring";
+    filp->full_path = strdup("/internal/io_uring");
+    filp->priv = ctx;
+
+    return filp;
+}
@@ -13,7 +13,11 @@
 #include <levos/elf.h>
 #include <levos/packet.h>
 #include <levos/spinlock.h>
+#include <levos/pid.h>
 #include <levos/work.h>
+#include <levos/softirq.h>
+#include <levos/rcu.h>
+#include <levos/sysstat.h>
 #include <levos/pci.h>
 #include <levos/arp.h>
 #include <levos/socket.h>
@@ -50,6 +54,7 @@ cmdline_parse(char *cmdline)
     default_user_device = &console_device;
     extern int __sysctl_trace_sys;
     __sysctl_trace_sys = 0;
+    extern int __sysctl_nosmp;
 
     pch = strtok_r(cmdline, " ", &lasts);
     while (pch != NULL) {
@@ -61,6 +66,8 @@ cmdline_parse(char *cmdline)
             default_user_device = videocon_get_for_vt(0);
         } else if (strcmp(pch, "tracesys") == 0) {
             __sysctl_trace_sys = 1;
+        } else if (strcmp(pch, "nosmp") == 0) {
+            __sysctl_nosmp = 1;
         }
         pch = strtok_r(NULL, " ", &lasts);
     }
@@ -72,7 +79,8 @@ bss_init(void)
     memset(&_bss_start, 0, &_bss_end - &_bss_end);
 }
 
-static spinlock_t setup_lock;
+/* set once late_init() is done, init waits for it */
+static volatile int setup_done;
 
 __noreturn void
 kernel_main(uint32_t boot_sig, void *ptr)
@@ -81,9 +89,8 @@ kernel_main(uint32_t boot_sig, void *ptr)
 
     bss_init();
 
-    spin_lock_init(&setup_lock);
-    spin_lock(&setup_lock);
-
+    /* sets up the per-CPU segment, has to come before anything that
+     * looks at current_task */
     arch_early_init(boot_sig, ptr);
 
     palloc_init();
@@ -102,6 +109,9 @@ kernel_main(uint32_t boot_sig, void *ptr)
     //printk("so far used: %d of %d, free: %d\n", palloc_get_used(), 
             //palloc_get_total(), palloc_get_free());
     printk("main: enabling interrupts\n");
+    softirq_init();
+    sysstat_init();
+    rcu_init();
     arch_preirq_init();
     ENABLE_IRQ();
     printk("main: IRQs enabled\n");
@@ -159,8 +169,8 @@ do_first_init()
 
     /* setup the task structure for exposure to userspace */
     current_task->ppid = 0;//current_task->pid;
-    current_task->pgid = current_task->pid;
-    current_task->sid  = current_task->pid;
+    task_set_pgrp(current_task, current_task->pid);
+    task_set_session(current_task, current_task->pid);
     current_task->cwd  = strdup("/");
     //printk("ALLOC %s %d: 0x%x\n", __func__, current_task->pid, current_task->cwd);
 
@@ -189,7 +199,9 @@ do_first_init()
     tty->tty_fg_proc = current_task->pid;
     struct file *f_in = tty_get_file(tty);
     f_in->refc = 3;
-    current_task->file_table[1] = current_task->file_table[2] = current_task->file_table[0] = f_in;
+    fd_install(current_task, 0, f_in);
+    fd_install(current_task, 1, f_in);
+    fd_install(current_task, 2, f_in);
     current_task->ctty = tty;
 
     /* TSS */
@@ -226,8 +238,8 @@ init_task(void)
     int rc, fd;
 
     /* wait until the setup is finished */
-    spin_lock(&setup_lock);
-    sched_yield();
+    while (!setup_done)
+        sched_yield();
 
 #ifdef CONFIG_PATH_TEST
     printk("--- path testing enabled ---\n");
@@ -352,6 +364,7 @@ late_init(void)
     net_init();
 
     struct task *pkthndlr = create_kernel_task(packet_processor_thread);
+    sched_setscheduler(pkthndlr, SCHED_FIFO, KTHREAD_RT_PRIO);
     sched_add_rq(pkthndlr);
     sched_yield();
 
@@ -380,8 +393,12 @@ late_init(void)
 
     tty_init();
 
+    smp_init();
+
+    ksoftirqd_init();
+
     /* use condvar */
-    spin_unlock(&setup_lock);
+    setup_done = 1;
 
 #if 0
     printk("main: falling through to echo\n");
@@ -391,11 +408,10 @@ late_init(void)
         console_emit(c);
     }
 #endif
-    /* become the idle task */
-    extern struct task *current_task;
-    printk("main: idle process idling from now\n");
+    /* the per-CPU idle tasks do the idling, get off the run queue */
+    printk("main: swapper going to sleep\n");
     while (1)
-        sched_yield();
+        task_block(current_task);
 
     __not_reached();
 }
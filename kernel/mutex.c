@@ -0,0 +1,64 @@
+#include <levos/kernel.h>
+#include <levos/mutex.h>
+#include <levos/wait.h>
+#include <levos/task.h>
+
+void
+mutex_init(struct mutex *m)
+{
+    m->m_owner = NULL;
+    wait_queue_init(&m->m_waiters);
+}
+
+int
+mutex_trylock(struct mutex *m)
+{
+    return __sync_bool_compare_and_swap(&m->m_owner, NULL, current_task);
+}
+
+static void
+mutex_lock_slow(struct mutex *m)
+{
+    struct wait_queue_entry wqe;
+
+    memset(&wqe, 0, sizeof(wqe));
+
+    /* being on the queue before the retry makes sure we get woken */
+    while (1) {
+        prepare_to_wait(&m->m_waiters, &wqe);
+        if (mutex_trylock(m))
+            break;
+        sched_yield();
+    }
+
+    finish_wait(&m->m_waiters, &wqe);
+}
+
+void
+mutex_lock(struct mutex *m)
+{
+    panic_on(m->m_owner == current_task, "mutex: recursive locking\n");
+
+    if (mutex_trylock(m))
+        return;
+
+    mutex_lock_slow(m);
+}
+
+void
+mutex_unlock(struct mutex *m)
+{
+    panic_on(m->m_owner != current_task, "mutex: unlocked by non-owner\n");
+
+    m->m_owner = NULL;
+    __sync_synchronize();
+
+    if (wait_queue_num_waiters(&m->m_waiters))
+        wait_wake_up_one(&m->m_waiters);
+}
+
+int
+mutex_is_locked(struct mutex *m)
+{
+    return m->m_owner != NULL;
+}
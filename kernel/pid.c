@@ -0,0 +1,245 @@
+#include <levos/kernel.h>
+#include <levos/types.h>
+#include <levos/pid.h>
+#include <levos/task.h>
+#include <levos/bitmap.h>
+#include <levos/hash.h>
+#include <levos/rcu.h>
+#include <levos/spinlock.h>
+
+spinlock_t pid_lock;
+
+static elem_type pid_bitmap_bits[PID_MAX / ELEM_BITS];
+static struct bitmap pid_bitmap = {
+    .bit_cnt = PID_MAX,
+    .bits = pid_bitmap_bits,
+};
+
+/*
+ * the last PID handed out, the search for a free one starts after it so
+ * that a PID that was just freed is not reused right away
+ */
+static pid_t pid_cursor = -1;
+
+/*
+ * A fixed size hash of singly linked chains, so that lookups can walk it
+ * under RCU while it changes.  Writers hold pid_lock.
+ */
+#define PID_HASH_SIZE 256
+
+static struct pid *pid_hash[PID_HASH_SIZE];
+
+static inline struct pid **
+pid_bucket(pid_t nr)
+{
+    return &pid_hash[hash_int(nr) % PID_HASH_SIZE];
+}
+
+void
+pid_init(void)
+{
+    spin_lock_init(&pid_lock);
+}
+
+/*
+ * pid_find - look up a PID in use
+ *
+ * @nr - the PID
+ *
+ * The caller must hold pid_lock or be in an RCU read-side critical
+ * section.
+ */
+struct pid *
+pid_find(pid_t nr)
+{
+    struct pid *pid;
+
+    for (pid = rcu_dereference(*pid_bucket(nr)); pid;
+            pid = rcu_dereference(pid->pid_next))
+        if (pid->pid_nr == nr)
+            return pid;
+
+    return NULL;
+}
+
+static void
+pid_free_rcu(struct rcu_head *head)
+{
+    free(container_of(head, struct pid, pid_rcu));
+}
+
+static void
+__pid_put(struct pid *pid)
+{
+    struct pid **link;
+
+    if (-- pid->pid_refs)
+        return;
+
+    for (link = pid_bucket(pid->pid_nr); *link != pid;
+            link = &(*link)->pid_next)
+        ;
+
+    /* readers that are on PID still get to move on to the next one */
+    rcu_assign_pointer(*link, pid->pid_next);
+    bitmap_reset(&pid_bitmap, pid->pid_nr);
+    call_rcu(&pid->pid_rcu, pid_free_rcu);
+}
+
+/*
+ * pid_alloc - get a free PID
+ *
+ * The first one handed out is 0, for the swapper.  Returns -EAGAIN if
+ * every PID is in use.  The reference returned is owned by the process,
+ * see process_destroy().
+ */
+pid_t
+pid_alloc(void)
+{
+    struct pid *pid = malloc(sizeof(*pid));
+    uint32_t flags;
+    size_t nr;
+
+    if (!pid)
+        return -ENOMEM;
+
+    memset(pid, 0, sizeof(*pid));
+    list_init(&pid->pid_pgrp);
+    list_init(&pid->pid_session);
+    pid->pid_refs = 1;
+
+    flags = spin_lock_irqsave(&pid_lock);
+    nr = bitmap_scan_and_flip(&pid_bitmap, pid_cursor + 1, 1, 0);
+    if (nr == BITMAP_ERROR)
+        nr = bitmap_scan_and_flip(&pid_bitmap, 1, 1, 0);
+    if (nr == BITMAP_ERROR) {
+        spin_unlock_irqrestore(&pid_lock, flags);
+        free(pid);
+        return -EAGAIN;
+    }
+
+    pid_cursor = nr;
+    pid->pid_nr = nr;
+    pid->pid_next = *pid_bucket(nr);
+    rcu_assign_pointer(*pid_bucket(nr), pid);
+    spin_unlock_irqrestore(&pid_lock, flags);
+
+    return nr;
+}
+
+/* drop the reference that pid_alloc() returned */
+void
+pid_put(pid_t nr)
+{
+    struct pid *pid;
+    uint32_t flags;
+
+    flags = spin_lock_irqsave(&pid_lock);
+    pid = pid_find(nr);
+    if (pid)
+        __pid_put(pid);
+    spin_unlock_irqrestore(&pid_lock, flags);
+}
+
+/*
+ * move the task behind ELEM from the list of *LINK to that of the PID NR,
+ * which is either the process group or the session list
+ */
+static void
+pid_link(struct pid **link, struct list_elem *elem, pid_t nr, int session)
+{
+    struct pid *pid = nr > 0 ? pid_find(nr) : NULL;
+
+    /* take the new reference first, NR might be what we are leaving */
+    if (pid)
+        pid->pid_refs ++;
+
+    if (*link) {
+        list_remove(elem);
+        __pid_put(*link);
+    }
+
+    *link = pid;
+    if (pid)
+        list_push_back(session ? &pid->pid_session : &pid->pid_pgrp, elem);
+}
+
+void
+task_set_pgrp(struct task *task, pid_t pgid)
+{
+    uint32_t flags;
+
+    flags = spin_lock_irqsave(&pid_lock);
+    task->pgid = pgid;
+    pid_link(&task->pgrp, &task->pgrp_elem, pgid, 0);
+    spin_unlock_irqrestore(&pid_lock, flags);
+}
+
+void
+task_set_session(struct task *task, pid_t sid)
+{
+    uint32_t flags;
+
+    flags = spin_lock_irqsave(&pid_lock);
+    task->sid = sid;
+    pid_link(&task->session, &task->session_elem, sid, 1);
+    spin_unlock_irqrestore(&pid_lock, flags);
+}
+
+/* make TASK visible to get_task_for_pid() */
+void
+pid_attach_task(struct task *task)
+{
+    struct pid *pid;
+    uint32_t flags;
+
+    flags = spin_lock_irqsave(&pid_lock);
+    pid = pid_find(task->pid);
+    if (pid && !pid->pid_task) {
+        rcu_assign_pointer(pid->pid_task, task);
+        pid->pid_refs ++;
+    }
+    spin_unlock_irqrestore(&pid_lock, flags);
+}
+
+/* TASK is exiting, hide it and take it out of its group and session */
+void
+pid_detach_task(struct task *task)
+{
+    struct pid *pid;
+    uint32_t flags;
+
+    flags = spin_lock_irqsave(&pid_lock);
+    pid_link(&task->pgrp, &task->pgrp_elem, 0, 0);
+    pid_link(&task->session, &task->session_elem, 0, 1);
+
+    pid = pid_find(task->pid);
+    if (pid && pid->pid_task == task) {
+        rcu_assign_pointer(pid->pid_task, NULL);
+        __pid_put(pid);
+    }
+    spin_unlock_irqrestore(&pid_lock, flags);
+}
+
+/*
+ * get_task_for_pid - the running task with a PID
+ *
+ * Lockless.  A task is only freed a grace period after it exited, so a
+ * caller that uses the task, not just checks that there is one, has to
+ * look it up and use it within one rcu_read_lock() section, and may not
+ * sleep in there.
+ */
+struct task *
+get_task_for_pid(pid_t nr)
+{
+    struct task *task = NULL;
+    struct pid *pid;
+
+    rcu_read_lock();
+    pid = pid_find(nr);
+    if (pid)
+        task = rcu_dereference(pid->pid_task);
+    rcu_read_unlock();
+
+    return task;
+}
@@ -3,44 +3,115 @@
 #include <levos/fs.h>
 #include <levos/task.h>
 #include <levos/spinlock.h>
+#include <levos/poll.h>
+#include <levos/signal.h>
+
+static inline int
+pipe_readable(struct pipe *pip)
+{
+    return ring_buffer_size(&pip->pipe_buffer) ||
+        pip->pipe_flags & PIPFLAG_WRITE_CLOSED;
+}
+
+static inline int
+pipe_writable(struct pipe *pip)
+{
+    return ring_buffer_size(&pip->pipe_buffer) < pip->pipe_buffer.capacity ||
+        pip->pipe_flags & PIPFLAG_READ_CLOSED;
+}
+
+/*
+ * pipe_wait - sleep on the pipe until COND says so
+ *
+ * Readers wake the queue when they make room, writers when they add data,
+ * and closing either end wakes it too.  Returns 0, or -EINTR if a signal
+ * came first.
+ */
+static int
+pipe_wait(struct pipe *pip, int (*cond)(struct pipe *))
+{
+    struct wait_queue_entry wqe;
+    int rc = 0;
+
+    memset(&wqe, 0, sizeof(wqe));
+
+    for (;;) {
+        prepare_to_wait(&pip->pipe_wq, &wqe);
+        if (cond(pip))
+            break;
+
+        if (task_has_pending_signals(current_task)) {
+            rc = -EINTR;
+            break;
+        }
+
+        sched_yield();
+    }
+
+    finish_wait(&pip->pipe_wq, &wqe);
+
+    return rc;
+}
 
 size_t
 do_pipe_read(struct pipe *pip, void *buf, size_t len)
 {
     size_t rc;
 
-    while (ring_buffer_size(&pip->pipe_buffer) == 0 &&
-            !(pip->pipe_flags & PIPFLAG_WRITE_CLOSED))
-        ;
+    rc = pipe_wait(pip, pipe_readable);
+    if (rc)
+        return rc;
 
     if (ring_buffer_size(&pip->pipe_buffer) == 0 && 
             pip->pipe_flags & PIPFLAG_WRITE_CLOSED)
         return 0;
 
+    mutex_lock(&pip->pipe_rmtx);
     spin_lock(&pip->pipe_lock);
     rc = ring_buffer_read(&pip->pipe_buffer, buf, len);
     spin_unlock(&pip->pipe_lock);
+    mutex_unlock(&pip->pipe_rmtx);
+
+    /* there's room for writers now */
+    wait_wake_up(&pip->pipe_wq);
     return rc;
 }
 
+/* writing with the read end gone, 0 if it's still there */
+static int
+pipe_check_reader(struct pipe *pip)
+{
+    if (!(pip->pipe_flags & PIPFLAG_READ_CLOSED))
+        return 0;
+
+    /* an io_uring worker writing for a process, nobody to signal */
+    if (current_task->flags & TFLAG_KTHREAD)
+        return -EPIPE;
+
+    if (signal_get_disp(current_task, SIGPIPE) == SIG_IGN)
+        return -EPIPE;
+    else
+        send_signal(current_task, SIGPIPE);
+
+    return -EINTR;
+}
+
 size_t
 do_pipe_write(struct pipe *pip, void *buf, size_t len)
 {
     size_t rc;
 
-    if (pip->pipe_flags & PIPFLAG_READ_CLOSED) {
-        if (signal_get_disp(current_task, SIGPIPE) == SIG_IGN)
-            return -EPIPE;
-        else
-            send_signal(current_task, SIGPIPE);
+    rc = pipe_check_reader(pip);
+    if (rc)
+        return rc;
 
-        return -EINTR;
-    }
-    
+    mutex_lock(&pip->pipe_wmtx);
     spin_lock(&pip->pipe_lock);
     rc = ring_buffer_write(&pip->pipe_buffer, buf, len);
     spin_unlock(&pip->pipe_lock);
+    mutex_unlock(&pip->pipe_wmtx);
 
+    wait_wake_up(&pip->pipe_wq);
     return rc;
 }
 
@@ -89,6 +160,7 @@ pipe_close(struct file *filp)
         pip->pipe_flags |= PIPFLAG_WRITE_CLOSED;
         pip->pipe_write = NULL;
     }
+    wait_wake_up(&pip->pipe_wq);
     free(filp);
     return 0;
 }
@@ -105,6 +177,166 @@ pipe_ioctl(struct file *filp, unsigned long req, unsigned long arg)
     return -EINVAL;
 }
 
+/*
+ * the read end is readable when there's data, and hung up once the write
+ * end is gone, the write end is writable while there's room
+ */
+int
+pipe_poll(struct file *filp, struct poll_table *pt)
+{
+    struct pipe *pip = filp->priv;
+    int size, mask = 0;
+
+    poll_wait(filp, &pip->pipe_wq, pt);
+
+    size = ring_buffer_size(&pip->pipe_buffer);
+
+    if (filp == pip->pipe_read) {
+        if (size)
+            mask |= POLLIN | POLLRDNORM;
+        if (pip->pipe_flags & PIPFLAG_WRITE_CLOSED)
+            mask |= POLLHUP;
+    } else {
+        if (size < pip->pipe_buffer.capacity)
+            mask |= POLLOUT | POLLWRNORM;
+        if (pip->pipe_flags & PIPFLAG_READ_CLOSED)
+            mask |= POLLERR;
+    }
+
+    return mask;
+}
+
+/*
+ * pipe_splice_write - fill the pipe from IN
+ *
+ * @out - the write end
+ * @in - where the data comes from
+ * @ppos - where in IN, NULL for its file position
+ * @len - how much at most
+ *
+ * IN is read straight into the free space of the ring, there is no copy
+ * in between.  Waits for room if the pipe is full, but not once some of
+ * it went in.
+ */
+int
+pipe_splice_write(struct file *out, struct file *in, int *ppos, size_t len)
+{
+    struct pipe *pip = out->priv;
+    size_t space, total = 0;
+    uint8_t *ptr;
+    int rc = 0;
+
+    if (out != pip->pipe_write)
+        return -EINVAL;
+
+    rc = pipe_check_reader(pip);
+    if (rc)
+        return rc;
+
+    mutex_lock(&pip->pipe_wmtx);
+
+    while (total < len) {
+        spin_lock(&pip->pipe_lock);
+        space = ring_buffer_write_space(&pip->pipe_buffer, &ptr);
+        spin_unlock(&pip->pipe_lock);
+
+        if (space == 0) {
+            if (total)
+                break;
+
+            /* the reader takes pipe_rmtx, not ours, so it can make room */
+            rc = pipe_wait(pip, pipe_writable);
+            if (rc)
+                break;
+
+            if (pip->pipe_flags & PIPFLAG_READ_CLOSED) {
+                rc = -EPIPE;
+                break;
+            }
+            continue;
+        }
+
+        if (space > len - total)
+            space = len - total;
+
+        rc = vfs_read_at(in, ptr, space, ppos);
+        if (rc <= 0)
+            break;
+
+        spin_lock(&pip->pipe_lock);
+        ring_buffer_commit(&pip->pipe_buffer, rc);
+        spin_unlock(&pip->pipe_lock);
+
+        wait_wake_up(&pip->pipe_wq);
+        total += rc;
+
+        /* the end of IN */
+        if (rc < space)
+            break;
+    }
+
+    mutex_unlock(&pip->pipe_wmtx);
+
+    return total ? total : rc;
+}
+
+/*
+ * pipe_splice_read - hand what's in the pipe to OUT
+ *
+ * The data goes to OUT's ->write right from the ring, and only what it
+ * took is consumed.  Waits for data like read() does.
+ */
+int
+pipe_splice_read(struct file *in, int *ppos, struct file *out, size_t len)
+{
+    struct pipe *pip = in->priv;
+    size_t avail, total = 0;
+    uint8_t *ptr;
+    int rc = 0;
+
+    if (in != pip->pipe_read)
+        return -EINVAL;
+
+    if (ppos)
+        return -ESPIPE;
+
+    rc = pipe_wait(pip, pipe_readable);
+    if (rc)
+        return rc;
+
+    mutex_lock(&pip->pipe_rmtx);
+
+    while (total < len) {
+        spin_lock(&pip->pipe_lock);
+        avail = ring_buffer_read_space(&pip->pipe_buffer, &ptr);
+        spin_unlock(&pip->pipe_lock);
+
+        if (avail == 0)
+            break;
+
+        if (avail > len - total)
+            avail = len - total;
+
+        rc = out->fops->write(out, ptr, avail);
+        if (rc <= 0)
+            break;
+
+        spin_lock(&pip->pipe_lock);
+        ring_buffer_consume(&pip->pipe_buffer, rc);
+        spin_unlock(&pip->pipe_lock);
+
+        wait_wake_up(&pip->pipe_wq);
+        total += rc;
+
+        if (rc < avail)
+            break;
+    }
+
+    mutex_unlock(&pip->pipe_rmtx);
+
+    return total ? total : rc;
+}
+
 struct file_operations pipe_fops = {
     .read = pipe_read,
     .write = pipe_write,
@@ -112,6 +344,9 @@ struct file_operations pipe_fops = {
     .close = pipe_close,
     .readdir = pipe_readdir,
     .ioctl = pipe_ioctl,
+    .poll = pipe_poll,
+    .splice_write = pipe_splice_write,
+    .splice_read = pipe_splice_read,
 };
 
 struct file *
@@ -148,6 +383,9 @@ pipe_create(void)
     ring_buffer_init(&pip->pipe_buffer, PIPE_BUF);
     ring_buffer_set_flags(&pip->pipe_buffer, RB_FLAG_NONBLOCK);
     spin_lock_init(&pip->pipe_lock);
+    mutex_init(&pip->pipe_rmtx);
+    mutex_init(&pip->pipe_wmtx);
+    wait_queue_init(&pip->pipe_wq);
 
     pip->pipe_read = pipe_create_file(pip);
     if (pip->pipe_read == NULL) {
@@ -169,11 +407,25 @@ int
 do_pipe(struct task *task, int *fds)
 {
     struct pipe *pip = pipe_create();
+    int rc;
+
     if (!pip)
         return -ENOMEM;
 
-    task->file_table[fds[0]] = pip->pipe_read;
-    task->file_table[fds[1]] = pip->pipe_write;
+    rc = fds[0] = fd_alloc(task, pip->pipe_read, 0);
+    if (rc < 0)
+        goto fail;
+
+    rc = fds[1] = fd_alloc(task, pip->pipe_write, 0);
+    if (rc < 0) {
+        fd_remove(task, fds[0]);
+        goto fail;
+    }
 
     return 0;
+
+fail:
+    vfs_close(pip->pipe_read);
+    vfs_close(pip->pipe_write);
+    return rc;
 }
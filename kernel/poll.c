@@ -0,0 +1,315 @@
+#include <levos/kernel.h>
+#include <levos/types.h>
+#include <levos/fs.h>
+#include <levos/poll.h>
+#include <levos/task.h>
+#include <levos/time.h>
+#include <levos/wait.h>
+#include <levos/spinlock.h>
+
+/* the wake_time of a poll() without a timeout */
+#define POLL_FOREVER 0xFFFFFFFF
+
+/* a wait queue of a file we poll was woken */
+static void
+pollwake(struct wait_queue_entry *wqe)
+{
+    struct poll_entry *pe = container_of(wqe, struct poll_entry, pe_wqe);
+    struct poll_wqueues *pw = pe->pe_owner;
+    struct task *task = pw->pw_task;
+
+    spin_lock(&pw->pw_lock);
+    pw->pw_triggered = 1;
+    if (task->state == TASK_SLEEPING)
+        task_kick(task);
+    spin_unlock(&pw->pw_lock);
+}
+
+static void
+poll_queue_proc(struct file *f, wait_queue_t *wq, struct poll_table *pt)
+{
+    struct poll_wqueues *pw = container_of(pt, struct poll_wqueues, pw_pt);
+    struct poll_chunk *pc = pw->pw_chunks;
+    struct poll_entry *pe;
+
+    if (!pc || pc->pc_num == POLL_CHUNK_ENTRIES) {
+        pc = malloc(sizeof(*pc));
+        if (!pc) {
+            pw->pw_error = -ENOMEM;
+            return;
+        }
+
+        pc->pc_num = 0;
+        pc->pc_next = pw->pw_chunks;
+        pw->pw_chunks = pc;
+    }
+
+    pe = &pc->pc_entries[pc->pc_num ++];
+    memset(pe, 0, sizeof(*pe));
+    pe->pe_wq = wq;
+    pe->pe_owner = pw;
+    pe->pe_wqe.wqe_task = pw->pw_task;
+    pe->pe_wqe.wqe_func = pollwake;
+
+    wait_queue_add(wq, &pe->pe_wqe);
+}
+
+void
+poll_initwait(struct poll_wqueues *pw)
+{
+    pw->pw_pt.pt_queue = poll_queue_proc;
+    pw->pw_task = current_task;
+    spin_lock_init(&pw->pw_lock);
+    pw->pw_triggered = 0;
+    pw->pw_error = 0;
+    pw->pw_chunks = NULL;
+}
+
+/* take the entries off the wait queues of the files */
+void
+poll_freewait(struct poll_wqueues *pw)
+{
+    struct poll_chunk *pc, *next;
+    int i;
+
+    for (pc = pw->pw_chunks; pc; pc = next) {
+        next = pc->pc_next;
+
+        for (i = 0; i < pc->pc_num; i ++)
+            wait_queue_remove(pc->pc_entries[i].pe_wq,
+                    &pc->pc_entries[i].pe_wqe);
+
+        free(pc);
+    }
+
+    pw->pw_chunks = NULL;
+}
+
+/*
+ * poll_schedule - sleep until a file polled with PW is woken
+ *
+ * @pw - the poll state, its table has been handed to the files
+ * @expire - the tick to give up at, 0 for never
+ *
+ * Returns right away if there was a wakeup since the last call.  Returns
+ * -EINTR if a signal came in, 0 otherwise, including on a timeout.
+ */
+int
+poll_schedule(struct poll_wqueues *pw, uint32_t expire)
+{
+    struct task *task = current_task;
+    uint32_t flags;
+    int sleeping = 0;
+
+    flags = spin_lock_irqsave(&pw->pw_lock);
+    if (!pw->pw_triggered) {
+        task_sleep(task, expire ? expire : POLL_FOREVER);
+        sleeping = 1;
+    }
+    spin_unlock_irqrestore(&pw->pw_lock, flags);
+
+    if (sleeping)
+        sched_yield();
+
+    flags = spin_lock_irqsave(&pw->pw_lock);
+    pw->pw_triggered = 0;
+    task->state = TASK_RUNNING;
+    spin_unlock_irqrestore(&pw->pw_lock, flags);
+
+    if (task->flags & TFLAG_INTERRUPTED) {
+        task->flags &= ~TFLAG_INTERRUPTED;
+        return -EINTR;
+    }
+
+    return 0;
+}
+
+/* a timeout in milliseconds as ticks, rounded up */
+uint32_t
+poll_timeout_to_ticks(int ms)
+{
+    return (ms / 1000) * HZ + ((ms % 1000) * HZ + 999) / 1000;
+}
+
+static int
+do_pollfd(struct pollfd *pfd, struct poll_table *pt)
+{
+    struct file *f;
+    int mask;
+
+    if (pfd->fd < 0)
+        return 0;
+
+    f = fd_lookup(current_task, pfd->fd);
+    if (!f)
+        return POLLNVAL;
+
+    mask = vfs_poll(f, pt);
+
+    return mask & (pfd->events | POLL_ALWAYS);
+}
+
+/*
+ * do_poll - wait for events on a set of files
+ *
+ * @fds - the files, in kernel memory, revents is filled in
+ * @nfds - number of them
+ * @timeout - in milliseconds, negative to wait for as long as it takes
+ *
+ * The first pass queues us on every file, later ones only look at the
+ * masks.  Returns the number of entries with revents set, or -EINTR.
+ */
+int
+do_poll(struct pollfd *fds, unsigned int nfds, int timeout)
+{
+    extern uint32_t __pit_ticks;
+    struct poll_wqueues pw;
+    struct poll_table *pt;
+    uint32_t expire = 0;
+    unsigned int i;
+    int count, rc = 0;
+
+    if (timeout > 0)
+        expire = __pit_ticks + poll_timeout_to_ticks(timeout);
+
+    poll_initwait(&pw);
+    pt = timeout ? &pw.pw_pt : NULL;
+
+    for (;;) {
+        count = 0;
+
+        for (i = 0; i < nfds; i ++) {
+            fds[i].revents = do_pollfd(&fds[i], pt);
+
+            /* no point in queueing on the rest, we won't sleep */
+            if (fds[i].revents) {
+                count ++;
+                pt = NULL;
+            }
+        }
+        pt = NULL;
+
+        if (count || !timeout)
+            break;
+
+        if (pw.pw_error) {
+            rc = pw.pw_error;
+            break;
+        }
+
+        if (expire && poll_expired(expire))
+            break;
+
+        rc = poll_schedule(&pw, expire);
+        if (rc)
+            break;
+    }
+
+    poll_freewait(&pw);
+
+    return rc ? rc : count;
+}
+
+#define FDS_BITS 32
+
+static inline int
+fds_test(uint32_t *set, int fd)
+{
+    return set && (set[fd / FDS_BITS] & (1U << (fd % FDS_BITS)));
+}
+
+static inline void
+fds_set(uint32_t *set, int fd)
+{
+    set[fd / FDS_BITS] |= 1U << (fd % FDS_BITS);
+}
+
+/*
+ * do_select - select() on top of do_poll()
+ *
+ * @n - one more than the highest descriptor in the sets
+ * @in, @out, @ex - the fd_sets, in kernel memory, may be NULL
+ * @timeout - in milliseconds, negative for none
+ *
+ * The sets are replaced with the descriptors that are ready.  Returns
+ * how many bits are set in them, -EBADF if one is not open or -EINTR.
+ */
+int
+do_select(int n, uint32_t *in, uint32_t *out, uint32_t *ex, int timeout)
+{
+    struct pollfd *fds;
+    int fd, i, nfds = 0, rc;
+
+    if (n < 0)
+        return -EINVAL;
+
+    if (n > FD_MAX)
+        n = FD_MAX;
+
+    fds = malloc((n ? n : 1) * sizeof(*fds));
+    if (!fds)
+        return -ENOMEM;
+
+    for (fd = 0; fd < n; fd ++) {
+        short events = 0;
+
+        if (fds_test(in, fd))
+            events |= POLLIN | POLLRDNORM;
+        if (fds_test(out, fd))
+            events |= POLLOUT | POLLWRNORM;
+        if (fds_test(ex, fd))
+            events |= POLLPRI;
+
+        if (!events)
+            continue;
+
+        if (!fd_lookup(current_task, fd)) {
+            free(fds);
+            return -EBADF;
+        }
+
+        fds[nfds].fd = fd;
+        fds[nfds].events = events;
+        nfds ++;
+    }
+
+    rc = do_poll(fds, nfds, timeout);
+    if (rc < 0) {
+        free(fds);
+        return rc;
+    }
+
+    for (i = 0; i < (n + FDS_BITS - 1) / FDS_BITS; i ++) {
+        if (in)
+            in[i] = 0;
+        if (out)
+            out[i] = 0;
+        if (ex)
+            ex[i] = 0;
+    }
+
+    rc = 0;
+    for (i = 0; i < nfds; i ++) {
+        short revents = fds[i].revents;
+
+        fd = fds[i].fd;
+
+        if (revents & (POLLIN | POLLRDNORM | POLLHUP | POLLERR) &&
+                fds[i].events & POLLIN) {
+            fds_set(in, fd);
+            rc ++;
+        }
+        if (revents & (POLLOUT | POLLWRNORM | POLLERR) &&
+                fds[i].events & POLLOUT) {
+            fds_set(out, fd);
+            rc ++;
+        }
+        if (revents & POLLPRI && fds[i].events & POLLPRI) {
+            fds_set(ex, fd);
+            rc ++;
+        }
+    }
+
+    free(fds);
+    return rc;
+}
@@ -0,0 +1,201 @@
+#include <levos/kernel.h>
+#include <levos/rcu.h>
+#include <levos/smp.h>
+#include <levos/softirq.h>
+#include <levos/semaphore.h>
+#include <levos/spinlock.h>
+#include <levos/task.h>
+
+#define MODULE_NAME rcu
+
+/*
+ * One grace period runs at a time.  Callbacks queued while it runs wait
+ * for the next one, those that were queued before it started run when it
+ * ends.  All of this is protected by rcu_lock.
+ */
+static spinlock_t rcu_lock;
+
+struct rcu_list {
+    struct rcu_head *rl_head;
+    struct rcu_head **rl_tail;
+};
+
+static struct rcu_list rcu_next;
+static struct rcu_head *rcu_wait;
+
+static int rcu_gp_active;
+
+/* cpu_rcu_qs of every CPU when the current grace period started */
+static uint32_t rcu_gp_snap[NR_CPUS];
+
+static void
+rcu_list_init(struct rcu_list *rl)
+{
+    rl->rl_head = NULL;
+    rl->rl_tail = &rl->rl_head;
+}
+
+static void
+rcu_list_add(struct rcu_list *rl, struct rcu_head *head)
+{
+    head->rh_next = NULL;
+    *rl->rl_tail = head;
+    rl->rl_tail = &head->rh_next;
+}
+
+/* this CPU can not be in a read-side critical section right now */
+void
+rcu_qs(void)
+{
+    this_cpu()->cpu_rcu_qs ++;
+}
+
+/*
+ * Called with interrupts disabled right before halting in the idle loop.
+ * A CPU that sleeps is quiescent for as long as it does, even with its
+ * tick stopped, until the next interrupt arrives.
+ */
+void
+rcu_idle_enter(void)
+{
+    struct cpu *cpu = this_cpu();
+
+    cpu->cpu_rcu_qs ++;
+    cpu->cpu_rcu_idle = 1;
+}
+
+void
+rcu_irq_enter(void)
+{
+    struct cpu *cpu = this_cpu();
+
+    if (!cpu->cpu_rcu_idle)
+        return;
+
+    /* the handler's readers must not be seen before this */
+    cpu->cpu_rcu_idle = 0;
+    __sync_synchronize();
+}
+
+int
+rcu_pending(void)
+{
+    return rcu_next.rl_head || rcu_gp_active;
+}
+
+/* from the tick, with interrupts disabled */
+void
+rcu_check_callbacks(void)
+{
+    if (rcu_pending())
+        __raise_softirq_irqoff(SOFTIRQ_RCU);
+}
+
+/* every CPU went through a quiescent state, caller holds rcu_lock */
+static int
+rcu_gp_done(void)
+{
+    struct cpu *cpu;
+
+    for_each_cpu(cpu) {
+        if (!cpu->cpu_online || cpu->cpu_rcu_idle)
+            continue;
+
+        if (cpu->cpu_rcu_qs == rcu_gp_snap[cpu->cpu_id])
+            return 0;
+    }
+
+    return 1;
+}
+
+static void
+rcu_gp_start(void)
+{
+    struct cpu *cpu;
+
+    for_each_cpu(cpu)
+        rcu_gp_snap[cpu->cpu_id] = cpu->cpu_rcu_qs;
+
+    rcu_wait = rcu_next.rl_head;
+    rcu_list_init(&rcu_next);
+
+    rcu_gp_active = 1;
+}
+
+/* the RCU softirq, ends the grace period and runs the callbacks */
+static void
+rcu_process_callbacks(void)
+{
+    struct rcu_head *done = NULL, *head, *next;
+    uint32_t flags;
+
+    flags = spin_lock_irqsave(&rcu_lock);
+    if (rcu_gp_active && rcu_gp_done()) {
+        done = rcu_wait;
+        rcu_wait = NULL;
+        rcu_gp_active = 0;
+    }
+
+    if (!rcu_gp_active && rcu_next.rl_head)
+        rcu_gp_start();
+    spin_unlock_irqrestore(&rcu_lock, flags);
+
+    for (head = done; head; head = next) {
+        next = head->rh_next;
+        head->rh_func(head);
+    }
+}
+
+/*
+ * call_rcu - run a function after a grace period
+ *
+ * @head - embedded in whatever is to be freed
+ * @func - called with @head from softirq context
+ *
+ * Callable from any context.
+ */
+void
+call_rcu(struct rcu_head *head, void (*func)(struct rcu_head *))
+{
+    uint32_t flags;
+
+    head->rh_func = func;
+
+    flags = spin_lock_irqsave(&rcu_lock);
+    rcu_list_add(&rcu_next, head);
+    spin_unlock_irqrestore(&rcu_lock, flags);
+}
+
+struct rcu_synchronize {
+    struct rcu_head rs_head;
+    struct completion rs_done;
+};
+
+static void
+wakeme_after_rcu(struct rcu_head *head)
+{
+    struct rcu_synchronize *rs =
+        container_of(head, struct rcu_synchronize, rs_head);
+
+    complete(&rs->rs_done);
+}
+
+/* sleep until every reader that is running now is done */
+void
+synchronize_rcu(void)
+{
+    struct rcu_synchronize rs;
+
+    init_completion(&rs.rs_done);
+    call_rcu(&rs.rs_head, wakeme_after_rcu);
+    wait_for_completion(&rs.rs_done);
+}
+
+void
+rcu_init(void)
+{
+    spin_lock_init(&rcu_lock);
+    rcu_list_init(&rcu_next);
+
+    open_softirq(SOFTIRQ_RCU, rcu_process_callbacks);
+}
@@ -8,12 +8,30 @@
 #include <levos/palloc.h>
 #include <levos/page.h>
 #include <levos/spinlock.h>
+#include <levos/fs.h>
 #include <levos/list.h>
+#include <levos/smp.h>
+#include <levos/time.h>
+#include <levos/pid.h>
+#include <levos/work.h>
+#include <levos/softirq.h>
+#include <levos/rcu.h>
+#include <levos/sysstat.h>
 
 #define TIME_SLICE 15
 
-static pid_t last_pid = 0;
-struct task *current_task;
+/*
+ * Real-time tasks may use at most RT_RUNTIME ticks of every RT_PERIOD on a
+ * CPU, so that a runaway one can't lock everybody else out.
+ */
+#define RT_PERIOD  HZ
+#define RT_RUNTIME (RT_PERIOD * 95 / 100)
+
+/* ticks between two load balancing passes on a CPU */
+#define BALANCE_INTERVAL 200
+
+/* tasks created since boot, see /proc/stat */
+static uint32_t sched_nr_forks;
 
 static spinlock_t all_tasks_lock;
 static struct list all_tasks;
@@ -26,25 +44,67 @@ int __task_need_cleanup;
 
 struct list zombie_processes;
 
-static int __preempt_enabled;
-
 void __noreturn late_init(void);
 void __noreturn __idle_thread(void);
 
-void intr_yield(struct pt_regs *);
 void sched_yield(void);
 void reschedule(void);
+void __reschedule_to(struct task *, struct task *);
+
+/*
+ * preempt_disable - don't let the tick or IRQs switch us out
+ *
+ * Nests; preemption is allowed again once every preempt_disable() has been
+ * matched by a preempt_enable().  Blocking, sleeping and yielding still
+ * switch away.
+ */
+void
+preempt_disable(void)
+{
+    struct task *task = current_task;
+
+    if (task)
+        task->preempt_count ++;
+    barrier();
+}
+
+/* drop a preemption count without acting on a pending reschedule */
+void
+preempt_enable_no_resched(void)
+{
+    struct task *task = current_task;
+
+    barrier();
+    if (task)
+        task->preempt_count --;
+}
 
 void
 preempt_enable(void)
 {
-    __preempt_enabled = 1;
+    preempt_enable_no_resched();
+    cond_resched();
 }
 
+int
+preemptible(void)
+{
+    struct task *task = current_task;
+
+    return task && task->preempt_count == 0 && !arch_irqs_disabled();
+}
+
+/*
+ * cond_resched - preemption point
+ *
+ * If an interrupt asked for a reschedule while we could not be preempted,
+ * now is the time.
+ */
 void
-preempt_disable(void)
+cond_resched(void)
 {
-    __preempt_enabled = 0;
+    if (percpu_read(cpu_need_resched) && preemptible())
+        sched_yield();
 }
 
 inline int
@@ -53,52 +113,63 @@ task_is_kernel(struct task *t)
     return t->mm == 0;
 }
 
-pid_t
-allocate_pid(void)
-{
-    return ++last_pid;
-}
-
 void __noreturn
 sched_init(void)
 {
     uint32_t kernel_stack, new_stack;
+    struct task *swapper;
+    struct cpu *cpu = this_cpu();
 
     printk("sched: init\n");
 
     list_init(&zombie_processes);
     list_init(&all_tasks);
     spin_lock_init(&all_tasks_lock);
+    pid_init();
 
-    current_task = malloc(sizeof(*current_task));
-    if (!current_task)
+    swapper = malloc(sizeof(*swapper));
+    if (!swapper)
         panic("Kernel ran out of memory when starting threading\n");
 
-    current_task->mm = 0;
-    current_task->pid = 0;
-    current_task->pgid = 0;
-    current_task->ppid = 0;
-    current_task->sid = 0;
-    current_task->state = TASK_RUNNING;
-    current_task->time_ran = 0;
-    signal_init(current_task);
-    vma_init(current_task);
-    spin_lock_init(&current_task->vm_lock);
-    list_init(&current_task->wait_ev_list);
-    spin_lock_init(&current_task->wait_ev_lock);
+    memset(swapper, 0, sizeof(*swapper));
+    swapper->mm = 0;
+    /* the first PID handed out is 0 */
+    swapper->pid = pid_alloc();
+    swapper->pgid = 0;
+    swapper->ppid = 0;
+    swapper->sid = 0;
+    swapper->state = TASK_RUNNING;
+    swapper->time_ran = 0;
+    /* no preemption until the scheduler is fully set up */
+    swapper->preempt_count = 1;
+    /* the swapper carries the boot stack, it never leaves the BSP */
+    swapper->flags = TFLAG_PINNED;
+    swapper->cpu = cpu->cpu_id;
+    swapper->on_cpu = 1;
+    signal_init(swapper);
+    vma_init(swapper);
+    spin_lock_init(&swapper->vm_lock);
+    list_init(&swapper->wait_ev_list);
+    spin_lock_init(&swapper->wait_ev_lock);
     char *fxsave = na_malloc(512, 16);
     memset(fxsave, 0, 512);
-    current_task->sse_save = fxsave;
-    do_sse_save(current_task);
+    swapper->sse_save = fxsave;
+    do_sse_save(swapper);
+
+    cpu->cpu_current = swapper;
+    cpu->cpu_online = 1;
 
     //memset(all_tasks, 0, sizeof(struct task *) * 128);
     //all_tasks[0] = current_task;
     spin_lock(&all_tasks_lock);
-    list_push_back(&all_tasks, &current_task->all_elem);
+    list_push_back(&all_tasks, &swapper->all_elem);
     spin_unlock(&all_tasks_lock);
+    pid_attach_task(swapper);
     //last_task = 0;
 
-    intr_register_user(0x2f, intr_yield);
+    spin_lock(&cpu->cpu_rq.rq_lock);
+    list_push_back(&cpu->cpu_rq.rq_tasks, &swapper->rq_elem);
+    spin_unlock(&cpu->cpu_rq.rq_lock);
 
     /* map a new stack */
     new_stack = (uint32_t) malloc(4096);
@@ -139,6 +210,7 @@ process_create(struct task *task)
     void
 process_destroy(struct process *proc)
 {
+    pid_put(proc->pid);
     free(proc);
 }
 
@@ -151,8 +223,12 @@ process_add_waiter(struct process *proc, struct task *waiter)
     int
 __task_init(struct task *task)
 {
+    extern uint32_t __pit_ticks;
+
     memset(task, 0, sizeof(*task));
-    task->pid = allocate_pid();
+    task->pid = pid_alloc();
+    if (task->pid < 0)
+        return task->pid;
     task->ppid = 0;
     task->pgid = 0;
     task->state = TASK_PREEMPTED;
@@ -161,6 +237,10 @@ __task_init(struct task *task)
     task->exit_code = 0;
     task->mm = kernel_pgd;
     task->flags = 0;
+    task->cpu = -1;
+    task->on_cpu = 0;
+    task->stats.ss_queued_at = __pit_ticks;
+    __sync_fetch_and_add(&sched_nr_forks, 1);
     task->cwd = strdup("/");
     list_init(&task->children_list);
     list_init(&task->wait_ev_list);
@@ -170,7 +250,7 @@ __task_init(struct task *task)
     signal_init(task);
     task->owner = process_create(task);
     if (!task->owner) {
-        //free_pid(task->pid); // TODO
+        pid_put(task->pid);
         free(task);
         return -ENOMEM;
     }
@@ -197,6 +277,7 @@ struct task *create_kernel_task(void (*func)(void))
         return NULL;
 
     task->comm = strdup("kthread");
+    task->flags |= TFLAG_KTHREAD;
 
     /* get a stack for the task, since this is a kernel thread
      * we can use malloc
@@ -224,7 +305,7 @@ struct task *create_kernel_task(void (*func)(void))
     *--new_stack = 0x00; /* vec_no */
     *--new_stack = 0x10; /* ds  */
     *--new_stack = 0x10; /* es  */
-    *--new_stack = 0x10; /* fs  */
+    *--new_stack = 0x30; /* fs (per-CPU) */
     *--new_stack = 0x10; /* gs  */
     /* pushad */
     tmp = (uint32_t) new_stack;
@@ -289,12 +370,122 @@ task_sleep(struct task *task, uint32_t ticks)
     task->state = TASK_SLEEPING;
 }
 
+/*
+ * sched_kick_cpu - make CPU notice new work
+ *
+ * @cpu - the CPU whose run queue gained a runnable task
+ *
+ * A CPU sitting in its idle task only looks at its run queue on the next
+ * tick, so poke it with an IPI instead.
+ */
+static void
+sched_kick_cpu(struct cpu *cpu)
+{
+    if (cpu == this_cpu() || !cpu->cpu_online)
+        return;
+
+    if (cpu->cpu_current == cpu->cpu_idle)
+        smp_send_resched(cpu);
+}
+
+static void
+sched_kick_task(struct task *task)
+{
+    struct cpu *cpu;
+
+    if (task->cpu < 0)
+        return;
+
+    cpu = &cpus[task->cpu];
+    sched_kick_cpu(cpu);
+
+    /* the IRQ we are in (if any) preempts on its way out */
+    if (task_is_rt(task) && cpu == this_cpu() &&
+            !task_is_rt(cpu->cpu_current))
+        percpu_write(cpu_need_resched, 1);
+
+    /* a real-time task preempts normal ones right away */
+    if (task_is_rt(task) && cpu != this_cpu() && cpu->cpu_online &&
+            cpu->cpu_current != cpu->cpu_idle &&
+            !task_is_rt(cpu->cpu_current))
+        smp_send_resched(cpu);
+}
+
+/*
+ * sched_stat_enqueue - note that TASK became runnable
+ *
+ * @task - the task
+ * @when - the tick it became runnable at
+ * @wakeup - whether it was woken up, rather than preempted
+ */
+static void
+sched_stat_enqueue(struct task *task, uint32_t when, int wakeup)
+{
+    task->stats.ss_queued_at = when;
+    task->stats.ss_woken = wakeup;
+}
+
+/* a task that is neither running nor runnable was woken up */
+static void
+sched_stat_wakeup(struct task *task)
+{
+    extern uint32_t __pit_ticks;
+
+    if (task->state != TASK_RUNNING && !task_runnable(task))
+        sched_stat_enqueue(task, __pit_ticks, 1);
+}
+
+static int
+sched_lat_bucket(uint32_t lat)
+{
+    int bucket = 0;
+
+    while (lat && bucket < SCHED_LAT_BUCKETS - 1) {
+        lat >>= 1;
+        bucket ++;
+    }
+
+    return bucket;
+}
+
+/* account a switch from PREV to NEXT on CPU */
+static void
+sched_stat_switch(struct cpu *cpu, struct task *prev, struct task *next)
+{
+    extern uint32_t __pit_ticks;
+    uint32_t now = __pit_ticks, waited;
+
+    cpu->cpu_nr_switches ++;
+
+    if (prev != cpu->cpu_idle) {
+        if (task_runnable(prev))
+            prev->stats.ss_nivcsw ++;
+        else
+            prev->stats.ss_nvcsw ++;
+    }
+
+    if (next == cpu->cpu_idle)
+        return;
+
+    waited = now - next->stats.ss_queued_at;
+    next->stats.ss_nr_runs ++;
+    next->stats.ss_wait_ticks += waited;
+
+    if (next->stats.ss_woken) {
+        next->stats.ss_woken = 0;
+        next->stats.ss_wakeups ++;
+        next->stats.ss_wakeup_lat[sched_lat_bucket(waited)] ++;
+    }
+}
+
     void
 task_kick(struct task *task)
 {
     //panic_ifnot(task->state == TASK_SLEEPING);
+    sched_stat_wakeup(task);
     task->wake_time = 0;
     task->state = TASK_PREEMPTED;
+    sched_kick_task(task);
     //printk("sched: kicked task %d\n", task->pid);
 }
 
@@ -310,9 +501,12 @@ sleep(uint32_t ticks)
 task_unblock(struct task *task)
 {
     panic_ifnot(task != current_task);
+    sched_stat_wakeup(task);
     task->state = TASK_PREEMPTED;
+    sched_kick_task(task);
 }
 
+/* for debug output only, the name is not safe to keep */
     char *
 get_comm_for_pid(pid_t pid)
 {
@@ -339,49 +533,48 @@ setup_filetable(struct task *task)
 
     extern struct file serial_base_file;
 
+    task->files = fdtable_create();
+    if (!task->files)
+        return;
+
     /* stdin */
-    task->file_table[0] = dup_file(&serial_base_file);
+    fd_install(task, 0, dup_file(&serial_base_file));
     /* stdout */
-    task->file_table[1] = dup_file(&serial_base_file);
+    fd_install(task, 1, dup_file(&serial_base_file));
     /* stderr */
-    task->file_table[2] = dup_file(&serial_base_file);
+    fd_install(task, 2, dup_file(&serial_base_file));
 }
 
     void
 copy_filetable(struct task *dst, struct task *src)
 {
+    struct file *f;
     int i;
 
     /* XXX: setup_filetable has dupped a few files, get rid of them */
-    free(dst->file_table[0]->respath);
-    free(dst->file_table[1]->respath);
-    free(dst->file_table[2]->respath);
+    for (i = 0; i < 3; i ++) {
+        f = fd_remove(dst, i);
+        if (!f)
+            continue;
 
-    free(dst->file_table[0]);
-    free(dst->file_table[1]);
-    free(dst->file_table[2]);
+        free(f->respath);
+        free(f);
+    }
+
+    if (dst->files)
+        fdtable_put(dst->files);
 
     /* actually copy the table, increasing refc */
-    for (i = 0; i < FD_MAX; i ++) {
-        dst->file_table[i] = src->file_table[i];
-        if (dst->file_table[i])
-            vfs_inc_refc(dst->file_table[i]);
-    }
+    dst->files = fdtable_copy(src->files);
 }
 
     void
 close_filetable(struct task *task)
 {
-    int i;
+    if (task->files)
+        fdtable_put(task->files);
 
-    for (i = 0; i < FD_MAX; i ++) {
-        struct file *filp = task->file_table[i];
-
-        if (filp)
-            vfs_close(filp);
-
-        task->file_table[i] = NULL;
-    }
+    task->files = NULL;
 }
 
 void
@@ -426,9 +619,22 @@ task_unblock_waiters(struct task *t)
     }
 }
 
+/* the rest of a task that lockless readers may still look at */
+static void
+task_free_rcu(struct rcu_head *head)
+{
+    struct task *t = container_of(head, struct task, rcu);
+
+    sysstat_free(t);
+    free(t->comm);
+    free(t);
+}
+
 void
 task_exit(struct task *t)
 {
+    struct task *parent;
+
     /* TODO: preliminary cleanup, but don't get rid of thread */
     t->state = TASK_ZOMBIE;
     if (t->pid == 1)
@@ -457,10 +663,20 @@ task_exit(struct task *t)
 #endif
 
     //printk("TASK EXIT for %d\n", t->pid);
-    
+
+    rcu_read_lock();
+    parent = get_task_for_pid(t->ppid);
+
+    /* the parent inherits our CPU time, see times(2) */
+    if (parent) {
+        parent->stats.ss_cutime += t->stats.ss_utime + t->stats.ss_cutime;
+        parent->stats.ss_cstime += t->stats.ss_stime + t->stats.ss_cstime;
+    }
+
     /* queue a SIGCHLD to the parent */
     //printk("would send signal SIGCHLD to %d from %d\n", t->ppid, t->pid);
-    send_signal(get_task_for_pid(t->ppid), SIGCHLD);
+    send_signal(parent, SIGCHLD);
+    rcu_read_unlock();
 
     /* flush the controlling terminal */
     if (t->ctty)
@@ -476,18 +692,17 @@ task_exit(struct task *t)
         list_push_back(&zombie_processes, &t->owner->elem);
     }
 
-    free(t->comm);
     na_free(16, t->sse_save);
     free(t->bstate.switch_stack);
     close_filetable(t);
     list_remove(&t->children_elem);
     free(t->cwd);
     free(t->irq_stack_bot);
-    list_remove(&t->all_elem);
+    sched_remove_rq(t);
     vma_unload_all(t);
     activate_pgd(kernel_pgd);
     mm_destroy(t->mm);
-    free(t);
+    call_rcu(&t->rcu, task_free_rcu);
 }
 
 struct task *create_user_task_withmm(int do_stack, pagedir_t mm, void (*func)(void))
@@ -570,8 +785,8 @@ sched_add_child(struct task *parent, struct task *child)
     child->parent = parent;
     child->owner->ppid = parent->pid;
     child->ppid = parent->pid;
-    child->sid = parent->sid;
-    child->pgid = parent->pgid;
+    task_set_session(child, parent->sid);
+    task_set_pgrp(child, parent->pgid);
 }
 
 struct process *
@@ -674,34 +889,10 @@ __task_do_wait(struct task *waiter, struct process *waited)
     return 0xffffffff;
 }
 
-struct task *
-get_task_for_pid(pid_t pid)
-{
-    int i;
-    struct list_elem *elem;
-    struct task *ret = NULL;
-
-    /*for (i = 0; i < 128; i ++)
-        if (all_tasks[i] && all_tasks[i]->pid == pid)
-            return all_tasks[i];*/
-    //spin_lock(&all_tasks_lock);
-    list_foreach_raw(&all_tasks, elem) {
-        struct task *task = list_entry(elem, struct task, all_elem);
-
-        if (task->pid == pid) {
-            ret = task;
-            break;
-        }
-    }
-    //spin_unlock(&all_tasks_lock); 
-
-    return ret;
-}
-
 void
 task_join_pg(struct task *task, pid_t pgid)
 {
-    task->pgid = pgid;
+    task_set_pgrp(task, pgid);
 }
 
 struct task *
@@ -748,6 +939,13 @@ create_user_task_fork(void (*func)(void))
     /* copy controlling terminal */
     new->ctty = current_task->ctty;
 
+    /* the scheduling policy is inherited */
+    new->policy = current_task->policy;
+    new->rt_priority = current_task->rt_priority;
+
+    /* and so is the syscall accounting */
+    sysstat_fork(new, current_task);
+
     /* copy BRK stuff */
     new->bstate.logical_brk = current_task->bstate.logical_brk;
     new->bstate.actual_brk = current_task->bstate.actual_brk;
@@ -802,21 +1000,307 @@ kernel_task_exit()
     sched_yield();
 }
 
+/* number of tasks on RQ that want a CPU, caller holds rq_lock */
+static int
+rq_load(struct runqueue *rq)
+{
+    struct list_elem *elem;
+    int load = 0;
+
+    list_foreach_raw(&rq->rq_tasks, elem) {
+        struct task *t = list_entry(elem, struct task, rq_elem);
+
+        if (task_runnable(t) || t->state == TASK_RUNNING)
+            load ++;
+    }
+
+    return load;
+}
+
+static int
+cpu_load(struct cpu *cpu)
+{
+    uint32_t flags;
+    int load;
+
+    flags = spin_lock_irqsave(&cpu->cpu_rq.rq_lock);
+    load = rq_load(&cpu->cpu_rq);
+    spin_unlock_irqrestore(&cpu->cpu_rq.rq_lock, flags);
+
+    return load;
+}
+
+/* new tasks go to the least loaded CPU */
+static struct cpu *
+sched_pick_cpu(void)
+{
+    struct cpu *cpu, *best = this_cpu();
+    int load, best_load = cpu_load(best);
+
+    for_each_cpu(cpu) {
+        if (!cpu->cpu_online || cpu == best)
+            continue;
+
+        load = cpu_load(cpu);
+        if (load < best_load) {
+            best = cpu;
+            best_load = load;
+        }
+    }
+
+    return best;
+}
+
 void
 sched_add_rq(struct task *task)
 {
+    sched_add_rq_cpu(task, sched_pick_cpu());
+}
+
+/* like sched_add_rq(), but onto the run queue of CPU */
+void
+sched_add_rq_cpu(struct task *task, struct cpu *cpu)
+{
+    uint32_t flags;
+
     //printk("%s: task->pid: %d task->regs: 0x%x\n", __func__, task->pid, task->regs);
-    /*for (int i = 0; i < 128; i ++) {
-        if (all_tasks[i] == 0) {
-            all_tasks[i] = task;
-            return;
-        }
-    }*/
-    //spin_lock(&all_tasks_lock);
+    flags = spin_lock_irqsave(&all_tasks_lock);
     list_push_back(&all_tasks, &task->all_elem);
-    //spin_unlock(&all_tasks_lock); 
-    return;
-    panic("RQ is full\n");
+    spin_unlock_irqrestore(&all_tasks_lock, flags);
+    pid_attach_task(task);
+
+    flags = spin_lock_irqsave(&cpu->cpu_rq.rq_lock);
+    task->cpu = cpu->cpu_id;
+    list_push_back(&cpu->cpu_rq.rq_tasks, &task->rq_elem);
+    spin_unlock_irqrestore(&cpu->cpu_rq.rq_lock, flags);
+
+    sched_kick_cpu(cpu);
+}
+
+/* takes TASK off its run queue, the list of all tasks and the PID hash */
+void
+sched_remove_rq(struct task *task)
+{
+    struct runqueue *rq;
+    uint32_t flags;
+
+    if (task->cpu >= 0) {
+        rq = &cpus[task->cpu].cpu_rq;
+        flags = spin_lock_irqsave(&rq->rq_lock);
+        list_remove(&task->rq_elem);
+        task->cpu = -1;
+        spin_unlock_irqrestore(&rq->rq_lock, flags);
+    }
+
+    flags = spin_lock_irqsave(&all_tasks_lock);
+    list_remove(&task->all_elem);
+    spin_unlock_irqrestore(&all_tasks_lock, flags);
+    pid_detach_task(task);
+}
+
+/*
+ * sched_next_wakeup - when does CPU need to look at its run queue again
+ *
+ * Returns 0 if something on the run queue can run right now, otherwise the
+ * tick at which the first sleeper is due, or NOHZ_FOREVER.
+ */
+static uint32_t
+sched_next_wakeup(struct cpu *cpu)
+{
+    extern uint32_t __pit_ticks;
+    struct runqueue *rq = &cpu->cpu_rq;
+    struct list_elem *elem;
+    struct task *task;
+    uint32_t next = NOHZ_FOREVER;
+
+    spin_lock(&rq->rq_lock);
+    list_foreach_raw(&rq->rq_tasks, elem) {
+        task = list_entry(elem, struct task, rq_elem);
+
+        if (task_runnable(task) || (task->state == TASK_SLEEPING &&
+                    task->wake_time <= __pit_ticks)) {
+            next = 0;
+            break;
+        }
+
+        if (task->state == TASK_SLEEPING && task->wake_time < next)
+            next = task->wake_time;
+    }
+    spin_unlock(&rq->rq_lock);
+
+    return next;
+}
+
+/*
+ * sched_nohz_enter - stop the tick of this CPU before it halts
+ *
+ * @cpu - this CPU
+ *
+ * Returns -EAGAIN if there is work on the run queue, 0 otherwise.  The BSP
+ * keeps time for everyone, so it only stops its tick when all the other
+ * CPUs are tickless as well, and then wakes up for the earliest of their
+ * deadlines.  Called with interrupts disabled.
+ */
+static int
+sched_nohz_enter(struct cpu *cpu)
+{
+    extern uint32_t __pit_ticks;
+    struct cpu *other;
+    uint32_t now = __pit_ticks, next, wheel;
+
+    next = sched_next_wakeup(cpu);
+    if (next == 0)
+        return -EAGAIN;
+
+    /* RCU callbacks need the tick to make progress */
+    if (rcu_pending())
+        return 0;
+
+    cpu->cpu_nohz = 1;
+    __sync_synchronize();
+
+    if (cpu->cpu_id == 0) {
+        /* the timer wheel runs off our tick */
+        wheel = work_timer_next();
+        if (wheel < next)
+            next = wheel;
+
+        for_each_cpu(other) {
+            if (other == cpu || !other->cpu_online)
+                continue;
+
+            if (!other->cpu_nohz) {
+                cpu->cpu_nohz = 0;
+                return 0;
+            }
+
+            if (other->cpu_nohz_until < next)
+                next = other->cpu_nohz_until;
+        }
+    }
+
+    /* not worth it */
+    if (next <= now + 1) {
+        cpu->cpu_nohz = 0;
+        return 0;
+    }
+
+    cpu->cpu_nohz_start = now;
+    cpu->cpu_nohz_until = next;
+    cpu->cpu_nohz_entries ++;
+
+    arch_timer_stop_tick(next == NOHZ_FOREVER ? 0 : next - now);
+    return 0;
+}
+
+/*
+ * sched_nohz_exit - restart the tick of this CPU if it was stopped
+ *
+ * Called with interrupts disabled from the idle loop and from the
+ * interrupts that can reschedule away from the idle task.
+ */
+static void
+sched_nohz_exit(void)
+{
+    extern uint32_t __pit_ticks;
+    struct cpu *cpu = this_cpu();
+
+    if (!cpu->cpu_nohz)
+        return;
+
+    arch_timer_restart_tick();
+
+    cpu->cpu_nohz = 0;
+    __sync_synchronize();
+
+    cpu->cpu_idle_ticks += __pit_ticks - cpu->cpu_nohz_start;
+
+    /* we are about to run something, time needs to move again */
+    if (cpu->cpu_id != 0 && cpus[0].cpu_nohz)
+        smp_send_resched(&cpus[0]);
+}
+
+/* the BSP wakes up the tickless CPUs whose sleepers are due */
+static void
+sched_nohz_kick(struct cpu *this)
+{
+    extern uint32_t __pit_ticks;
+    struct cpu *cpu;
+
+    for_each_cpu(cpu) {
+        if (cpu == this || !cpu->cpu_online || !cpu->cpu_nohz)
+            continue;
+
+        if (cpu->cpu_nohz_until <= __pit_ticks)
+            smp_send_resched(cpu);
+    }
+}
+
+void __noreturn
+sched_idle_loop(void)
+{
+    while (1) {
+        DISABLE_IRQ();
+
+        if (sched_nohz_enter(this_cpu()) == -EAGAIN) {
+            ENABLE_IRQ();
+            sched_yield();
+            continue;
+        }
+
+        rcu_idle_enter();
+
+        /* atomically enables interrupts and halts */
+        arch_cpu_idle();
+
+        DISABLE_IRQ();
+        sched_nohz_exit();
+        ENABLE_IRQ();
+    }
+}
+
+/*
+ * sched_create_idle - create the idle task of a CPU
+ *
+ * @cpu - index of the CPU in cpus[]
+ *
+ * The idle task is not on any run queue, pick_next_task() falls back to it
+ * when there is nothing else to run.
+ */
+struct task *
+sched_create_idle(int cpu)
+{
+    struct task *idle = create_kernel_task(sched_idle_loop);
+
+    if (!idle)
+        return NULL;
+
+    free(idle->comm);
+    idle->comm = strdup("idle");
+    /* never visible to get_task_for_pid(), so it needs no PID of its own */
+    pid_put(idle->pid);
+    idle->pid = 0;
+    idle->owner->pid = 0;
+    idle->flags |= TFLAG_PINNED;
+
+    cpus[cpu].cpu_idle = idle;
+    return idle;
+}
+
+/* entry to the scheduler for application processors */
+void __noreturn
+sched_ap_enter(void)
+{
+    struct cpu *cpu = this_cpu();
+    struct task *idle = cpu->cpu_idle;
+
+    DISABLE_IRQ();
+    cpu->cpu_current = idle;
+    idle->on_cpu = 1;
+    cpu->cpu_online = 1;
+
+    __reschedule_to(idle, idle);
+    __not_reached();
 }
 
 extern void init_task(void);
@@ -824,7 +1308,7 @@ void __noreturn
 __idle_thread(void)
 {
     struct task *n;
-    __preempt_enabled = 1;
+    preempt_enable();
     arch_switch_timer_sched();
 
     /* XXX 4/22/17 review: I am not entirely sure why this is/was
@@ -840,6 +1324,9 @@ __idle_thread(void)
     panic_on(n == NULL, "failed to create init task\n");
     sched_add_rq(n);
 
+    /* after init, so that it still gets pid 1 */
+    panic_on(sched_create_idle(0) == NULL, "failed to create the idle task\n");
+
     current_task->comm = "swapper";
 
     late_init();
@@ -847,149 +1334,692 @@ __idle_thread(void)
     __not_reached();
 }
 
-struct task *
-pick_next_task(void)
+/*
+ * sched_reap_dying - free the tasks on RQ that have exited
+ *
+ * @rq - this CPU's run queue
+ *
+ * A dying task may still be on its way out of its CPU, only reap the ones
+ * that have fully left.
+ */
+static void
+sched_reap_dying(struct runqueue *rq)
+{
+    struct list dead;
+    struct list_elem *elem, *next;
+    struct task *t;
+
+    list_init(&dead);
+
+    spin_lock(&rq->rq_lock);
+    for (elem = list_begin(&rq->rq_tasks);
+            elem != list_end(&rq->rq_tasks);
+            elem = next) {
+        next = list_next(elem);
+        t = list_entry(elem, struct task, rq_elem);
+
+        if (t->state == TASK_DYING && !t->on_cpu) {
+            list_remove(&t->rq_elem);
+            t->cpu = -1;
+            list_push_back(&dead, &t->rq_elem);
+        }
+    }
+    spin_unlock(&rq->rq_lock);
+
+    while (!list_empty(&dead)) {
+        t = list_entry(list_pop_front(&dead), struct task, rq_elem);
+        task_exit(t);
+        __sync_fetch_and_sub(&__task_need_cleanup, 1);
+    }
+}
+
+/*
+ * rq_pick - choose the next task from CPU's run queue, caller holds rq_lock
+ *
+ * The real-time task with the highest priority wins, unless the CPU is RT
+ * throttled.  Otherwise it's round robin among the normal tasks.
+ */
+static struct task *
+rq_pick(struct cpu *cpu, struct task *prev)
 {
-    //printk("%s\n", __func__);
     extern uint32_t __pit_ticks;
+    struct runqueue *rq = &cpu->cpu_rq;
     struct list_elem *elem;
-    struct task *task = current_task, *t;
+    struct task *task, *rt = NULL, *normal = NULL;
 
-    if (__task_need_cleanup > 0) {
-        list_foreach_raw(&all_tasks, elem) {
-            t = list_entry(elem, struct task, all_elem);
+    list_foreach_raw(&rq->rq_tasks, elem) {
+        task = list_entry(elem, struct task, rq_elem);
 
-            if (t->state == TASK_DYING)
-                task_exit(t);
+        if (task->state == TASK_SLEEPING && task->wake_time <= __pit_ticks) {
+            sched_stat_enqueue(task, task->wake_time, 1);
+            task->state = TASK_PREEMPTED;
         }
-        __task_need_cleanup = 0;
+
+        if (!task_runnable(task))
+            continue;
+
+        /* still on its way out of another CPU */
+        if (task->on_cpu && task != prev)
+            continue;
+
+        if (task_is_rt(task)) {
+            if (!cpu->cpu_rt_throttled &&
+                    (!rt || task->rt_priority > rt->rt_priority))
+                rt = task;
+        } else if (!normal)
+            normal = task;
     }
 
-    //spin_lock(&all_tasks_lock);
-/*retry:
-    for (int i = last_task; i < 128; i ++) {
-        if (all_tasks[i] != 0) { 
-            if (all_tasks[i]->state == TASK_DYING) {
-                task_exit(all_tasks[i]);
-                continue;
-            } else if (all_tasks[i]->state == TASK_SLEEPING &&
-                    all_tasks[i]->wake_time <= __pit_ticks) {
-                all_tasks[i]->state = TASK_PREEMPTED;
-            } else if (!task_runnable(all_tasks[i]))
-                continue;
-            last_task = i + 1;
-            //if (all_tasks[i]->pid == 2)
-                //printk("pid:%d\n", all_tasks[i]->pid);
-            return all_tasks[i];
+    task = rt ? rt : normal;
+    if (!task)
+        return NULL;
+
+    /* move it to the back, so everyone gets their turn */
+    list_remove(&task->rq_elem);
+    list_push_back(&rq->rq_tasks, &task->rq_elem);
+    task->on_cpu = 1;
+    return task;
+}
+
+/* is there a real-time task on CPU's run queue that should run now */
+static int
+sched_rt_pending(struct cpu *cpu)
+{
+    extern uint32_t __pit_ticks;
+    struct list_elem *elem;
+    struct task *task;
+    int ret = 0;
+
+    if (cpu->cpu_rt_throttled)
+        return 0;
+
+    spin_lock(&cpu->cpu_rq.rq_lock);
+    list_foreach_raw(&cpu->cpu_rq.rq_tasks, elem) {
+        task = list_entry(elem, struct task, rq_elem);
+
+        if (!task_is_rt(task))
+            continue;
+
+        if (task_runnable(task) || (task->state == TASK_SLEEPING &&
+                    task->wake_time <= __pit_ticks)) {
+            ret = 1;
+            break;
         }
     }
+    spin_unlock(&cpu->cpu_rq.rq_lock);
 
-    if (last_task == 0)
-        panic("No task to run\n");
-    last_task = 0;
-    */
+    return ret;
+}
+
+/*
+ * sched_rt_tick - RT bandwidth accounting, returns 1 if CUR must yield
+ *
+ * @cpu - this CPU
+ * @cur - the task that was running when the tick came
+ */
+static int
+sched_rt_tick(struct cpu *cpu, struct task *cur)
+{
+    extern uint32_t __pit_ticks;
+
+    if (__pit_ticks - cpu->cpu_rt_period_start >= RT_PERIOD) {
+        cpu->cpu_rt_period_start = __pit_ticks;
+        cpu->cpu_rt_time = 0;
+        cpu->cpu_rt_throttled = 0;
+    }
+
+    if (!task_is_rt(cur))
+        return 0;
+
+    if (++ cpu->cpu_rt_time >= RT_RUNTIME && !cpu->cpu_rt_throttled) {
+        printk("sched: RT throttling activated on cpu%d\n", cpu->cpu_id);
+        cpu->cpu_rt_throttled = 1;
+        return 1;
+    }
+
+    return 0;
+}
+
+static void
+double_rq_lock(struct cpu *a, struct cpu *b)
+{
+    if (a->cpu_id < b->cpu_id) {
+        spin_lock(&a->cpu_rq.rq_lock);
+        spin_lock(&b->cpu_rq.rq_lock);
+    } else {
+        spin_lock(&b->cpu_rq.rq_lock);
+        spin_lock(&a->cpu_rq.rq_lock);
+    }
+}
+
+static void
+double_rq_unlock(struct cpu *a, struct cpu *b)
+{
+    spin_unlock(&a->cpu_rq.rq_lock);
+    spin_unlock(&b->cpu_rq.rq_lock);
+}
+
+/*
+ * sched_migrate_one - move a runnable task from SRC to DST
+ *
+ * Both run queues must be locked.  Returns the task that was moved, or NULL
+ * if SRC had nothing that could be moved.
+ */
+static struct task *
+sched_migrate_one(struct cpu *src, struct cpu *dst)
+{
+    struct list_elem *elem;
+    struct task *task;
+
+    list_foreach_raw(&src->cpu_rq.rq_tasks, elem) {
+        task = list_entry(elem, struct task, rq_elem);
+
+        if (!task_runnable(task) || task->on_cpu ||
+                (task->flags & TFLAG_PINNED))
+            continue;
+
+        list_remove(&task->rq_elem);
+        task->cpu = dst->cpu_id;
+        list_push_back(&dst->cpu_rq.rq_tasks, &task->rq_elem);
+        return task;
+    }
+
+    return NULL;
+}
+
+/* an idle CPU steals work from the others */
+static int
+sched_steal_task(struct cpu *this)
+{
+    struct cpu *cpu;
+    struct task *task = NULL;
+
+    for_each_cpu(cpu) {
+        if (cpu == this || !cpu->cpu_online)
+            continue;
+
+        double_rq_lock(this, cpu);
+        task = sched_migrate_one(cpu, this);
+        double_rq_unlock(this, cpu);
+
+        if (task)
+            return 1;
+    }
+
+    return 0;
+}
+
+/* pull a task over if some other CPU is busier than us by two or more */
+static void
+sched_balance(struct cpu *this)
+{
+    struct cpu *cpu, *busiest = NULL;
+    int load, max_load = 0, this_load;
+
+    this_load = cpu_load(this);
+
+    for_each_cpu(cpu) {
+        if (cpu == this || !cpu->cpu_online)
+            continue;
+
+        load = cpu_load(cpu);
+        if (load > max_load) {
+            busiest = cpu;
+            max_load = load;
+        }
+    }
+
+    if (!busiest || max_load - this_load < 2)
+        return;
+
+    double_rq_lock(this, busiest);
+    sched_migrate_one(busiest, this);
+    double_rq_unlock(this, busiest);
+}
+
+struct task *
+pick_next_task(void)
+{
+    struct cpu *cpu = this_cpu();
+    struct runqueue *rq = &cpu->cpu_rq;
+    struct task *prev = cpu->cpu_current, *task;
+
+    if (__task_need_cleanup > 0)
+        sched_reap_dying(rq);
+
+    spin_lock(&rq->rq_lock);
+    task = rq_pick(cpu, prev);
+    spin_unlock(&rq->rq_lock);
+
+    if (!task && sched_steal_task(cpu)) {
+        spin_lock(&rq->rq_lock);
+        task = rq_pick(cpu, prev);
+        spin_unlock(&rq->rq_lock);
+    }
+
+    if (!task) {
+        task = cpu->cpu_idle ? cpu->cpu_idle : prev;
+        task->on_cpu = 1;
+    }
 
-retry:
-    elem = list_next(&task->all_elem);
-    if (elem == list_tail(&all_tasks))
-        elem = list_begin(&all_tasks);
-    task = list_entry(elem, struct task, all_elem);
-
-    if (task->state == TASK_DYING) {
-        //printk("rejected %d because it's dying\n", task->pid);
-        task_exit(task);
-        goto retry;
-    } else if (task->state == TASK_SLEEPING && task->wake_time <= __pit_ticks) {
-        task->state = TASK_PREEMPTED;
-    } else if (!task_runnable(task)) {
-        //printk("rejected %d because it was not runnable\n", task->pid);
-        goto retry;
-    }
-
-    //spin_unlock(&all_tasks_lock); 
     return task;
 }
 
+static void __noreturn schedule(void);
+
+/* on the way out of an IRQ that set need_resched */
 void
-intr_yield(struct pt_regs *r)
+sched_preempt_irq(struct pt_regs *r)
 {
-    DISABLE_IRQ();
     current_task->regs = r;
-    //current_task->regs->ss = 0x23;
     reschedule();
 }
 
+/* somebody queued work for us while we were idle */
 void
-sched_yield()
+sched_resched_irq(struct pt_regs *r)
 {
-    asm volatile("int $0x2F");
+    sched_nohz_exit();
+    percpu_write(cpu_need_resched, 1);
 }
 
-void
-__reschedule_to(struct task *next)
+/*
+ * sched_switch_prepare - make NEXT the current task of this CPU
+ *
+ * @prev - the task we are switching away from
+ * @next - the task to run
+ *
+ * Returns 0 if NEXT should not run after all, e.g. because a signal
+ * stopped or killed it, in which case something else has to be picked.
+ */
+static int
+sched_switch_prepare(struct task *prev, struct task *next)
 {
     next->time_ran = 0;
     next->state = TASK_RUNNING;
+    next->on_cpu = 1;
     //current_task->sys_regs = current_task->regs;
-    do_sse_save(current_task);
-    current_task = next;
+    this_cpu()->cpu_current = next;
 
-    if (current_task->mm)
-        activate_pgd(current_task->mm);
+    if (next->mm)
+        activate_pgd(next->mm);
     //else activate_pgd(kernel_pgd);
     
-    tss_update(current_task);
+    tss_update(next);
 
     if (!(next->flags & TFLAG_NO_SIGNAL) && task_has_pending_signals(next)) {
+        struct pt_regs *regs = next->regs;
+
         //task->sys_regs = task->regs;
         signal_handle(next);
+
+        /* it's off to a handler, whatever it was doing in the kernel is lost */
+        if (next->regs != regs)
+            next->context = 0;
     }
 
-    if (next->state != TASK_RUNNING)
-        return;
+    if (next->state != TASK_RUNNING) {
+        if (next != prev)
+            next->on_cpu = 0;
+        return 0;
+    }
 
     next->flags &= ~TFLAG_NO_SIGNAL;
 
+    /* nobody schedules from inside an RCU read-side critical section */
+    rcu_qs();
+
+    if (next != prev)
+        sched_stat_switch(this_cpu(), prev, next);
+
     do_sse_restore(next);
-    /* switch stack */
+    return 1;
+}
+
+/* continue NEXT from its interrupt frame */
+static void __noreturn
+sched_resume_regs(struct task *next, int *prev_on_cpu)
+{
+    /*
+     * switch stack, only once we are off it can prev be picked up by
+     * another CPU
+     */
     asm volatile("movl %0, %%esp;"
-                 "movw $0x20, %%dx;"
-                 "movb $0x20, %%al;"
-                 "outb %%al, %%dx;"
+                 "movl $0, (%1);"
                  "sti;"
-                 "jmp intr_exit"::"r"(next->regs));
+                 "jmp intr_exit"::"r"(next->regs), "r"(prev_on_cpu));
     __not_reached();
 }
 
+void
+__reschedule_to(struct task *prev, struct task *next)
+{
+    static int dummy_on_cpu;
+    int *prev_on_cpu = prev == next ? &dummy_on_cpu : &prev->on_cpu;
+    uint32_t context;
+    int vec;
+
+    if (!sched_switch_prepare(prev, next))
+        return;
+
+    /*
+     * switching from inside a handler, its EOI would never be sent.  On
+     * the way out of an IRQ intr_handler() has sent it already.
+     */
+    vec = irq_abandon();
+    if (vec >= 0)
+        arch_irq_eoi(vec);
+
+    /* it gave up the CPU itself, so it returns to sched_yield() */
+    if (next->context) {
+        context = next->context;
+        next->context = 0;
+        arch_switch_resume(context, prev_on_cpu);
+        __not_reached();
+    }
+
+    sched_resume_regs(next, prev_on_cpu);
+}
+
 void
 reschedule_to(struct task *next)
 {
+    struct task *prev = current_task;
+
+    do_sse_save(prev);
+
 retry:
-    __reschedule_to(next);
+    __reschedule_to(prev, next);
     next = pick_next_task();
     goto retry;
 }
 
+/*
+ * sched_yield - give up the CPU
+ *
+ * The voluntary path: there is no need for an interrupt frame, we only
+ * save what the C calling convention expects to survive the call and
+ * return here once somebody switches back to us.  If the current task is
+ * still runnable, it stays on the run queue.
+ */
 void
-reschedule(void)
+sched_yield(void)
+{
+    struct task *prev = current_task, *next;
+    struct pt_regs *regs = prev->regs;
+    int irqs_off = arch_irqs_disabled();
+    uint32_t context;
+
+    DISABLE_IRQ();
+    percpu_write(cpu_need_resched, 0);
+
+    if (prev->state == TASK_RUNNING) {
+        extern uint32_t __pit_ticks;
+
+        sched_stat_enqueue(prev, __pit_ticks, 0);
+        prev->state = TASK_PREEMPTED;
+    }
+
+    do_sse_save(prev);
+
+    do
+        next = pick_next_task();
+    while (!sched_switch_prepare(prev, next));
+
+    if (next == prev) {
+        /* a signal handler is to be run instead of returning */
+        if (prev->regs != regs) {
+            static int dummy_on_cpu;
+
+            sched_resume_regs(prev, &dummy_on_cpu);
+        }
+    } else if (next->context) {
+        context = next->context;
+        next->context = 0;
+        arch_switch_to(&prev->context, context, &prev->on_cpu);
+    } else
+        arch_switch_to_regs(&prev->context, next->regs, &prev->on_cpu);
+
+    if (!irqs_off)
+        ENABLE_IRQ();
+}
+
+static void __noreturn
+schedule(void)
 {
     struct task *next;
+
     DISABLE_IRQ();
-    if (__preempt_enabled == 0)
-        reschedule_to(current_task);
+    percpu_write(cpu_need_resched, 0);
 
-    if (current_task->state == TASK_RUNNING)
+    if (current_task->state == TASK_RUNNING) {
+        extern uint32_t __pit_ticks;
+
+        sched_stat_enqueue(current_task, __pit_ticks, 0);
         current_task->state = TASK_PREEMPTED;
+    }
     next = pick_next_task();
     reschedule_to(next);
+    __not_reached();
+}
+
+/* preempt the current task, or note that we should once it allows it */
+void
+reschedule(void)
+{
+    DISABLE_IRQ();
+
+    /* a task that is blocking is on its way out anyway */
+    if (current_task->preempt_count && current_task->state == TASK_RUNNING) {
+        percpu_write(cpu_need_resched, 1);
+        reschedule_to(current_task);
+    }
+
+    schedule();
 }
 
 void
 sched_tick(struct pt_regs *r)
 {
-    current_task->time_ran ++;
-    current_task->regs = r;
+    struct cpu *cpu = this_cpu();
+    struct task *cur = cpu->cpu_current;
+
+    /* the tick that ends a tickless period is accounted by nohz_exit */
+    if (cpu->cpu_nohz)
+        sched_nohz_exit();
+    else if (cur == cpu->cpu_idle)
+        cpu->cpu_idle_ticks ++;
+
+    if (cpu->cpu_id == 0) {
+        sched_nohz_kick(cpu);
+        __raise_softirq_irqoff(SOFTIRQ_TIMER);
+    }
+
+    if (cur != cpu->cpu_idle) {
+        if (r->cs & 3) {
+            /* user mode is outside of any RCU reader */
+            rcu_qs();
+            cur->stats.ss_utime ++;
+            cpu->cpu_user_ticks ++;
+        } else {
+            cur->stats.ss_stime ++;
+            cpu->cpu_system_ticks ++;
+        }
+    }
+
+    cur->time_ran ++;
+    cur->regs = r;
     //printk("TICK\n");
-    if (current_task->time_ran > TIME_SLICE)
-        reschedule();
+
+    rcu_check_callbacks();
+
+    if (++ cpu->cpu_balance_ticks >= BALANCE_INTERVAL) {
+        cpu->cpu_balance_ticks = 0;
+        sched_balance(cpu);
+    }
+
+    /*
+     * the switch happens on the way out of the interrupt, after the
+     * softirqs we raised had their turn
+     */
+    if (sched_rt_tick(cpu, cur) || cur == cpu->cpu_idle)
+        percpu_write(cpu_need_resched, 1);
+
+    /* SCHED_FIFO tasks run until they give up the CPU */
+    if (task_is_rt(cur)) {
+        if (cur->policy == SCHED_RR && cur->time_ran > TIME_SLICE)
+            percpu_write(cpu_need_resched, 1);
+    } else if (cur->time_ran > TIME_SLICE || sched_rt_pending(cpu))
+        percpu_write(cpu_need_resched, 1);
+}
+
+/* /proc/idle: idle time of every CPU, in ticks */
+size_t
+sched_proc_idle(int pos, void *buf, size_t len, char *__arg)
+{
+    extern uint32_t __pit_ticks;
+    char buffer[64 * (NR_CPUS + 1)];
+    struct cpu *cpu;
+    int off;
+
+    off = snprintf(buffer, sizeof(buffer), "uptime %u\n", __pit_ticks);
+
+    for_each_cpu(cpu) {
+        if (!cpu->cpu_online)
+            continue;
+
+        off += snprintf(buffer + off, sizeof(buffer) - off,
+                "cpu%d idle %u nohz %u\n", cpu->cpu_id,
+                cpu->cpu_idle_ticks, cpu->cpu_nohz_entries);
+    }
+
+    return generic_write_buf(pos, buf, len, buffer);
+}
+
+/*
+ * sched_task_stats_dump - describe the CPU usage of TASK
+ *
+ * @task - the task
+ * @buf - where to put the text
+ * @size - size of BUF
+ *
+ * Returns the length of the text, this is /proc/<pid>/sched.
+ */
+int
+sched_task_stats_dump(struct task *task, char *buf, size_t size)
+{
+    static const char *lat_names[SCHED_LAT_BUCKETS] = {
+        "<1", "1", "2-3", "4-7", "8-15", "16-31", "32+"
+    };
+    struct sched_stats *st = &task->stats;
+    int off, i;
+
+    off = snprintf(buf, size,
+            "pid %d\n"
+            "comm %s\n"
+            "cpu %d\n"
+            "policy %d\n"
+            "rt_priority %d\n"
+            "utime %u\n"
+            "stime %u\n"
+            "cutime %u\n"
+            "cstime %u\n"
+            "nvcsw %u\n"
+            "nivcsw %u\n"
+            "nr_runs %u\n"
+            "wait_ticks %u\n"
+            "wakeups %u\n"
+            "wakeup_latency",
+            task->pid, task->comm, task->cpu,
+            task->policy, task->rt_priority,
+            st->ss_utime, st->ss_stime, st->ss_cutime, st->ss_cstime,
+            st->ss_nvcsw, st->ss_nivcsw, st->ss_nr_runs,
+            st->ss_wait_ticks, st->ss_wakeups);
+
+    for (i = 0; i < SCHED_LAT_BUCKETS; i ++)
+        off += snprintf(buf + off, size - off, " %s:%u",
+                lat_names[i], st->ss_wakeup_lat[i]);
+
+    off += snprintf(buf + off, size - off, "\n");
+
+    return off;
+}
+
+/* /proc/stat: system-wide CPU usage, in ticks */
+size_t
+sched_proc_stat(int pos, void *buf, size_t len, char *__arg)
+{
+    char buffer[64 * (NR_CPUS + 6)];
+    uint32_t user = 0, system = 0, idle = 0, switches = 0;
+    int running = 0, blocked = 0, off;
+    struct list_elem *elem;
+    struct cpu *cpu;
+    uint32_t flags;
+
+    for_each_cpu(cpu) {
+        user += cpu->cpu_user_ticks;
+        system += cpu->cpu_system_ticks;
+        idle += cpu->cpu_idle_ticks;
+        switches += cpu->cpu_nr_switches;
+    }
+
+    flags = spin_lock_irqsave(&all_tasks_lock);
+    list_foreach_raw(&all_tasks, elem) {
+        struct task *t = list_entry(elem, struct task, all_elem);
+
+        if (t->state == TASK_RUNNING || task_runnable(t))
+            running ++;
+        else if (t->state == TASK_BLOCKED || t->state == TASK_SLEEPING)
+            blocked ++;
+    }
+    spin_unlock_irqrestore(&all_tasks_lock, flags);
+
+    off = snprintf(buffer, sizeof(buffer), "cpu %u %u %u\n",
+            user, system, idle);
+
+    for_each_cpu(cpu) {
+        if (!cpu->cpu_online)
+            continue;
+
+        off += snprintf(buffer + off, sizeof(buffer) - off,
+                "cpu%d %u %u %u\n", cpu->cpu_id, cpu->cpu_user_ticks,
+                cpu->cpu_system_ticks, cpu->cpu_idle_ticks);
+    }
+
+    snprintf(buffer + off, sizeof(buffer) - off,
+            "ctxt %u\n"
+            "processes %u\n"
+            "procs_running %d\n"
+            "procs_blocked %d\n",
+            switches, sched_nr_forks, running, blocked);
+
+    return generic_write_buf(pos, buf, len, buffer);
+}
+
+/*
+ * sched_setscheduler - change the scheduling policy of TASK
+ *
+ * @task - the task
+ * @policy - SCHED_OTHER, SCHED_FIFO or SCHED_RR
+ * @prio - the real-time priority, must be 0 for SCHED_OTHER
+ */
+int
+sched_setscheduler(struct task *task, int policy, int prio)
+{
+    if (policy == SCHED_OTHER) {
+        if (prio != 0)
+            return -EINVAL;
+    } else if (policy == SCHED_FIFO || policy == SCHED_RR) {
+        if (prio < SCHED_RT_PRIO_MIN || prio > SCHED_RT_PRIO_MAX)
+            return -EINVAL;
+    } else
+        return -EINVAL;
+
+    task->policy = policy;
+    task->rt_priority = prio;
+    task->time_ran = 0;
+
+    sched_kick_task(task);
+
+    return 0;
 }
@@ -0,0 +1,112 @@
+#include <levos/kernel.h>
+#include <levos/semaphore.h>
+#include <levos/wait.h>
+#include <levos/task.h>
+
+/* take one from *COUNT if it's positive, returns whether we did */
+static int
+count_try_dec(volatile int *count)
+{
+    int old;
+
+    do {
+        old = *count;
+        if (old <= 0)
+            return 0;
+    } while (!__sync_bool_compare_and_swap(count, old, old - 1));
+
+    return 1;
+}
+
+/* sleep on WQ until we could take one from *COUNT */
+static void
+count_wait_dec(volatile int *count, wait_queue_t *wq)
+{
+    struct wait_queue_entry wqe;
+
+    if (count_try_dec(count))
+        return;
+
+    memset(&wqe, 0, sizeof(wqe));
+
+    while (1) {
+        prepare_to_wait(wq, &wqe);
+        if (count_try_dec(count))
+            break;
+        sched_yield();
+    }
+
+    finish_wait(wq, &wqe);
+}
+
+void
+sema_init(struct semaphore *s, int count)
+{
+    s->s_count = count;
+    wait_queue_init(&s->s_waiters);
+}
+
+void
+down(struct semaphore *s)
+{
+    count_wait_dec(&s->s_count, &s->s_waiters);
+}
+
+/* returns 0 if the semaphore was taken, like Linux */
+int
+down_trylock(struct semaphore *s)
+{
+    return !count_try_dec(&s->s_count);
+}
+
+void
+up(struct semaphore *s)
+{
+    __sync_fetch_and_add(&s->s_count, 1);
+
+    if (wait_queue_num_waiters(&s->s_waiters))
+        wait_wake_up_one(&s->s_waiters);
+}
+
+void
+init_completion(struct completion *c)
+{
+    c->c_done = 0;
+    wait_queue_init(&c->c_waiters);
+}
+
+/* for using C again, nobody may be waiting on it */
+void
+reinit_completion(struct completion *c)
+{
+    c->c_done = 0;
+}
+
+void
+wait_for_completion(struct completion *c)
+{
+    count_wait_dec(&c->c_done, &c->c_waiters);
+}
+
+/* returns 1 if C was done, without sleeping */
+int
+try_wait_for_completion(struct completion *c)
+{
+    return count_try_dec(&c->c_done);
+}
+
+void
+complete(struct completion *c)
+{
+    __sync_fetch_and_add(&c->c_done, 1);
+    wait_wake_up_one(&c->c_waiters);
+}
+
+void
+complete_all(struct completion *c)
+{
+    /* enough that nobody will ever count it down to zero */
+    c->c_done = 0x3fffffff;
+    __sync_synchronize();
+    wait_wake_up(&c->c_waiters);
+}
@@ -1,6 +1,7 @@
 #include <levos/kernel.h>
 #include <levos/task.h>
 #include <levos/signal.h>
+#include <levos/pid.h>
 #include <levos/list.h>
 #include <levos/palloc.h>
 
@@ -124,15 +125,20 @@ send_signal_group(pid_t pgid, int signal)
 {
     struct task *task = NULL;
     struct list_elem *elem;
-
-    list_foreach_raw(__ALL_TASKS_PTR, elem) {
-        task = list_entry(elem, struct task, all_elem);
-        if (task->pid == pgid || task->pgid == pgid) {
+    struct pid *pid;
+    uint32_t flags;
+
+    flags = spin_lock_irqsave(&pid_lock);
+    pid = pid_find(pgid);
+    if (pid) {
+        list_foreach_raw(&pid->pid_pgrp, elem) {
+            task = list_entry(elem, struct task, pgrp_elem);
             printk("sent a %s sig to pgid %d pid %d\n", signal_to_string(signal),
                     task->pgid, task->pid);
             __send_signal(task, signal); 
         }
     }
+    spin_unlock_irqrestore(&pid_lock, flags);
 
     /* if our PG has been signalled, we need to reschedule to process
      * the signal
@@ -152,12 +158,18 @@ void send_signal_session(pid_t sid, int signal)
 {
     struct task *task = NULL;
     struct list_elem *elem;
-    list_foreach_raw(__ALL_TASKS_PTR, elem) {
-        task = list_entry(elem, struct task, all_elem);
-        if (task->sid == sid) {
+    struct pid *pid;
+    uint32_t flags;
+
+    flags = spin_lock_irqsave(&pid_lock);
+    pid = pid_find(sid);
+    if (pid) {
+        list_foreach_raw(&pid->pid_session, elem) {
+            task = list_entry(elem, struct task, session_elem);
             __send_signal(task, signal); 
         }
     }
+    spin_unlock_irqrestore(&pid_lock, flags);
 
     /* if our session has been signalled, we need to reschedule to process
      * the signal
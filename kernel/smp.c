@@ -0,0 +1,50 @@
+#include <levos/kernel.h>
+#include <levos/arch.h>
+#include <levos/smp.h>
+#include <levos/task.h>
+
+struct cpu cpus[NR_CPUS];
+
+/* "nosmp" on the command line keeps the APs parked */
+int __sysctl_nosmp;
+
+void
+percpu_init(int id)
+{
+    struct cpu *cpu = &cpus[id];
+
+    memset(cpu, 0, sizeof(*cpu));
+    cpu->cpu_self = cpu;
+    cpu->cpu_id = id;
+    spin_lock_init(&cpu->cpu_rq.rq_lock);
+    list_init(&cpu->cpu_rq.rq_tasks);
+}
+
+int
+smp_num_cpus(void)
+{
+    struct cpu *cpu;
+    int n = 0;
+
+    for_each_cpu(cpu)
+        if (cpu->cpu_online)
+            n ++;
+
+    return n;
+}
+
+void
+smp_init(void)
+{
+#ifdef CONFIG_SMP
+    if (__sysctl_nosmp) {
+        printk("smp: disabled on the command line\n");
+        return;
+    }
+
+    arch_smp_boot();
+#endif
+
+    printk("smp: %d CPU%s online\n", smp_num_cpus(),
+            smp_num_cpus() == 1 ? "" : "s");
+}
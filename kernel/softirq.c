@@ -0,0 +1,365 @@
+#include <levos/kernel.h>
+#include <levos/types.h>
+#include <levos/softirq.h>
+#include <levos/task.h>
+#include <levos/smp.h>
+#include <levos/fs.h>
+#include <levos/list.h>
+#include <levos/rcu.h>
+
+#define MODULE_NAME softirq
+
+/* rounds do_softirq() goes before leaving the rest to ksoftirqd */
+#define MAX_SOFTIRQ_RESTART 10
+
+struct softirq_cpu {
+    volatile uint32_t sc_pending;
+
+    /* hard IRQ nesting, and whether do_softirq() is running */
+    int sc_hardirq;
+    int sc_active;
+
+    /* the vector of the innermost hard IRQ, not EOI'd until irq_exit() */
+    int sc_vec;
+
+    /* scheduled tasklets, for SOFTIRQ_HI and SOFTIRQ_TASKLET */
+    struct list sc_tasklets_hi;
+    struct list sc_tasklets;
+
+    struct task *sc_ksoftirqd;
+
+    /* see /proc/softirqs */
+    uint32_t sc_count[NR_SOFTIRQS];
+};
+
+static struct softirq_cpu softirq_cpus[NR_CPUS];
+
+static softirq_action_t *softirq_vec[NR_SOFTIRQS];
+
+static char *softirq_names[NR_SOFTIRQS] = {
+    [SOFTIRQ_HI]      = "HI",
+    [SOFTIRQ_TIMER]   = "TIMER",
+    [SOFTIRQ_TASKLET] = "TASKLET",
+    [SOFTIRQ_RCU]     = "RCU",
+};
+
+static inline struct softirq_cpu *
+this_softirq(void)
+{
+    return &softirq_cpus[percpu_read(cpu_id)];
+}
+
+void
+open_softirq(int nr, softirq_action_t *action)
+{
+    softirq_vec[nr] = action;
+}
+
+/* the softirqs of this CPU are only looked at again by ksoftirqd */
+static void
+wakeup_ksoftirqd(struct softirq_cpu *sc)
+{
+    struct task *task = sc->sc_ksoftirqd;
+
+    if (task && task->state == TASK_BLOCKED)
+        task_kick(task);
+}
+
+void
+__raise_softirq_irqoff(int nr)
+{
+    struct softirq_cpu *sc = this_softirq();
+
+    sc->sc_pending |= 1 << nr;
+
+    /* nobody would run it on the way out of an interrupt */
+    if (!sc->sc_hardirq && !sc->sc_active)
+        wakeup_ksoftirqd(sc);
+}
+
+void
+raise_softirq(int nr)
+{
+    uint32_t flags = arch_irqs_disabled();
+
+    DISABLE_IRQ();
+    __raise_softirq_irqoff(nr);
+    if (!flags)
+        ENABLE_IRQ();
+}
+
+/*
+ * do_softirq - run the pending softirqs of this CPU
+ *
+ * Interrupts are enabled while the handlers run, but preemption is not.
+ * If they keep getting raised, ksoftirqd takes over after a while, so that
+ * the interrupted task gets to make progress.
+ */
+void
+do_softirq(void)
+{
+    int irqs_off = arch_irqs_disabled();
+    int restart = MAX_SOFTIRQ_RESTART, nr;
+    struct softirq_cpu *sc;
+    uint32_t pending;
+
+    DISABLE_IRQ();
+    sc = this_softirq();
+    if (sc->sc_active || !sc->sc_pending)
+        goto out;
+
+    sc->sc_active = 1;
+    preempt_disable();
+
+again:
+    pending = sc->sc_pending;
+    sc->sc_pending = 0;
+    ENABLE_IRQ();
+
+    for (nr = 0; nr < NR_SOFTIRQS; nr ++) {
+        if (!(pending & (1 << nr)) || !softirq_vec[nr])
+            continue;
+
+        sc->sc_count[nr] ++;
+        softirq_vec[nr]();
+    }
+
+    DISABLE_IRQ();
+    if (sc->sc_pending) {
+        if (-- restart)
+            goto again;
+
+        wakeup_ksoftirqd(sc);
+    }
+
+    sc->sc_active = 0;
+
+    /* the interrupt we are returning from checks for that */
+    preempt_enable_no_resched();
+
+out:
+    if (!irqs_off)
+        ENABLE_IRQ();
+}
+
+void
+irq_enter(int vec)
+{
+    struct softirq_cpu *sc = this_softirq();
+
+    rcu_irq_enter();
+    sc->sc_hardirq ++;
+    sc->sc_vec = vec;
+}
+
+/* called with interrupts disabled after the EOI of a hard IRQ */
+void
+irq_exit(void)
+{
+    struct softirq_cpu *sc = this_softirq();
+
+    if (-- sc->sc_hardirq || !sc->sc_pending || !current_task)
+        return;
+
+    do_softirq();
+}
+
+/*
+ * irq_abandon - the interrupt frames of this CPU are left for good
+ *
+ * A handler that switches to another task never gets to irq_exit().
+ * Returns the vector of the handler we are leaving, whose EOI is still
+ * to be sent, or -1 if we are not inside one.
+ */
+int
+irq_abandon(void)
+{
+    struct softirq_cpu *sc = this_softirq();
+    int vec = sc->sc_hardirq ? sc->sc_vec : -1;
+
+    sc->sc_hardirq = 0;
+
+    return vec;
+}
+
+void
+tasklet_init(struct tasklet *t, void (*func)(unsigned long), unsigned long data)
+{
+    t->t_state = 0;
+    t->t_func = func;
+    t->t_data = data;
+}
+
+static void
+__tasklet_schedule(struct tasklet *t, int nr)
+{
+    struct softirq_cpu *sc;
+    int irqs_off;
+
+    if (__sync_fetch_and_or(&t->t_state, TASKLET_STATE_SCHED) &
+            TASKLET_STATE_SCHED)
+        return;
+
+    irqs_off = arch_irqs_disabled();
+    DISABLE_IRQ();
+    sc = this_softirq();
+    list_push_back(nr == SOFTIRQ_HI ? &sc->sc_tasklets_hi : &sc->sc_tasklets,
+                   &t->t_elem);
+    __raise_softirq_irqoff(nr);
+    if (!irqs_off)
+        ENABLE_IRQ();
+}
+
+void
+tasklet_schedule(struct tasklet *t)
+{
+    __tasklet_schedule(t, SOFTIRQ_TASKLET);
+}
+
+void
+tasklet_hi_schedule(struct tasklet *t)
+{
+    __tasklet_schedule(t, SOFTIRQ_HI);
+}
+
+static void
+tasklet_action_common(int nr)
+{
+    struct softirq_cpu *sc = this_softirq();
+    struct list *queue = nr == SOFTIRQ_HI ? &sc->sc_tasklets_hi
+                                          : &sc->sc_tasklets;
+    struct list todo;
+    struct tasklet *t;
+
+    list_init(&todo);
+
+    DISABLE_IRQ();
+    while (!list_empty(queue))
+        list_push_back(&todo, list_pop_front(queue));
+    ENABLE_IRQ();
+
+    while (!list_empty(&todo)) {
+        t = list_entry(list_pop_front(&todo), struct tasklet, t_elem);
+
+        /* still running on another CPU, try again later */
+        if (__sync_fetch_and_or(&t->t_state, TASKLET_STATE_RUN) &
+                TASKLET_STATE_RUN) {
+            DISABLE_IRQ();
+            list_push_back(queue, &t->t_elem);
+            __raise_softirq_irqoff(nr);
+            ENABLE_IRQ();
+            continue;
+        }
+
+        /* it may be scheduled again from here on */
+        __sync_fetch_and_and(&t->t_state, ~TASKLET_STATE_SCHED);
+        t->t_func(t->t_data);
+        __sync_fetch_and_and(&t->t_state, ~TASKLET_STATE_RUN);
+    }
+}
+
+static void
+tasklet_hi_action(void)
+{
+    tasklet_action_common(SOFTIRQ_HI);
+}
+
+static void
+tasklet_action(void)
+{
+    tasklet_action_common(SOFTIRQ_TASKLET);
+}
+
+static void
+ksoftirqd_thread(void)
+{
+    struct softirq_cpu *sc = this_softirq();
+
+    while (1) {
+        /* a softirq raised from here on kicks us */
+        DISABLE_IRQ();
+        if (!sc->sc_pending) {
+            task_block_noresched(current_task);
+            ENABLE_IRQ();
+            sched_yield();
+            continue;
+        }
+        ENABLE_IRQ();
+
+        do_softirq();
+
+        /* we are here because they keep coming, let others in */
+        sched_yield();
+    }
+}
+
+/* /proc/softirqs: how often each softirq ran, per CPU */
+size_t
+softirq_proc_stat(int pos, void *buf, size_t len, char *__arg)
+{
+    char buffer[64 * (NR_CPUS + 1)];
+    struct cpu *cpu;
+    int off, nr;
+
+    off = snprintf(buffer, sizeof(buffer), "cpu");
+    for (nr = 0; nr < NR_SOFTIRQS; nr ++)
+        off += snprintf(buffer + off, sizeof(buffer) - off, " %s",
+                softirq_names[nr]);
+    off += snprintf(buffer + off, sizeof(buffer) - off, "\n");
+
+    for_each_cpu(cpu) {
+        if (!cpu->cpu_online)
+            continue;
+
+        off += snprintf(buffer + off, sizeof(buffer) - off, "%d",
+                cpu->cpu_id);
+        for (nr = 0; nr < NR_SOFTIRQS; nr ++)
+            off += snprintf(buffer + off, sizeof(buffer) - off, " %u",
+                    softirq_cpus[cpu->cpu_id].sc_count[nr]);
+        off += snprintf(buffer + off, sizeof(buffer) - off, "\n");
+    }
+
+    return generic_write_buf(pos, buf, len, buffer);
+}
+
+void
+softirq_init(void)
+{
+    int i;
+
+    for (i = 0; i < NR_CPUS; i ++) {
+        list_init(&softirq_cpus[i].sc_tasklets_hi);
+        list_init(&softirq_cpus[i].sc_tasklets);
+    }
+
+    open_softirq(SOFTIRQ_HI, tasklet_hi_action);
+    open_softirq(SOFTIRQ_TASKLET, tasklet_action);
+}
+
+/* one ksoftirqd for every CPU that is online */
+void
+ksoftirqd_init(void)
+{
+    struct task *task;
+    struct cpu *cpu;
+    char name[16];
+
+    for_each_cpu(cpu) {
+        if (!cpu->cpu_online)
+            continue;
+
+        task = create_kernel_task(ksoftirqd_thread);
+        if (!task)
+            panic("softirq: failed to create ksoftirqd\n");
+
+        snprintf(name, sizeof(name), "ksoftirqd/%d", cpu->cpu_id);
+        free(task->comm);
+        task->comm = strdup(name);
+        task->flags |= TFLAG_PINNED;
+
+        softirq_cpus[cpu->cpu_id].sc_ksoftirqd = task;
+        sched_add_rq_cpu(task, cpu);
+    }
+
+    mprintk("%d ksoftirqd threads started\n", smp_num_cpus());
+}
@@ -1,27 +1,206 @@
+#include <levos/kernel.h>
 #include <levos/spinlock.h>
 #include <levos/arch.h>
 #include <levos/task.h>
+#include <levos/fs.h>
 
+#ifdef CONFIG_LOCK_STAT
+/* every class some lock was initialized with, newest first */
+static struct lock_class *volatile lock_classes;
+
+static void
+lockstat_register(struct lock_class *class)
+{
+    struct lock_class *head;
+
+    if (class->lc_registered ||
+            !__sync_bool_compare_and_swap(&class->lc_registered, 0, 1))
+        return;
+
+    do {
+        head = lock_classes;
+        class->lc_next = head;
+    } while (!__sync_bool_compare_and_swap(&lock_classes, head, class));
+}
+
+static void
+lockstat_update_max(uint32_t *max, uint64_t cycles)
+{
+    uint32_t val = cycles > 0xFFFFFFFF ? 0xFFFFFFFF : cycles;
+    uint32_t old;
+
+    do {
+        old = *max;
+        if (val <= old)
+            return;
+    } while (!__sync_bool_compare_and_swap(max, old, val));
+}
+
+/* take the lock, noting if and how long we had to wait for it */
+static void
+lockstat_lock(spinlock_t *l)
+{
+    struct lock_class *class = l->class;
+    uint64_t start;
+
+    if (arch_spin_trylock(&l->value)) {
+        start = 0;
+    } else {
+        start = arch_rdtsc();
+        arch_spin_lock(&l->value);
+    }
+
+    l->acquired_at = arch_rdtsc();
+
+    if (!class)
+        return;
+
+    __sync_fetch_and_add(&class->lc_acquired, 1);
+    if (start) {
+        __sync_fetch_and_add(&class->lc_contended, 1);
+        lockstat_update_max(&class->lc_wait_max, l->acquired_at - start);
+    }
+}
+
+static void
+lockstat_unlock(spinlock_t *l)
+{
+    if (l->class)
+        lockstat_update_max(&l->class->lc_hold_max,
+                arch_rdtsc() - l->acquired_at);
+}
+
+void
+__spin_lock_init(spinlock_t *l, struct lock_class *class)
+{
+    l->value = 0;
+    l->holder = NULL;
+    l->class = class;
+    l->acquired_at = 0;
+
+    lockstat_register(class);
+}
+
+/*
+ * spinlock_proc_lockstat - /proc/lockstat
+ *
+ * One line per lock class: acquisitions, contended acquisitions, and the
+ * longest wait for and hold of a lock of the class, in TSC cycles.
+ * Locks that were never passed to spin_lock_init() are not counted.
+ */
+size_t
+spinlock_proc_lockstat(int pos, void *buf, size_t len, char *__arg)
+{
+    struct lock_class *class;
+    size_t size = 4096, rc;
+    char *buffer;
+    int off;
+
+    buffer = malloc(size);
+    if (!buffer)
+        return 0;
+
+    /* once it's full, the rest of the classes are left out */
+    off = snprintf(buffer, size, "class acquired contended wait-max hold-max\n");
+    for (class = lock_classes; class && off + 1 < size; class = class->lc_next)
+        off += snprintf(buffer + off, size - off, "%s %u %u %u %u\n",
+                class->lc_name, class->lc_acquired, class->lc_contended,
+                class->lc_wait_max, class->lc_hold_max);
+
+    rc = generic_write_buf(pos, buf, len, buffer);
+    free(buffer);
+
+    return rc;
+}
+#else
 void
 spin_lock_init(spinlock_t *l)
 {
     l->value = 0;
     l->holder = NULL;
 }
+#endif
+
+/*
+ * The holder of a spinlock is not preempted, or whoever spins on it next
+ * could be spinning for a whole time slice.  Neither is a waiter: with
+ * ticket locks it holds its place in the line, and everybody queued
+ * behind it would keep spinning after the lock is released, until it
+ * runs again.  So preemption is off from before we take a ticket.
+ */
 
 void
 spin_lock(spinlock_t *l)
 {
+    preempt_disable();
+#ifdef CONFIG_LOCK_STAT
+    lockstat_lock(l);
+#else
     arch_spin_lock(&l->value);
+#endif
     if (current_task)
         l->holder = current_task;
 }
 
+/* returns 1 if we got the lock */
+int
+spin_trylock(spinlock_t *l)
+{
+    preempt_disable();
+    if (!arch_spin_trylock(&l->value)) {
+        preempt_enable();
+        return 0;
+    }
+
+#ifdef CONFIG_LOCK_STAT
+    l->acquired_at = arch_rdtsc();
+    if (l->class)
+        __sync_fetch_and_add(&l->class->lc_acquired, 1);
+#endif
+    if (current_task)
+        l->holder = current_task;
+
+    return 1;
+}
+
 void
 spin_unlock(spinlock_t *l)
 {
     l->holder = NULL;
+#ifdef CONFIG_LOCK_STAT
+    lockstat_unlock(l);
+#endif
     arch_spin_unlock(&l->value);
+    preempt_enable();
+}
+
+uint32_t
+spin_lock_irqsave(spinlock_t *l)
+{
+    uint32_t flags;
+
+    preempt_disable();
+#ifdef CONFIG_LOCK_STAT
+    flags = arch_irq_save();
+    lockstat_lock(l);
+#else
+    flags = arch_spin_lock_irqsave(&l->value);
+#endif
+    if (current_task)
+        l->holder = current_task;
+
+    return flags;
+}
+
+void
+spin_unlock_irqrestore(spinlock_t *l, uint32_t flags)
+{
+    l->holder = NULL;
+#ifdef CONFIG_LOCK_STAT
+    lockstat_unlock(l);
+#endif
+    arch_spin_unlock_irqrestore(&l->value, flags);
+    preempt_enable();
 }
 
 int
@@ -10,6 +10,13 @@
 #include <levos/socket.h>
 #include <levos/work.h>
 #include <levos/tty.h>
+#include <levos/time.h>
+#include <levos/pid.h>
+#include <levos/uaccess.h>
+#include <levos/poll.h>
+#include <levos/eventpoll.h>
+#include <levos/io_uring.h>
+#include <levos/sysstat.h>
 
 #define ARGS_MAX 16
 #define ENVS_MAX 16
@@ -20,143 +27,72 @@ syscall_undefined(uint32_t no)
     printk("WARNING: undefined systemcall %d\n", no);
 }
 
-static int
-__verify_buffer(uint32_t start, size_t sz)
+/*
+ * copy_array_from_user - copy a NULL terminated array of strings in
+ *
+ * @ptr - the user array
+ * @max - unused
+ *
+ * Returns an array allocated as one block with the strings after it,
+ * free it with free_copied_array(), or an ERR_PTR.
+ */
+char **
+copy_array_from_user(char **ptr, int max)
 {
-    int i;
-
-    //printk("%s: start 0x%x sz %d\n", __func__, start, sz);
-
-    /* is the buffer a valid user address? */
-    if (start > VIRT_BASE || start + sz > VIRT_BASE) {
-        //printk("Case KERN\n");
-        return 1;
-    }
-
-    /* if a null pointer or looks like one then bail */
-    if (start < 4096) {
-        //printk("Case NULL\n");
-        return 1;
-    }
+    int c, i, len = 0, sofar = 0, rc = 0;
+    char *buf, *str, **arr, **tmp = NULL;
 
-    if (start % 0x1000 == 0) {
-        //printk("Case 1\n");
-        /* we are on a page boundary, should be easy to check */
-        for (i = 0; i < sz; i += 0x1000) {
-            if (!page_mapped_curr(start + i))
-                return 1;
+    for (c = 0; ; c ++) {
+        if (copy_from_user(&str, &ptr[c], sizeof(str))) {
+            rc = -EFAULT;
+            goto out;
         }
-    } else {
-        /* first, check if the size concerns the next page */
-        uint32_t this_page = PG_RND_DOWN(start);
-        uint32_t next_page = PG_RND_DOWN(start + sz);
-        //printk("Case 2 this: 0x%x next: 0x%x\n", this_page, next_page);
-
-        /* the buffer is as a whole on the same page */
-        if (this_page == next_page) {
-            //printk("Case 2.1\n");
-            if (page_mapped_curr(start)) {
-                //printk("Case 2.1.T\n");
-                return 0;
-            }
-            //printk("Case 2.1.F\n");
-            return 1;
-        } else {
-            //printk("Case 2.2");
-            /* check the next pages */
-            for (i = 0; i < sz; i += 0x1000) {
-                if (!page_mapped_curr(start + i)) {
-             //       printk("Case 2.2.F");
-                    return 1;
-                }
-            }
-            //printk("Case 2.2.T");
-            return 0;
-        }
-    }
-
-    /* all done, the buffer is valid */
-    return 0;
-}
-
-static int
-verify_buffer(void *p, size_t sz)
-{
-    if (p > VIRT_BASE || p + sz > VIRT_BASE)
-        return 1;
-    vma_try_prefault(current_task, p, sz);
-    return __verify_buffer((uint32_t) p, sz);
-}
-
-int
-verify_buffer_string(char *string, int max)
-{
-    int i;
-    char c;
-    char *p = (char *)string;
-
-    /* First check if the whole buffer would fit anyway */
-    if (verify_buffer(string, max) == 0)
-        return 0;
 
-    /* check if the first byte is valid */
-    if (verify_buffer(string, 0) != 0)
-        return 1;
+        if (!str)
+            break;
 
-    /*
-     * the whole buffer doesnt fit, check byte-by-byte until a zero
-     * byte is found
-     */
-    for (i = 0; i < max; i ++) {
-        c = p[i];
+        arr = realloc(tmp, (c + 1) * sizeof(char *));
+        if (!arr) {
+            rc = -ENOMEM;
+            goto out;
+        }
+        tmp = arr;
 
-        /* found end, good to go */
-        if (c == 0)
-            return 0;
+        tmp[c] = strndup_user(str, PATH_MAX);
+        if (IS_ERR(tmp[c])) {
+            rc = PTR_ERR(tmp[c]);
+            goto out;
+        }
 
-        /* verify that the next access is correct */
-        if (verify_buffer(&p[i+1], 0) != 0)
-            return 1;
+        len += strlen(tmp[c]) + 1;
     }
 
-    /* overflowed the max */
-    return 1;
-}
-
-char **
-copy_array_from_user(char **ptr, int max)
-{
-    int c = 0, i = 0;
-    int len = 0, sofar = 0;
-    char *buf = NULL;
-    char **arr = NULL;
-
-    /* FIXME: proper check */
-
-    for (c = 0; ptr[c] != NULL; c ++)
-        len += strlen(ptr[c]) + 2;
-
-    //printk("%s total len %d\n", __func__, len);
-
-    buf = malloc(len);
-    if (!buf)
-        return ERR_PTR(-ENOMEM);
+    buf = malloc(len + 1);
+    if (!buf) {
+        rc = -ENOMEM;
+        goto out;
+    }
 
     arr = malloc((c + 1) * sizeof(uintptr_t));
     if (!arr) {
         free(buf);
-        return ERR_PTR(-ENOMEM);
+        rc = -ENOMEM;
+        goto out;
     }
     memset(arr, 0, (c + 1) * sizeof(uintptr_t));
 
     for (i = 0; i < c; i ++) {
-        memcpy(buf + sofar, ptr[i], strlen(ptr[i]) + 1);
-        //printk("buf+sofar(%d) is %s\n", sofar, buf + sofar);
+        memcpy(buf + sofar, tmp[i], strlen(tmp[i]) + 1);
         arr[i] = buf + sofar;
-        sofar += strlen(ptr[i]) + 1;
+        sofar += strlen(tmp[i]) + 1;
     }
 
-    return arr;
+out:
+    for (i = 0; i < c; i ++)
+        free(tmp[i]);
+    free(tmp);
+
+    return rc ? ERR_PTR(rc) : arr;
 }
 
 void
@@ -168,18 +104,15 @@ free_copied_array(char **arr)
 
 
 static int
-sys_open(char *__filename, int flags, int mode)
+do_open(char *__filename, int flags, int mode)
 {
     struct file *f;
     struct task *task = current_task;
     char *filename, *full_filename;
-    int i, need_free = 0;
+    int fd, need_free = 0;
 
     //printk("%s\n", __func__);
 
-    if (verify_buffer_string(__filename, PATH_MAX))
-        return -EFAULT;
-
     if (flags & ~(O_TRUNC | O_NOCTTY | O_CLOEXEC | O_CREAT | O_WRONLY | O_RDWR | O_EXCL))
         printk("pid %d: unsupported openflag detected in 0x%x isol: 0x%x\n",
                 current_task->pid, flags,
@@ -191,7 +124,6 @@ sys_open(char *__filename, int flags, int mode)
             flags & O_WRONLY == 0)
         return -EINVAL;
 
-    /* can I derefence this? fixme */
     if (__filename[0] != '/') {
         filename = __canonicalize_path(current_task->cwd, __filename);
         need_free = 1;
@@ -267,41 +199,48 @@ xc:
                     current_task->ctty->tty_id);
         }
 
-    for (i = 0; i < FD_MAX; i ++) {
-        if (task->file_table[i] == NULL) {
-            task->file_table[i] = f;
-            //f->full_path = full_filename;
-            free(full_filename); /* todo: figure this out */
-            if (need_free) free(filename);
-            //printk("%s r6: fd %d\n", __func__, i);
-            return i;
-        }
-    }
-    
+    fd = fd_alloc(task, f, 0);
+    if (fd < 0)
+        vfs_close(f);
+
+    //f->full_path = full_filename;
+    free(full_filename); /* todo: figure this out */
     if (need_free) free(filename);
-    //printk("%s r5: %s\n", __func__, errno_to_string(-EMFILE));
-    return -EMFILE;
+    //printk("%s r6: fd %d\n", __func__, fd);
+    return fd;
+}
+
+static int
+sys_open(char *u_filename, int flags, int mode)
+{
+    char *filename = strndup_user(u_filename, PATH_MAX);
+    int rc;
+
+    if (IS_ERR(filename))
+        return PTR_ERR(filename);
+
+    rc = do_open(filename, flags, mode);
+    free(filename);
+
+    return rc;
 }
 
 static int
 do_close(int fd)
 {
-    struct file *f = current_task->file_table[fd];
+    struct file *f = fd_remove(current_task, fd);
+
+    if (!f)
+        return -EBADF;
+
     //printk("%s: fd %d refc %d\n", __func__, fd, f->refc);
     vfs_close(f);
-    current_task->file_table[fd] = NULL;
     return 0;
 }
 
 static int
 sys_close(int fd)
 {
-    if (fd < 0 || fd >= FD_MAX)
-        return -EBADF;
-
-    if (!current_task->file_table[fd])
-        return -EBADF;
-
     return do_close(fd);
 }
 
@@ -312,29 +251,32 @@ sys_getpid(void)
 }
 
 static int
-sys_stat(char *__fn, struct stat *st)
+sys_stat(char *u_fn, struct stat *st)
 {
-    char *fn, need_free = 0;
+    char *__fn, *fn, need_free = 0;
+    struct stat kst;
     int rc;
 
-    if (verify_buffer_string(__fn, PATH_MAX))
-        return -EFAULT;
-
-    if (verify_buffer(st, sizeof(*st)))
-        return -EFAULT;
+    __fn = strndup_user(u_fn, PATH_MAX);
+    if (IS_ERR(__fn))
+        return PTR_ERR(__fn);
 
     if (__fn[0] != '/') {
         fn =  __canonicalize_path(current_task->cwd, __fn);
         need_free = 1;
     } else fn = __fn;
 
-    memset(st, 0, sizeof(*st));
+    memset(&kst, 0, sizeof(kst));
 
     //printk("%s: canonical filename: %s\n", __func__, fn);
 
-    rc = vfs_stat(fn, st);
+    rc = vfs_stat(fn, &kst);
     if (need_free)
         free(fn);
+    free(__fn);
+
+    if (rc == 0 && copy_to_user(st, &kst, sizeof(kst)))
+        return -EFAULT;
 
     return rc;
 }
@@ -343,18 +285,14 @@ static int
 sys_fstat(int fd, struct stat *st)
 {
     struct file *f;
+    struct stat kst;
+    int rc;
 
-    if (fd < 0 || fd >= FD_MAX)
-        return -EBADF;
-
-    if (verify_buffer(st, sizeof(*st)))
-        return -EFAULT;
-
-    f = current_task->file_table[fd];
+    f = fd_lookup(current_task, fd);
     if (!f)
             return -EBADF;
 
-    memset(st, 0, sizeof(*st));
+    memset(&kst, 0, sizeof(kst));
 
     /*
     printk("well fops is at 0x%x\n", f->fops);
@@ -364,7 +302,11 @@ sys_fstat(int fd, struct stat *st)
         printk("doesnt have a full_path so the fops is at 0x%x\n", f->fops);
     }*/
 
-    return f->fops->fstat(f, st);
+    rc = f->fops->fstat(f, &kst);
+    if (rc == 0 && copy_to_user(st, &kst, sizeof(kst)))
+        return -EFAULT;
+
+    return rc;
 }
 
 static int
@@ -373,14 +315,9 @@ sys_execve(char *fn, char **u_argvp, char **u_envp)
     int rc = 0;
     char **argvp, **envp;
 
-    if (verify_buffer_string(fn, PATH_MAX))
-        return -EFAULT;
-
-    char *kfn = malloc(strlen(fn) + 1);
-    if (!kfn)
-        return -ENOMEM;
-    memset(kfn, 0, strlen(fn) + 1);
-    memcpy(kfn, fn, strlen(fn));
+    char *kfn = strndup_user(fn, PATH_MAX);
+    if (IS_ERR(kfn))
+        return PTR_ERR(kfn);
 
     char *full_path = __canonicalize_path(current_task->cwd, kfn);
     free(kfn);
@@ -396,16 +333,16 @@ sys_execve(char *fn, char **u_argvp, char **u_envp)
     __flush_tlb();
 
     argvp = copy_array_from_user(u_argvp, ARGS_MAX);
-    if (IS_ERR(argvp) && PTR_ERR(argvp) == -EFAULT) {
+    if (IS_ERR(argvp)) {
         free(kfn);
-        return -EFAULT;
+        return PTR_ERR(argvp);
     }
 
     envp = copy_array_from_user(u_envp, ENVS_MAX);
-    if (IS_ERR(envp) && PTR_ERR(envp) == -EFAULT) {
+    if (IS_ERR(envp)) {
         free_copied_array(argvp);
         free(kfn);
-        return -EFAULT;
+        return PTR_ERR(envp);
     }
 
     //printk("EXECVE %d: FULL_PATH %s KFN %s\n", current_task->pid, f->full_path, kfn);
@@ -464,7 +401,7 @@ sys_exit(int err_code)
     current_task->owner->exit_code = err_code;
     current_task->owner->status = TASK_EXITED;
     extern int __task_need_cleanup;
-    __task_need_cleanup ++;
+    __sync_fetch_and_add(&__task_need_cleanup, 1);
     //printk("pid %d(%s) exited with exit code %d\n", current_task->pid, current_task->comm, err_code);
     sched_yield();
     __not_reached();
@@ -475,10 +412,7 @@ sys_write(int fd, char *buf, size_t count)
 {
     struct file *f;
 
-    if (fd < 0 || fd >= FD_MAX)
-        return -EBADF;
-
-    f = current_task->file_table[fd];
+    f = fd_lookup(current_task, fd);
     if (!f)
         return -EBADF;
 
@@ -488,7 +422,8 @@ sys_write(int fd, char *buf, size_t count)
     if (count == 0)
         return 0;
 
-    if (verify_buffer(buf, count))
+    /* the file operations access BUF directly */
+    if (fault_in_readable(buf, count))
         return -EFAULT;
 
     return f->fops->write(f, buf, count);
@@ -522,10 +457,130 @@ sys_read(int fd, char *buf, size_t count)
 {
     struct file *f;
 
-    if (fd < 0 || fd >= FD_MAX)
+    f = fd_lookup(current_task, fd);
+    if (!f)
         return -EBADF;
 
-    f = current_task->file_table[fd];
+    if (f->isdir)
+        return -EISDIR;
+
+    if (count == 0)
+        return 0;
+
+    /* the file operations access BUF directly */
+    if (fault_in_writeable(buf, count))
+        return -EFAULT;
+
+    return f->fops->read(f, buf, count);
+}
+
+/*
+ * Copy an iovec array in from userspace, into FAST if it fits there.
+ * Each segment is faulted in, like the buffer of a plain read or write.
+ * Returns the array, which the caller frees if it is not FAST, or an
+ * ERR_PTR.
+ */
+static struct iovec *
+iovec_from_user(struct iovec *uiov, int cnt, struct iovec *fast, int writing)
+{
+    struct iovec *iov = fast;
+    size_t total = 0;
+    int i, rc = 0;
+
+    if (cnt < 0 || cnt > IOV_MAX)
+        return ERR_PTR(-EINVAL);
+
+    if (cnt > UIO_FASTIOV) {
+        iov = malloc(cnt * sizeof(*iov));
+        if (!iov)
+            return ERR_PTR(-ENOMEM);
+    }
+
+    if (copy_from_user(iov, uiov, cnt * sizeof(*iov))) {
+        rc = -EFAULT;
+        goto fail;
+    }
+
+    for (i = 0; i < cnt; i ++) {
+        /* the total has to fit the return value */
+        if (iov[i].iov_len > 0x7fffffff - total) {
+            rc = -EINVAL;
+            goto fail;
+        }
+        total += iov[i].iov_len;
+
+        if (writing)
+            rc = fault_in_writeable(iov[i].iov_base, iov[i].iov_len);
+        else
+            rc = fault_in_readable(iov[i].iov_base, iov[i].iov_len);
+        if (rc)
+            goto fail;
+    }
+
+    return iov;
+
+fail:
+    if (iov != fast)
+        free(iov);
+    return ERR_PTR(rc);
+}
+
+static int
+sys_readv(int fd, struct iovec *uiov, int cnt)
+{
+    struct iovec fast[UIO_FASTIOV], *iov;
+    struct file *f;
+    int rc;
+
+    f = fd_lookup(current_task, fd);
+    if (!f)
+        return -EBADF;
+
+    if (f->isdir)
+        return -EISDIR;
+
+    iov = iovec_from_user(uiov, cnt, fast, 1);
+    if (IS_ERR(iov))
+        return PTR_ERR(iov);
+
+    rc = vfs_readv(f, iov, cnt);
+    if (iov != fast)
+        free(iov);
+
+    return rc;
+}
+
+static int
+sys_writev(int fd, struct iovec *uiov, int cnt)
+{
+    struct iovec fast[UIO_FASTIOV], *iov;
+    struct file *f;
+    int rc;
+
+    f = fd_lookup(current_task, fd);
+    if (!f)
+        return -EBADF;
+
+    if (f->isdir)
+        return -EISDIR;
+
+    iov = iovec_from_user(uiov, cnt, fast, 0);
+    if (IS_ERR(iov))
+        return PTR_ERR(iov);
+
+    rc = vfs_writev(f, iov, cnt);
+    if (iov != fast)
+        free(iov);
+
+    return rc;
+}
+
+static int
+sys_pread(int fd, char *buf, size_t count, int pos)
+{
+    struct file *f;
+
+    f = fd_lookup(current_task, fd);
     if (!f)
         return -EBADF;
 
@@ -535,16 +590,342 @@ sys_read(int fd, char *buf, size_t count)
     if (count == 0)
         return 0;
 
-    if (verify_buffer(buf, count))
+    if (fault_in_writeable(buf, count))
         return -EFAULT;
 
-    return f->fops->read(f, buf, count);
+    return vfs_pread(f, buf, count, pos);
+}
+
+static int
+sys_pwrite(int fd, char *buf, size_t count, int pos)
+{
+    struct file *f;
+
+    f = fd_lookup(current_task, fd);
+    if (!f)
+        return -EBADF;
+
+    if (f->isdir)
+        return -EISDIR;
+
+    if (count == 0)
+        return 0;
+
+    if (fault_in_readable(buf, count))
+        return -EFAULT;
+
+    return vfs_pwrite(f, buf, count, pos);
+}
+
+static int
+sys_poll(struct pollfd *ufds, unsigned int nfds, int timeout)
+{
+    struct pollfd *fds;
+    int rc;
+
+    /* there can't be more distinct ones than this */
+    if (nfds > FD_MAX)
+        return -EINVAL;
+
+    fds = malloc((nfds ? nfds : 1) * sizeof(*fds));
+    if (!fds)
+        return -ENOMEM;
+
+    if (copy_from_user(fds, ufds, nfds * sizeof(*fds))) {
+        free(fds);
+        return -EFAULT;
+    }
+
+    rc = do_poll(fds, nfds, timeout);
+    if (rc >= 0 && copy_to_user(ufds, fds, nfds * sizeof(*fds)))
+        rc = -EFAULT;
+
+    free(fds);
+    return rc;
+}
+
+/* the old select(2), that takes its arguments in memory */
+struct sel_arg_struct {
+    int n;
+    uint32_t *inp;
+    uint32_t *outp;
+    uint32_t *exp;
+    struct user_timeval *tvp;
+};
+
+static int
+sys_select(struct sel_arg_struct *u_arg)
+{
+    struct sel_arg_struct arg;
+    uint32_t sets[3][(FD_MAX + 31) / 32];
+    uint32_t *usets[3], *ksets[3];
+    struct user_timeval tv;
+    int i, n, len, timeout = -1, rc;
+
+    if (copy_from_user(&arg, u_arg, sizeof(arg)))
+        return -EFAULT;
+
+    if (arg.n < 0)
+        return -EINVAL;
+
+    /* only the bits of descriptors that can exist are looked at */
+    n = arg.n > FD_MAX ? FD_MAX : arg.n;
+    len = (n + 31) / 32 * sizeof(uint32_t);
+
+    usets[0] = arg.inp;
+    usets[1] = arg.outp;
+    usets[2] = arg.exp;
+    for (i = 0; i < 3; i ++) {
+        ksets[i] = usets[i] ? sets[i] : NULL;
+        if (usets[i] && copy_from_user(sets[i], usets[i], len))
+            return -EFAULT;
+    }
+
+    if (arg.tvp) {
+        if (copy_from_user(&tv, arg.tvp, sizeof(tv)))
+            return -EFAULT;
+
+        if (tv.tv_sec < 0 || tv.tv_usec < 0 || tv.tv_usec >= 1000000)
+            return -EINVAL;
+
+        if (tv.tv_sec >= 0x7fffffff / 1000)
+            timeout = 0x7fffffff;
+        else
+            timeout = (uint32_t) tv.tv_sec * 1000 +
+                        ((uint32_t) tv.tv_usec + 999) / 1000;
+    }
+
+    rc = do_select(n, ksets[0], ksets[1], ksets[2], timeout);
+    if (rc < 0)
+        return rc;
+
+    for (i = 0; i < 3; i ++)
+        if (usets[i] && copy_to_user(usets[i], sets[i], len))
+            return -EFAULT;
+
+    return rc;
+}
+
+static int
+sys_epoll_create(int size)
+{
+    struct file *filp;
+    int fd;
+
+    if (size <= 0)
+        return -EINVAL;
+
+    filp = eventpoll_create();
+    if (IS_ERR(filp))
+        return PTR_ERR(filp);
+
+    fd = fd_alloc(current_task, filp, 0);
+    if (fd < 0)
+        vfs_close(filp);
+
+    return fd;
+}
+
+static int
+sys_epoll_ctl(int epfd, int op, int fd, struct epoll_event *uevent)
+{
+    struct epoll_event event;
+    struct file *epf, *f;
+
+    epf = fd_lookup(current_task, epfd);
+    f = fd_lookup(current_task, fd);
+    if (!epf || !f)
+        return -EBADF;
+
+    if (!is_eventpoll_file(epf) || epf == f)
+        return -EINVAL;
+
+    if (op != EPOLL_CTL_DEL &&
+            copy_from_user(&event, uevent, sizeof(event)))
+        return -EFAULT;
+
+    return eventpoll_ctl(epf, op, fd, f, &event);
+}
+
+static int
+sys_epoll_wait(int epfd, struct epoll_event *uevents, int maxevents,
+               int timeout)
+{
+    struct epoll_event *events;
+    struct file *epf;
+    int rc;
+
+    epf = fd_lookup(current_task, epfd);
+    if (!epf)
+        return -EBADF;
+
+    if (!is_eventpoll_file(epf) || maxevents <= 0)
+        return -EINVAL;
+
+    /* returning fewer than asked for is fine, they stay ready */
+    if (maxevents > EP_MAX_BATCH)
+        maxevents = EP_MAX_BATCH;
+
+    if (fault_in_writeable(uevents, maxevents * sizeof(*events)))
+        return -EFAULT;
+
+    events = malloc(maxevents * sizeof(*events));
+    if (!events)
+        return -ENOMEM;
+
+    rc = eventpoll_wait(epf, events, maxevents, timeout);
+    if (rc > 0 && copy_to_user(uevents, events, rc * sizeof(*events)))
+        rc = -EFAULT;
+
+    free(events);
+    return rc;
+}
+
+static int
+sys_fsync(int fd)
+{
+    struct file *f;
+
+    f = fd_lookup(current_task, fd);
+    if (!f)
+        return -EBADF;
+
+    return vfs_fsync(f);
+}
+
+/*
+ * sys_sendfile - copy COUNT bytes from IN_FD to OUT_FD in the kernel
+ *
+ * If OFFSET is set IN_FD is read from there, its file position is left
+ * alone and OFFSET is moved past what was sent.
+ */
+static int
+sys_sendfile(int out_fd, int in_fd, int *offset, size_t count)
+{
+    struct file *in, *out;
+    int off, rc;
+
+    in = fd_lookup(current_task, in_fd);
+    out = fd_lookup(current_task, out_fd);
+    if (!in || !out)
+        return -EBADF;
+
+    if (!offset)
+        return vfs_splice(in, NULL, out, count);
+
+    if (copy_from_user(&off, offset, sizeof(off)))
+        return -EFAULT;
+
+    if (off < 0)
+        return -EINVAL;
+
+    rc = vfs_splice(in, &off, out, count);
+
+    if (copy_to_user(offset, &off, sizeof(off)))
+        return -EFAULT;
+
+    return rc;
+}
+
+/* the SPLICE_F_* flags, they are only hints */
+#define SPLICE_F_ALL 0x0f
+
+/*
+ * sys_splice - move LEN bytes between FD_IN and FD_OUT, one of them a pipe
+ *
+ * Both ends are used at their file positions, there's no room for the
+ * offsets of Linux in the four arguments we get.
+ */
+static int
+sys_splice(int fd_in, int fd_out, size_t len, unsigned int flags)
+{
+    struct file *in, *out;
+
+    if (flags & ~SPLICE_F_ALL)
+        return -EINVAL;
+
+    in = fd_lookup(current_task, fd_in);
+    out = fd_lookup(current_task, fd_out);
+    if (!in || !out)
+        return -EBADF;
+
+    if (in->type != FILE_TYPE_PIPE && out->type != FILE_TYPE_PIPE)
+        return -EINVAL;
+
+    /* both ends of the same pipe */
+    if (in->type == FILE_TYPE_PIPE && in->priv == out->priv)
+        return -EINVAL;
+
+    return vfs_splice(in, NULL, out, len);
+}
+
+/*
+ * sys_prctl - per-process knobs
+ *
+ * Only our own for now, PR_SET_SYSCALL_STATS and PR_SET_SYSCALL_TRACE,
+ * see include/levos/sysstat.h.
+ */
+static int
+sys_prctl(int option, unsigned long arg2, unsigned long arg3, unsigned long arg4)
+{
+    switch (option) {
+        case PR_SET_SYSCALL_STATS:
+            return sysstat_task_set(current_task, SYSSTAT_TASK, !!arg2);
+        case PR_SET_SYSCALL_TRACE:
+            return sysstat_task_set(current_task, SYSSTAT_TRACE, !!arg2);
+    }
+
+    return -EINVAL;
+}
+
+static int
+sys_io_uring_setup(unsigned int entries, struct io_uring_params *up)
+{
+    struct io_uring_params p;
+    struct file *filp;
+    int fd;
+
+    if (copy_from_user(&p, up, sizeof(p)))
+        return -EFAULT;
+
+    p.sq_entries = entries;
+
+    filp = io_uring_create(&p);
+    if (IS_ERR(filp))
+        return PTR_ERR(filp);
+
+    if (copy_to_user(up, &p, sizeof(p))) {
+        vfs_close(filp);
+        return -EFAULT;
+    }
+
+    fd = fd_alloc(current_task, filp, 0);
+    if (fd < 0)
+        vfs_close(filp);
+
+    return fd;
+}
+
+static int
+sys_io_uring_enter(int fd, unsigned int to_submit, unsigned int min_complete,
+                   unsigned int flags)
+{
+    struct file *f;
+
+    f = fd_lookup(current_task, fd);
+    if (!f)
+        return -EBADF;
+
+    if (!is_io_uring_file(f))
+        return -EINVAL;
+
+    return io_uring_enter(f, to_submit, min_complete, flags);
 }
 
 int
 sys_uname(struct uname *un)
 {
-    if (verify_buffer(un, sizeof(*un)))
+    if (fault_in_writeable(un, sizeof(*un)))
         return -EFAULT;
 
     do_uname(un);
@@ -557,7 +938,7 @@ sys_uname(struct uname *un)
 int
 sys_socket(int domain, int family, int proto)
 {
-    int i;
+    int fd;
     struct socket *sock;
     struct file *filp;
 
@@ -571,14 +952,11 @@ sys_socket(int domain, int family, int proto)
         return -ENOMEM;
     }
 
-    for (i = 0; i < FD_MAX; i ++) {
-        if (current_task->file_table[i] == NULL) {
-            current_task->file_table[i] = filp;
-            return i;
-        }
-    }
+    fd = fd_alloc(current_task, filp, 0);
+    if (fd < 0)
+        vfs_close(filp);
 
-    return -EMFILE;
+    return fd;
 }
 
 int
@@ -587,17 +965,14 @@ sys_connect(int sockfd, void *sockaddr, size_t len)
     struct file *f;
     struct socket *sock;
 
-    if (sockfd < 0 || sockfd >= FD_MAX)
-        return -EBADF;
-
-    f = current_task->file_table[sockfd];
+    f = fd_lookup(current_task, sockfd);
     if (!f)
         return -EBADF;
 
     if (f->type != FILE_TYPE_SOCKET)
         return -ENOTSOCK;
 
-    if (verify_buffer(sockaddr, len))
+    if (fault_in_readable(sockaddr, len))
         return -EFAULT;
 
     sock = f->priv;
@@ -610,7 +985,8 @@ sys_waitpid(pid_t pid, int *wstatus, int opts)
 {
     struct process *target;
 
-    if (verify_buffer(wstatus, sizeof(int)))
+    /* stored to directly, from deep in the wait */
+    if (fault_in_writeable(wstatus, sizeof(int)))
         return -EFAULT;
 
     /* TODO: support the opts field */
@@ -641,9 +1017,10 @@ retry:
                                     " or exited\n");
                     }
                 }
+                pid = proc->pid;
                 list_remove(&proc->elem);
                 process_destroy(proc);
-                return proc->pid;
+                return pid;
             }
         }
 
@@ -705,10 +1082,7 @@ sys_lseek(int fd, size_t off, int whence)
 {
     struct file *f;
 
-    if (fd < 0 || fd >= FD_MAX)
-        return -EBADF;
-
-    f = current_task->file_table[fd];
+    f = fd_lookup(current_task, fd);
     if (!f)
         return -EBADF;
 
@@ -734,24 +1108,18 @@ int
 sys_dup(int fd)
 {
     struct file *f;
-    int i;
-
-    if (fd < 0 || fd >= FD_MAX)
-        return -EBADF;
+    int rc;
 
-    f = current_task->file_table[fd];
+    f = fd_lookup(current_task, fd);
     if (!f)
         return -EBADF;
 
-    for (i = 0; i < FD_MAX; i ++) {
-        if (current_task->file_table[i] == NULL) {
-            current_task->file_table[i] = f;
-            vfs_inc_refc(f);
-            return i;
-        }
-    }
+    vfs_inc_refc(f);
+    rc = fd_alloc(current_task, f, 0);
+    if (rc < 0)
+        vfs_close(f);
 
-    return -EMFILE;
+    return rc;
 }
 
 int
@@ -759,29 +1127,28 @@ sys_dup2(int fd, int to)
 {
     struct file *f, *f2;
 
-    if (fd < 0 || fd >= FD_MAX)
+    if (to < 0 || to >= FD_MAX)
         return -EBADF;
 
-    if (to < 0 || to >= FD_MAX)
+    f = fd_lookup(current_task, fd);
+    if (!f)
         return -EBADF;
 
     if (fd == to)
         return to;
 
-    f = current_task->file_table[fd];
-    if (!f)
-        return -EBADF;
-
-    f2 = current_task->file_table[to];
-    if (f2)
-        do_close(to);
+    vfs_inc_refc(f);
 
-    current_task->file_table[to] = f;
+    /* this clears FD_CLOEXEC */
+    f2 = fd_install(current_task, to, f);
+    if (IS_ERR(f2)) {
+        vfs_close(f);
+        return PTR_ERR(f2);
+    }
 
-    /* clear FD_CLOEXEC */
-    current_task->file_table_flags[to] = 0;
+    if (f2)
+        vfs_close(f2);
 
-    vfs_inc_refc(f);
     return to;
 }
 
@@ -790,20 +1157,41 @@ sys_readdir(int fd, struct linux_dirent *buf, int count)
 {
     struct file *f;
 
-    if (fd < 0 || fd >= FD_MAX)
+    f = fd_lookup(current_task, fd);
+    if (!f)
         return -EBADF;
 
-    f = current_task->file_table[fd];
+    if (!f->isdir)
+        return -ENOTDIR;
+
+    if (fault_in_writeable(buf, sizeof(struct linux_dirent)))
+        return -EFAULT;
+
+    return f->fops->readdir(f, buf);
+}
+
+/*
+ * sys_getdents - read the entries of the directory FD into BUF
+ *
+ * As many packed struct getdents_dirent records as fit in COUNT bytes,
+ * rather than one per call like readdir.
+ */
+static int
+sys_getdents(int fd, void *buf, unsigned int count)
+{
+    struct file *f;
+
+    f = fd_lookup(current_task, fd);
     if (!f)
         return -EBADF;
 
     if (!f->isdir)
         return -ENOTDIR;
 
-    if (verify_buffer(buf, sizeof(struct linux_dirent)))
+    if (fault_in_writeable(buf, count))
         return -EFAULT;
 
-    return f->fops->readdir(f, buf);
+    return vfs_getdents(f, buf, count);
 }
 
 sighandler_t
@@ -829,12 +1217,8 @@ sys_signal(int signum, sighandler_t handler)
 int
 sys_kill(int pid, int sig)
 {
-    if (sig == 0) {
-        struct task *task = get_task_for_pid(pid);
-        if (task)
-            return 0;
-        return -ESRCH;
-    }
+    if (sig == 0)
+        return get_task_for_pid(pid) ? 0 : -ESRCH;
 
     if (sig < MIN_SIG || sig > MAX_SIG)
         return -EINVAL;
@@ -845,8 +1229,18 @@ sys_kill(int pid, int sig)
     }
 
     if (pid > 0) {
-        struct task *task = get_task_for_pid(pid);
+        struct task *task;
+
+        rcu_read_lock();
+        task = get_task_for_pid(pid);
+        if (task == current_task) {
+            /* this reschedules, it is us so we don't go away */
+            rcu_read_unlock();
+            send_signal(task, sig);
+            return 0;
+        }
         send_signal(task, sig);
+        rcu_read_unlock();
         return 0;
     }
 
@@ -874,8 +1268,8 @@ sys_setsid(void)
     if (current_task->pg_leader)
         return -EPERM;
 
-    current_task->sid = current_task->pid;
-    current_task->pgid = current_task->pid;
+    task_set_session(current_task, current_task->pid);
+    task_set_pgrp(current_task, current_task->pid);
     current_task->pg_leader = NULL;
 
     return current_task->pid;
@@ -895,38 +1289,51 @@ sys_setpgid(pid_t pid, pid_t pgid)
     if (pgid == 0)
         pgid = pid;
 
+    rcu_read_lock();
+
     pg_leader = get_task_for_pid(pgid);
     /* err, this is not mentioned by POSIX, but this seems
      * like the thing to do?
      */
     if (!pg_leader)
-        return -ESRCH;
+        goto out_srch;
 
     task = get_task_for_pid(pid);
     if (!task)
-        return -ESRCH;
+        goto out_srch;
 
     /* if we are moving a task, then it must match the session ids */
     if (task->pgid != pgid &&
-            task->sid != pg_leader->sid)
+            task->sid != pg_leader->sid) {
+        rcu_read_unlock();
         return -EPERM;
+    }
 
-    task->pgid = pgid;
+    task_set_pgrp(task, pgid);
+    rcu_read_unlock();
     return 0;
+
+out_srch:
+    rcu_read_unlock();
+    return -ESRCH;
 }
 
 int
 sys_getpgid(pid_t pid)
 {
     struct task *task;
+    int pgid = -ESRCH;
+
     if (pid == 0)
         return current_task->pgid;
 
+    rcu_read_lock();
     task = get_task_for_pid(pid);
     if (task)
-        return task->pgid;
+        pgid = task->pgid;
+    rcu_read_unlock();
 
-    return -ESRCH;
+    return pgid;
 }
 
 int
@@ -934,10 +1341,7 @@ sys_ioctl(int fd, int cmd, int arg)
 {
     struct file *f;
 
-    if (fd < 0 || fd >= FD_MAX)
-        return -EBADF;
-
-    f = current_task->file_table[fd];
+    f = fd_lookup(current_task, fd);
     if (!f)
         return -EBADF;
 
@@ -950,33 +1354,21 @@ sys_ioctl(int fd, int cmd, int arg)
 int
 sys_pipe(int *fildes)
 {
-    int i, spc = 0;
     int kfds[2] = { -1, -1 };
     int rc;
 
-    if (verify_buffer(fildes, sizeof(int) * 2))
+    if (!access_ok(fildes, sizeof(kfds)))
         return -EFAULT;
 
-    /* check if there is enough space in the file_table */
-    for (i = 0; i < FD_MAX; i ++)
-        if (current_task->file_table[i] == NULL) {
-            if (kfds[0] == -1) {
-                kfds[0] = i;
-            } else if (kfds[1] == -1) {
-                kfds[1] = i;
-                break;
-            }
-        }
-
-    if (kfds[0] == -1 || kfds[1] == -1)
-        return -EMFILE;
-
     rc = do_pipe(current_task, kfds);
     if (rc)
         return rc;
 
-    fildes[0] = kfds[0];
-    fildes[1] = kfds[1];
+    if (copy_to_user(fildes, kfds, sizeof(kfds))) {
+        do_close(kfds[0]);
+        do_close(kfds[1]);
+        return -EFAULT;
+    }
 
     return 0;
 }
@@ -984,20 +1376,12 @@ sys_pipe(int *fildes)
 int
 sys_chdir(char *fn)
 {
-    int len;
     char *kbuf;
     char *ptr;
 
-    if (verify_buffer_string(fn, PATH_MAX))
-        return -EFAULT;
-
-    len = strlen(fn);
-    kbuf = malloc(len + 1);
-    if (!kbuf)
-        return -ENOMEM;
-
-    memset(kbuf, 0, len + 1);
-    memcpy(kbuf, fn, len);
+    kbuf = strndup_user(fn, PATH_MAX);
+    if (IS_ERR(kbuf))
+        return PTR_ERR(kbuf);
 
     ptr = canonicalize_path(current_task->cwd, kbuf);
     if (IS_ERR(ptr)) {
@@ -1078,49 +1462,35 @@ sys_getcwd(char *buf, unsigned long size)
     if (!size || !buf)
         return -EINVAL;
 
-    if (verify_buffer(buf, size))
-        return -EFAULT;
-
     if ((strlen(current_task->cwd) + 1) > size)
         return -ERANGE;
 
-    memset(buf, 0, size);
-
-    memcpy(buf, current_task->cwd, strlen(current_task->cwd));
-
-    return 0;
+    return copy_to_user(buf, current_task->cwd, strlen(current_task->cwd) + 1);
 }
 
 int
 sys_fcntl(int fd, unsigned long cmd, unsigned long arg)
 {
-    int i;
     struct file *f;
+    int rc;
 
-    if (fd < 0 || fd >= FD_MAX)
-        return -EBADF;
-
-    f = current_task->file_table[fd];
+    f = fd_lookup(current_task, fd);
     if (!f)
         return -EBADF;
 
     switch (cmd) {
         case F_DUPFD:
-            if (arg < 0 || arg >= FD_MAX)
+            if (arg >= FD_MAX)
                 return -EINVAL;
-            for (i = arg; i < FD_MAX; i ++) {
-                if (current_task->file_table[i] == NULL) {
-                    current_task->file_table[i] = current_task->file_table[fd];
-                    vfs_inc_refc(current_task->file_table[i]);
-                    return i;
-                }
-            }
-            return -EMFILE;
+            vfs_inc_refc(f);
+            rc = fd_alloc(current_task, f, arg);
+            if (rc < 0)
+                vfs_close(f);
+            return rc;
         case F_GETFD:
-            return current_task->file_table_flags[fd];
+            return fd_get_flags(current_task, fd);
         case F_SETFD:
-            current_task->file_table_flags[fd] |= arg;
-            return 0;
+            return fd_set_flags(current_task, fd, arg & FD_CLOEXEC);
     }
 
     printk("WARNING: Unimplement fnctl(2) cmd: %d with arg 0x%x\n", cmd, arg);
@@ -1134,7 +1504,7 @@ sys_sysconf(int req)
         return FD_MAX;
 
     if (req == 2)
-        return 100;
+        return USER_HZ;
 
     if (req == 8)
         return 4096;
@@ -1148,13 +1518,14 @@ sys_sysconf(int req)
 }
 
 int
-sys_mkdir(char *pathname, int mode)
+sys_mkdir(char *u_pathname, int mode)
 {
-    char *fn, need_free = 0;
+    char *pathname, *fn, need_free = 0;
     int rc;
 
-    if (verify_buffer_string(pathname, PATH_MAX))
-        return -EFAULT;
+    pathname = strndup_user(u_pathname, PATH_MAX);
+    if (IS_ERR(pathname))
+        return PTR_ERR(pathname);
 
     if (pathname[0] != '/') {
         fn =  __canonicalize_path(current_task->cwd, pathname);
@@ -1164,6 +1535,7 @@ sys_mkdir(char *pathname, int mode)
     rc = vfs_mkdir(fn, mode);
     if (need_free)
         free(fn);
+    free(pathname);
 
     return rc;
 }
@@ -1173,6 +1545,8 @@ __deliver_alarm(void *aux)
 {
     struct task *task = aux;
 
+    /* the work is freed once we return */
+    task->alarm_work = NULL;
     send_signal(task, SIGALRM);
 }
 
@@ -1192,9 +1566,15 @@ sys_alarm(int secs)
             rc = 1;
     }
 
+    current_task->alarm_work = NULL;
+
+    /* alarm(0) only cancels */
+    if (secs == 0)
+        return rc;
+
     struct work *work = work_create(__deliver_alarm, current_task);
 
-    schedule_work_delay(work, secs * 150);
+    queue_work_delay(system_highpri_wq, work, secs * 150);
 
     current_task->alarm_work = work;
 
@@ -1218,9 +1598,116 @@ sys_secsleep(int secs)
 }
 
 int
-sys_gettimeofday(struct timeval *tv, void *z)
+sys_gettimeofday(struct user_timeval *tv, void *z)
 {
-    return gettimeofday(tv, z);
+    struct user_timeval utv;
+    struct timeval ktv;
+    int rc;
+
+    rc = gettimeofday(&ktv, z);
+    if (rc)
+        return rc;
+
+    utv.tv_sec = ktv.tv_sec;
+    utv.tv_usec = ktv.tv_usec;
+
+    return copy_to_user(tv, &utv, sizeof(utv));
+}
+
+struct sched_param {
+    int sched_priority;
+};
+
+int
+sys_sched_setscheduler(pid_t pid, int policy, struct sched_param *param)
+{
+    struct sched_param kparam;
+    struct task *task;
+    int rc = -ESRCH;
+
+    /* before the lookup, this can fault */
+    if (copy_from_user(&kparam, param, sizeof(kparam)))
+        return -EFAULT;
+
+    rcu_read_lock();
+    task = pid ? get_task_for_pid(pid) : current_task;
+    if (task)
+        rc = sched_setscheduler(task, policy, kparam.sched_priority);
+    rcu_read_unlock();
+
+    return rc;
+}
+
+int
+sys_sched_getscheduler(pid_t pid)
+{
+    struct task *task;
+    int policy = -ESRCH;
+
+    rcu_read_lock();
+    task = pid ? get_task_for_pid(pid) : current_task;
+    if (task)
+        policy = task->policy;
+    rcu_read_unlock();
+
+    return policy;
+}
+
+int
+sys_sched_yield(void)
+{
+    sched_yield();
+    return 0;
+}
+
+int
+sys_times(struct tms *buf)
+{
+    extern uint32_t __pit_ticks;
+    struct sched_stats *st = &current_task->stats;
+
+    if (buf) {
+        struct tms ktms;
+
+        ktms.tms_utime = ticks_to_clock_t(st->ss_utime);
+        ktms.tms_stime = ticks_to_clock_t(st->ss_stime);
+        ktms.tms_cutime = ticks_to_clock_t(st->ss_cutime);
+        ktms.tms_cstime = ticks_to_clock_t(st->ss_cstime);
+
+        if (copy_to_user(buf, &ktms, sizeof(ktms)))
+            return -EFAULT;
+    }
+
+    return ticks_to_clock_t(__pit_ticks);
+}
+
+static void
+ticks_to_timeval(uint32_t ticks, struct user_timeval *tv)
+{
+    tv->tv_sec = ticks / HZ;
+    tv->tv_usec = (ticks % HZ) * (1000000 / HZ);
+}
+
+int
+sys_getrusage(int who, struct rusage *ru)
+{
+    struct sched_stats *st = &current_task->stats;
+    struct rusage kru;
+
+    memset(&kru, 0, sizeof(kru));
+
+    if (who == RUSAGE_SELF) {
+        ticks_to_timeval(st->ss_utime, &kru.ru_utime);
+        ticks_to_timeval(st->ss_stime, &kru.ru_stime);
+        kru.ru_nvcsw = st->ss_nvcsw;
+        kru.ru_nivcsw = st->ss_nivcsw;
+    } else if (who == RUSAGE_CHILDREN) {
+        ticks_to_timeval(st->ss_cutime, &kru.ru_utime);
+        ticks_to_timeval(st->ss_cstime, &kru.ru_stime);
+    } else
+        return -EINVAL;
+
+    return copy_to_user(ru, &kru, sizeof(kru));
 }
 
 struct mmap_arg_struct {
@@ -1233,18 +1720,16 @@ struct mmap_arg_struct {
 };
 
 int
-sys_mmap(struct mmap_arg_struct *arg)
+sys_mmap(struct mmap_arg_struct *u_arg)
 {
+    struct mmap_arg_struct karg, *arg = &karg;
     struct file *f = NULL;
 
-    if (verify_buffer(arg, sizeof(*arg)))
+    if (copy_from_user(arg, u_arg, sizeof(*arg)))
         return -EFAULT;
 
     if (!(arg->flags & MAP_ANONYMOUS)) {
-        if (arg->fd < 0 || arg->fd >= FD_MAX)
-            return -EBADF;
-
-        f = current_task->file_table[arg->fd];
+        f = fd_lookup(current_task, arg->fd);
         if (!f)
             return -EBADF;
     }
@@ -1265,13 +1750,17 @@ sys_getppid()
 }
 
 int
-sys_sigprocmask(int how, unsigned long *new, unsigned long *old)
+sys_sigprocmask(int how, unsigned long *u_new, unsigned long *old)
 {
     uint64_t old_mask = signal_get_mask(current_task);
+    unsigned long knew, kold, *new = &knew;
 
-    if (new == NULL)
+    if (u_new == NULL)
         goto set_old;
 
+    if (copy_from_user(new, u_new, sizeof(*new)))
+        return -EFAULT;
+
     if (how == SIG_BLOCK) {
         signal_set_mask(current_task, old_mask | (uint32_t)*new);
         goto set_old;
@@ -1287,13 +1776,11 @@ sys_sigprocmask(int how, unsigned long *new, unsigned long *old)
 
 set_old:
         //reschedule_to(current_task);
-        if (old == NULL) {
+        if (old == NULL)
             return 0;
-        } else if (verify_buffer(old, sizeof(unsigned long)))
-            return -EFAULT;
 
-        *old = (uint32_t) old_mask;
-        return 0;
+        kold = (uint32_t) old_mask;
+        return copy_to_user(old, &kold, sizeof(kold));
 }
 
 
@@ -1395,6 +1882,9 @@ __trace_syscall(int no, uint32_t a, uint32_t b, uint32_t c, uint32_t d)
         case 0x2c:
             printk("pid %d sys_sysconf(%d)\n", pid, a);
             return;
+        case 0x2b:
+            printk("pid %d sys_times(0x%x)\n", pid, a);
+            return;
         case 0x30:
             printk("pid %d sys_signal(%s, 0x%x)\n", pid, signal_to_string(a), b);
             return;
@@ -1416,9 +1906,15 @@ __trace_syscall(int no, uint32_t a, uint32_t b, uint32_t c, uint32_t d)
         case 0x42:
             printk("pid %d sys_setsid()\n", pid);
             return;
+        case 0x4d:
+            printk("pid %d sys_getrusage(%d, 0x%x)\n", pid, a, b);
+            return;
         case 0x4e:
             printk("pid %d sys_gettimeofday(0x%x, 0x%x)\n", pid, a, b);
             return;
+        case 0x52:
+            printk("pid %d sys_select(0x%x)\n", pid, a);
+            return;
         case 0x59:
             printk("pid %d sys_readdir(%d, 0x%x, %d)\n", pid, a, b, c);
             return;
@@ -1431,18 +1927,72 @@ __trace_syscall(int no, uint32_t a, uint32_t b, uint32_t c, uint32_t d)
         case 0x6d:
             printk("pid %d sys_uname(0x%x)\n", pid, a);
             return;
+        case 0x76:
+            printk("pid %d sys_fsync(%d)\n", pid, a);
+            return;
         case 0x7e:
             printk("pid %d sys_sigprocmask(%d, 0x%x, 0x%x)\n", pid, a, b, c);
             return;
         case 0x84:
             printk("pid %d sys_getpgid(%d)\n", pid, a);
             return;
+        case 0x8d:
+            printk("pid %d sys_getdents(%d, 0x%x, %d)\n", pid, a, b, c);
+            return;
+        case 0x91:
+            printk("pid %d sys_readv(%d, 0x%x, %d)\n", pid, a, b, c);
+            return;
+        case 0x92:
+            printk("pid %d sys_writev(%d, 0x%x, %d)\n", pid, a, b, c);
+            return;
+        case 0x9c:
+            printk("pid %d sys_sched_setscheduler(%d, %d, 0x%x)\n", pid, a, b, c);
+            return;
+        case 0x9d:
+            printk("pid %d sys_sched_getscheduler(%d)\n", pid, a);
+            return;
+        case 0x9e:
+            printk("pid %d sys_sched_yield()\n", pid);
+            return;
         case 0xa2:
             printk("pid %d sys_secsleep(%d)\n", pid, a);
             return;
+        case 0xa8:
+            printk("pid %d sys_poll(0x%x, %d, %d)\n", pid, a, b, c);
+            return;
+        case 0xac:
+            printk("pid %d sys_prctl(0x%x, %d, %d, %d)\n", pid, a, b, c, d);
+            return;
+        case 0xb4:
+            printk("pid %d sys_pread(%d, 0x%x, %d, %d)\n", pid, a, b, c, d);
+            return;
+        case 0xb5:
+            printk("pid %d sys_pwrite(%d, 0x%x, %d, %d)\n", pid, a, b, c, d);
+            return;
         case 0xb7:
             printk("pid %d sys_getcwd(0x%x, %d)\n", pid, a, b);
             return;
+        case 0xbb:
+            printk("pid %d sys_sendfile(%d, %d, 0x%x, %d)\n", pid, a, b, c, d);
+            return;
+        case 0xfe:
+            printk("pid %d sys_epoll_create(%d)\n", pid, a);
+            return;
+        case 0xff:
+            printk("pid %d sys_epoll_ctl(%d, %d, %d, 0x%x)\n", pid, a, b, c, d);
+            return;
+        case 0x100:
+            printk("pid %d sys_epoll_wait(%d, 0x%x, %d, %d)\n", pid, a, b, c, d);
+            return;
+        case 0x139:
+            printk("pid %d sys_splice(%d, %d, %d, 0x%x)\n", pid, a, b, c, d);
+            return;
+        case 0x1a9:
+            printk("pid %d sys_io_uring_setup(%d, 0x%x)\n", pid, a, b);
+            return;
+        case 0x1aa:
+            printk("pid %d sys_io_uring_enter(%d, %d, %d, 0x%x)\n", pid, a, b, c, d);
+            return;
     }
 }
 
@@ -1466,6 +2016,7 @@ syscall_hub(int no, uint32_t a, uint32_t b, uint32_t c, uint32_t d)
 
     if (__sysctl_trace_sys)
         __trace_syscall(no, a, b, c, d);
+    uint64_t start = sysstat_enter(no, a, b, c, d);
     int rc;
     switch(no) {
         case 0x1:
@@ -1534,6 +2085,9 @@ syscall_hub(int no, uint32_t a, uint32_t b, uint32_t c, uint32_t d)
         case 0x2c:
             rc = sys_sysconf((int) a);
             break;
+        case 0x2b:
+            rc = sys_times((struct tms *) a);
+            break;
         case 0x30:
             rc = sys_signal((int) a, (sighandler_t) b);
             break;
@@ -1555,8 +2109,15 @@ syscall_hub(int no, uint32_t a, uint32_t b, uint32_t c, uint32_t d)
         case 0x42:
             rc = sys_setsid();
             break;
+        case 0x4d:
+            rc = sys_getrusage((int) a, (struct rusage *) b);
+            break;
         case 0x4e:
             rc = sys_gettimeofday((void *) a, (void *) b);
+            break;
+        case 0x52:
+            rc = sys_select((struct sel_arg_struct *) a);
+            break;
         case 0x59:
             rc = sys_readdir((int) a, (struct linux_dirent *) b, (int) c);
             break;
@@ -1569,24 +2130,82 @@ syscall_hub(int no, uint32_t a, uint32_t b, uint32_t c, uint32_t d)
         case 0x6d:
             rc = sys_uname((struct uname *) a);
             break;
+        case 0x76:
+            rc = sys_fsync((int) a);
+            break;
         case 0x7e:
             rc = sys_sigprocmask((int) a, (void *) b, (void *)c);
             break;
         case 0x84:
             rc = sys_getpgid((int) a);
             break;
+        case 0x8d:
+            rc = sys_getdents((int) a, (void *) b, (unsigned int) c);
+            break;
+        case 0x91:
+            rc = sys_readv((int) a, (struct iovec *) b, (int) c);
+            break;
+        case 0x92:
+            rc = sys_writev((int) a, (struct iovec *) b, (int) c);
+            break;
+        case 0x9c:
+            rc = sys_sched_setscheduler((pid_t) a, (int) b, (struct sched_param *) c);
+            break;
+        case 0x9d:
+            rc = sys_sched_getscheduler((pid_t) a);
+            break;
+        case 0x9e:
+            rc = sys_sched_yield();
+            break;
         case 0xa2:
             rc = sys_secsleep((int) a);
             break;
+        case 0xa8:
+            rc = sys_poll((struct pollfd *) a, (unsigned int) b, (int) c);
+            break;
+        case 0xac:
+            rc = sys_prctl((int) a, (unsigned long) b, (unsigned long) c,
+                           (unsigned long) d);
+            break;
+        case 0xb4:
+            rc = sys_pread((int) a, (char *) b, (size_t) c, (int) d);
+            break;
+        case 0xb5:
+            rc = sys_pwrite((int) a, (char *) b, (size_t) c, (int) d);
+            break;
         case 0xb7:
             rc = sys_getcwd((char *) a, (unsigned long) b);
             break;
+        case 0xbb:
+            rc = sys_sendfile((int) a, (int) b, (int *) c, (size_t) d);
+            break;
+        case 0xfe:
+            rc = sys_epoll_create((int) a);
+            break;
+        case 0xff:
+            rc = sys_epoll_ctl((int) a, (int) b, (int) c, (struct epoll_event *) d);
+            break;
+        case 0x100:
+            rc = sys_epoll_wait((int) a, (struct epoll_event *) b, (int) c, (int) d);
+            break;
+        case 0x139:
+            rc = sys_splice((int) a, (int) b, (size_t) c, (unsigned int) d);
+            break;
+        case 0x1a9:
+            rc = sys_io_uring_setup((unsigned int) a, (struct io_uring_params *) b);
+            break;
+        case 0x1aa:
+            rc = sys_io_uring_enter((int) a, (unsigned int) b, (unsigned int) c,
+                                    (unsigned int) d);
+            break;
         default:
             syscall_undefined(no);
             rc = -ENOSYS;
             break;
     }
 
+    sysstat_exit(no, rc, start);
+
     if (__sysctl_trace_sys)
         __trace_return(rc);
 
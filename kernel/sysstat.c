@@ -0,0 +1,375 @@
+#include <levos/kernel.h>
+#include <levos/types.h>
+#include <levos/sysstat.h>
+#include <levos/task.h>
+#include <levos/smp.h>
+#include <levos/arch.h>
+#include <levos/arithmetic.h>
+#include <levos/fs.h>
+
+/* what syscall_hub() knows about, keep the two in sync */
+static const char *syscall_names[NR_SYSCALLS] = {
+    [0x1] = "exit",
+    [0x2] = "fork",
+    [0x3] = "read",
+    [0x4] = "write",
+    [0x5] = "open",
+    [0x6] = "close",
+    [0x7] = "waitpid",
+    [0xB] = "execve",
+    [0xC] = "chdir",
+    [0x11] = "socket",
+    [0x12] = "stat",
+    [0x13] = "lseek",
+    [0x14] = "getpid",
+    [0x1b] = "alarm",
+    [0x1c] = "fstat",
+    [0x1f] = "connect",
+    [0x23] = "sbrk",
+    [0x25] = "kill",
+    [0x27] = "mkdir",
+    [0x29] = "dup",
+    [0x2a] = "pipe",
+    [0x2c] = "sysconf",
+    [0x2b] = "times",
+    [0x30] = "signal",
+    [0x36] = "ioctl",
+    [0x37] = "fcntl",
+    [0x39] = "setpgid",
+    [0x3f] = "dup2",
+    [0x40] = "getppid",
+    [0x42] = "setsid",
+    [0x4d] = "getrusage",
+    [0x4e] = "gettimeofday",
+    [0x52] = "select",
+    [0x59] = "readdir",
+    [0x5a] = "mmap",
+    [0x5b] = "munmap",
+    [0x6d] = "uname",
+    [0x76] = "fsync",
+    [0x7e] = "sigprocmask",
+    [0x84] = "getpgid",
+    [0x8d] = "getdents",
+    [0x91] = "readv",
+    [0x92] = "writev",
+    [0x9c] = "sched_setscheduler",
+    [0x9d] = "sched_getscheduler",
+    [0x9e] = "sched_yield",
+    [0xa2] = "secsleep",
+    [0xa8] = "poll",
+    [0xac] = "prctl",
+    [0xb4] = "pread",
+    [0xb5] = "pwrite",
+    [0xb7] = "getcwd",
+    [0xbb] = "sendfile",
+    [0xfe] = "epoll_create",
+    [0xff] = "epoll_ctl",
+    [0x100] = "epoll_wait",
+    [0x139] = "splice",
+    [0x1a9] = "io_uring_setup",
+    [0x1aa] = "io_uring_enter",
+};
+
+/*
+ * Only the calls that exist get counters, the slot of each is looked up
+ * here.  Slot 0 is for everything else.
+ */
+static uint8_t sysstat_slot[NR_SYSCALLS];
+static int sysstat_slot_no[SYSSTAT_SLOTS];
+static int sysstat_nr_slots = 1;
+
+/* per CPU, so that nobody has to share a cache line or take a lock */
+static struct syscall_stat sysstat_cpus[NR_CPUS][SYSSTAT_SLOTS];
+
+static const char *sysstat_lat_names[SYSSTAT_LAT_BUCKETS] = {
+    "<1k", "<2k", "<4k", "<8k", "<16k", "<32k",
+    "<64k", "<128k", "<256k", "<512k", "<1M", "1M+",
+};
+
+void
+sysstat_init(void)
+{
+    int no;
+
+    for (no = 0; no < NR_SYSCALLS; no ++) {
+        if (!syscall_names[no])
+            continue;
+
+        if (sysstat_nr_slots == SYSSTAT_SLOTS)
+            panic("sysstat: raise SYSSTAT_SLOTS\n");
+
+        sysstat_slot[no] = sysstat_nr_slots;
+        sysstat_slot_no[sysstat_nr_slots ++] = no;
+    }
+}
+
+static inline int
+sysstat_lat_bucket(uint32_t cycles)
+{
+    int b = 0;
+
+    cycles >>= SYSSTAT_LAT_SHIFT;
+    while (cycles && b < SYSSTAT_LAT_BUCKETS - 1) {
+        cycles >>= 1;
+        b ++;
+    }
+
+    return b;
+}
+
+static inline void
+sysstat_account(struct syscall_stat *sc, int rc, uint32_t cycles)
+{
+    sc->sc_calls ++;
+    if (rc < 0 && rc >= -4095)
+        sc->sc_errors ++;
+    sc->sc_cycles += cycles;
+    sc->sc_lat[sysstat_lat_bucket(cycles)] ++;
+}
+
+/*
+ * sysstat_enter - a system call is starting
+ *
+ * Logs it if the task is being traced.  Returns the TSC, to be handed to
+ * sysstat_exit() when the call is done.
+ */
+uint64_t
+sysstat_enter(int no, uint32_t a, uint32_t b, uint32_t c, uint32_t d)
+{
+    struct systrace *st = current_task->systrace;
+    struct systrace_entry *te;
+
+    if (st && current_task->sysstat_flags & SYSSTAT_TRACE) {
+        te = &st->st_ring[st->st_seq % SYSTRACE_ENTRIES];
+        te->te_seq = st->st_seq ++;
+        te->te_no = no;
+        te->te_args[0] = a;
+        te->te_args[1] = b;
+        te->te_args[2] = c;
+        te->te_args[3] = d;
+        te->te_done = 0;
+    }
+
+    return arch_rdtsc();
+}
+
+/* the call NO that started at START returned RC */
+void
+sysstat_exit(int no, int rc, uint64_t start)
+{
+    struct task *task = current_task;
+    struct systrace *st = task->systrace;
+    struct systrace_entry *te;
+    uint64_t delta = arch_rdtsc() - start;
+    uint32_t cycles = delta > 0xFFFFFFFF ? 0xFFFFFFFF : delta;
+    int slot = no >= 0 && no < NR_SYSCALLS ? sysstat_slot[no] : 0;
+
+    preempt_disable();
+    sysstat_account(&sysstat_cpus[percpu_read(cpu_id)][slot], rc, cycles);
+    preempt_enable();
+
+    if (task->sysstat && task->sysstat_flags & SYSSTAT_TASK)
+        sysstat_account(&task->sysstat[slot], rc, cycles);
+
+    /* not if tracing was turned on during the call */
+    if (st && st->st_seq && task->sysstat_flags & SYSSTAT_TRACE) {
+        te = &st->st_ring[(st->st_seq - 1) % SYSTRACE_ENTRIES];
+        if (!te->te_done) {
+            te->te_rc = rc;
+            te->te_cycles = cycles;
+            te->te_done = 1;
+        }
+    }
+}
+
+/*
+ * sysstat_task_set - turn per-task counters or tracing on or off
+ *
+ * @task - whose
+ * @flag - SYSSTAT_TASK or SYSSTAT_TRACE
+ * @on - whether
+ *
+ * What was gathered is kept when it's turned off, so it can still be read
+ * in /proc/<pid>.
+ */
+int
+sysstat_task_set(struct task *task, int flag, int on)
+{
+    if (!on) {
+        task->sysstat_flags &= ~flag;
+        return 0;
+    }
+
+    if (flag == SYSSTAT_TASK && !task->sysstat) {
+        task->sysstat = malloc(SYSSTAT_SLOTS * sizeof(struct syscall_stat));
+        if (!task->sysstat)
+            return -ENOMEM;
+        memset(task->sysstat, 0, SYSSTAT_SLOTS * sizeof(struct syscall_stat));
+    }
+
+    if (flag == SYSSTAT_TRACE && !task->systrace) {
+        task->systrace = malloc(sizeof(struct systrace));
+        if (!task->systrace)
+            return -ENOMEM;
+        memset(task->systrace, 0, sizeof(struct systrace));
+    }
+
+    task->sysstat_flags |= flag;
+
+    return 0;
+}
+
+/* the child is accounted for like the parent, from scratch */
+void
+sysstat_fork(struct task *new, struct task *parent)
+{
+    if (parent->sysstat_flags & SYSSTAT_TASK)
+        sysstat_task_set(new, SYSSTAT_TASK, 1);
+
+    if (parent->sysstat_flags & SYSSTAT_TRACE)
+        sysstat_task_set(new, SYSSTAT_TRACE, 1);
+}
+
+void
+sysstat_free(struct task *task)
+{
+    free(task->sysstat);
+    free(task->systrace);
+}
+
+static const char *
+sysstat_slot_name(int slot)
+{
+    return slot ? syscall_names[sysstat_slot_no[slot]] : "other";
+}
+
+/* one line per call that was made at least once */
+static int
+sysstat_format(struct syscall_stat *stats, char *buf, size_t size)
+{
+    struct syscall_stat *sc;
+    int off, slot, i;
+    uint32_t avg;
+
+    off = snprintf(buf, size, "name calls errors avg_cycles");
+    for (i = 0; i < SYSSTAT_LAT_BUCKETS; i ++)
+        off += snprintf(buf + off, size - off, " %s", sysstat_lat_names[i]);
+    off += snprintf(buf + off, size - off, "\n");
+
+    for (slot = 0; slot < sysstat_nr_slots; slot ++) {
+        sc = &stats[slot];
+        if (!sc->sc_calls)
+            continue;
+
+        /* the longest line is well below 256 */
+        if (off + 256 > size)
+            break;
+
+        avg = div_u64_rem(sc->sc_cycles, sc->sc_calls, NULL);
+        off += snprintf(buf + off, size - off, "%s %u %u %u",
+                sysstat_slot_name(slot), sc->sc_calls, sc->sc_errors, avg);
+        for (i = 0; i < SYSSTAT_LAT_BUCKETS; i ++)
+            off += snprintf(buf + off, size - off, " %u", sc->sc_lat[i]);
+        off += snprintf(buf + off, size - off, "\n");
+    }
+
+    return off;
+}
+
+#define SYSSTAT_DUMP_SIZE 16384
+
+/* /proc/syscalls: the counters of all CPUs added up */
+size_t
+sysstat_proc_syscalls(int pos, void *buf, size_t len, char *__arg)
+{
+    struct syscall_stat *stats, *sc;
+    char *buffer;
+    int cpu, slot, i;
+    size_t rc;
+
+    stats = malloc(SYSSTAT_SLOTS * sizeof(*stats));
+    buffer = malloc(SYSSTAT_DUMP_SIZE);
+    if (!stats || !buffer) {
+        free(stats);
+        free(buffer);
+        return -ENOMEM;
+    }
+
+    memset(stats, 0, SYSSTAT_SLOTS * sizeof(*stats));
+    for (cpu = 0; cpu < NR_CPUS; cpu ++) {
+        for (slot = 0; slot < sysstat_nr_slots; slot ++) {
+            sc = &sysstat_cpus[cpu][slot];
+            stats[slot].sc_calls += sc->sc_calls;
+            stats[slot].sc_errors += sc->sc_errors;
+            stats[slot].sc_cycles += sc->sc_cycles;
+            for (i = 0; i < SYSSTAT_LAT_BUCKETS; i ++)
+                stats[slot].sc_lat[i] += sc->sc_lat[i];
+        }
+    }
+
+    sysstat_format(stats, buffer, SYSSTAT_DUMP_SIZE);
+    rc = generic_write_buf(pos, buf, len, buffer);
+
+    free(stats);
+    free(buffer);
+
+    return rc;
+}
+
+/* /proc/<pid>/syscalls, empty unless PR_SET_SYSCALL_STATS was set */
+int
+sysstat_task_dump(struct task *task, char *buf, size_t size)
+{
+    if (!task->sysstat)
+        return 0;
+
+    return sysstat_format(task->sysstat, buf, size);
+}
+
+/*
+ * systrace_task_dump - /proc/<pid>/strace
+ *
+ * The calls in the ring, oldest first.  The result and the cycles it took
+ * are left out for the call that is still running.
+ */
+int
+systrace_task_dump(struct task *task, char *buf, size_t size)
+{
+    struct systrace *st = task->systrace;
+    struct systrace_entry *te;
+    const char *name;
+    uint32_t seq, end;
+    int off = 0;
+
+    if (!st)
+        return 0;
+
+    end = st->st_seq;
+    seq = end > SYSTRACE_ENTRIES ? end - SYSTRACE_ENTRIES : 0;
+
+    for (; seq != end; seq ++) {
+        te = &st->st_ring[seq % SYSTRACE_ENTRIES];
+
+        if (off + 128 > size)
+            break;
+
+        name = te->te_no >= 0 && te->te_no < NR_SYSCALLS ?
+                syscall_names[te->te_no] : NULL;
+        if (name)
+            off += snprintf(buf + off, size - off, "%u %s(", te->te_seq, name);
+        else
+            off += snprintf(buf + off, size - off, "%u syscall_0x%x(",
+                    te->te_seq, te->te_no);
+
+        off += snprintf(buf + off, size - off, "0x%x, 0x%x, 0x%x, 0x%x)",
+                te->te_args[0], te->te_args[1], te->te_args[2], te->te_args[3]);
+
+        if (te->te_done)
+            off += snprintf(buf + off, size - off, " = %d <%u>\n",
+                    te->te_rc, te->te_cycles);
+        else
+            off += snprintf(buf + off, size - off, " ...\n");
+    }
+
+    return off;
+}
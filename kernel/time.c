@@ -1,5 +1,8 @@
 #include <levos/kernel.h>
 #include <levos/time.h>
+#include <levos/page.h>
+#include <levos/arch.h>
+#include <levos/compiler.h>
 
 #define MODULE_NAME time
 
@@ -7,6 +10,14 @@ static struct timesource *current_timesource;
 
 static uint64_t __boot_time;
 
+#if TIME_PAGE_ADDR != USER_SHARED_BASE
+#error "the time page has to be at the start of the shared area"
+#endif
+
+/* a whole page, since all of it is visible to userspace */
+static uint8_t time_page_buf[4096] __page_align;
+static struct time_page *time_page = (void *) time_page_buf;
+
 void
 timesource_set(struct timesource *ts)
 {
@@ -14,26 +25,68 @@ timesource_set(struct timesource *ts)
     current_timesource = ts;
 }
 
+/*
+ * time_page_publish - update what userspace sees in the time page
+ *
+ * @tsc - a TSC value
+ * @sec - the UNIX time when the TSC was at @tsc
+ * @khz - TSC frequency
+ * @mult - see struct time_page
+ */
+void
+time_page_publish(uint64_t tsc, uint64_t sec, uint32_t khz, uint32_t mult)
+{
+    time_page->tp_seq ++;
+    barrier();
+
+    time_page->tp_tsc_base = tsc;
+    time_page->tp_base_sec = sec;
+    time_page->tp_tsc_khz = khz;
+    time_page->tp_tsc_mult = mult;
+
+    barrier();
+    time_page->tp_seq ++;
+}
+
 int
 time_init(void)
 {
+    struct timesource *ts;
+
     mprintk("initializing\n");
 
     rtc_init();
 
-    timesource_set(rtc_get_timesource());
-
     __boot_time = rtc_get_unix_seconds();
 
     mprintk("UNIX timestamp of boot: %d\n", __boot_time);
 
+    map_user_shared(kv2p(time_page_buf), TIME_PAGE_ADDR);
+
+    /* the RTC only has a resolution of a second, prefer anything else */
+    ts = arch_timesource_init(__boot_time);
+    if (!ts)
+        ts = rtc_get_timesource();
+
+    timesource_set(ts);
+
     return 0;
 }
 
+void
+time_get_uptime_tv(struct timeval *tv)
+{
+    gettimeofday(tv, NULL);
+    tv->tv_sec -= __boot_time;
+}
+
 uint64_t
 time_get_uptime()
 {
-    return rtc_get_unix_seconds() - __boot_time;
+    struct timeval tv;
+
+    time_get_uptime_tv(&tv);
+    return tv.tv_sec;
 }
 
 /*
@@ -0,0 +1,171 @@
+#include <levos/kernel.h>
+#include <levos/uaccess.h>
+#include <levos/page.h>
+
+/* see the linker script */
+extern struct exception_table_entry __ex_table_start[], __ex_table_end[];
+
+/*
+ * search_exception_table - find where a faulting user access recovers
+ *
+ * @eip - the instruction that faulted
+ *
+ * Returns the address of the fixup, or 0 if EIP is not allowed to fault.
+ * The table only has a handful of entries, all in arch/x86/uaccess.S.
+ */
+uint32_t
+search_exception_table(uint32_t eip)
+{
+    struct exception_table_entry *ex;
+
+    for (ex = __ex_table_start; ex < __ex_table_end; ex ++)
+        if (ex->insn == eip)
+            return ex->fixup;
+
+    return 0;
+}
+
+/*
+ * copy_from_user - copy a buffer from userspace
+ *
+ * @to - kernel buffer
+ * @from - user buffer
+ * @n - number of bytes
+ *
+ * Returns 0, or -EFAULT if any part of FROM can not be read.
+ */
+int
+copy_from_user(void *to, const void *from, size_t n)
+{
+    if (!access_ok(from, n))
+        return -EFAULT;
+
+    return arch_copy_user(to, from, n) ? -EFAULT : 0;
+}
+
+/*
+ * copy_to_user - copy a buffer to userspace
+ *
+ * @to - user buffer
+ * @from - kernel buffer
+ * @n - number of bytes
+ *
+ * Returns 0, or -EFAULT if any part of TO can not be written.
+ */
+int
+copy_to_user(void *to, const void *from, size_t n)
+{
+    if (!access_ok(to, n))
+        return -EFAULT;
+
+    return arch_copy_user(to, from, n) ? -EFAULT : 0;
+}
+
+/*
+ * strncpy_from_user - copy a string from userspace
+ *
+ * @to - kernel buffer of at least N bytes
+ * @from - user string
+ * @n - the most bytes to copy, including the NUL
+ *
+ * Returns the length of the string, N if it did not end within N bytes
+ * (and TO is not terminated then) or -EFAULT.
+ */
+long
+strncpy_from_user(char *to, const char *from, long n)
+{
+    uint32_t start = (uint32_t) from;
+    long len;
+
+    if (start < 4096 || start >= VIRT_BASE)
+        return -EFAULT;
+
+    /* a string that runs into the kernel is not terminated for us */
+    if (n > VIRT_BASE - start) {
+        len = arch_strncpy_user(to, from, VIRT_BASE - start);
+        return len == VIRT_BASE - start ? -EFAULT : len;
+    }
+
+    return arch_strncpy_user(to, from, n);
+}
+
+/*
+ * strndup_user - copy a string from userspace into a new allocation
+ *
+ * @from - user string
+ * @max - the most bytes the string may take, including the NUL
+ *
+ * Returns the copy, which the caller frees, or -EFAULT, -ENAMETOOLONG
+ * or -ENOMEM as an ERR_PTR.
+ */
+char *
+strndup_user(const char *from, long max)
+{
+    char *buf, *ret;
+    long len;
+
+    buf = malloc(max);
+    if (!buf)
+        return ERR_PTR(-ENOMEM);
+
+    len = strncpy_from_user(buf, from, max);
+    if (len < 0 || len == max) {
+        free(buf);
+        return ERR_PTR(len < 0 ? len : -ENAMETOOLONG);
+    }
+
+    /* most strings are a lot shorter than MAX */
+    ret = strdup(buf);
+    free(buf);
+
+    return ret ? ret : ERR_PTR(-ENOMEM);
+}
+
+/*
+ * fault_in_readable - make a user buffer present for reading
+ *
+ * @ptr - user buffer
+ * @len - its length
+ *
+ * For buffers that are handed on to code that accesses them with plain
+ * loads, file operations for one.  Touches a byte in every page, so that
+ * the VMAs are loaded now and bad addresses are reported as -EFAULT
+ * rather than faulting later on.  Nothing unmaps pages of the task while
+ * it is in a system call, so they stay present afterwards.
+ */
+int
+fault_in_readable(const void *ptr, size_t len)
+{
+    uint32_t addr = (uint32_t) ptr, end = addr + len;
+
+    if (!access_ok(ptr, len))
+        return -EFAULT;
+
+    if (len == 0)
+        return 0;
+
+    for (; addr < end; addr = PG_RND_DOWN(addr) + 4096)
+        if (arch_probe_read((void *) addr))
+            return -EFAULT;
+
+    return 0;
+}
+
+/* like fault_in_readable(), but also breaks copy-on-write */
+int
+fault_in_writeable(void *ptr, size_t len)
+{
+    uint32_t addr = (uint32_t) ptr, end = addr + len;
+
+    if (!access_ok(ptr, len))
+        return -EFAULT;
+
+    if (len == 0)
+        return 0;
+
+    for (; addr < end; addr = PG_RND_DOWN(addr) + 4096)
+        if (arch_probe_write((void *) addr))
+            return -EFAULT;
+
+    return 0;
+}
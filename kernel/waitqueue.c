@@ -1,40 +1,150 @@
 #include <levos/kernel.h>
 #include <levos/wait.h>
 #include <levos/task.h>
+#include <levos/spinlock.h>
 
 void
 wait_queue_init(wait_queue_t *wq)
 {
+    spin_lock_init(&wq->wq_lock);
     list_init(&wq->wq_waiters);
+    wq->wq_num = 0;
 }
 
+int
+wait_queue_num_waiters(wait_queue_t *wq)
+{
+    return wq->wq_num;
+}
+
+/*
+ * prepare_to_wait - get ready to sleep on WQ
+ *
+ * @wq - the queue
+ * @wqe - an entry for the current task, zero it before the first call
+ *
+ * Marks the current task blocked, so the caller must check the condition
+ * it is waiting for after this and then sched_yield(), or finish_wait() if
+ * it's already true.  May be called again after a wakeup.
+ */
 void
-wait_task_on(struct task *task, wait_queue_t *wq)
+prepare_to_wait(wait_queue_t *wq, struct wait_queue_entry *wqe)
 {
-    preempt_disable();
-    list_push_back(&wq->wq_waiters, &task->wait_elem);
-    preempt_enable();
+    uint32_t flags;
+
+    wqe->wqe_task = current_task;
+
+    flags = spin_lock_irqsave(&wq->wq_lock);
+    if (!wqe->wqe_queued) {
+        list_push_back(&wq->wq_waiters, &wqe->wqe_elem);
+        wqe->wqe_queued = 1;
+        wq->wq_num ++;
+    }
+    task_block_noresched(current_task);
+    spin_unlock_irqrestore(&wq->wq_lock, flags);
 }
 
+/* done waiting, the condition is true */
 void
-wait_on(wait_queue_t *wq)
+finish_wait(wait_queue_t *wq, struct wait_queue_entry *wqe)
 {
-    wait_task_on(current_task, wq);
+    uint32_t flags;
+
+    flags = spin_lock_irqsave(&wq->wq_lock);
+    if (wqe->wqe_queued) {
+        list_remove(&wqe->wqe_elem);
+        wqe->wqe_queued = 0;
+        wq->wq_num --;
+    }
+    current_task->state = TASK_RUNNING;
+    spin_unlock_irqrestore(&wq->wq_lock, flags);
 }
 
-int
-wait_queue_num_waiters(wait_queue_t *wq)
+/*
+ * wait_queue_add - put a callback entry on WQ
+ *
+ * @wq - the queue
+ * @wqe - the entry, with wqe_func set
+ *
+ * Each wakeup of WQ calls wqe_func, from whatever context it happens in
+ * and with wq_lock held, until wait_queue_remove().
+ */
+void
+wait_queue_add(wait_queue_t *wq, struct wait_queue_entry *wqe)
 {
-    return wq->wq_num;
+    uint32_t flags;
+
+    flags = spin_lock_irqsave(&wq->wq_lock);
+    if (!wqe->wqe_queued) {
+        list_push_back(&wq->wq_waiters, &wqe->wqe_elem);
+        wqe->wqe_queued = 1;
+        wq->wq_num ++;
+    }
+    spin_unlock_irqrestore(&wq->wq_lock, flags);
+}
+
+/* take an entry off WQ, once this returns its wqe_func is not running */
+void
+wait_queue_remove(wait_queue_t *wq, struct wait_queue_entry *wqe)
+{
+    uint32_t flags;
+
+    flags = spin_lock_irqsave(&wq->wq_lock);
+    if (wqe->wqe_queued) {
+        list_remove(&wqe->wqe_elem);
+        wqe->wqe_queued = 0;
+        wq->wq_num --;
+    }
+    spin_unlock_irqrestore(&wq->wq_lock, flags);
 }
 
+/*
+ * caller holds wq_lock, calls the callbacks on the way and wakes the first
+ * sleeper, or all of them if ALL.  Returns the (last) task woken.
+ */
+static struct task *
+__wait_wake_up(wait_queue_t *wq, int all)
+{
+    struct wait_queue_entry *wqe;
+    struct list_elem *elem, *next;
+    struct task *task = NULL;
+
+    for (elem = list_begin(&wq->wq_waiters);
+            elem != list_end(&wq->wq_waiters); elem = next) {
+        next = list_next(elem);
+        wqe = list_entry(elem, struct wait_queue_entry, wqe_elem);
+
+        if (wqe->wqe_func) {
+            wqe->wqe_func(wqe);
+            continue;
+        }
+
+        list_remove(elem);
+        wqe->wqe_queued = 0;
+        wq->wq_num --;
+
+        /* it may not have gotten around to sleeping yet */
+        if (wqe->wqe_task->state == TASK_BLOCKED)
+            task_kick(wqe->wqe_task);
+
+        task = wqe->wqe_task;
+        if (!all)
+            break;
+    }
+
+    return task;
+}
+
+/* wake the first task on WQ, returns it or NULL if there was none */
 struct task *
 wait_wake_up_one(wait_queue_t *wq)
 {
-    struct list_elem *elem = list_pop_front(&wq->wq_waiters);
-    struct task *task = list_entry(elem, struct task, wait_elem);
+    struct task *task;
+    uint32_t flags;
 
-    task_unblock(task);
+    flags = spin_lock_irqsave(&wq->wq_lock);
+    task = __wait_wake_up(wq, 0);
+    spin_unlock_irqrestore(&wq->wq_lock, flags);
 
     return task;
 }
@@ -42,7 +152,9 @@ wait_wake_up_one(wait_queue_t *wq)
 void
 wait_wake_up(wait_queue_t *wq)
 {
-    int i = wait_queue_num_waiters(wq);
-    while (i --)
-        wait_wake_up_one(wq);
+    uint32_t flags;
+
+    flags = spin_lock_irqsave(&wq->wq_lock);
+    __wait_wake_up(wq, 1);
+    spin_unlock_irqrestore(&wq->wq_lock, flags);
 }
@@ -3,15 +3,80 @@
 #include <levos/list.h>
 #include <levos/spinlock.h>
 #include <levos/task.h>
+#include <levos/smp.h>
+#include <levos/fs.h>
+#include <levos/time.h>
+#include <levos/arithmetic.h>
+#include <levos/softirq.h>
+
+/*
+ * Delayed work sits on a hashed hierarchical timer wheel: WHEEL_LEVELS
+ * levels of WHEEL_SIZE slots, a work due in less than WHEEL_SIZE ticks
+ * hashes into level 0 by its expiry tick, later ones into a coarser level.
+ * Every time level 0 wraps around, the next slot of level 1 is cascaded
+ * down (and so on upwards), so arming and cancelling are O(1) and the
+ * tick only ever looks at one slot.
+ *
+ * Expired work is queued to its workqueue from SOFTIRQ_TIMER.
+ */
+#define WHEEL_BITS   6
+#define WHEEL_SIZE   (1 << WHEEL_BITS)
+#define WHEEL_MASK   (WHEEL_SIZE - 1)
+#define WHEEL_LEVELS 4
+
+/* the furthest out a work can be armed, later ones are clamped to this */
+#define WHEEL_MAX_DELAY ((1 << (WHEEL_BITS * WHEEL_LEVELS)) - 1)
+
+#define WHEEL_INDEX(clk, level) (((clk) >> ((level) * WHEEL_BITS)) & WHEEL_MASK)
+
+static struct list wheel[WHEEL_LEVELS][WHEEL_SIZE];
+
+/* the next tick the wheel has to process */
+static uint32_t wheel_clock;
+
+/* works on the wheel */
+static int wheel_pending;
 
-struct list work_list;
 spinlock_t work_lock;
-struct work *current_work;
 void work_destroy(struct work *);
 
 extern uint32_t __pit_ticks;
 
-struct task *worker_task;
+static uint32_t work_timers_armed;
+static uint32_t work_timers_fired;
+static uint32_t work_timers_cancelled;
+
+/*
+ * Ready work goes to the worker pool of its workqueue.  The high priority
+ * pool's workers are real-time, so that e.g. retransmissions don't wait
+ * behind a slow work on system_wq.
+ */
+#define POOL_MAX_WORKERS 8
+
+static struct worker_pool pool_highpri = {
+    .wp_name = "H",
+    .wp_policy = SCHED_FIFO,
+    .wp_prio = KTHREAD_RT_PRIO,
+    .wp_max_workers = POOL_MAX_WORKERS,
+};
+
+static struct worker_pool pool_normal = {
+    .wp_name = "",
+    .wp_policy = SCHED_OTHER,
+    .wp_prio = 0,
+    .wp_max_workers = POOL_MAX_WORKERS,
+};
+
+#define NR_POOLS 2
+static struct worker_pool *pools[NR_POOLS] = { &pool_highpri, &pool_normal };
+
+struct workqueue *system_highpri_wq;
+struct workqueue *system_wq;
+
+static struct list workqueues;
+
+/* starts workers for pools that have run out of them */
+static struct task *manager_task;
 
 uint32_t
 work_get_ticks()
@@ -20,36 +85,245 @@ work_get_ticks()
     return __pit_ticks;
 }
 
-bool
-work_less(const struct list_elem *ea, const struct list_elem *eb, void *aux)
+static uint64_t
+work_now_usec(void)
+{
+    struct timeval tv;
+
+    gettimeofday(&tv, NULL);
+    return (uint64_t) tv.tv_sec * 1000000 + tv.tv_usec;
+}
+
+/* put WORK in its slot, caller holds work_lock */
+static void
+wheel_add(struct work *work)
+{
+    uint32_t expires = work->work_at;
+    uint32_t delta = expires - wheel_clock;
+    int level = 0;
+
+    if ((int32_t) delta < 0) {
+        /* already due, have it go off on the next tick we process */
+        expires = wheel_clock;
+    } else {
+        if (delta > WHEEL_MAX_DELAY)
+            expires = wheel_clock + WHEEL_MAX_DELAY;
+
+        while (level < WHEEL_LEVELS - 1 &&
+                expires - wheel_clock >= 1 << ((level + 1) * WHEEL_BITS))
+            level ++;
+    }
+
+    list_push_back(&wheel[level][WHEEL_INDEX(expires, level)], &work->elem);
+}
+
+/* re-hash the works in a slot of LEVEL into the lower levels */
+static int
+wheel_cascade(int level)
+{
+    int index = WHEEL_INDEX(wheel_clock, level);
+    struct list *slot = &wheel[level][index];
+
+    while (!list_empty(slot))
+        wheel_add(list_entry(list_pop_front(slot), struct work, elem));
+
+    return index;
+}
+
+/*
+ * pool_stalled - is every worker of POOL blocked in the middle of a work
+ *
+ * Caller holds work_lock.  A worker that is about to look at wp_ready
+ * counts as not stalled.
+ */
+static int
+pool_stalled(struct worker_pool *pool)
+{
+    struct list_elem *elem;
+    struct worker *worker;
+    int state;
+
+    list_foreach_raw(&pool->wp_workers, elem) {
+        worker = list_entry(elem, struct worker, wk_elem);
+
+        if (!worker->wk_current)
+            return 0;
+
+        state = worker->wk_task->state;
+        if (state != TASK_BLOCKED && state != TASK_SLEEPING)
+            return 0;
+    }
+
+    return 1;
+}
+
+/* see if POOL needs another worker to make progress, caller holds work_lock */
+static void
+pool_check_stall(struct worker_pool *pool)
+{
+    if (list_empty(&pool->wp_ready) || pool->wp_need_worker ||
+            pool->wp_nr_workers >= pool->wp_max_workers)
+        return;
+
+    if (!pool_stalled(pool))
+        return;
+
+    pool->wp_need_worker = 1;
+
+    /* it sleeps with work_lock held, like the workers */
+    if (manager_task->state == TASK_BLOCKED)
+        task_kick(manager_task);
+}
+
+/* WORK is ready to run, caller holds work_lock */
+static void
+pool_push(struct worker_pool *pool, struct work *work)
+{
+    struct worker *worker;
+
+    list_push_back(&pool->wp_ready, &work->elem);
+
+    if (list_empty(&pool->wp_idle)) {
+        pool_check_stall(pool);
+        return;
+    }
+
+    worker = list_entry(list_pop_front(&pool->wp_idle),
+                        struct worker, wk_idle_elem);
+    task_kick(worker->wk_task);
+}
+
+/* hand WORK to the pool, or hold it back if WQ is ordered and busy */
+static void
+work_enqueue(struct work *work)
+{
+    struct workqueue *wq = work->work_wq;
+
+    work->work_queued_at = work_now_usec();
+    work->work_flags |= WORK_FLAG_QUEUED;
+
+    if ((wq->wq_flags & WQ_ORDERED) && wq->wq_active) {
+        work->work_flags |= WORK_FLAG_DELAYED;
+        list_push_back(&wq->wq_delayed, &work->elem);
+        return;
+    }
+
+    wq->wq_active ++;
+    pool_push(wq->wq_pool, work);
+}
+
+/* a work of WQ is done or was taken back, let the next one go */
+static void
+wq_finish(struct workqueue *wq)
 {
-    struct work *a = list_entry(ea, struct work, elem);
-    struct work *b = list_entry(eb, struct work, elem);
+    struct work *work;
+
+    wq->wq_active --;
+
+    if (!(wq->wq_flags & WQ_ORDERED) || list_empty(&wq->wq_delayed))
+        return;
 
-    return a->work_at < b->work_at;
+    work = list_entry(list_pop_front(&wq->wq_delayed), struct work, elem);
+    work->work_flags &= ~WORK_FLAG_DELAYED;
+    wq->wq_active ++;
+    pool_push(wq->wq_pool, work);
 }
 
+/*
+ * take WORK off the wheel, its pool or its workqueue, caller holds
+ * work_lock, returns whether it was on the wheel
+ */
+static int
+work_dequeue(struct work *work)
+{
+    int timer = work->work_flags & WORK_FLAG_TIMER;
+
+    if (!(work->work_flags & WORK_FLAG_QUEUED))
+        return 0;
+
+    list_remove(&work->elem);
+    if (timer)
+        wheel_pending --;
+    else if (!(work->work_flags & WORK_FLAG_DELAYED))
+        wq_finish(work->work_wq);
+
+    work->work_flags &= ~(WORK_FLAG_QUEUED | WORK_FLAG_TIMER |
+                          WORK_FLAG_DELAYED);
+
+    return timer;
+}
+
+/* put WORK on the wheel, caller holds work_lock */
+static void
+work_arm(struct work *work, uint32_t abs)
+{
+    work->work_at = abs;
+    work->work_flags |= WORK_FLAG_QUEUED | WORK_FLAG_TIMER;
+    wheel_add(work);
+    wheel_pending ++;
+    work_timers_armed ++;
+}
+
+/*
+ * queue_work - run WORK on WQ as soon as possible
+ *
+ * WORK runs on WQ from now on, also when it reschedules itself.
+ */
 int
-schedule_work(struct work *work)
+queue_work(struct workqueue *wq, struct work *work)
+{
+    uint32_t flags;
+
+    flags = spin_lock_irqsave(&work_lock);
+    work_dequeue(work);
+    work->work_wq = wq;
+    work_enqueue(work);
+    spin_unlock_irqrestore(&work_lock, flags);
+
+    return 0;
+}
+
+/* queue_work - after DELAY ticks */
+int
+queue_work_delay(struct workqueue *wq, struct work *work, uint32_t delay)
 {
-    spin_lock(&work_lock);
-    list_insert_ordered(&work_list, &work->elem, work_less, NULL);
-    spin_unlock(&work_lock);
+    uint32_t flags;
 
-    task_kick(worker_task);
+    flags = spin_lock_irqsave(&work_lock);
+    work_dequeue(work);
+    work->work_wq = wq;
+    work_arm(work, work_get_ticks() + delay);
+    spin_unlock_irqrestore(&work_lock, flags);
 
     return 0;
 }
 
+int
+schedule_work(struct work *work)
+{
+    return queue_work(work->work_wq, work);
+}
+
+/*
+ * schedule_work_at - arm WORK to run at tick ABS
+ *
+ * Re-arms WORK if it was already queued.  Returns 1 if ABS is in the past,
+ * WORK is not queued then.
+ */
 int
 schedule_work_at(struct work *work, uint32_t abs)
 {
+    uint32_t flags;
+
     if (abs < work_get_ticks())
         return 1;
 
-    work->work_at = abs;
+    flags = spin_lock_irqsave(&work_lock);
+    work_dequeue(work);
+    work_arm(work, abs);
+    spin_unlock_irqrestore(&work_lock, flags);
 
-    return schedule_work(work);
+    return 0;
 }
 
 int
@@ -58,45 +332,75 @@ schedule_work_delay(struct work *work, uint32_t delay)
     return schedule_work_at(work, work_get_ticks() + delay);
 }
 
+static struct work *
+current_work(void)
+{
+    struct worker *worker = current_task->worker;
+
+    panic_ifnot(worker != NULL);
+
+    return worker->wk_current;
+}
+
 int
 work_reschedule(uint32_t delay)
 {
-    panic_ifnot(current_task == worker_task);
+    struct work *work = current_work();
+    uint32_t flags;
 
-    if (current_work->work_flags & WORK_FLAG_CANCELLED)
+    flags = spin_lock_irqsave(&work_lock);
+    if (work->work_flags & WORK_FLAG_CANCELLED) {
+        spin_unlock_irqrestore(&work_lock, flags);
         return -1;
+    }
+
+    work->work_flags &= ~WORK_FLAG_KILLED;
+    spin_unlock_irqrestore(&work_lock, flags);
 
-    current_work->work_flags &= ~WORK_FLAG_KILLED;
-    schedule_work_delay(current_work, delay);
+    schedule_work_delay(work, delay);
 
     return 0;
 }
 
+/*
+ * work_cancel - make sure WORK does not run (again)
+ *
+ * A queued work is taken off the wheel and freed right away.  If WORK is
+ * running, it is freed when it returns, and can't reschedule itself.
+ */
 int
 work_cancel(struct work *work)
 {
-    spin_lock(&work_lock);
+    uint32_t flags;
+    int rc = 0;
+
+    flags = spin_lock_irqsave(&work_lock);
 
-    if (work == current_work) {
+    if (work->work_flags & WORK_FLAG_RUNNING) {
         /* if the currently running work is being cancelled, set a flag */
-        work->work_flags |= WORK_FLAG_CANCELLED;
+        work_dequeue(work);
+        work->work_flags |= WORK_FLAG_CANCELLED | WORK_FLAG_KILLED;
+    } else if (work->work_flags & WORK_FLAG_QUEUED) {
+        if (work_dequeue(work))
+            work_timers_cancelled ++;
+        spin_unlock_irqrestore(&work_lock, flags);
+        work_destroy(work);
+        return 0;
     } else if (work->work_flags & WORK_FLAG_CANCELLED) {
-        return -1;
+        rc = -1;
     } else {
         work->work_flags |= WORK_FLAG_KILLED;
     }
 
-    spin_unlock(&work_lock);
+    spin_unlock_irqrestore(&work_lock, flags);
 
-    return 0;
+    return rc;
 }
 
 int
 work_cancel_current(void)
 {
-    panic_ifnot(current_task == worker_task);
-
-    return work_cancel(current_work);
+    return work_cancel(current_work());
 }
 
 struct work *
@@ -110,6 +414,7 @@ work_create(void (*f)(void *), void *aux)
     work->work_aux = aux;
     work->work_at = 0;
     work->work_flags = 0;
+    work->work_wq = system_wq;
 
     return work;
 }
@@ -120,57 +425,363 @@ work_destroy(struct work *work)
     free(work);
 }
 
+/*
+ * work_timer_tick - run the wheel up to the current tick
+ *
+ * This is SOFTIRQ_TIMER, raised by the tick of the BSP, which keeps
+ * __pit_ticks.  After a tickless period this catches up on all the ticks
+ * skipped.  Also notices pools whose workers all got stuck since work was
+ * queued.
+ */
 void
-do_work(struct work *work)
+work_timer_tick(void)
 {
-    current_work = work;
+    uint32_t now = work_get_ticks();
+    struct list *slot;
+    uint32_t flags;
+    int index, i;
 
-    if (!(work->work_flags & WORK_FLAG_KILLED)) {
-        work->work_flags |= WORK_FLAG_KILLED;
-        work->work_func(work->work_aux);
+    if (!manager_task)
+        return;
+
+    flags = spin_lock_irqsave(&work_lock);
+
+    /* nothing armed, no need to walk the wheel */
+    if (!wheel_pending)
+        wheel_clock = now + 1;
+
+    while ((int32_t) (now - wheel_clock) >= 0) {
+        index = wheel_clock & WHEEL_MASK;
+
+        if (!index && !wheel_cascade(1) && !wheel_cascade(2))
+            wheel_cascade(3);
+
+        slot = &wheel[0][index];
+        while (!list_empty(slot)) {
+            struct work *work = list_entry(list_pop_front(slot),
+                                           struct work, elem);
+
+            work->work_flags &= ~WORK_FLAG_TIMER;
+            wheel_pending --;
+            work_timers_fired ++;
+            work_enqueue(work);
+        }
+
+        wheel_clock ++;
+    }
+
+    for (i = 0; i < NR_POOLS; i ++)
+        pool_check_stall(pools[i]);
+
+    spin_unlock_irqrestore(&work_lock, flags);
+}
+
+/*
+ * work_timer_next - the tick by which work_timer_tick() must have run
+ *
+ * This is exact for the works in level 0, for the others it's when the
+ * next slot is cascaded.  Returns NOHZ_FOREVER if nothing is armed.
+ */
+uint32_t
+work_timer_next(void)
+{
+    uint32_t flags, next = NOHZ_FOREVER;
+    int i;
+
+    flags = spin_lock_irqsave(&work_lock);
+
+    if (!wheel_pending)
+        goto out;
+
+    for (i = 0; i < WHEEL_SIZE; i ++) {
+        uint32_t tick = wheel_clock + i;
+
+        /* past here, a higher level may have to be cascaded first */
+        if (i && !(tick & WHEEL_MASK))
+            break;
+
+        if (!list_empty(&wheel[0][tick & WHEEL_MASK])) {
+            next = tick;
+            goto out;
+        }
     }
 
-    current_work = NULL;
-    
-    if (work->work_flags & WORK_FLAG_KILLED)
+    next = (wheel_clock | WHEEL_MASK) + 1;
+
+out:
+    spin_unlock_irqrestore(&work_lock, flags);
+    return next;
+}
+
+/* run WORK unless it was killed before it got to run, then maybe free it */
+static void
+worker_run(struct worker *worker, struct work *work, int killed)
+{
+    struct workqueue *wq = work->work_wq;
+    uint32_t flags;
+    int destroy;
+
+    if (!killed)
+        work->work_func(work->work_aux);
+
+    flags = spin_lock_irqsave(&work_lock);
+    worker->wk_current = NULL;
+    work->work_flags &= ~WORK_FLAG_RUNNING;
+    destroy = work->work_flags & WORK_FLAG_KILLED;
+    wq_finish(wq);
+    spin_unlock_irqrestore(&work_lock, flags);
+
+    if (destroy)
         work_destroy(work);
 }
 
 void
 worker_thread(void)
 {
+    struct worker *worker = current_task->worker;
+    struct worker_pool *pool = worker->wk_pool;
+    struct workqueue *wq;
     struct work *work;
+    uint32_t flags, latency;
+    int killed;
 
     while (1) {
-        spin_lock(&work_lock);
-        if (list_empty(&work_list)) {
-            spin_unlock(&work_lock);
+        /*
+         * go to sleep with the lock held, so that nobody can kick us
+         * before we are asleep
+         */
+        flags = spin_lock_irqsave(&work_lock);
+        if (list_empty(&pool->wp_ready)) {
+            list_push_back(&pool->wp_idle, &worker->wk_idle_elem);
+            task_block_noresched(current_task);
+            spin_unlock_irqrestore(&work_lock, flags);
             sched_yield();
             continue;
         }
-        work = list_entry(list_pop_front(&work_list), struct work, elem);
-        if (work->work_at >= work_get_ticks()) {
-            list_push_front(&work_list, &work->elem);
-            spin_unlock(&work_lock);
-            sleep(work->work_at - work_get_ticks());
+        work = list_entry(list_pop_front(&pool->wp_ready), struct work, elem);
+
+        /* unless it's rescheduled, it's freed when done */
+        killed = work->work_flags & WORK_FLAG_KILLED;
+        work->work_flags &= ~WORK_FLAG_QUEUED;
+        work->work_flags |= WORK_FLAG_RUNNING | WORK_FLAG_KILLED;
+        worker->wk_current = work;
+
+        wq = work->work_wq;
+        latency = work_now_usec() - work->work_queued_at;
+        wq->wq_runs ++;
+        wq->wq_latency_total += latency;
+        if (latency > wq->wq_latency_max)
+            wq->wq_latency_max = latency;
+
+        spin_unlock_irqrestore(&work_lock, flags);
+
+        worker_run(worker, work, killed);
+    }
+}
+
+static struct worker *
+worker_create(struct worker_pool *pool)
+{
+    struct worker *worker;
+    struct task *task;
+    uint32_t flags;
+    char name[16];
+
+    worker = malloc(sizeof(*worker));
+    if (!worker)
+        return NULL;
+
+    memset(worker, 0, sizeof(*worker));
+    worker->wk_pool = pool;
+
+    task = create_kernel_task(worker_thread);
+    if (!task) {
+        free(worker);
+        return NULL;
+    }
+
+    snprintf(name, sizeof(name), "kworker/%s%d", pool->wp_name,
+            pool->wp_nr_workers);
+    free(task->comm);
+    task->comm = strdup(name);
+    task->worker = worker;
+    worker->wk_task = task;
+
+    if (pool->wp_policy != SCHED_OTHER)
+        sched_setscheduler(task, pool->wp_policy, pool->wp_prio);
+
+    flags = spin_lock_irqsave(&work_lock);
+    list_push_back(&pool->wp_workers, &worker->wk_elem);
+    pool->wp_nr_workers ++;
+    spin_unlock_irqrestore(&work_lock, flags);
+
+    sched_add_rq(task);
+
+    return worker;
+}
+
+static void
+manager_thread(void)
+{
+    struct worker_pool *pool;
+    uint32_t flags;
+    int i;
+
+    while (1) {
+        flags = spin_lock_irqsave(&work_lock);
+        for (i = 0, pool = NULL; i < NR_POOLS && !pool; i ++)
+            if (pools[i]->wp_need_worker)
+                pool = pools[i];
+
+        if (!pool) {
+            task_block_noresched(current_task);
+            spin_unlock_irqrestore(&work_lock, flags);
+            sched_yield();
             continue;
         }
-        spin_unlock(&work_lock);
+        spin_unlock_irqrestore(&work_lock, flags);
+
+        if (worker_create(pool))
+            printk("work: pool %s stalled, started worker %d\n",
+                    pool->wp_name, pool->wp_nr_workers);
+
+        flags = spin_lock_irqsave(&work_lock);
+        pool->wp_need_worker = 0;
+        spin_unlock_irqrestore(&work_lock, flags);
+    }
+}
+
+static struct workqueue *
+workqueue_create(char *name, struct worker_pool *pool, int wq_flags)
+{
+    struct workqueue *wq = malloc(sizeof(*wq));
+    uint32_t flags;
+
+    if (!wq)
+        return NULL;
+
+    memset(wq, 0, sizeof(*wq));
+    wq->wq_name = name;
+    wq->wq_flags = wq_flags;
+    wq->wq_pool = pool;
+    list_init(&wq->wq_delayed);
+
+    flags = spin_lock_irqsave(&work_lock);
+    list_push_back(&workqueues, &wq->wq_elem);
+    spin_unlock_irqrestore(&work_lock, flags);
+
+    return wq;
+}
+
+/*
+ * workqueue_create_ordered - a workqueue that runs one work at a time
+ *
+ * @name - for /proc/workqueues, not copied
+ *
+ * Works run in the order they became ready.
+ */
+struct workqueue *
+workqueue_create_ordered(char *name)
+{
+    return workqueue_create(name, &pool_normal, WQ_ORDERED);
+}
+
+size_t
+work_proc_timers(int pos, void *buf, size_t len, char *__arg)
+{
+    char buffer[128];
+
+    snprintf(buffer, sizeof(buffer),
+            "armed %u\nfired %u\ncancelled %u\npending %d\n",
+            work_timers_armed, work_timers_fired,
+            work_timers_cancelled, wheel_pending);
+
+    return generic_write_buf(pos, buf, len, buffer);
+}
+
+/*
+ * work_proc_workqueues - /proc/workqueues
+ *
+ * One line per workqueue with the latency from a work being ready until
+ * a worker picks it, then the size of the pools.
+ */
+size_t
+work_proc_workqueues(int pos, void *buf, size_t len, char *__arg)
+{
+    struct list_elem *elem;
+    struct workqueue *wq;
+    struct worker_pool *pool;
+    char buffer[1024];
+    uint32_t flags, avg;
+    int off, i;
+
+    off = snprintf(buffer, sizeof(buffer), "name active runs avg_us max_us\n");
 
-        do_work(work);
+    flags = spin_lock_irqsave(&work_lock);
+    list_foreach_raw(&workqueues, elem) {
+        wq = list_entry(elem, struct workqueue, wq_elem);
+
+        avg = wq->wq_runs ?
+            div_u64_rem(wq->wq_latency_total, wq->wq_runs, NULL) : 0;
+
+        off += snprintf(buffer + off, sizeof(buffer) - off,
+                "%s %d %u %u %u\n", wq->wq_name, wq->wq_active,
+                wq->wq_runs, avg, wq->wq_latency_max);
+    }
+
+    for (i = 0; i < NR_POOLS; i ++) {
+        pool = pools[i];
+        off += snprintf(buffer + off, sizeof(buffer) - off,
+                "pool kworker/%s workers %d idle %d\n", pool->wp_name,
+                pool->wp_nr_workers, list_size(&pool->wp_idle));
     }
+    spin_unlock_irqrestore(&work_lock, flags);
+
+    return generic_write_buf(pos, buf, len, buffer);
 }
 
 int
 work_init(void)
 {
+    struct worker_pool *pool;
+    int i, j;
+
     spin_lock_init(&work_lock);
-    list_init(&work_list);
+    list_init(&workqueues);
 
-    worker_task = create_kernel_task(worker_thread);
-    sched_add_rq(worker_task);
+    for (i = 0; i < WHEEL_LEVELS; i ++)
+        for (j = 0; j < WHEEL_SIZE; j ++)
+            list_init(&wheel[i][j]);
+
+    wheel_clock = work_get_ticks();
+    open_softirq(SOFTIRQ_TIMER, work_timer_tick);
+
+    for (i = 0; i < NR_POOLS; i ++) {
+        pool = pools[i];
+        list_init(&pool->wp_ready);
+        list_init(&pool->wp_workers);
+        list_init(&pool->wp_idle);
+    }
+
+    system_highpri_wq = workqueue_create("events_highpri", &pool_highpri, 0);
+    system_wq = workqueue_create("events", &pool_normal, 0);
+    if (!system_highpri_wq || !system_wq)
+        panic("work: no memory for the system workqueues\n");
+
+    manager_task = create_kernel_task(manager_thread);
+    free(manager_task->comm);
+    manager_task->comm = strdup("kworker/manager");
+    sched_setscheduler(manager_task, SCHED_FIFO, KTHREAD_RT_PRIO);
+    sched_add_rq(manager_task);
+
+    for (i = 0; i < NR_POOLS; i ++) {
+        pool = pools[i];
+        if (!worker_create(pool))
+            panic("work: failed to start a worker for pool %s\n",
+                    pool->wp_name);
+    }
 
-    printk("kworker initialized as pid %d\n", worker_task->pid);
+    printk("work: %d worker pools initialized\n", NR_POOLS);
 
     return 0;
 }
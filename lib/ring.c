@@ -108,3 +108,52 @@ ring_buffer_size(struct ring_buffer *rb)
 {
     return rb->size;
 }
+
+/*
+ * ring_buffer_write_space - the free space at the head that is in one piece
+ *
+ * Returns its length and points PTR at it.  Whatever is put there is only
+ * in the ring after ring_buffer_commit().
+ */
+size_t
+ring_buffer_write_space(struct ring_buffer *rb, uint8_t **ptr)
+{
+    *ptr = rb->buffer + rb->head;
+
+    if (rb->size == rb->capacity)
+        return 0;
+
+    if (rb->head >= rb->tail)
+        return rb->capacity - rb->head;
+
+    return rb->tail - rb->head;
+}
+
+void
+ring_buffer_commit(struct ring_buffer *rb, size_t len)
+{
+    rb->head = (rb->head + len) % rb->capacity;
+    rb->size += len;
+}
+
+/* like ring_buffer_write_space(), the data at the tail */
+size_t
+ring_buffer_read_space(struct ring_buffer *rb, uint8_t **ptr)
+{
+    *ptr = rb->buffer + rb->tail;
+
+    if (rb->size == 0)
+        return 0;
+
+    if (rb->tail < rb->head)
+        return rb->head - rb->tail;
+
+    return rb->capacity - rb->tail;
+}
+
+void
+ring_buffer_consume(struct ring_buffer *rb, size_t len)
+{
+    rb->tail = (rb->tail + len) % rb->capacity;
+    rb->size -= len;
+}
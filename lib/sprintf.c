@@ -0,0 +1,119 @@
+#include <levos/kernel.h>
+
+#include <stdarg.h>
+
+/*
+ * A small vsnprintf for building text in procfs and the like.
+ *
+ * Understands %d, %u, %x, %s, %c and %%, with an optional '0' flag and a
+ * field width.  Always NUL-terminates BUF if SIZE is non-zero and returns
+ * the number of characters written, not counting the NUL.
+ */
+
+struct sprintf_out {
+    char *buf;
+    size_t size;
+    size_t pos;
+};
+
+static void
+sprintf_emit(struct sprintf_out *out, char c)
+{
+    if (out->pos + 1 < out->size)
+        out->buf[out->pos ++] = c;
+}
+
+static void
+sprintf_emit_str(struct sprintf_out *out, const char *s, int width, char pad)
+{
+    int len = strlen(s);
+
+    while (width -- > len)
+        sprintf_emit(out, pad);
+
+    while (*s)
+        sprintf_emit(out, *s ++);
+}
+
+int
+vsnprintf(char *buf, size_t size, const char *fmt, va_list ap)
+{
+    struct sprintf_out out = { buf, size, 0 };
+    char num[34];
+    const char *s;
+    int width, neg;
+    char pad;
+
+    for (; *fmt; fmt ++) {
+        if (*fmt != '%') {
+            sprintf_emit(&out, *fmt);
+            continue;
+        }
+
+        fmt ++;
+        pad = ' ';
+        width = 0;
+
+        if (*fmt == '0') {
+            pad = '0';
+            fmt ++;
+        }
+
+        while (*fmt >= '0' && *fmt <= '9')
+            width = width * 10 + *fmt ++ - '0';
+
+        switch (*fmt) {
+            case 'd': {
+                int v = va_arg(ap, int);
+
+                neg = v < 0;
+                itoa(neg ? -v : v, 10, num + 1);
+                if (neg) {
+                    num[0] = '-';
+                    sprintf_emit_str(&out, num, width, pad);
+                } else
+                    sprintf_emit_str(&out, num + 1, width, pad);
+                break;
+            }
+            case 'u':
+                itoa(va_arg(ap, unsigned), 10, num);
+                sprintf_emit_str(&out, num, width, pad);
+                break;
+            case 'x':
+                itoa(va_arg(ap, unsigned), 16, num);
+                sprintf_emit_str(&out, num, width, pad);
+                break;
+            case 's':
+                s = va_arg(ap, const char *);
+                sprintf_emit_str(&out, s ? s : "(null)", width, ' ');
+                break;
+            case 'c':
+                sprintf_emit(&out, (char) va_arg(ap, int));
+                break;
+            case '%':
+                sprintf_emit(&out, '%');
+                break;
+            case '\0':
+                fmt --;
+                break;
+        }
+    }
+
+    if (size)
+        buf[out.pos] = '\0';
+
+    return out.pos;
+}
+
+int
+snprintf(char *buf, size_t size, const char *fmt, ...)
+{
+    va_list ap;
+    int ret;
+
+    va_start(ap, fmt);
+    ret = vsnprintf(buf, size, fmt, ap);
+    va_end(ap);
+
+    return ret;
+}
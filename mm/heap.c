@@ -32,6 +32,8 @@
 static elem_type heap_bitmap_bits[512];
 static struct bitmap heap_bitmap;
 static spinlock_t malloc_lock __align(4);
+/* the heap is used from interrupt context too, see liballoc_lock() */
+static uint32_t malloc_lock_flags;
 
 static struct liballoc_major *l_memRoot = NULL;	///< The root memory block acquired from the system.
 static struct liballoc_major *l_bestBet = NULL; ///< The major with the most free memory.
@@ -74,7 +76,7 @@ heap_proc_heapstats(int pos, void *buf, size_t len, char *__arg)
  * failure.
  */
 int liballoc_lock() {
-	spin_lock(&malloc_lock);
+    malloc_lock_flags = spin_lock_irqsave(&malloc_lock);
     return 0;
 }
 
@@ -85,7 +87,7 @@ int liballoc_lock() {
  * \return 0 if the lock was successfully released.
  */
 int liballoc_unlock() {
-	spin_unlock(&malloc_lock);
+    spin_unlock_irqrestore(&malloc_lock, malloc_lock_flags);
     return 0;
 }
 
@@ -5,6 +5,7 @@
 #include <levos/task.h>
 #include <levos/palloc.h>
 #include <levos/string.h>
+#include <levos/uaccess.h>
 
 pde_t kernel_pgd[1024] __page_align;
 
@@ -17,6 +18,7 @@ static page_t kernel_pgt[1024] __page_align; /* 768 */
 static page_t heap_1_pgt[1024] __page_align; /* 769 */
 static page_t heap_2_pgt[1024] __page_align; /* 770 */
 static page_t kernel_virt_pgt[1024] __page_align; /* IDK FIXME */
+static page_t user_shared_pgt[1024] __page_align; /* 1023 */
 
 inline int pde_index(uint32_t addr)
 {
@@ -68,22 +70,32 @@ inline pde_t create_pde(uint32_t phys_addr, int user, int rw)
 		   (phys_addr << PDE_ADDR_SHIFT);
 }
 
-void __noreturn
+void
 do_kernel_pagefault(page_t *page, struct pt_regs *regs, uint32_t cr2)
 {
+    uint32_t fixup;
+
     /* check if the kernel pagefaulted accessing user region */
     if (cr2 < VIRT_BASE) {
         //panic("ERMHAGERD\n");
         //printk("VOILA MOTHER FUCKERS\n");
+        if (((page && !*page) || !page) &&
+                vma_handle_pagefault(current_task, cr2) == 0)
+            return;
+
+        /* a user access that is allowed to fail, see uaccess.h */
+        fixup = search_exception_table((uint32_t) regs->eip);
+        if (fixup) {
+            regs->eip = (void *) fixup;
+            return;
+        }
+
         if ((page && !*page) || !page) {
-            int rc = vma_handle_pagefault(current_task, cr2);
-            if (rc) {
-                printk("unable to handle a missing user page accessed from kernelspace at 0x%x!\n", cr2);
-                dump_registers(regs);
-                dump_stack(8);
-                vma_dump(current_task);
-                send_signal(current_task, SIGSEGV);
-            }
+            printk("unable to handle a missing user page accessed from kernelspace at 0x%x!\n", cr2);
+            dump_registers(regs);
+            dump_stack(8);
+            vma_dump(current_task);
+            send_signal(current_task, SIGSEGV);
 
             return;
         }
@@ -263,7 +275,9 @@ handle_pagefault(struct pt_regs *regs)
         return;
     }
 
-    current_task->sys_regs = regs;
+    /* faults in the kernel do not change where the system call returns to */
+    if (regs->cs & 3)
+        current_task->sys_regs = regs;
 
     /* if a COW page is written then fetch new page and map */
     page = get_page_from_curr(PG_RND_DOWN(cr2));
@@ -328,6 +342,21 @@ map_page(pagedir_t pgd, uint32_t phys_addr, uint32_t virt_addr, int perm)
     return 0;
 }
 
+/*
+ * map_user_shared - let every process read a page of the kernel
+ *
+ * @phys - physical address of the page
+ * @virt - where to map it, in the USER_SHARED_BASE area
+ *
+ * The kernel keeps writing to the page through its own mapping.
+ */
+void
+map_user_shared(uint32_t phys, uint32_t virt)
+{
+    user_shared_pgt[pte_index(virt)] = create_pte(phys, 1, 0);
+    __flush_tlb();
+}
+
 int
 page_mapped(pagedir_t pgd, uint32_t virt_addr)
 {
@@ -354,8 +383,6 @@ page_mapped_curr(uint32_t virt_addr)
 int
 map_page_curr(uint32_t p, uint32_t v, int perm)
 {
-    extern struct task *current_task;
-
     if (!current_task)
         panic("invalid mappagecurr\n");
 
@@ -607,6 +634,10 @@ paging_init(void)
     kernel_pgd[pde_index(VIRT_BASE + 16 * 10124 * 1024)]
             = create_pde(kv2p(kernel_virt_pgt), 0, 1);
 
+    /* user accessible, but every process shares the page table */
+    kernel_pgd[pde_index(USER_SHARED_BASE)]
+            = create_pde(kv2p(user_shared_pgt), 1, 0);
+
     activate_pgd(kernel_pgd);
     printk("page: kernel directory activated\n");
     ENABLE_IRQ();
@@ -2,6 +2,7 @@
 #include <levos/palloc.h>
 #include <levos/arch.h>
 #include <levos/bitmap.h>
+#include <levos/spinlock.h>
 
 static int palloc_total_pages;
 
@@ -14,24 +15,32 @@ static struct bitmap pre_palloc_bitmap = {
 
 static struct bitmap *palloc_bitmap = &pre_palloc_bitmap;
 
-static void
-palloc_mark(int id)
-{
-    bitmap_mark(palloc_bitmap, id);
-}
+/*
+ * Guards palloc_bitmap, pages are taken and given back on every CPU, from
+ * page faults and interrupt handlers too.
+ */
+static spinlock_t palloc_lock;
 
 void
 palloc_mark_address(uintptr_t ptr)
 {
+    uint32_t flags;
+
+    flags = spin_lock_irqsave(&palloc_lock);
     bitmap_mark(palloc_bitmap, ptr / 4096);
+    spin_unlock_irqrestore(&palloc_lock, flags);
 }
 
 void
 palloc_free_pages(void *addr, int num)
 {
+    uint32_t flags;
+
     panic_ifnot((int) addr % 4096 == 0);
 
+    flags = spin_lock_irqsave(&palloc_lock);
     bitmap_set_multiple(palloc_bitmap, ((int)addr / 4096), num, 0);
+    spin_unlock_irqrestore(&palloc_lock, flags);
     return;
 }
 
@@ -44,9 +53,12 @@ palloc_free_page(void *addr)
 uintptr_t
 palloc_get_pages(int num)
 {
+    uint32_t flags;
     size_t pg;
 
+    flags = spin_lock_irqsave(&palloc_lock);
     pg = bitmap_scan_and_flip(palloc_bitmap, 0, num, 0);
+    spin_unlock_irqrestore(&palloc_lock, flags);
     if (pg == BITMAP_ERROR)
         panic("Out of physical memory\n");
 
@@ -62,7 +74,12 @@ palloc_get_page(void)
 size_t
 palloc_get_free(void)
 {
-    int ret = bitmap_count(palloc_bitmap, 0, palloc_bitmap->bit_cnt, 0);
+    uint32_t flags;
+    int ret;
+
+    flags = spin_lock_irqsave(&palloc_lock);
+    ret = bitmap_count(palloc_bitmap, 0, palloc_bitmap->bit_cnt, 0);
+    spin_unlock_irqrestore(&palloc_lock, flags);
     //printk("%d pages are marked as 0\n", ret);
     return ret;
 }
@@ -142,12 +159,18 @@ palloc_proc_memtotal(int pos, void *buf, size_t len, char *__arg)
 void
 palloc_reinit(void)
 {
-    DISABLE_IRQ();
-    palloc_bitmap = bitmap_create(arch_get_total_ram() / 4096) ;
-    if (palloc_bitmap == NULL)
+    struct bitmap *bitmap;
+    uint32_t flags;
+
+    /* the heap may want pages of its own, so not under the lock */
+    bitmap = bitmap_create(arch_get_total_ram() / 4096) ;
+    if (bitmap == NULL)
         panic("failed to reinitalize palloc\n");
-    memcpy(palloc_bitmap->bits, palloc_bitmap_bits, 8192);
-    ENABLE_IRQ();
+
+    flags = spin_lock_irqsave(&palloc_lock);
+    memcpy(bitmap->bits, palloc_bitmap_bits, 8192);
+    palloc_bitmap = bitmap;
+    spin_unlock_irqrestore(&palloc_lock, flags);
 }
 
 void
@@ -155,6 +178,7 @@ palloc_init(void)
 {
     uintptr_t ptr;
 
+    spin_lock_init(&palloc_lock);
     memset(palloc_bitmap_bits, 0, 8192);
 
     //palloc_total_pages = arch_get_total_ram() / 4096;
@@ -4,49 +4,90 @@
 #include <levos/list.h>
 #include <levos/work.h>
 #include <levos/task.h>
+#include <levos/rcu.h>
+#include <levos/spinlock.h>
 
-static struct hash arpcache;
+/*
+ * The cache is looked up for every packet we send, so lookups are
+ * lockless: the chains are RCU protected, and only inserting and
+ * expiring entries takes arpcache_lock.
+ */
+#define ARP_HASH_SIZE 64
+
+static struct arp_cache_entry *arpcache[ARP_HASH_SIZE];
+static spinlock_t arpcache_lock;
 
 struct arp_cache_entry {
     eth_addr_t ace_eth;
     ip_addr_t ace_ip;
     uint32_t ace_expiry;
-    struct hash_elem helem;
+    struct arp_cache_entry *ace_next;
+    struct rcu_head ace_rcu;
 };
 
-static bool
-arp_hash_ip_less(const struct hash_elem *ha,
-                 const struct hash_elem *hb,
-                 void *aux)
+static inline struct arp_cache_entry **
+arp_bucket(ip_addr_t ip)
+{
+    return &arpcache[hash_int(ip) % ARP_HASH_SIZE];
+}
+
+/* caller holds arpcache_lock or is in an RCU read-side critical section */
+static struct arp_cache_entry *
+__arp_cache_find(ip_addr_t ip)
 {
-    struct arp_cache_entry *a = hash_entry(ha, struct arp_cache_entry, helem);
-    struct arp_cache_entry *b = hash_entry(hb, struct arp_cache_entry, helem);
+    struct arp_cache_entry *entry;
 
-    return a->ace_ip < b->ace_ip;
+    for (entry = rcu_dereference(*arp_bucket(ip)); entry;
+            entry = rcu_dereference(entry->ace_next))
+        if (entry->ace_ip == ip)
+            return entry;
+
+    return NULL;
 }
 
-static unsigned
-arp_hash_ip(const struct hash_elem *ha, void *aux)
+/* copy the address IP is at to ETH, returns 0 if it's in the cache */
+static int
+arp_cache_lookup(ip_addr_t ip, eth_addr_t eth)
 {
-    struct arp_cache_entry *a = hash_entry(ha, struct arp_cache_entry, helem);
+    struct arp_cache_entry *entry;
+
+    rcu_read_lock();
+    entry = __arp_cache_find(ip);
+    if (entry)
+        memcpy(eth, entry->ace_eth, 6);
+    rcu_read_unlock();
 
-    return hash_int(a->ace_ip);
+    return entry ? 0 : -ENOENT;
+}
+
+static void
+arp_free_entry_rcu(struct rcu_head *head)
+{
+    free(container_of(head, struct arp_cache_entry, ace_rcu));
 }
 
 static void
 arp_remove_entry_work(void *v)
 {
-    struct arp_cache_entry *entry = v;
+    struct arp_cache_entry *entry = v, **link;
+    uint32_t flags;
 
-    hash_delete(&arpcache, &entry->helem);
+    flags = spin_lock_irqsave(&arpcache_lock);
+    for (link = arp_bucket(entry->ace_ip); *link != entry;
+            link = &(*link)->ace_next)
+        ;
+    rcu_assign_pointer(*link, entry->ace_next);
+    spin_unlock_irqrestore(&arpcache_lock, flags);
 
-    free(entry);
+    call_rcu(&entry->ace_rcu, arp_free_entry_rcu);
 }
 
 int
 arp_cache_insert(ip_addr_t ip, eth_addr_t eth)
 {
     struct work *work;
+    struct arp_cache_entry **bucket;
+    uint32_t flags;
     struct arp_cache_entry *entry = malloc(sizeof(*entry));
     if (!entry)
         return -ENOMEM;
@@ -54,10 +95,29 @@ arp_cache_insert(ip_addr_t ip, eth_addr_t eth)
     memcpy(entry->ace_eth, eth, 6);
     entry->ace_ip = ip;
     entry->ace_expiry = 1000000;
-    hash_insert(&arpcache, &entry->helem);
 
-    /* schedule work to remove it */
     work = work_create(arp_remove_entry_work, entry);
+    if (!work) {
+        free(entry);
+        return -ENOMEM;
+    }
+
+    flags = spin_lock_irqsave(&arpcache_lock);
+
+    /* the first answer stays until it expires */
+    if (__arp_cache_find(ip)) {
+        spin_unlock_irqrestore(&arpcache_lock, flags);
+        free(work);
+        free(entry);
+        return 0;
+    }
+
+    bucket = arp_bucket(ip);
+    entry->ace_next = *bucket;
+    rcu_assign_pointer(*bucket, entry);
+    spin_unlock_irqrestore(&arpcache_lock, flags);
+
+    /* schedule work to remove it */
     schedule_work_delay(work, entry->ace_expiry);
 
     net_printk("%s: %pI is at %pE\n", __func__, ip, eth);
@@ -65,65 +125,61 @@ arp_cache_insert(ip_addr_t ip, eth_addr_t eth)
     return 0;
 }
 
-uint8_t *
-arp_do_request_eth(struct net_info *ni, ip_addr_t ip)
+static int
+arp_do_request_eth(struct net_info *ni, ip_addr_t ip, eth_addr_t eth)
 {
     packet_t *pkt;
     struct net_device *ndev = NDEV_FROM_NI(ni);
-    int delay = 100000, tries = 3;
-    struct hash_elem *entry;
-    struct arp_cache_entry ace;
-
-    ace.ace_ip = to_be_32(ip);
+    int delay = 100000;
 
     pkt = arp_construct_request_eth_ip(ni->ni_hw_mac, ni->ni_src_ip, ip);
     if (!pkt)
-        return NULL;
+        return -ENOMEM;
 
     /* send the packet */
     ndev->send_packet(ndev, pkt);
 
-    entry = hash_find(&arpcache, &ace.helem);
-    while (entry == NULL) {
-
-        memset(&ace, 0, sizeof(ace));
-        ace.ace_ip = to_be_32(ip);
-
+    while (arp_cache_lookup(to_be_32(ip), eth)) {
         delay  --;
         if (delay <= 0)
-            return NULL;
+            return -EHOSTUNREACH;
 
         sched_yield();
-
-        entry = hash_find(&arpcache, &ace.helem);
     }
-    return hash_entry(entry, struct arp_cache_entry, helem)->ace_eth;
+
+    return 0;
 }
 
-uint8_t *
-arp_get_eth_addr(struct net_info *ni, ip_addr_t ip)
+/*
+ * arp_get_eth_addr - resolve an IP address
+ *
+ * @ni - the interface to ask on
+ * @ip - the address
+ * @eth - where to put the ethernet address
+ *
+ * On a cache miss, sends a request and waits for the answer.  Returns
+ * -EHOSTUNREACH if nobody answered.
+ */
+int
+arp_get_eth_addr(struct net_info *ni, ip_addr_t ip, eth_addr_t eth)
 {
-    struct arp_cache_entry entry;
-    entry.ace_ip = to_be_32(ip);
-
-    net_printk("%s: %pI\n", __func__, entry.ace_ip);
-
-    struct hash_elem *helem = hash_find(&arpcache, &entry.helem);
-    if (helem == NULL) {
-        /* not in the cache, send request, wait then add to cache */
-        printk("%s: cache miss\n", __func__);
-        return arp_do_request_eth(ni, ip);
-    } else {
-        /* element was in the cache, return the ethernet address */
-        struct arp_cache_entry *entry = hash_entry(helem, struct arp_cache_entry, helem);
-        net_printk("%s: returned %pE\n", __func__, entry->ace_eth);
-        return entry->ace_eth;
+    net_printk("%s: %pI\n", __func__, to_be_32(ip));
+
+    if (arp_cache_lookup(to_be_32(ip), eth) == 0) {
+        /* element was in the cache */
+        net_printk("%s: returned %pE\n", __func__, eth);
+        return 0;
     }
+
+    /* not in the cache, send request, wait then add to cache */
+    printk("%s: cache miss\n", __func__);
+    return arp_do_request_eth(ni, ip, eth);
 }
 
 int
 arp_cache_init(void)
 {
-    hash_init(&arpcache, arp_hash_ip, arp_hash_ip_less, NULL);
+    spin_lock_init(&arpcache_lock);
     printk("arpcache: initialized ARP cache\n");
+    return 0;
 }
@@ -5,6 +5,7 @@
 #include <levos/tcp.h>
 #include <levos/udp.h>
 #include <levos/icmp.h>
+#include <levos/socket.h>
 
 void
 printk_print_ip_addr(uint32_t _ip)
@@ -127,11 +128,10 @@ packet_t *
 ip_construct_packet_ni(struct net_info *ni, ip_addr_t dst)
 {
     packet_t *pkt;
-    uint8_t *desteth;
+    eth_addr_t desteth;
 
     /* do the routing */
-    desteth = net_route_to(ni, dst);
-    if (desteth == NULL) {
+    if (net_route_to(ni, dst, desteth)) {
         printk("null eth\n");
         return NULL;
     }
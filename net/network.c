@@ -6,6 +6,9 @@
 #include <levos/udp.h>
 #include <levos/arp.h>
 #include <levos/bitmap.h>
+#include <levos/rcu.h>
+#include <levos/task.h>
+#include <levos/poll.h>
 
 struct list net_devices_list;
 spinlock_t net_devices_lock;
@@ -16,10 +19,11 @@ struct route {
     ip_addr_t iprt_gateway;
     struct net_device *iprt_iface;
 
-    struct list_elem iprt_elem;
+    struct route *iprt_next;
 };
 
-struct list route_table;
+/* the newest route first, RCU protected, writers take route_table_lock */
+static struct route *route_table;
 spinlock_t route_table_lock;
 
 spinlock_t port_lock;
@@ -39,7 +43,7 @@ net_init()
     spin_lock_init(&net_devices_lock);
 
     /* initialize routing table */
-    list_init(&route_table);
+    route_table = NULL;
     spin_lock_init(&route_table_lock);
 
     /* initialize srcport allocation */
@@ -74,16 +78,46 @@ net_add_route(struct net_device *iface, ip_addr_t base, ip_addr_t netmask,
     route->iprt_gateway = gateway;
     route->iprt_iface = iface;
 
-    list_push_front(&route_table, &route->iprt_elem);
+    route->iprt_next = route_table;
+    rcu_assign_pointer(route_table, route);
 
     spin_unlock(&route_table_lock);
     return 0;
 }
 
+/* the route to DST, the caller is in an RCU read-side critical section */
+static struct route *
+__route_lookup(ip_addr_t dst)
+{
+    struct route *route;
+
+    for (route = rcu_dereference(route_table); route;
+            route = rcu_dereference(route->iprt_next))
+        if ((route->iprt_base & route->iprt_netmask) ==
+                (dst & route->iprt_netmask))
+            return route;
+
+    return NULL;
+}
+
+/*
+ * net_find_route - the device packets to TARGET leave on
+ *
+ * Lockless, falls back to the default device.
+ */
 struct net_device *
 net_find_route(ip_addr_t target)
 {
-    return net_get_default();
+    struct net_device *ndev = NULL;
+    struct route *route;
+
+    rcu_read_lock();
+    route = __route_lookup(target);
+    if (route)
+        ndev = route->iprt_iface;
+    rcu_read_unlock();
+
+    return ndev ? ndev : net_get_default();
 }
 
 struct net_info *
@@ -118,39 +152,34 @@ __dump_route(struct route *iprt)
             __func__, iprt->iprt_base, iprt->iprt_netmask, iprt->iprt_gateway);
 }
 
-uint8_t *
-net_route_to(struct net_info *ni, ip_addr_t dst)
+/*
+ * net_route_to - the next hop's ethernet address for DST
+ *
+ * @ni - the interface we are sending on
+ * @dst - where the packet is going
+ * @eth - where to put the address
+ *
+ * Returns -ENETUNREACH if there is no route, -EHOSTUNREACH if the next
+ * hop does not answer ARP.
+ */
+int
+net_route_to(struct net_info *ni, ip_addr_t dst, eth_addr_t eth)
 {
-    uint8_t *desteth;
-    struct list_elem *elem;
     struct route *route;
+    ip_addr_t hop;
 
-    spin_lock(&route_table_lock);
-    list_foreach_raw(&route_table, elem) {
-        route = list_entry(elem, struct route, iprt_elem);
-
-        //printk("trying route to %pi: ", dst);
-        //__dump_route(route);
-
-        //printk("%pi vs %pi\n",
-                //route->iprt_base & route->iprt_netmask,
-                //dst & route->iprt_netmask);
-
-        if ((route->iprt_base & route->iprt_netmask) == (dst & route->iprt_netmask))
-            break;
+    rcu_read_lock();
+    route = __route_lookup(dst);
+    if (route) {
+        /* no gateway if it's a local network */
+        hop = route->iprt_gateway ? route->iprt_gateway : dst;
     }
-    spin_unlock(&route_table_lock);
-
-    //__dump_route(route);
+    rcu_read_unlock();
 
-    if (route->iprt_gateway == 0) {
-        /* this is a local network */
-        desteth = arp_get_eth_addr(ni, dst);
-    } else {
-        desteth = arp_get_eth_addr(ni, route->iprt_gateway);
-    }
+    if (!route)
+        return -ENETUNREACH;
 
-    return desteth;
+    return arp_get_eth_addr(ni, hop, eth);
 }
 
 int
@@ -264,6 +293,47 @@ socket_fs_write(struct file *filp, void *buf, size_t len)
     return sock->sock_ops->write(sock, buf, len);
 }
 
+size_t
+socket_fs_writev(struct file *filp, struct iovec *iov, int cnt)
+{
+    struct socket *sock = filp->priv;
+    int i, rc, total = 0;
+
+    if (sock->sock_ops->writev)
+        return sock->sock_ops->writev(sock, iov, cnt);
+
+    for (i = 0; i < cnt; i ++) {
+        rc = sock->sock_ops->write(sock, iov[i].iov_base, iov[i].iov_len);
+        if (rc < 0)
+            return total ? total : rc;
+        total += rc;
+    }
+
+    return total;
+}
+
+int
+socket_fs_poll(struct file *filp, struct poll_table *pt)
+{
+    struct socket *sock = filp->priv;
+
+    if (!sock->sock_ops->poll)
+        return DEFAULT_POLLMASK;
+
+    return sock->sock_ops->poll(sock, filp, pt);
+}
+
+int
+socket_fs_splice_write(struct file *filp, struct file *in, int *ppos, size_t len)
+{
+    struct socket *sock = filp->priv;
+
+    if (!sock->sock_ops->splice_write)
+        return generic_splice(in, ppos, filp, len);
+
+    return sock->sock_ops->splice_write(sock, in, ppos, len);
+}
+
 int
 socket_fs_fstat(struct file *filp, struct stat *buf)
 {
@@ -291,6 +361,9 @@ struct file_operations socket_fops = {
     .read = socket_fs_read,
     .write = socket_fs_write,
     .close = socket_fs_close,
+    .writev = socket_fs_writev,
+    .poll = socket_fs_poll,
+    .splice_write = socket_fs_splice_write,
 };
 
 /* wraps a socket in a struct file for inclusion in the filetable */
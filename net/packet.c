@@ -6,6 +6,9 @@
 #include <levos/list.h>
 #include <levos/tcp.h>
 #include <levos/work.h>
+#include <levos/task.h>
+#include <levos/wait.h>
+#include <levos/fs.h>
 #include <levos/e1000.h> /* FIXME: make it net_device eventually */
 
 #ifdef CONFIG_ETH_DEBUG
@@ -14,15 +17,18 @@
 #define net_printk(...) ;
 #endif
 
-static struct list packet_list;
-static spinlock_t packet_list_lock;
+/* packets handled before looking at the next ring */
+#define PACKET_BATCH 32
 
-struct packet_desc {
-    void *pdata;
-    size_t plen;
-    struct net_info *ni;
-    struct list_elem elem;
-};
+#define PACKET_MAX_RINGS 8
+
+/* the rx ring of every net_info, see net_info_init() */
+static struct packet_ring *packet_rings[PACKET_MAX_RINGS];
+static struct net_info *packet_ring_nis[PACKET_MAX_RINGS];
+static volatile int packet_nr_rings;
+
+/* the packet processor sleeps here while every ring is empty */
+static wait_queue_t packet_wq;
 
 packet_t *packet_allocate()
 {
@@ -121,7 +127,8 @@ packet_schedule_retransmission(struct net_info *ni,
     if (!work)
         return NULL;
 
-    schedule_work_delay(work, delay);
+    /* don't let retransmissions wait behind slow work */
+    queue_work_delay(system_highpri_wq, work, delay);
 
     return work;
 }
@@ -137,25 +144,57 @@ net_info_init(struct net_info *ni)
     hash_init(&ni->ni_tcp_infos, tcp_hash_tcp_info, tcp_less_tcp_info, NULL);
     hash_init(&ni->ni_udp_sockets, udp_hash_usp, udp_less_usp, NULL);
     spin_lock_init(&ni->ni_tcp_infos_lock);
+
+    if (packet_nr_rings == PACKET_MAX_RINGS)
+        panic("too many network interfaces\n");
+
+    packet_rings[packet_nr_rings] = &ni->ni_rx_ring;
+    packet_ring_nis[packet_nr_rings] = ni;
+    barrier();
+    packet_nr_rings ++;
 }
 
-/* THIS IS CALLED IN IRQ CONTEXT */
+/*
+ * packet_push_queue - hand a received packet to the packet processor
+ *
+ * @ni - the interface it came in on
+ * @packet - the frame, a malloc'd buffer we take over
+ * @len - its length
+ *
+ * Called from the NIC's bottom half, never from two CPUs at the same time
+ * for the same @ni.  If the ring is full the packet is dropped.
+ */
 void
 packet_push_queue(struct net_info *ni, void *packet, size_t len)
 {
-    struct packet_desc *desc = malloc(sizeof(*desc));
-    if (!desc)
-        return;
-
-    desc->pdata = packet;
-    desc->plen = len;
-    desc->ni = ni;
+    struct packet_ring *ring = &ni->ni_rx_ring;
+    uint32_t head = ring->pr_head, tail = ring->pr_tail;
+    struct packet_desc *desc;
 
-    spin_lock(&packet_list_lock);
+    ring->pr_received ++;
 
-    list_push_back(&packet_list, &desc->elem);
+    if (head - tail >= PACKET_RING_SIZE) {
+        ring->pr_drops ++;
+        free(packet);
+        return;
+    }
 
-    spin_unlock(&packet_list_lock);
+    desc = &ring->pr_descs[head % PACKET_RING_SIZE];
+    desc->pd_data = packet;
+    desc->pd_len = len;
+
+    /* the descriptor is filled in before the consumer can see it */
+    barrier();
+    ring->pr_head = head + 1;
+
+    /*
+     * Only wake the processor if the ring was empty, otherwise it still
+     * has our predecessors to handle and will find us too.  Pairs with
+     * prepare_to_wait() in packet_processor_thread().
+     */
+    __sync_synchronize();
+    if (ring->pr_tail == head && wait_queue_num_waiters(&packet_wq))
+        wait_wake_up_one(&packet_wq);
 }
 
 void
@@ -205,53 +244,103 @@ free:
     //heap_proc_heapstats(0, 0, NULL, 0);
 }
 
-void
-handle_packet(struct packet_desc *packet)
+static void
+handle_packet(struct net_info *ni, struct packet_desc *desc)
 {
-    struct net_info *ni;
     packet_t *pkt = malloc(sizeof(*pkt));
     if (!pkt) {
         printk("CRITICAL: dropped a packet due to OOM\n");
+        free(desc->pd_data);
         return;
     }
 
     /* setup the packet, reusing the buffer */
-    pkt->p_buf = packet->pdata;
-    pkt->p_ptr = packet->pdata;
-    pkt->p_len = packet->plen;
+    pkt->p_buf = desc->pd_data;
+    pkt->p_ptr = desc->pd_data;
+    pkt->p_len = desc->pd_len;
     pkt->pkt_payload_offset = 0;
     pkt->pkt_ip_offset = 0;
     pkt->pkt_proto_offset = 0;
-    
-    ni = packet->ni;
-
-    /* free the descriptor */
-    free(packet);
 
     /* handle the packet now */
     do_handle_packet(ni, pkt);
 }
 
+/* handle up to PACKET_BATCH packets from RING, returns how many */
+static int
+packet_ring_drain(struct net_info *ni, struct packet_ring *ring)
+{
+    uint32_t head = ring->pr_head, tail = ring->pr_tail;
+    struct packet_desc batch[PACKET_BATCH];
+    int n = 0;
+
+    /* the descriptors are not read before pr_head */
+    barrier();
+
+    while (tail != head && n < PACKET_BATCH)
+        batch[n ++] = ring->pr_descs[tail ++ % PACKET_RING_SIZE];
+
+    /* give the slots back in one go */
+    barrier();
+    ring->pr_tail = tail;
+
+    for (int i = 0; i < n; i ++)
+        handle_packet(ni, &batch[i]);
+
+    return n;
+}
+
+static int
+packet_rings_empty(void)
+{
+    for (int i = 0; i < packet_nr_rings; i ++)
+        if (packet_rings[i]->pr_head != packet_rings[i]->pr_tail)
+            return 0;
+
+    return 1;
+}
+
 void
 packet_processor_thread()
 {
+    struct wait_queue_entry wqe;
+    int i, handled;
+
     printk("packethandler: process spawned\n");
-    list_init(&packet_list);
-    spin_lock_init(&packet_list_lock);
+    wait_queue_init(&packet_wq);
+    memset(&wqe, 0, sizeof(wqe));
 
     while (1) {
-        if (list_empty(&packet_list)) {
-            sched_yield();
+        handled = 0;
+        for (i = 0; i < packet_nr_rings; i ++)
+            handled += packet_ring_drain(packet_ring_nis[i], packet_rings[i]);
+
+        if (handled)
             continue;
-        }
 
-        spin_lock(&packet_list_lock);
-        struct packet_desc *desc
-            = list_entry(list_pop_front(&packet_list),
-                         struct packet_desc,
-                         elem);
-        spin_unlock(&packet_list_lock);
+        /* packet_push_queue() wakes us up */
+        prepare_to_wait(&packet_wq, &wqe);
+        if (packet_rings_empty())
+            sched_yield();
+        finish_wait(&packet_wq, &wqe);
+    }
+}
 
-        handle_packet(desc);
+/* /proc/rxrings: packets received and dropped on every rx ring */
+size_t
+packet_proc_rxrings(int pos, void *buf, size_t len, char *__arg)
+{
+    char buffer[64 * (PACKET_MAX_RINGS + 1)];
+    struct packet_ring *ring;
+    int off, i;
+
+    off = snprintf(buffer, sizeof(buffer), "ring received dropped queued\n");
+    for (i = 0; i < packet_nr_rings; i ++) {
+        ring = packet_rings[i];
+        off += snprintf(buffer + off, sizeof(buffer) - off, "%d %u %u %u\n",
+                i, ring->pr_received, ring->pr_drops,
+                ring->pr_head - ring->pr_tail);
     }
+
+    return generic_write_buf(pos, buf, len, buffer);
 }
@@ -5,6 +5,8 @@
 #include <levos/arp.h>
 #include <levos/work.h>
 #include <levos/socket.h>
+#include <levos/poll.h>
+#include <levos/fs.h>
 
 /* TODO list:
  * 1) segment reconstruction
@@ -204,6 +206,7 @@ tcp_do_fail(struct net_info *ni, struct tcp_info *ti, int errno)
 {
     ti->ti_tcp_state = TI_STATE_CLOSED;
     ti->ti_fail_code = errno;
+    wait_wake_up(&ti->ti_wq);
 }
 
 void
@@ -229,6 +232,7 @@ tcp_notify_retransmit_failed(struct net_info *ni, packet_t *pkt)
     ti->ti_retransmit_work = NULL;
     ti->ti_fail_code = -ETIMEDOUT;
     ti->ti_tcp_state = TI_STATE_CLOSED;
+    wait_wake_up(&ti->ti_wq);
     return;
 }
 
@@ -330,6 +334,7 @@ tcp_conn_start(struct net_info *ni, port_t srcport, ip_addr_t dstip,
 
     ring_buffer_init(&ti->ti_rb, TCP_BUFFER_SIZE);
     ring_buffer_set_flags(&ti->ti_rb, RB_FLAG_NONBLOCK);
+    wait_queue_init(&ti->ti_wq);
 
     /* lock since we are manipulating */
     spin_lock(&ni->ni_tcp_infos_lock);
@@ -719,6 +724,7 @@ tcp_handle_packet_estab(struct net_info *ni, struct tcp_info *ti,
             if (ring_buffer_size(&ti->ti_rb) + payload_len < TCP_BUFFER_SIZE) {
                 /* XXX: does this need locking? */
                 ring_buffer_write(&ti->ti_rb, payload, payload_len);
+                wait_wake_up(&ti->ti_wq);
 
                 /* send ACK */
                 tcp_ack_packet(ni, pkt, ti, tcp);
@@ -778,6 +784,7 @@ tcp_handle_packet_estab(struct net_info *ni, struct tcp_info *ti,
 
         /* move to LAST_ACK */
         ti->ti_tcp_state = TI_STATE_LAST_ACK;
+        wait_wake_up(&ti->ti_wq);
 
         return PACKET_HANDLED;
     }
@@ -992,6 +999,89 @@ tcp_sock_write(struct socket *sock, void *buf, size_t len)
     return rc;
 }
 
+/* gather the segments so that they go out in one TCP segment */
+int
+tcp_sock_writev(struct socket *sock, struct iovec *iov, int cnt)
+{
+    size_t len = iov_length(iov, cnt), off = 0;
+    uint8_t *buf;
+    int i, rc;
+
+    buf = malloc(len);
+    if (!buf)
+        return -ENOMEM;
+
+    for (i = 0; i < cnt; off += iov[i].iov_len, i ++)
+        memcpy(buf + off, iov[i].iov_base, iov[i].iov_len);
+
+    rc = tcp_sock_write(sock, buf, len);
+    free(buf);
+
+    return rc;
+}
+
+/*
+ * tcp_sock_splice_write - send LEN bytes of IN
+ *
+ * Each segment is read from IN straight into the payload of its packet,
+ * so the data is copied once on its way out.
+ */
+int
+tcp_sock_splice_write(struct socket *sock, struct file *in, int *ppos, size_t len)
+{
+    struct tcp_info *ti = sock->sock_priv;
+    struct net_info *ni = sock->sock_ni;
+    struct tcp_header *ntcp;
+    packet_t *packet;
+    size_t seg, total = 0;
+    int rc = 0;
+
+    if (!ti || ti->ti_tcp_state != TI_STATE_ESTAB)
+        return -ENOTCONN;
+
+    while (total < len) {
+        seg = len - total;
+        if (seg > TCP_MSS)
+            seg = TCP_MSS;
+
+        packet = tcp_new_packet(ni, ti->ti_src_port, ti->ti_dstip, ti->ti_dst_port);
+        if (!packet) {
+            rc = -ENOMEM;
+            break;
+        }
+
+        if (packet_grow(packet, seg)) {
+            packet_destroy(packet);
+            rc = -ENOMEM;
+            break;
+        }
+
+        rc = vfs_read_at(in, packet->p_ptr, seg, ppos);
+        if (rc <= 0) {
+            packet_destroy(packet);
+            break;
+        }
+
+        /* a short read, trim what's left over */
+        packet->p_len -= seg - rc;
+
+        ntcp = packet->p_buf + packet->pkt_proto_offset;
+
+        tcp_packet_set_ack(packet, 1);
+        tcp_packet_set_psh(packet, 1);
+        ntcp->tcp_seq = to_be_32(ti->ti_next_seq);
+        ntcp->tcp_ack = to_be_32(ti->ti_next_ack);
+
+        tcp_send_packet(ni, ti, packet, rc);
+        total += rc;
+
+        if (rc < seg)
+            break;
+    }
+
+    return total ? (int) total : rc;
+}
+
 int
 tcp_sock_read(struct socket *sock, void *buf, size_t len)
 {
@@ -1006,6 +1096,35 @@ tcp_sock_read(struct socket *sock, void *buf, size_t len)
     return ring_buffer_read(&ti->ti_rb, buf, len);
 }
 
+/*
+ * readable while there's data, hung up once the other side is done, and
+ * writable for as long as the connection is up
+ */
+int
+tcp_sock_poll(struct socket *sock, struct file *filp, struct poll_table *pt)
+{
+    struct tcp_info *ti = sock->sock_priv;
+    int mask = 0;
+
+    if (!ti)
+        return POLLOUT | POLLHUP;
+
+    poll_wait(filp, &ti->ti_wq, pt);
+
+    if (ring_buffer_size(&ti->ti_rb))
+        mask |= POLLIN | POLLRDNORM;
+
+    if (ti->ti_tcp_state == TI_STATE_ESTAB)
+        mask |= POLLOUT | POLLWRNORM;
+    else
+        mask |= POLLHUP;
+
+    if (ti->ti_tcp_state == TI_STATE_CLOSED && ti->ti_fail_code)
+        mask |= POLLERR;
+
+    return mask;
+}
+
 int
 tcp_sock_destroy(struct socket *sock)
 {
@@ -1031,6 +1150,9 @@ tcp_sock_destroy(struct socket *sock)
 struct socket_ops tcp_sock_ops = {
     .connect = tcp_sock_connect,
     .write = tcp_sock_write,
+    .writev = tcp_sock_writev,
     .read = tcp_sock_read,
     .destroy = tcp_sock_destroy,
+    .poll = tcp_sock_poll,
+    .splice_write = tcp_sock_splice_write,
 };
@@ -7,6 +7,7 @@
 #include <levos/dhcp.h>
 #include <levos/work.h>
 #include <levos/socket.h>
+#include <levos/poll.h>
 
 unsigned udp_hash_usp(const struct hash_elem *e, void *aux)
 {
@@ -82,17 +83,21 @@ int udp_add_header(packet_t *pkt, port_t srcport, port_t dstport)
 }
 
 int
-udp_set_payload(packet_t *pkt, void *data, size_t len)
+udp_set_payload_iov(packet_t *pkt, struct iovec *iov, int cnt)
 {
     struct udp_header *udp;
     struct ip_base_header *ip;
+    size_t len = iov_length(iov, cnt);
+    uint8_t *p;
+    int i;
 
     /* first, grow the packet */
     if (packet_grow(pkt, len))
         return -ENOMEM;
 
-    /* add the payload */
-    memcpy(pkt->p_ptr, data, len);
+    /* add the payload, one segment after the other */
+    for (i = 0, p = pkt->p_ptr; i < cnt; p += iov[i].iov_len, i ++)
+        memcpy(p, iov[i].iov_base, iov[i].iov_len);
 
     /* update UDP header */
     udp = pkt->p_buf + pkt->pkt_proto_offset;
@@ -107,20 +112,26 @@ udp_set_payload(packet_t *pkt, void *data, size_t len)
     return 0;
 }
 
+int
+udp_set_payload(packet_t *pkt, void *data, size_t len)
+{
+    struct iovec iov = { .iov_base = data, .iov_len = len };
+
+    return udp_set_payload_iov(pkt, &iov, 1);
+}
+
 packet_t *udp_construct_packet(struct net_info *ni, 
                                eth_addr_t srceth, ip_addr_t srcip, port_t srcport,
                                ip_addr_t dstip, port_t dstport)
 {
     int rc;
     packet_t *pkt;
-    uint8_t *dsteth;
+    eth_addr_t dsteth;
 
     /* FIXME: ouch */
     dstip = to_be_32(dstip);
 
-    dsteth = arp_get_eth_addr(ni, dstip);
-
-    if (dsteth == NULL)
+    if (arp_get_eth_addr(ni, dstip, dsteth))
         return NULL;
 
     pkt = ip_construct_packet_eth_full(srceth, dsteth, srcip, dstip);
@@ -204,6 +215,7 @@ do_udp_handle_packet(struct net_info *ni, packet_t *pkt, struct udp_header *udp)
 
     /* off it goes */
     list_push_back(&usp->usp_dgrams, &dgram->udg_elem);
+    wait_wake_up(&usp->usp_wq);
 
     //printk("WROTE %d\n", payload_len);
 
@@ -239,6 +251,7 @@ do_udp_inet_sock_connect(struct socket *sock, struct sockaddr_in *addr, socklen_
 
     priv->usp_buffer_len = 0;
     list_init(&priv->usp_dgrams);
+    wait_queue_init(&priv->usp_wq);
 
     hash_insert(&sock->sock_ni->ni_udp_sockets, &priv->usp_helem);
 
@@ -262,12 +275,14 @@ udp_sock_connect(struct socket *sock, struct sockaddr *addr, socklen_t len)
     return -EINVAL;
 }
 
+/* the segments go out as a single datagram */
 int
-udp_sock_write(struct socket *sock, void *buf, size_t len)
+udp_sock_writev(struct socket *sock, struct iovec *iov, int cnt)
 {
     struct udp_sock_priv *priv = sock->sock_priv;
     struct net_device *ndev = NDEV_FROM_NI(sock->sock_ni);
     packet_t *pkt;
+    int rc;
 
     if (priv == NULL)
         return -ENOTCONN;
@@ -280,11 +295,23 @@ udp_sock_write(struct socket *sock, void *buf, size_t len)
     if (!pkt)
         return -ENOMEM;
 
-    udp_set_payload(pkt, buf, len);
+    rc = udp_set_payload_iov(pkt, iov, cnt);
+    if (rc) {
+        packet_destroy(pkt);
+        return rc;
+    }
 
     ndev->send_packet(ndev, pkt);
 
-    return 0;
+    return iov_length(iov, cnt);
+}
+
+int
+udp_sock_write(struct socket *sock, void *buf, size_t len)
+{
+    struct iovec iov = { .iov_base = buf, .iov_len = len };
+
+    return udp_sock_writev(sock, &iov, 1);
 }
 
 struct udp_dgram *
@@ -332,6 +359,24 @@ udp_sock_read(struct socket *sock, void *buf, size_t len)
     return alen;
 }
 
+/* datagrams go out right away, so it's always writable */
+int
+udp_sock_poll(struct socket *sock, struct file *filp, struct poll_table *pt)
+{
+    struct udp_sock_priv *priv = sock->sock_priv;
+    int mask = POLLOUT | POLLWRNORM;
+
+    if (priv == NULL)
+        return mask;
+
+    poll_wait(filp, &priv->usp_wq, pt);
+
+    if (!list_empty(&priv->usp_dgrams))
+        mask |= POLLIN | POLLRDNORM;
+
+    return mask;
+}
+
 int
 udp_sock_destroy(struct socket *sock)
 {
@@ -364,6 +409,8 @@ udp_sock_destroy(struct socket *sock)
 struct socket_ops udp_sock_ops = {
     .connect = udp_sock_connect,
     .write = udp_sock_write,
+    .writev = udp_sock_writev,
     .read = udp_sock_read,
     .destroy = udp_sock_destroy,
+    .poll = udp_sock_poll,
 };
@@ -0,0 +1,32 @@
+#ifndef __LEVOS_BENCH_H
+#define __LEVOS_BENCH_H
+
+#include <stdio.h>
+#include <stdint.h>
+#include <sys/time_page.h>
+
+/* timing for the microbenchmarks, times() only counts whole ticks */
+
+static inline uint64_t
+rdtsc(void)
+{
+    uint64_t tsc;
+
+    asm volatile("rdtsc" : "=A"(tsc));
+    return tsc;
+}
+
+/* N things took CYCLES TSC cycles, the time page knows how long that is */
+static inline void
+report(char *what, int n, uint64_t cycles)
+{
+    struct time_page *tp = (void *) TIME_PAGE_ADDR;
+
+    printf("%s: %d, %lu cycles each", what, n, (unsigned long) (cycles / n));
+    if (tp->tp_tsc_khz)
+        printf(", %lu us in all",
+                (unsigned long) (cycles * 1000 / tp->tp_tsc_khz));
+    printf("\n");
+}
+
+#endif /* __LEVOS_BENCH_H */
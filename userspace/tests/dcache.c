@@ -0,0 +1,79 @@
+#include <stdlib.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <string.h>
+#include <stdio.h>
+#include <errno.h>
+#include <sys/stat.h>
+
+#include "test.h"
+
+static char buf[256];
+
+/* the counter NAME from /proc/dcache, -1 if it's not there */
+static int
+dcache_stat(char *name)
+{
+    char *line, key[32];
+    int fd, len, val;
+
+    fd = open("/proc/dcache", O_RDONLY);
+    if (fd < 0)
+        return -1;
+
+    len = read(fd, buf, sizeof(buf) - 1);
+    close(fd);
+    if (len < 0)
+        return -1;
+    buf[len] = 0;
+
+    for (line = strtok(buf, "\n"); line; line = strtok(NULL, "\n"))
+        if (sscanf(line, "%31s %d", key, &val) == 2 && strcmp(key, name) == 0)
+            return val;
+
+    return -1;
+}
+
+int
+run_test()
+{
+    char file[64], dir[64], sub[64];
+    struct stat st;
+    int rc, fd, i, hits, neg;
+
+    /* the tree stays around between runs, so the names have to be new */
+    snprintf(file, sizeof(file), "/dcache-%d", getpid());
+    snprintf(dir, sizeof(dir), "/dcache-%d.d", getpid());
+    snprintf(sub, sizeof(sub), "%s/file", dir);
+
+    /* the second miss is answered from memory */
+    CHECK_ERR(stat(file, &st), ENOENT);
+    neg = dcache_stat("negative");
+    CHECK(neg >= 0, 1);
+    CHECK_ERR(stat(file, &st), ENOENT);
+    CHECK(dcache_stat("negative") > neg, 1);
+
+    /* creating it drops the negative entry */
+    fd = open(file, O_CREAT | O_RDWR, 0644);
+    CHECK(fd >= 0, 1);
+    CHECK(close(fd), 0);
+    CHECK(stat(file, &st), 0);
+
+    /* and looking it up again doesn't go to the disk */
+    hits = dcache_stat("hits");
+    for (i = 0; i < 16; i ++)
+        CHECK(stat(file, &st), 0);
+    CHECK(dcache_stat("hits") >= hits + 16, 1);
+
+    /* the same for mkdir() and a name in the new directory */
+    CHECK_ERR(stat(dir, &st), ENOENT);
+    CHECK(mkdir(dir, 0755), 0);
+    CHECK(stat(dir, &st), 0);
+    CHECK_ERR(stat(sub, &st), ENOENT);
+    fd = open(sub, O_CREAT | O_RDWR, 0644);
+    CHECK(fd >= 0, 1);
+    CHECK(close(fd), 0);
+    CHECK(stat(sub, &st), 0);
+
+    return 0;
+}
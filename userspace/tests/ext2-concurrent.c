@@ -0,0 +1,93 @@
+#include <stdlib.h>
+#include <stdio.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <string.h>
+#include <sys/wait.h>
+
+#include "test.h"
+
+#define NR_WRITERS 4
+#define NR_CHUNKS  8
+#define CHUNK_SIZE 1024
+
+static void
+file_name(char *buf, int n)
+{
+    sprintf(buf, "/ext2-concurrent-%d", n);
+}
+
+/* every writer allocates blocks and inodes at the same time as the others */
+static void
+writer(int n)
+{
+    char name[32], buf[CHUNK_SIZE];
+    int fd, i;
+
+    file_name(name, n);
+    fd = open(name, O_RDWR | O_CREAT, 0644);
+    if (fd < 0)
+        exit(1);
+
+    for (i = 0; i < NR_CHUNKS; i ++) {
+        memset(buf, 'a' + n * NR_CHUNKS + i, sizeof(buf));
+        if (write(fd, buf, sizeof(buf)) != sizeof(buf))
+            exit(2);
+    }
+
+    close(fd);
+    exit(0);
+}
+
+static int
+verify(int n)
+{
+    char name[32], buf[CHUNK_SIZE];
+    int fd, i, j;
+
+    file_name(name, n);
+    fd = open(name, O_RDONLY);
+    if (fd < 0)
+        return 0;
+
+    for (i = 0; i < NR_CHUNKS; i ++) {
+        if (read(fd, buf, sizeof(buf)) != sizeof(buf))
+            goto fail;
+
+        for (j = 0; j < CHUNK_SIZE; j ++)
+            if (buf[j] != 'a' + n * NR_CHUNKS + i)
+                goto fail;
+    }
+
+    close(fd);
+    return 1;
+
+fail:
+    close(fd);
+    return 0;
+}
+
+int
+run_test()
+{
+    int rc, i, status;
+    pid_t pids[NR_WRITERS];
+
+    for (i = 0; i < NR_WRITERS; i ++) {
+        pids[i] = fork();
+        if (pids[i] == 0)
+            writer(i);
+        CHECK(pids[i] > 0, 1);
+    }
+
+    for (i = 0; i < NR_WRITERS; i ++) {
+        CHECK(waitpid(pids[i], &status, 0), pids[i]);
+        CHECK(WEXITSTATUS(status), 0);
+    }
+
+    /* nobody's blocks or inodes ended up in somebody else's file */
+    for (i = 0; i < NR_WRITERS; i ++)
+        CHECK(verify(i), 1);
+
+    test_success();
+}
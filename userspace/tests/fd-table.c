@@ -0,0 +1,82 @@
+#include <stdlib.h>
+#include <stdio.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/wait.h>
+#include <sys/errno.h>
+
+#include "test.h"
+
+/* see FD_MAX in include/levos/fdtable.h */
+#define FD_MAX 1024
+
+#define NR_FDS 200
+
+int
+run_test()
+{
+    int rc, i, status;
+    pid_t pid;
+
+    /* well past the 32 a table starts out with */
+    for (i = 3; i < NR_FDS; i ++) {
+        CHECK(dup(0), i);
+    }
+
+    /* the lowest free one is handed out */
+    CHECK(close(17), 0);
+    CHECK(close(150), 0);
+    CHECK(dup(0), 17);
+    CHECK(dup(0), 150);
+    CHECK(dup(0), NR_FDS);
+
+    /* dup2() grows the table to where it's asked to */
+    CHECK(dup2(0, 900), 900);
+    CHECK(dup2(0, FD_MAX - 1), FD_MAX - 1);
+    CHECK_ERR(dup2(0, FD_MAX), EBADF);
+    CHECK_ERR(dup2(555, 556), EBADF);
+
+    /* F_DUPFD looks from its argument on */
+    CHECK(fcntl(0, F_DUPFD, 900), 901);
+    CHECK_ERR(fcntl(0, F_DUPFD, FD_MAX), EINVAL);
+
+    /* the flags are per descriptor */
+    CHECK(fcntl(900, F_SETFD, FD_CLOEXEC), 0);
+    CHECK(fcntl(900, F_GETFD), FD_CLOEXEC);
+    CHECK(fcntl(901, F_GETFD), 0);
+    CHECK(fcntl(900, F_SETFD, 0), 0);
+    CHECK(fcntl(900, F_GETFD), 0);
+
+    /* and cleared when the slot is reused */
+    CHECK(fcntl(901, F_SETFD, FD_CLOEXEC), 0);
+    CHECK(close(901), 0);
+    CHECK(fcntl(0, F_DUPFD, 901), 901);
+    CHECK(fcntl(901, F_GETFD), 0);
+
+    /* the child gets a copy, closing there leaves ours alone */
+    pid = fork();
+    if (pid == 0) {
+        if (fcntl(FD_MAX - 1, F_GETFD) != 0)
+            exit(1);
+        if (close(900) != 0)
+            exit(2);
+        exit(0);
+    }
+    CHECK(waitpid(pid, &status, 0), pid);
+    CHECK(WEXITSTATUS(status), 0);
+    CHECK(fcntl(900, F_GETFD), 0);
+
+    /* it's all the way full */
+    while (dup(0) >= 0)
+        ;
+    CHECK(errno, EMFILE);
+    CHECK(close(FD_MAX - 2), 0);
+    CHECK(dup(0), FD_MAX - 2);
+
+    for (i = 3; i < FD_MAX; i ++)
+        close(i);
+
+    CHECK(dup(0), 3);
+
+    return 0;
+}
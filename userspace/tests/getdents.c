@@ -0,0 +1,122 @@
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <sys/stat.h>
+#include <sys/errno.h>
+
+#include "test.h"
+
+/* newlib has no wrapper for it */
+#define SYS_GETDENTS 0x8d
+
+/* see include/levos/fs.h */
+struct getdents_dirent {
+    unsigned long  d_ino;
+    unsigned long  d_off;
+    unsigned short d_reclen;
+    char           d_name[];
+};
+
+#define NR_FILES 80
+
+static char buf[4096];
+
+static int
+getdents(int fd, void *p, int size)
+{
+    return sys(SYS_GETDENTS, fd, (int) p, size, 0);
+}
+
+/* whether the records in buf up to LEN are well formed, with NAME in them */
+static int
+walk(int len, char *name, int *nr_files, int *found)
+{
+    struct getdents_dirent *d;
+    int off;
+
+    for (off = 0; off < len; off += d->d_reclen) {
+        d = (struct getdents_dirent *) (buf + off);
+
+        if (d->d_reclen % 4 || off + d->d_reclen > len)
+            return 0;
+        if (strlen(d->d_name) + 10 + 2 > d->d_reclen)
+            return 0;
+
+        if (strncmp(d->d_name, "file-", 5) == 0)
+            (*nr_files) ++;
+        if (name && strcmp(d->d_name, name) == 0)
+            *found = 1;
+    }
+
+    return 1;
+}
+
+int
+run_test()
+{
+    char path[64];
+    int rc, i, fd, len, calls, nr_files, found;
+
+    /* it's still there from an earlier run, that's fine */
+    rc = mkdir("/getdents-dir", 0755);
+    CHECK(rc == 0 || errno == EEXIST, 1);
+    for (i = 0; i < NR_FILES; i ++) {
+        snprintf(path, sizeof(path), "/getdents-dir/file-%02d", i);
+        fd = open(path, O_CREAT | O_RDWR, 0644);
+        CHECK(fd >= 0, 1);
+        CHECK(close(fd), 0);
+    }
+
+    fd = open("/getdents-dir", O_RDONLY);
+    CHECK(fd >= 0, 1);
+
+    /* a small buffer takes a few calls, and nothing is seen twice */
+    calls = nr_files = found = 0;
+    while ((len = getdents(fd, buf, 256)) > 0) {
+        CHECK(walk(len, ".", &nr_files, &found), 1);
+        calls ++;
+    }
+    CHECK(len, 0);
+    CHECK(nr_files, NR_FILES);
+    CHECK(found, 1);
+    CHECK(calls > 1, 1);
+
+    /* a big one gets it all at once */
+    CHECK(lseek(fd, 0, SEEK_SET), 0);
+    nr_files = found = 0;
+    len = getdents(fd, buf, sizeof(buf));
+    CHECK(walk(len, "..", &nr_files, &found), 1);
+    CHECK(nr_files, NR_FILES);
+    CHECK(found, 1);
+    CHECK(getdents(fd, buf, sizeof(buf)), 0);
+
+    /* not even one entry fits */
+    CHECK(lseek(fd, 0, SEEK_SET), 0);
+    CHECK_ERR(getdents(fd, buf, 8), EINVAL);
+    CHECK(close(fd), 0);
+
+    /* devfs and procfs */
+    fd = open("/dev", O_RDONLY);
+    CHECK(fd >= 0, 1);
+    nr_files = found = 0;
+    len = getdents(fd, buf, sizeof(buf));
+    CHECK(walk(len, "null", &nr_files, &found), 1);
+    CHECK(found, 1);
+    CHECK(close(fd), 0);
+
+    fd = open("/proc", O_RDONLY);
+    CHECK(fd >= 0, 1);
+    nr_files = found = 0;
+    len = getdents(fd, buf, sizeof(buf));
+    CHECK(walk(len, "syscalls", &nr_files, &found), 1);
+    CHECK(found, 1);
+    CHECK(close(fd), 0);
+
+    fd = open("/getdents-dir/file-00", O_RDONLY);
+    CHECK_ERR(getdents(fd, buf, sizeof(buf)), ENOTDIR);
+    CHECK(close(fd), 0);
+
+    return 0;
+}
@@ -0,0 +1,51 @@
+#include <stdlib.h>
+#include <stdio.h>
+#include <unistd.h>
+#include <stdint.h>
+#include <sys/sysenter.h>
+
+#include "test.h"
+#include "bench.h"
+
+/*
+ * System call entry microbenchmark: getpid() in a loop, once through
+ * "int $0x80" and once through SYSENTER.
+ */
+
+#define SYS_GETPID 0x14
+#define CALLS 100000
+
+int
+run_test()
+{
+    int rc, i;
+    pid_t pid = getpid();
+    uint64_t start, end;
+
+    CHECK(levos_int80(SYS_GETPID, 0, 0, 0, 0), pid);
+
+    start = rdtsc();
+    for (i = 0; i < CALLS; i ++)
+        levos_int80(SYS_GETPID, 0, 0, 0, 0);
+    end = rdtsc();
+    report("int $0x80", CALLS, end - start);
+
+    if (!levos_have_sysenter()) {
+        printf("no SYSENTER, nothing more to test\n");
+        return 0;
+    }
+
+    CHECK(levos_sysenter(SYS_GETPID, 0, 0, 0, 0), pid);
+
+    start = rdtsc();
+    for (i = 0; i < CALLS; i ++)
+        levos_sysenter(SYS_GETPID, 0, 0, 0, 0);
+    end = rdtsc();
+    report("sysenter", CALLS, end - start);
+
+    /* the stub picks it, and the registers survive the round trip */
+    CHECK(levos_syscall(SYS_GETPID, 0, 0, 0, 0), pid);
+    CHECK(getpid(), pid);
+
+    return 0;
+}
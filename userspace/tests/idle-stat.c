@@ -0,0 +1,72 @@
+#include <stdlib.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <string.h>
+#include <stdio.h>
+
+#include "test.h"
+
+/* see include/levos/time.h */
+#define HZ 200
+
+struct idle_stat {
+    unsigned uptime;
+    unsigned idle;
+    unsigned nohz;
+};
+
+/* the ticks from /proc/idle, summed over the CPUs, -1 on error */
+static int
+idle_stat(struct idle_stat *st)
+{
+    char buf[512], *line;
+    unsigned idle, nohz;
+    int fd, len, cpu, cpus = 0;
+
+    fd = open("/proc/idle", O_RDONLY);
+    if (fd < 0)
+        return -1;
+
+    len = read(fd, buf, sizeof(buf) - 1);
+    close(fd);
+    if (len <= 0)
+        return -1;
+    buf[len] = 0;
+
+    if (sscanf(buf, "uptime %u", &st->uptime) != 1)
+        return -1;
+
+    st->idle = st->nohz = 0;
+    for (line = strtok(buf, "\n"); line; line = strtok(NULL, "\n")) {
+        if (sscanf(line, "cpu%d idle %u nohz %u", &cpu, &idle, &nohz) != 3)
+            continue;
+
+        st->idle += idle;
+        st->nohz += nohz;
+        cpus ++;
+    }
+
+    return cpus ? 0 : -1;
+}
+
+int
+run_test()
+{
+    struct idle_stat before, after;
+    int rc;
+
+    CHECK(idle_stat(&before), 0);
+
+    /* nothing else runs, so the CPUs go tickless for most of it */
+    CHECK(sleep(1), 0);
+
+    CHECK(idle_stat(&after), 0);
+
+    /* time still moves while the tick is stopped */
+    CHECK(after.uptime - before.uptime >= HZ / 2, 1);
+
+    CHECK(after.nohz > before.nohz, 1);
+    CHECK(after.idle - before.idle >= HZ / 2, 1);
+
+    test_success();
+}
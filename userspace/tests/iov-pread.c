@@ -0,0 +1,72 @@
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <sys/errno.h>
+
+#include "test.h"
+
+/* newlib has no wrappers for these */
+#define SYS_READV  0x91
+#define SYS_WRITEV 0x92
+#define SYS_PREAD  0xb4
+#define SYS_PWRITE 0xb5
+
+struct iovec {
+    void  *iov_base;
+    size_t iov_len;
+};
+
+int
+run_test()
+{
+    int rc, fd, pipefd[2];
+    char a[8], b[8], buf[32];
+    struct iovec iov[3] = {
+        { "Hello", 5 },
+        { ", ", 2 },
+        { "vectored world", 14 },
+    };
+
+    fd = open("/iov-pread", O_CREAT | O_RDWR, 0644);
+    CHECK(fd >= 0, 1);
+
+    /* the segments land back to back, and move the position */
+    CHECK(sys(SYS_WRITEV, fd, (int) iov, 3, 0), 21);
+    CHECK(lseek(fd, 0, SEEK_CUR), 21);
+
+    /* positional I/O leaves it alone */
+    memset(buf, 0, sizeof(buf));
+    CHECK(sys(SYS_PREAD, fd, (int) buf, 5, 7), 5);
+    CHECK(memcmp(buf, "vecto", 5), 0);
+    CHECK(sys(SYS_PWRITE, fd, (int) "J", 1, 0), 1);
+    CHECK(lseek(fd, 0, SEEK_CUR), 21);
+
+    /* reading past the end is not an error */
+    CHECK(sys(SYS_PREAD, fd, (int) buf, 5, 100), 0);
+
+    /* scatter it back */
+    CHECK(lseek(fd, 0, SEEK_SET), 0);
+    iov[0].iov_base = a;
+    iov[0].iov_len = sizeof(a);
+    iov[1].iov_base = b;
+    iov[1].iov_len = sizeof(b);
+    CHECK(sys(SYS_READV, fd, (int) iov, 2, 0), 16);
+    CHECK(memcmp(a, "Jello, v", 8), 0);
+    CHECK(memcmp(b, "ectored ", 8), 0);
+
+    /* a bad segment fails the whole call */
+    iov[1].iov_base = (void *) 0x11223344;
+    CHECK_ERR(sys(SYS_WRITEV, fd, (int) iov, 2, 0), EFAULT);
+    CHECK_ERR(sys(SYS_WRITEV, fd, (int) iov, -1, 0), EINVAL);
+
+    CHECK(close(fd), 0);
+
+    /* pipes have no position */
+    CHECK(pipe(pipefd), 0);
+    CHECK_ERR(sys(SYS_PREAD, pipefd[0], (int) buf, 1, 0), ESPIPE);
+    CHECK_ERR(sys(SYS_PWRITE, pipefd[1], (int) "x", 1, 0), ESPIPE);
+
+    return 0;
+}
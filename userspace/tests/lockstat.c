@@ -0,0 +1,63 @@
+#include <stdlib.h>
+#include <stdio.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <string.h>
+
+#include "test.h"
+
+/* acquisitions of lock class NAME in /proc/lockstat, -1 if it's not there */
+static int
+lock_acquired(char *name)
+{
+    static char buf[4096];
+    char class[64], *line;
+    unsigned acquired, contended, wait_max, hold_max;
+    int fd, len;
+
+    fd = open("/proc/lockstat", O_RDONLY);
+    if (fd < 0)
+        return -1;
+
+    len = read(fd, buf, sizeof(buf) - 1);
+    close(fd);
+    if (len <= 0)
+        return -1;
+    buf[len] = 0;
+
+    for (line = strtok(buf, "\n"); line; line = strtok(NULL, "\n")) {
+        if (sscanf(line, "%63s %u %u %u %u", class, &acquired, &contended,
+                    &wait_max, &hold_max) != 5)
+            continue;
+
+        /* a lock can't be contended more often than taken */
+        if (contended > acquired)
+            return -1;
+
+        if (strcmp(class, name) == 0)
+            return acquired;
+    }
+
+    return -1;
+}
+
+int
+run_test()
+{
+    int rc, fd, before;
+
+    /* only built with CONFIG_LOCK_STAT=y, see the Makefile */
+    fd = open("/proc/lockstat", O_RDONLY);
+    CHECK(fd >= 0, 1);
+    close(fd);
+
+    before = lock_acquired("&malloc_lock");
+    CHECK(before > 0, 1);
+
+    /* opening a file allocates from the kernel heap */
+    close(open("/proc/uptime", O_RDONLY));
+
+    CHECK(lock_acquired("&malloc_lock") > before, 1);
+
+    return 0;
+}
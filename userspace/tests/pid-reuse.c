@@ -0,0 +1,87 @@
+#include <stdlib.h>
+#include <stdio.h>
+#include <unistd.h>
+#include <errno.h>
+#include <sys/signal.h>
+#include <sys/wait.h>
+
+#include "test.h"
+
+/* see include/levos/pid.h */
+#define PID_MAX 32768
+
+/*
+ * Forks and reaps children until the PIDs wrap around, while one child
+ * that is still running and one zombie hold on to theirs.  Neither may be
+ * handed out again, every other one is gone as soon as it was reaped.
+ */
+int
+run_test()
+{
+    int rc, i, status, wrapped = 0, p[2];
+    pid_t held, zombie, pid, last;
+    char c;
+
+    CHECK(pipe(p), 0);
+
+    held = fork();
+    if (held == 0) {
+        close(p[1]);
+        read(p[0], &c, 1);
+        exit(0);
+    }
+    CHECK(held > 0, 1);
+    close(p[0]);
+
+    zombie = fork();
+    if (zombie == 0)
+        exit(0);
+    CHECK(zombie > 0, 1);
+    CHECK(zombie != held, 1);
+
+    /* let it die, we only reap it at the end */
+    sleep(1);
+    CHECK(kill(held, 0), 0);
+
+    last = zombie;
+    for (i = 0; i < PID_MAX + 16 && !wrapped; i ++) {
+        pid = fork();
+        if (pid == 0)
+            exit(0);
+
+        if (pid <= 0 || pid >= PID_MAX) {
+            printf("fork %d gave pid %d\n", i, pid);
+            return 1;
+        }
+
+        if (pid == held || pid == zombie || pid == last) {
+            printf("fork %d reused pid %d\n", i, pid);
+            return 1;
+        }
+
+        if (waitpid(pid, &status, 0) != pid || !WIFEXITED(status)) {
+            printf("could not reap pid %d\n", pid);
+            return 1;
+        }
+
+        if (kill(pid, 0) != -1 || errno != ESRCH) {
+            printf("pid %d is still there after it was reaped\n", pid);
+            return 1;
+        }
+
+        if (pid < last)
+            wrapped = 1;
+        last = pid;
+    }
+
+    printf("wrapped around to pid %d after %d forks\n", last, i);
+    CHECK(wrapped, 1);
+
+    CHECK(kill(held, 0), 0);
+    close(p[1]);
+    CHECK(waitpid(held, &status, 0), held);
+    CHECK(waitpid(zombie, &status, 0), zombie);
+    CHECK(WIFEXITED(status), 1);
+
+    test_success();
+}
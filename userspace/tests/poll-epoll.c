@@ -0,0 +1,150 @@
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <unistd.h>
+#include <stdint.h>
+#include <sys/time.h>
+#include <sys/wait.h>
+#include <sys/errno.h>
+
+#include "test.h"
+
+/* newlib has no wrappers for these */
+#define SYS_SELECT       0x52
+#define SYS_POLL         0xa8
+#define SYS_EPOLL_CREATE 0xfe
+#define SYS_EPOLL_CTL    0xff
+#define SYS_EPOLL_WAIT   0x100
+
+#define POLLIN  0x0001
+#define POLLOUT 0x0004
+#define POLLHUP 0x0010
+
+#define EPOLLET (1U << 31)
+
+#define EPOLL_CTL_ADD 1
+#define EPOLL_CTL_DEL 2
+#define EPOLL_CTL_MOD 3
+
+struct pollfd {
+    int   fd;
+    short events;
+    short revents;
+};
+
+struct epoll_event {
+    uint32_t events;
+    uint64_t data;
+};
+
+struct sel_arg_struct {
+    int n;
+    uint32_t *inp;
+    uint32_t *outp;
+    uint32_t *exp;
+    struct timeval *tvp;
+};
+
+static int
+epoll_ctl(int epfd, int op, int fd, uint32_t events, uint64_t data)
+{
+    struct epoll_event ev = { .events = events, .data = data };
+
+    return sys(SYS_EPOLL_CTL, epfd, op, fd, (int) &ev);
+}
+
+int
+run_test()
+{
+    int rc, ep, status, p[2], q[2];
+    struct pollfd pfd[2];
+    struct epoll_event ev[4];
+    struct timeval tv = { 0, 0 };
+    uint32_t in, out;
+    struct sel_arg_struct sel = { 0, &in, &out, NULL, &tv };
+    pid_t pid;
+    char c;
+
+    CHECK(pipe(p), 0);
+
+    /* an empty pipe is writable but not readable */
+    pfd[0].fd = p[0];
+    pfd[0].events = POLLIN;
+    pfd[1].fd = p[1];
+    pfd[1].events = POLLOUT;
+    CHECK(sys(SYS_POLL, (int) pfd, 2, 0, 0), 1);
+    CHECK(pfd[0].revents, 0);
+    CHECK(pfd[1].revents, POLLOUT);
+
+    /* select sees the same */
+    sel.n = p[1] + 1;
+    in = 1 << p[0];
+    out = 1 << p[1];
+    CHECK(sys(SYS_SELECT, (int) &sel, 0, 0, 0), 1);
+    CHECK(in, 0);
+    CHECK(out, 1 << p[1]);
+
+    /* and times out */
+    CHECK(sys(SYS_POLL, (int) pfd, 1, 50, 0), 0);
+    in = 1 << p[0];
+    out = 0;
+    tv.tv_usec = 50000;
+    CHECK(sys(SYS_SELECT, (int) &sel, 0, 0, 0), 0);
+    CHECK(in, 0);
+    tv.tv_usec = 0;
+
+    CHECK(write(p[1], "ab", 2), 2);
+    CHECK(sys(SYS_POLL, (int) pfd, 1, -1, 0), 1);
+    CHECK(pfd[0].revents, POLLIN);
+
+    /* level triggered, it's reported for as long as there is data */
+    ep = sys(SYS_EPOLL_CREATE, 1, 0, 0, 0);
+    CHECK(ep >= 0, 1);
+    CHECK(epoll_ctl(ep, EPOLL_CTL_ADD, p[0], POLLIN, 42), 0);
+    CHECK_ERR(epoll_ctl(ep, EPOLL_CTL_ADD, p[0], POLLIN, 42), EEXIST);
+    CHECK(sys(SYS_EPOLL_WAIT, ep, (int) ev, 4, 0), 1);
+    CHECK(ev[0].events, POLLIN);
+    CHECK(ev[0].data == 42, 1);
+    CHECK(sys(SYS_EPOLL_WAIT, ep, (int) ev, 4, 0), 1);
+
+    /* edge triggered, only once until the next wakeup */
+    CHECK(epoll_ctl(ep, EPOLL_CTL_MOD, p[0], POLLIN | EPOLLET, 7), 0);
+    CHECK(sys(SYS_EPOLL_WAIT, ep, (int) ev, 4, 0), 1);
+    CHECK(ev[0].data == 7, 1);
+    CHECK(sys(SYS_EPOLL_WAIT, ep, (int) ev, 4, 0), 0);
+    CHECK(read(p[0], &c, 1), 1);
+    CHECK(read(p[0], &c, 1), 1);
+
+    /* a wakeup from another process gets us out of a wait */
+    pid = fork();
+    if (pid == 0) {
+        sleep(1);
+        write(p[1], "x", 1);
+        exit(0);
+    }
+    CHECK(sys(SYS_EPOLL_WAIT, ep, (int) ev, 4, -1), 1);
+    CHECK(ev[0].events, POLLIN);
+    CHECK(read(p[0], &c, 1), 1);
+    CHECK(c, 'x');
+    CHECK(waitpid(pid, &status, 0), pid);
+
+    CHECK(epoll_ctl(ep, EPOLL_CTL_DEL, p[0], 0, 0), 0);
+    CHECK_ERR(epoll_ctl(ep, EPOLL_CTL_DEL, p[0], 0, 0), ENOENT);
+
+    /* the set doesn't keep a file open, closing it takes it out */
+    CHECK(pipe(q), 0);
+    CHECK(epoll_ctl(ep, EPOLL_CTL_ADD, q[1], POLLOUT, 1), 0);
+    CHECK(close(q[1]), 0);
+    CHECK(read(q[0], &c, 1), 0);
+    CHECK(sys(SYS_EPOLL_WAIT, ep, (int) ev, 4, 0), 0);
+    CHECK(close(q[0]), 0);
+    CHECK(close(ep), 0);
+
+    /* the read end hangs up with the write end gone */
+    CHECK(close(p[1]), 0);
+    CHECK(sys(SYS_POLL, (int) pfd, 1, -1, 0), 1);
+    CHECK(pfd[0].revents & POLLHUP, POLLHUP);
+    CHECK(close(p[0]), 0);
+
+    return 0;
+}
@@ -0,0 +1,57 @@
+#include <stdlib.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <string.h>
+#include <stdio.h>
+
+#include "test.h"
+
+/* number of rings in /proc/rxrings that look sane, -1 on error */
+static int
+rxrings_check(void)
+{
+    char buf[1024], *line;
+    unsigned received, dropped, queued;
+    int fd, len, ring, nr = 0;
+
+    fd = open("/proc/rxrings", O_RDONLY);
+    if (fd < 0)
+        return -1;
+
+    len = read(fd, buf, sizeof(buf) - 1);
+    close(fd);
+    if (len <= 0)
+        return -1;
+    buf[len] = 0;
+
+    if (strncmp(buf, "ring received dropped queued\n", 29) != 0)
+        return -1;
+
+    for (line = strtok(buf, "\n"); line; line = strtok(NULL, "\n")) {
+        if (sscanf(line, "%d %u %u %u", &ring, &received, &dropped,
+                    &queued) != 4)
+            continue;
+
+        /* a packet is either dropped or queued at first */
+        if (dropped + queued > received)
+            return -1;
+
+        /* the ring never holds more than fits */
+        if (queued > 256)
+            return -1;
+
+        nr ++;
+    }
+
+    return nr;
+}
+
+int
+run_test()
+{
+    int rc;
+
+    CHECK(rxrings_check() >= 0, 1);
+
+    test_success();
+}
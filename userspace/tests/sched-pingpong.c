@@ -0,0 +1,89 @@
+#include <stdlib.h>
+#include <stdio.h>
+#include <unistd.h>
+#include <stdint.h>
+#include <sys/wait.h>
+
+#include "test.h"
+#include "bench.h"
+
+/*
+ * Context switch microbenchmark: a parent and a child bounce a byte
+ * between each other through two pipes, so every round trip blocks (and
+ * switches) twice.  Then both of them call sched_yield() in a loop.
+ */
+
+#define ROUNDS 2000
+#define YIELDS 5000
+
+static int
+do_sched_yield(void)
+{
+    int ret;
+
+    /* newlib has no wrapper for this one */
+    asm volatile("int $0x80" : "=a"(ret) : "a"(0x9e) : "memory");
+    return ret;
+}
+
+int
+run_test()
+{
+    int rc, i, status, ping[2], pong[2];
+    uint64_t start, end;
+    unsigned char c;
+    pid_t cpid;
+
+    CHECK(pipe(ping), 0);
+    CHECK(pipe(pong), 0);
+
+    cpid = fork();
+    if (cpid == 0) {
+        close(ping[1]);
+        close(pong[0]);
+
+        for (i = 0; i < ROUNDS; i ++) {
+            if (read(ping[0], &c, 1) != 1 || c != (unsigned char) i)
+                exit(1);
+            c ++;
+            if (write(pong[1], &c, 1) != 1)
+                exit(1);
+        }
+
+        for (i = 0; i < YIELDS; i ++)
+            if (do_sched_yield())
+                exit(1);
+
+        exit(0);
+    }
+
+    CHECK(cpid > 0, 1);
+    close(ping[0]);
+    close(pong[1]);
+
+    start = rdtsc();
+    for (i = 0; i < ROUNDS; i ++) {
+        c = i;
+        if (write(ping[1], &c, 1) != 1 || read(pong[0], &c, 1) != 1 ||
+                c != (unsigned char) (i + 1)) {
+            printf("round trip %d failed\n", i);
+            return 1;
+        }
+    }
+    end = rdtsc();
+    report("pipe round trips", ROUNDS, end - start);
+
+    start = rdtsc();
+    for (i = 0; i < YIELDS; i ++)
+        if (do_sched_yield()) {
+            printf("sched_yield failed\n");
+            return 1;
+        }
+    end = rdtsc();
+    report("sched_yield calls", YIELDS, end - start);
+
+    CHECK(waitpid(cpid, &status, 0), cpid);
+    CHECK(WIFEXITED(status) && WEXITSTATUS(status) == 0, 1);
+
+    return 0;
+}
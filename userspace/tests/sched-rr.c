@@ -0,0 +1,84 @@
+#include <stdlib.h>
+#include <stdio.h>
+#include <unistd.h>
+#include <errno.h>
+#include <sys/signal.h>
+#include <sys/wait.h>
+
+#include "test.h"
+
+/* newlib has no wrappers for these, see kernel/syscall.c */
+#define SYS_SCHED_SETSCHEDULER 0x9c
+#define SYS_SCHED_GETSCHEDULER 0x9d
+#define SYS_SCHED_YIELD        0x9e
+
+/* see include/levos/task.h */
+#ifndef SCHED_OTHER
+#define SCHED_OTHER 0
+#define SCHED_FIFO  1
+#define SCHED_RR    2
+#endif
+
+static int
+setscheduler(pid_t pid, int policy, int prio)
+{
+    /* struct sched_param is just the priority */
+    return sys(SYS_SCHED_SETSCHEDULER, pid, policy, (int) &prio, 0);
+}
+
+static int
+getscheduler(pid_t pid)
+{
+    return sys(SYS_SCHED_GETSCHEDULER, pid, 0, 0, 0);
+}
+
+int
+run_test()
+{
+    int rc, status;
+    pid_t cpid;
+
+    CHECK(getscheduler(0), SCHED_OTHER);
+    CHECK(getscheduler(getpid()), SCHED_OTHER);
+
+    /* nonsense is refused and changes nothing */
+    CHECK_ERR(setscheduler(0, 42, 0), EINVAL);
+    CHECK_ERR(setscheduler(0, SCHED_OTHER, 1), EINVAL);
+    CHECK_ERR(setscheduler(0, SCHED_RR, 0), EINVAL);
+    CHECK_ERR(setscheduler(0, SCHED_RR, 100), EINVAL);
+    CHECK_ERR(sys(SYS_SCHED_SETSCHEDULER, 0, SCHED_RR, 0, 0), EFAULT);
+    CHECK_ERR(setscheduler(0x7ffffff, SCHED_RR, 10), ESRCH);
+    CHECK_ERR(getscheduler(0x7ffffff), ESRCH);
+    CHECK(getscheduler(0), SCHED_OTHER);
+
+    CHECK(setscheduler(0, SCHED_FIFO, 10), 0);
+    CHECK(getscheduler(0), SCHED_FIFO);
+    CHECK(setscheduler(0, SCHED_RR, 10), 0);
+    CHECK(getscheduler(0), SCHED_RR);
+
+    /*
+     * The child inherits the policy and never blocks.  Yielding puts us
+     * behind it, we only get the CPU back because its time slice runs
+     * out, which SCHED_FIFO would not do.
+     */
+    cpid = fork();
+    if (cpid == 0)
+        for (;;)
+            ;
+
+    CHECK(cpid > 0, 1);
+    CHECK(getscheduler(cpid), SCHED_RR);
+    CHECK(sys(SYS_SCHED_YIELD, 0, 0, 0, 0), 0);
+
+    /* and back, for someone else's task too */
+    CHECK(setscheduler(cpid, SCHED_OTHER, 0), 0);
+    CHECK(getscheduler(cpid), SCHED_OTHER);
+    CHECK(setscheduler(0, SCHED_OTHER, 0), 0);
+    CHECK(getscheduler(0), SCHED_OTHER);
+
+    CHECK(kill(cpid, SIGKILL), 0);
+    CHECK(waitpid(cpid, &status, 0), cpid);
+    CHECK(WIFSIGNALED(status), 1);
+
+    test_success();
+}
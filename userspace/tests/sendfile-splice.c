@@ -0,0 +1,90 @@
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <sys/errno.h>
+
+#include "test.h"
+
+/* newlib has no wrappers for these */
+#define SYS_SENDFILE 0xbb
+#define SYS_SPLICE   0x139
+
+#define SIZE 6000
+
+static char data[SIZE], buf[SIZE];
+
+/* read LEN bytes of FD, however many reads it takes */
+static int
+read_all(int fd, char *p, int len)
+{
+    int rc, total = 0;
+
+    while (total < len) {
+        rc = read(fd, p + total, len - total);
+        if (rc <= 0)
+            return total;
+        total += rc;
+    }
+
+    return total;
+}
+
+int
+run_test()
+{
+    int rc, i, src, dst, p[2], off;
+
+    for (i = 0; i < SIZE; i ++)
+        data[i] = 'a' + i % 23;
+
+    src = open("/sendfile-src", O_CREAT | O_RDWR | O_TRUNC, 0644);
+    CHECK(src >= 0, 1);
+    CHECK(write(src, data, SIZE), SIZE);
+    CHECK(close(src), 0);
+
+    src = open("/sendfile-src", O_RDONLY);
+    CHECK(src >= 0, 1);
+    CHECK(pipe(p), 0);
+
+    /* from an offset into a pipe, the file position stays put */
+    off = 100;
+    CHECK(sys(SYS_SENDFILE, p[1], src, (int) &off, 3000), 3000);
+    CHECK(off, 3100);
+    CHECK(lseek(src, 0, SEEK_CUR), 0);
+    CHECK(read_all(p[0], buf, 3000), 3000);
+    CHECK(memcmp(buf, data + 100, 3000), 0);
+
+    /* splice moves the file positions */
+    CHECK(sys(SYS_SPLICE, src, p[1], 2000, 0), 2000);
+    CHECK(lseek(src, 0, SEEK_CUR), 2000);
+
+    dst = open("/splice-dst", O_CREAT | O_RDWR | O_TRUNC, 0644);
+    CHECK(dst >= 0, 1);
+    CHECK(sys(SYS_SPLICE, p[0], dst, 2000, 0), 2000);
+    CHECK(lseek(dst, 0, SEEK_CUR), 2000);
+
+    /* one end has to be a pipe, and not both ends of the same one */
+    CHECK_ERR(sys(SYS_SPLICE, src, dst, 10, 0), EINVAL);
+    CHECK_ERR(sys(SYS_SPLICE, p[0], p[1], 10, 0), EINVAL);
+    CHECK_ERR(sys(SYS_SPLICE, p[0], dst, 10, 0x100), EINVAL);
+
+    /* file to file, the rest of it */
+    CHECK(sys(SYS_SENDFILE, dst, src, 0, SIZE), SIZE - 2000);
+    CHECK(sys(SYS_SENDFILE, dst, src, 0, SIZE), 0);
+
+    CHECK(lseek(dst, 0, SEEK_SET), 0);
+    CHECK(read_all(dst, buf, SIZE), SIZE);
+    CHECK(memcmp(buf, data, SIZE), 0);
+
+    CHECK_ERR(sys(SYS_SENDFILE, dst, 555, 0, 10), EBADF);
+    CHECK_ERR(sys(SYS_SENDFILE, dst, src, (int) 0xC0000000, 10), EFAULT);
+
+    CHECK(close(p[0]), 0);
+    CHECK(close(p[1]), 0);
+    CHECK(close(src), 0);
+    CHECK(close(dst), 0);
+
+    return 0;
+}
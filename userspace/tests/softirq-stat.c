@@ -0,0 +1,56 @@
+#include <stdlib.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <string.h>
+#include <stdio.h>
+
+#include "test.h"
+
+/* TIMER runs of CPU 0 according to /proc/softirqs, -1 on error */
+static int
+timer_softirqs(void)
+{
+    char buf[512], *line;
+    unsigned hi, timer, tasklet, rcu;
+    int fd, len, cpu;
+
+    fd = open("/proc/softirqs", O_RDONLY);
+    if (fd < 0)
+        return -1;
+
+    len = read(fd, buf, sizeof(buf) - 1);
+    close(fd);
+    if (len <= 0)
+        return -1;
+    buf[len] = 0;
+
+    if (strncmp(buf, "cpu HI TIMER TASKLET RCU\n", 25) != 0)
+        return -1;
+
+    for (line = strtok(buf, "\n"); line; line = strtok(NULL, "\n")) {
+        if (sscanf(line, "%d %u %u %u %u", &cpu, &hi, &timer, &tasklet,
+                    &rcu) != 5)
+            continue;
+
+        if (cpu == 0)
+            return timer;
+    }
+
+    return -1;
+}
+
+int
+run_test()
+{
+    int rc, before;
+
+    before = timer_softirqs();
+    CHECK(before >= 0, 1);
+
+    /* the tick of CPU 0 raises it */
+    CHECK(sleep(1), 0);
+
+    CHECK(timer_softirqs() > before, 1);
+
+    test_success();
+}
@@ -0,0 +1,111 @@
+#include <stdlib.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <string.h>
+#include <stdio.h>
+#include <errno.h>
+
+#include "test.h"
+
+/* see include/levos/sysstat.h */
+#define SYS_PRCTL 0xac
+#define PR_SET_SYSCALL_STATS 0x4c560001
+#define PR_SET_SYSCALL_TRACE 0x4c560002
+
+static char buf[16384];
+
+static int
+prctl(int option, int arg)
+{
+    return sys(SYS_PRCTL, option, arg, 0, 0);
+}
+
+/* all of PATH into buf */
+static int
+slurp(char *path)
+{
+    int fd, rc, len = 0;
+
+    fd = open(path, O_RDONLY);
+    if (fd < 0)
+        return -1;
+
+    while ((rc = read(fd, buf + len, sizeof(buf) - 1 - len)) > 0)
+        len += rc;
+    close(fd);
+
+    buf[len] = 0;
+    return len;
+}
+
+/* the calls and errors of NAME in the syscalls file PATH, -1 if it's not there */
+static int
+syscall_count(char *path, char *name, int *errors)
+{
+    char *line, sc[32];
+    int calls;
+
+    if (slurp(path) < 0)
+        return -1;
+
+    for (line = strtok(buf, "\n"); line; line = strtok(NULL, "\n")) {
+        if (sscanf(line, "%31s %d %d", sc, &calls, errors) != 3)
+            continue;
+
+        if (strcmp(sc, name) == 0)
+            return calls;
+    }
+
+    return -1;
+}
+
+int
+run_test()
+{
+    char path[64], line[64];
+    int rc, i, errors, before;
+
+    getpid();
+    before = syscall_count("/proc/syscalls", "getpid", &errors);
+    CHECK(before >= 1, 1);
+
+    for (i = 0; i < 10; i ++)
+        getpid();
+    CHECK(syscall_count("/proc/syscalls", "getpid", &errors) >= before + 10, 1);
+
+    /* nothing of ours until it's turned on */
+    snprintf(path, sizeof(path), "/proc/%d/syscalls", getpid());
+    CHECK(slurp(path), 0);
+
+    CHECK(prctl(PR_SET_SYSCALL_STATS, 1), 0);
+    for (i = 0; i < 5; i ++)
+        getppid();
+    CHECK_ERR(close(-1), EBADF);
+
+    CHECK(syscall_count(path, "getppid", &errors), 5);
+    CHECK(errors, 0);
+    CHECK(syscall_count(path, "close", &errors), 1);
+    CHECK(errors, 1);
+
+    /* the trace has the calls with their results */
+    CHECK(prctl(PR_SET_SYSCALL_TRACE, 1), 0);
+    CHECK_ERR(close(-1), EBADF);
+    getppid();
+
+    snprintf(path, sizeof(path), "/proc/%d/strace", getpid());
+    CHECK(slurp(path) > 0, 1);
+    CHECK(strstr(buf, "close(0xffffffff, ") != NULL, 1);
+    snprintf(line, sizeof(line), ") = %d <", -EBADF);
+    CHECK(strstr(buf, line) != NULL, 1);
+    snprintf(line, sizeof(line), ") = %d <", getppid());
+    CHECK(strstr(buf, line) != NULL, 1);
+
+    /* the read of the file itself is still going */
+    CHECK(strstr(buf, " ...\n") != NULL, 1);
+
+    CHECK(prctl(PR_SET_SYSCALL_TRACE, 0), 0);
+    CHECK(prctl(PR_SET_SYSCALL_STATS, 0), 0);
+    CHECK_ERR(prctl(12345, 1), EINVAL);
+
+    test_success();
+}
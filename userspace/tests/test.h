@@ -1,6 +1,9 @@
 #ifndef __LEVOS_TEST_H
 #define __LEVOS_TEST_H
 
+#include <errno.h>
+#include <sys/sysenter.h>
+
 extern int run_test();
 extern void test_failure(void);
 extern void test_success(void);
@@ -25,6 +28,19 @@ extern void test_success(void);
             printf("" #call " failed with rc %d\n", rc); \
             return 1; \
         }
-        
+
+/* a system call that newlib has no wrapper for, errors go to errno */
+static inline int
+sys(int no, int a, int b, int c, int d)
+{
+    int rc = levos_syscall(no, a, b, c, d);
+
+    if (rc < 0) {
+        errno = -rc;
+        return -1;
+    }
+
+    return rc;
+}
 
 #endif
@@ -0,0 +1,61 @@
+#include <stdlib.h>
+#include <stdio.h>
+#include <stdint.h>
+#include <string.h>
+#include <sys/time.h>
+#include <sys/time_page.h>
+#include <sys/sysenter.h>
+
+#include "test.h"
+
+#define SYS_GETTIMEOFDAY 0x4e
+
+int
+run_test()
+{
+    struct time_page *tp = (void *) TIME_PAGE_ADDR;
+    uint32_t sec, usec, sec2, usec2;
+    struct {
+        struct timeval tv;
+        long guard;
+    } k;
+    struct timeval tv, tv2;
+    int rc;
+
+    /* the system call fills in the struct <sys/time.h> has, no more */
+    memset(&k, 0x5a, sizeof(k));
+    CHECK(levos_syscall(SYS_GETTIMEOFDAY, (int) &k.tv, 0, 0, 0), 0);
+    CHECK(k.guard == 0x5a5a5a5a, 1);
+    CHECK(k.tv.tv_usec >= 0 && k.tv.tv_usec < 1000000, 1);
+
+    if (tp->tp_tsc_khz == 0) {
+        printf("no TSC, nothing more to test\n");
+        return 0;
+    }
+
+    printf("TSC at %u kHz\n", tp->tp_tsc_khz);
+
+    CHECK(time_page_read(tp, &sec, &usec), 0);
+    CHECK(levos_syscall(SYS_GETTIMEOFDAY, (int) &k.tv, 0, 0, 0), 0);
+    CHECK(time_page_read(tp, &sec2, &usec2), 0);
+
+    /* the kernel's and our view of the time agree */
+    CHECK(k.tv.tv_sec >= sec && k.tv.tv_sec <= sec2, 1);
+
+    /* and it does not go backwards */
+    CHECK(sec2 > sec || (sec2 == sec && usec2 >= usec), 1);
+
+    /*
+     * libc goes by the page, so the time moves on within a second, it
+     * doesn't jump from one to the next
+     */
+    CHECK(gettimeofday(&tv, NULL), 0);
+    do
+        rc = gettimeofday(&tv2, NULL);
+    while (rc == 0 && tv2.tv_sec == tv.tv_sec && tv2.tv_usec == tv.tv_usec);
+    CHECK(rc, 0);
+    CHECK(tv2.tv_usec >= 0 && tv2.tv_usec < 1000000, 1);
+    CHECK(tv2.tv_sec == tv.tv_sec && tv2.tv_usec > tv.tv_usec, 1);
+
+    return 0;
+}
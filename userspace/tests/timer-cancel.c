@@ -0,0 +1,76 @@
+#include <stdlib.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <sys/signal.h>
+#include <stdio.h>
+#include <errno.h>
+
+#include "test.h"
+
+static int __alarm_tick = 0;
+
+void
+alarm_tick(int sig)
+{
+    __alarm_tick ++;
+}
+
+struct timer_stats {
+    unsigned armed, fired, cancelled;
+    int pending;
+};
+
+static int
+read_timer_stats(struct timer_stats *ts)
+{
+    char buf[128];
+    int fd, len;
+
+    fd = open("/proc/timers", O_RDONLY);
+    if (fd < 0)
+        return -1;
+
+    len = read(fd, buf, sizeof(buf) - 1);
+    close(fd);
+    if (len <= 0)
+        return -1;
+
+    buf[len] = 0;
+    if (sscanf(buf, "armed %u\nfired %u\ncancelled %u\npending %d\n",
+                &ts->armed, &ts->fired, &ts->cancelled, &ts->pending) != 4)
+        return -1;
+
+    return 0;
+}
+
+int
+run_test()
+{
+    struct timer_stats before, after;
+    int rc;
+
+    CHECK(read_timer_stats(&before), 0);
+
+    CHECK((int) signal(SIGALRM, alarm_tick), (int) SIG_DFL);
+
+    /* the second alarm cancels the first one */
+    CHECK(alarm(5), 0);
+    CHECK(alarm(1) > 0, 1);
+
+    CHECK_ERR(sleep(10), EINTR);
+    CHECK(__alarm_tick, 1);
+
+    /* and the first one never goes off */
+    CHECK(sleep(6), 0);
+    CHECK(__alarm_tick, 1);
+
+    CHECK(read_timer_stats(&after), 0);
+    printf("armed %u fired %u cancelled %u\n", after.armed - before.armed,
+            after.fired - before.fired, after.cancelled - before.cancelled);
+
+    CHECK(after.armed - before.armed >= 2, 1);
+    CHECK(after.fired - before.fired >= 1, 1);
+    CHECK(after.cancelled - before.cancelled >= 1, 1);
+
+    test_success();
+}
@@ -0,0 +1,66 @@
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <errno.h>
+#include <unistd.h>
+#include <sys/times.h>
+#include <sys/resource.h>
+#include <sys/wait.h>
+
+#include "test.h"
+
+static void
+burn_cpu(void)
+{
+    volatile int c = 0x4000000;
+
+    while (c --)
+        ;
+}
+
+int
+run_test()
+{
+    struct tms before, after;
+    struct rusage ru_before;
+    struct {
+        struct rusage ru;
+        long guard;
+    } r;
+    int rc, status;
+
+    CHECK(times(&before) != (clock_t) -1, 1);
+    CHECK(getrusage(RUSAGE_SELF, &ru_before), 0);
+    burn_cpu();
+    CHECK(times(&after) != (clock_t) -1, 1);
+
+    /* the loop runs in user mode, so it must show up there */
+    CHECK(after.tms_utime > before.tms_utime, 1);
+
+    /*
+     * and in getrusage(), with every field where <sys/resource.h> has it:
+     * a sane tv_usec and nothing written past the end
+     */
+    memset(&r, 0x5a, sizeof(r));
+    CHECK(getrusage(RUSAGE_SELF, &r.ru), 0);
+    CHECK(r.guard == 0x5a5a5a5a, 1);
+    CHECK(r.ru.ru_utime.tv_usec >= 0 && r.ru.ru_utime.tv_usec < 1000000, 1);
+    CHECK(r.ru.ru_stime.tv_usec >= 0 && r.ru.ru_stime.tv_usec < 1000000, 1);
+    CHECK(r.ru.ru_utime.tv_sec > ru_before.ru_utime.tv_sec ||
+            (r.ru.ru_utime.tv_sec == ru_before.ru_utime.tv_sec &&
+             r.ru.ru_utime.tv_usec > ru_before.ru_utime.tv_usec), 1);
+    CHECK(r.ru.ru_maxrss, 0);
+    CHECK_ERR(getrusage(42, &r.ru), EINVAL);
+
+    /* a terminated child's time is added to ours */
+    if (fork() == 0) {
+        burn_cpu();
+        exit(0);
+    }
+
+    CHECK(wait(&status) > 0, 1);
+    CHECK(times(&after) != (clock_t) -1, 1);
+    CHECK(after.tms_cutime > before.tms_cutime, 1);
+
+    return 0;
+}
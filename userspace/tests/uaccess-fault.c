@@ -0,0 +1,46 @@
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <signal.h>
+#include <sys/errno.h>
+#include <sys/stat.h>
+#include <sys/time.h>
+
+#include "test.h"
+
+#define UNMAPPED ((void *) 0x11223344)
+#define BIGBUF (64 * 1024)
+
+int
+run_test()
+{
+    int rc, fds[2];
+    struct stat st;
+    char *buf;
+
+    /* bad pointers in either direction come back as EFAULT */
+    CHECK_ERR(stat("/", UNMAPPED), EFAULT);
+    CHECK_ERR(stat(UNMAPPED, &st), EFAULT);
+    CHECK_ERR(open(UNMAPPED, 0), EFAULT);
+    CHECK_ERR(gettimeofday(UNMAPPED, NULL), EFAULT);
+    CHECK_ERR(pipe(UNMAPPED), EFAULT);
+    CHECK_ERR(sigprocmask(SIG_BLOCK, NULL, UNMAPPED), EFAULT);
+
+    /* and the task lives on to use good ones */
+    CHECK(stat("/", &st), 0);
+    CHECK(pipe(fds), 0);
+
+    /* pages the task never touched get faulted in by the kernel */
+    buf = malloc(BIGBUF);
+    CHECK(buf != NULL, 1);
+    CHECK(write(fds[1], "levos", 5), 5);
+    CHECK(read(fds[0], buf + BIGBUF - 5, 5), 5);
+    CHECK(memcmp(buf + BIGBUF - 5, "levos", 5), 0);
+
+    CHECK(close(fds[0]), 0);
+    CHECK(close(fds[1]), 0);
+
+    return 0;
+}
@@ -0,0 +1,222 @@
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <unistd.h>
+#include <stdint.h>
+#include <fcntl.h>
+#include <sys/wait.h>
+#include <sys/errno.h>
+
+#include "test.h"
+
+/* newlib has no wrappers for these */
+#define SYS_IO_URING_SETUP 0x1a9
+#define SYS_IO_URING_ENTER 0x1aa
+
+/* see include/levos/io_uring.h */
+#define IORING_OP_NOP      0
+#define IORING_OP_FSYNC    3
+#define IORING_OP_POLL_ADD 6
+#define IORING_OP_READ     22
+#define IORING_OP_WRITE    23
+
+#define IORING_OFF_FPOS 0xFFFFFFFF
+
+#define IORING_ENTER_GETEVENTS 1
+
+#define POLLIN 0x0001
+
+struct io_uring_sqe {
+    uint8_t  opcode;
+    uint8_t  flags;
+    uint16_t ioprio;
+    int32_t  fd;
+    uint32_t off;
+    uint32_t addr;
+    uint32_t len;
+    uint32_t poll_events;
+    uint64_t user_data;
+};
+
+struct io_uring_cqe {
+    uint64_t user_data;
+    int32_t  res;
+    uint32_t flags;
+};
+
+#define ENTRIES 32
+
+struct sq_ring {
+    volatile uint32_t head;
+    volatile uint32_t tail;
+    uint32_t ring_mask;
+    uint32_t ring_entries;
+    struct io_uring_sqe sqes[ENTRIES];
+};
+
+struct cq_ring {
+    volatile uint32_t head;
+    volatile uint32_t tail;
+    uint32_t ring_mask;
+    uint32_t ring_entries;
+    struct io_uring_cqe cqes[2 * ENTRIES];
+};
+
+struct io_uring_params {
+    uint32_t sq_entries;
+    uint32_t cq_entries;
+    uint32_t flags;
+    uint32_t resv;
+    struct sq_ring *sq_ring;
+    struct cq_ring *cq_ring;
+};
+
+static struct sq_ring sq;
+static struct cq_ring cq;
+
+static void
+queue(int op, int fd, void *buf, uint32_t len, uint32_t off, uint64_t data)
+{
+    struct io_uring_sqe *sqe = &sq.sqes[sq.tail & sq.ring_mask];
+
+    memset(sqe, 0, sizeof(*sqe));
+    sqe->opcode = op;
+    sqe->fd = fd;
+    sqe->addr = (uint32_t) buf;
+    sqe->len = len;
+    sqe->off = off;
+    sqe->user_data = data;
+    sq.tail ++;
+}
+
+static struct io_uring_cqe *
+reap(void)
+{
+    if (cq.head == cq.tail)
+        return NULL;
+
+    return &cq.cqes[cq.head ++ & cq.ring_mask];
+}
+
+int
+run_test()
+{
+    struct io_uring_params p;
+    struct io_uring_cqe *cqe;
+    char buf[ENTRIES][4], rbuf[ENTRIES][4];
+    int rc, ring, fd, tty, i, p2[2], p3[2], status;
+    pid_t pid;
+
+    memset(&p, 0, sizeof(p));
+    p.sq_ring = &sq;
+    p.cq_ring = &cq;
+    CHECK_ERR(sys(SYS_IO_URING_SETUP, 3, (int) &p, 0, 0), EINVAL);
+
+    ring = sys(SYS_IO_URING_SETUP, ENTRIES, (int) &p, 0, 0);
+    CHECK(ring >= 0, 1);
+    CHECK(p.cq_entries, 2 * ENTRIES);
+    CHECK(sq.ring_entries, ENTRIES);
+    CHECK(cq.ring_mask, 2 * ENTRIES - 1);
+
+    fd = open("/uring-batch", O_CREAT | O_RDWR | O_TRUNC, 0644);
+    CHECK(fd >= 0, 1);
+
+    /* a whole ring of small writes, in one trap */
+    for (i = 0; i < ENTRIES; i ++) {
+        snprintf(buf[i], sizeof(buf[i]), "%03d", i);
+        queue(IORING_OP_WRITE, fd, buf[i], 3, i * 3, i);
+    }
+    CHECK(sys(SYS_IO_URING_ENTER, ring, ENTRIES, ENTRIES,
+              IORING_ENTER_GETEVENTS), ENTRIES);
+    CHECK(sq.head, ENTRIES);
+
+    for (i = 0; i < ENTRIES; i ++) {
+        cqe = reap();
+        CHECK(cqe != NULL, 1);
+        CHECK(cqe->res, 3);
+    }
+    CHECK(reap() == NULL, 1);
+
+    /* and read them back */
+    for (i = 0; i < ENTRIES - 1; i ++)
+        queue(IORING_OP_READ, fd, rbuf[i], 3, i * 3, i);
+    queue(IORING_OP_FSYNC, fd, NULL, 0, 0, 1000);
+    CHECK(sys(SYS_IO_URING_ENTER, ring, ENTRIES, ENTRIES,
+              IORING_ENTER_GETEVENTS), ENTRIES);
+
+    for (i = 0; i < ENTRIES; i ++) {
+        cqe = reap();
+        CHECK(cqe != NULL, 1);
+        if (cqe->user_data == 1000) {
+            CHECK(cqe->res, 0);
+            continue;
+        }
+        CHECK(cqe->res, 3);
+        CHECK(memcmp(rbuf[cqe->user_data], buf[cqe->user_data], 3), 0);
+    }
+
+    /* bad entries still complete, with the error */
+    queue(IORING_OP_NOP, -1, NULL, 0, 0, 1);
+    queue(IORING_OP_READ, 31, rbuf[0], 3, 0, 2);
+    queue(IORING_OP_READ, fd, (void *) 0xC0000000, 3, 0, 3);
+    CHECK(sys(SYS_IO_URING_ENTER, ring, 3, 3, IORING_ENTER_GETEVENTS), 3);
+    CHECK((cqe = reap()) && cqe->user_data == 1 && cqe->res == 0, 1);
+    CHECK((cqe = reap()) && cqe->user_data == 2 && cqe->res == -EBADF, 1);
+    CHECK((cqe = reap()) && cqe->user_data == 3 && cqe->res == -EFAULT, 1);
+
+    /* a read of an empty pipe waits for the writer, not in a worker */
+    CHECK(pipe(p2), 0);
+    queue(IORING_OP_POLL_ADD, p2[0], NULL, 0, 0, 1);
+    sq.sqes[(sq.tail - 1) & sq.ring_mask].poll_events = POLLIN;
+    queue(IORING_OP_READ, p2[0], rbuf[0], 4, IORING_OFF_FPOS, 2);
+    CHECK(sys(SYS_IO_URING_ENTER, ring, 2, 0, 0), 2);
+    CHECK(reap() == NULL, 1);
+
+    pid = fork();
+    if (pid == 0) {
+        sleep(1);
+        write(p2[1], "ping", 4);
+        exit(0);
+    }
+
+    CHECK(sys(SYS_IO_URING_ENTER, ring, 0, 2, IORING_ENTER_GETEVENTS), 0);
+    for (i = 0; i < 2; i ++) {
+        cqe = reap();
+        CHECK(cqe != NULL, 1);
+        if (cqe->user_data == 1) {
+            CHECK(cqe->res & POLLIN, POLLIN);
+        } else {
+            CHECK(cqe->res, 4);
+            CHECK(memcmp(rbuf[0], "ping", 4), 0);
+        }
+    }
+    CHECK(waitpid(pid, &status, 0), pid);
+
+    /* no SIGPIPE from the worker, the error is in the completion */
+    CHECK(pipe(p3), 0);
+    CHECK(close(p3[0]), 0);
+    queue(IORING_OP_WRITE, p3[1], "pong", 4, IORING_OFF_FPOS, 1);
+    CHECK(sys(SYS_IO_URING_ENTER, ring, 1, 1, IORING_ENTER_GETEVENTS), 1);
+    CHECK((cqe = reap()) && cqe->res == -EPIPE, 1);
+    CHECK(close(p3[1]), 0);
+
+    /* the worker has no terminal to stand in for /dev/tty */
+    tty = open("/dev/tty", O_RDWR);
+    if (tty >= 0) {
+        queue(IORING_OP_WRITE, tty, "x", 1, IORING_OFF_FPOS, 1);
+        CHECK(sys(SYS_IO_URING_ENTER, ring, 1, 1, IORING_ENTER_GETEVENTS), 1);
+        CHECK((cqe = reap()) && cqe->res == -EINVAL, 1);
+        CHECK(close(tty), 0);
+    }
+
+    /* closing the ring with a request still waiting */
+    queue(IORING_OP_READ, p2[0], rbuf[0], 4, IORING_OFF_FPOS, 1);
+    CHECK(sys(SYS_IO_URING_ENTER, ring, 1, 0, 0), 1);
+    CHECK(close(ring), 0);
+
+    CHECK(close(p2[0]), 0);
+    CHECK(close(p2[1]), 0);
+    CHECK(close(fd), 0);
+
+    return 0;
+}
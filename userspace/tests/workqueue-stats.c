@@ -0,0 +1,62 @@
+#include <stdlib.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <string.h>
+#include <sys/signal.h>
+#include <stdio.h>
+#include <errno.h>
+
+#include "test.h"
+
+static void
+alarm_tick(int sig)
+{
+}
+
+/* the runs of workqueue NAME in /proc/workqueues, -1 if it's not there */
+static int
+workqueue_runs(char *name)
+{
+    char buf[1024], *line;
+    char wq[32];
+    int fd, len, active, runs;
+
+    fd = open("/proc/workqueues", O_RDONLY);
+    if (fd < 0)
+        return -1;
+
+    len = read(fd, buf, sizeof(buf) - 1);
+    close(fd);
+    if (len <= 0)
+        return -1;
+    buf[len] = 0;
+
+    for (line = strtok(buf, "\n"); line; line = strtok(NULL, "\n")) {
+        if (sscanf(line, "%31s %d %d", wq, &active, &runs) != 3)
+            continue;
+
+        if (strcmp(wq, name) == 0)
+            return runs;
+    }
+
+    return -1;
+}
+
+int
+run_test()
+{
+    int rc, before;
+
+    before = workqueue_runs("events_highpri");
+    CHECK(before >= 0, 1);
+    CHECK(workqueue_runs("events") >= 0, 1);
+
+    /* alarms are delivered from the high priority workqueue */
+    CHECK((int) signal(SIGALRM, alarm_tick), (int) SIG_DFL);
+    CHECK(alarm(1), 0);
+    CHECK_ERR(sleep(10), EINTR);
+
+    CHECK(workqueue_runs("events_highpri") > before, 1);
+
+    test_success();
+}